@@ -0,0 +1,354 @@
+/*****************************************************************************
+ * Copyright (C) 2015 Jonas Lundqvist
+ *
+ * Author: Jonas Lundqvist <jonas@gannon.se>
+ *
+ * This file is part of vlc-spotify.
+ *
+ * vlc-spotify is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+// VLC includes
+#include <vlc_common.h>
+#include <vlc_messages.h>
+#include <vlc_threads.h>
+#include <vlc_input.h>
+#include <vlc_fs.h>
+#include <vlc_url.h>
+
+#include <libspotify/api.h>
+
+#include "session.h"
+#include "artcache.h"
+
+#ifndef _WIN32
+#define DIR_SEP "/"
+#else
+#define DIR_SEP "\\"
+#endif
+
+typedef struct art_waiter_t art_waiter_t;
+struct art_waiter_t {
+    input_item_t *p_item;
+    art_waiter_t *p_next;
+};
+
+// One per cover, however many items wait for it
+typedef struct art_entry_t art_entry_t;
+struct art_entry_t {
+    char          psz_id[41];
+    bool          b_inflight;
+    art_waiter_t *p_waiters;
+    art_entry_t  *p_next;
+
+    // Session thread only, while the fetch is in flight
+    sp_image     *p_image;
+    mtime_t       i_start;
+    art_entry_t  *p_next_inflight;
+};
+
+static struct {
+    // Never held while calling into libspotify or VLC
+    vlc_mutex_t   lock;
+    // In the order they were added, the ones in flight stay in the list
+    art_entry_t  *p_first;
+    art_entry_t **pp_last;
+    // While a session thread runs to fetch what is added
+    bool          b_open;
+
+    // Session thread only, the fetches that have been started
+    art_entry_t  *p_inflight;
+    int           i_inflight;
+} g_art = {
+    .lock = VLC_STATIC_MUTEX,
+    .p_first = NULL,
+    .pp_last = &g_art.p_first,
+};
+
+void art_image_id(const byte *p_id, char *psz_id)
+{
+    for (int i = 0; i < 20; i++)
+        sprintf(psz_id + 2 * i, "%02x", p_id[i]);
+}
+
+static bool parse_image_id(const char *psz_id, byte *p_id)
+{
+    for (int i = 0; i < 20; i++) {
+        unsigned u;
+        if (sscanf(psz_id + 2 * i, "%2x", &u) != 1)
+            return false;
+        p_id[i] = u;
+    }
+    return psz_id[40] == '\0';
+}
+
+static void art_path(const char *psz_id, char *psz_path, size_t i_size)
+{
+    snprintf(psz_path, i_size, "%s" DIR_SEP "%s.jpg", VLC_SPOTIFY_ART_DIR, psz_id);
+}
+
+char *art_cached_url(const char *psz_id)
+{
+    char        psz_path[256];
+    struct stat st;
+
+    art_path(psz_id, psz_path, sizeof(psz_path));
+    if (vlc_stat(psz_path, &st) != 0)
+        return NULL;
+    return vlc_path2uri(psz_path, "file");
+}
+
+static void delete_entry(art_entry_t *p_entry)
+{
+    while (p_entry->p_waiters != NULL) {
+        art_waiter_t *p_waiter = p_entry->p_waiters;
+        p_entry->p_waiters = p_waiter->p_next;
+        vlc_gc_decref(p_waiter->p_item);
+        free(p_waiter);
+    }
+    free(p_entry);
+}
+
+static void unlink_entry(art_entry_t **pp_entry)
+{
+    art_entry_t *p_entry = *pp_entry;
+
+    *pp_entry = p_entry->p_next;
+    if (g_art.pp_last == &p_entry->p_next)
+        g_art.pp_last = pp_entry;
+    p_entry->p_next = NULL;
+}
+
+void art_queue_add(input_item_t *p_item, const char *psz_id)
+{
+    char         *psz_url = art_cached_url(psz_id);
+    art_waiter_t *p_waiter;
+    art_entry_t  *p_entry;
+
+    if (psz_url != NULL) {
+        input_item_SetArtURL(p_item, psz_url);
+        free(psz_url);
+        return;
+    }
+
+    p_waiter = malloc(sizeof(*p_waiter));
+    if (unlikely(p_waiter == NULL))
+        return;
+    vlc_gc_incref(p_item);
+    p_waiter->p_item = p_item;
+
+    vlc_mutex_lock(&g_art.lock);
+    // No session to fetch it, the item gets its art when it is looked up
+    // in one
+    if (!g_art.b_open) {
+        vlc_mutex_unlock(&g_art.lock);
+        vlc_gc_decref(p_item);
+        free(p_waiter);
+        return;
+    }
+    for (p_entry = g_art.p_first; p_entry != NULL; p_entry = p_entry->p_next)
+        if (strcmp(p_entry->psz_id, psz_id) == 0)
+            break;
+
+    if (p_entry == NULL) {
+        p_entry = calloc(1, sizeof(*p_entry));
+        if (unlikely(p_entry == NULL)) {
+            vlc_mutex_unlock(&g_art.lock);
+            vlc_gc_decref(p_item);
+            free(p_waiter);
+            return;
+        }
+        snprintf(p_entry->psz_id, sizeof(p_entry->psz_id), "%s", psz_id);
+        *g_art.pp_last = p_entry;
+        g_art.pp_last = &p_entry->p_next;
+    }
+    p_waiter->p_next = p_entry->p_waiters;
+    p_entry->p_waiters = p_waiter;
+    // Before the unlock, the session thread can not have flushed the queue
+    // and closed its wakeup since
+    spotify_session_notify();
+    vlc_mutex_unlock(&g_art.lock);
+}
+
+// Session thread. Written to a temporary file first, so that nobody sees a
+// cover that is half written.
+static char *store_image(vlc_object_t *p_obj, const char *psz_id,
+                         const void *p_data, size_t i_size)
+{
+    char  psz_path[256];
+    char  psz_tmp[264];
+    FILE *p_file;
+    bool  b_ok;
+
+    vlc_mkdir(VLC_SPOTIFY_ART_DIR, 0700);
+
+    art_path(psz_id, psz_path, sizeof(psz_path));
+    snprintf(psz_tmp, sizeof(psz_tmp), "%s.tmp", psz_path);
+
+    p_file = vlc_fopen(psz_tmp, "wb");
+    if (p_file == NULL) {
+        msg_Warn(p_obj, "Failed to create %s", psz_tmp);
+        return NULL;
+    }
+    b_ok = fwrite(p_data, 1, i_size, p_file) == i_size;
+    b_ok = fclose(p_file) == 0 && b_ok;
+    if (!b_ok || vlc_rename(psz_tmp, psz_path) != 0) {
+        msg_Warn(p_obj, "Failed to store the cover %s", psz_path);
+        vlc_unlink(psz_tmp);
+        return NULL;
+    }
+
+    return vlc_path2uri(psz_path, "file");
+}
+
+// Session thread, without the lock. The fetch is over, whether the cover
+// loaded or not.
+static void finish_fetch(vlc_object_t *p_obj, art_entry_t *p_entry)
+{
+    char *psz_url = NULL;
+
+    if (!sp_image_is_loaded(p_entry->p_image)) {
+        msg_Warn(p_obj, "Giving up on the cover %s, still loading", p_entry->psz_id);
+    } else if (sp_image_error(p_entry->p_image) == SP_ERROR_OK) {
+        size_t      i_size;
+        const void *p_data = sp_image_data(p_entry->p_image, &i_size);
+        psz_url = store_image(p_obj, p_entry->psz_id, p_data, i_size);
+    } else {
+        msg_Dbg(p_obj, "No cover %s: %s", p_entry->psz_id,
+                sp_error_message(sp_image_error(p_entry->p_image)));
+    }
+    sp_image_release(p_entry->p_image);
+
+    // Nobody adds waiters to it any more
+    if (psz_url != NULL) {
+        for (art_waiter_t *p_waiter = p_entry->p_waiters; p_waiter != NULL;
+             p_waiter = p_waiter->p_next)
+            input_item_SetArtURL(p_waiter->p_item, psz_url);
+        free(psz_url);
+    }
+    delete_entry(p_entry);
+}
+
+// With the lock held
+static void remove_entry(art_entry_t *p_entry)
+{
+    art_entry_t **pp_entry = &g_art.p_first;
+
+    while (*pp_entry != p_entry)
+        pp_entry = &(*pp_entry)->p_next;
+    unlink_entry(pp_entry);
+}
+
+void art_queue_process(vlc_object_t *p_obj, sp_session *p_session)
+{
+    art_entry_t  *p_done = NULL;
+    art_entry_t  *p_start = NULL;
+    art_entry_t **pp_entry;
+    mtime_t       now = mdate();
+
+    // Only this thread touches the fetches in flight, and their images
+    pp_entry = &g_art.p_inflight;
+    while (*pp_entry != NULL) {
+        art_entry_t *p_entry = *pp_entry;
+
+        if (sp_image_is_loaded(p_entry->p_image) ||
+            now >= p_entry->i_start + ART_QUEUE_TIMEOUT_US) {
+            *pp_entry = p_entry->p_next_inflight;
+            p_entry->p_next_inflight = p_done;
+            p_done = p_entry;
+            g_art.i_inflight--;
+        } else {
+            pp_entry = &p_entry->p_next_inflight;
+        }
+    }
+
+    vlc_mutex_lock(&g_art.lock);
+    for (art_entry_t *p_entry = p_done; p_entry != NULL; p_entry = p_entry->p_next_inflight)
+        remove_entry(p_entry);
+    // Oldest first
+    for (art_entry_t *p_entry = g_art.p_first;
+         p_entry != NULL && g_art.i_inflight < ART_QUEUE_MAX_INFLIGHT;
+         p_entry = p_entry->p_next) {
+        if (p_entry->b_inflight)
+            continue;
+        p_entry->b_inflight = true;
+        p_entry->p_next_inflight = p_start;
+        p_start = p_entry;
+        g_art.i_inflight++;
+    }
+    vlc_mutex_unlock(&g_art.lock);
+
+    while (p_start != NULL) {
+        art_entry_t *p_entry = p_start;
+        byte         id[20];
+
+        p_start = p_entry->p_next_inflight;
+        if (parse_image_id(p_entry->psz_id, id))
+            p_entry->p_image = sp_image_create(p_session, id);
+        if (p_entry->p_image == NULL) {
+            vlc_mutex_lock(&g_art.lock);
+            remove_entry(p_entry);
+            vlc_mutex_unlock(&g_art.lock);
+            g_art.i_inflight--;
+            delete_entry(p_entry);
+            continue;
+        }
+        p_entry->i_start = now;
+        p_entry->p_next_inflight = g_art.p_inflight;
+        g_art.p_inflight = p_entry;
+    }
+
+    while (p_done != NULL) {
+        art_entry_t *p_entry = p_done;
+
+        p_done = p_entry->p_next_inflight;
+        finish_fetch(p_obj, p_entry);
+    }
+}
+
+void art_queue_flush(void)
+{
+    art_entry_t *p_entry;
+
+    vlc_mutex_lock(&g_art.lock);
+    p_entry = g_art.p_first;
+    g_art.p_first = NULL;
+    g_art.pp_last = &g_art.p_first;
+    // Until the next session
+    g_art.b_open = false;
+    vlc_mutex_unlock(&g_art.lock);
+
+    g_art.p_inflight = NULL;
+    g_art.i_inflight = 0;
+    while (p_entry != NULL) {
+        art_entry_t *p_next = p_entry->p_next;
+        if (p_entry->p_image != NULL)
+            sp_image_release(p_entry->p_image);
+        delete_entry(p_entry);
+        p_entry = p_next;
+    }
+}
+
+void art_queue_open(void)
+{
+    vlc_mutex_lock(&g_art.lock);
+    g_art.b_open = true;
+    vlc_mutex_unlock(&g_art.lock);
+}
@@ -0,0 +1,61 @@
+/*****************************************************************************
+ * Copyright (C) 2015 Jonas Lundqvist
+ *
+ * Author: Jonas Lundqvist <jonas@gannon.se>
+ *
+ * This file is part of vlc-spotify.
+ *
+ * vlc-spotify is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+// Album covers.
+//
+// Fetched with sp_image_create() by the session thread after the items are
+// posted, and stored in VLC_SPOTIFY_ART_DIR as <image id>.jpg. The items
+// get a file:// art URL once their cover is there. All the tracks of an
+// album share the cover, so it is only fetched and stored once.
+
+#ifndef _WIN32
+#define VLC_SPOTIFY_ART_DIR "/tmp/vlc-spotify/art"
+#else
+#define VLC_SPOTIFY_ART_DIR "C:\\temp\\vlc-spotify\\art"
+#endif
+
+#define ART_QUEUE_MAX_INFLIGHT 2
+// A cover still loading after this long is given up on
+#define ART_QUEUE_TIMEOUT_US (10 * CLOCK_FREQ)
+
+// The 20 bytes of an image id as 40 hex digits, psz_id has room for 41
+void art_image_id(const byte *p_id, char *psz_id);
+
+// Any thread. The file:// URL of the cover psz_id if it is stored, or NULL.
+// To be freed.
+char *art_cached_url(const char *psz_id);
+
+// Any thread. Set the art of the item once the cover psz_id is stored,
+// right away if it already is. Only fetched while a session is running,
+// between art_queue_open() and art_queue_flush().
+void art_queue_add(input_item_t *p_item, const char *psz_id);
+
+// Session thread. Start and finish fetches, called after each
+// sp_session_process_events().
+void art_queue_process(vlc_object_t *p_obj, sp_session *p_session);
+
+// Session thread. Start taking covers to fetch, when the thread starts.
+void art_queue_open(void);
+
+// Session thread. Drop everything and stop taking covers, before the
+// session is released.
+void art_queue_flush(void);
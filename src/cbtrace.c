@@ -0,0 +1,276 @@
+/*****************************************************************************
+ * Copyright (C) 2015 Jonas Lundqvist
+ *
+ * Author: Jonas Lundqvist <jonas@gannon.se>
+ *
+ * This file is part of vlc-spotify.
+ *
+ * vlc-spotify is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "cbtrace.h"
+
+// A record without its audio is at most this long
+#define CBTRACE_MAX_RECORD (1 + 6 * 10)
+
+struct cbtrace_t {
+    pthread_mutex_t  lock;
+    FILE            *p_file;
+    bool             b_audio;
+    bool             b_failed;
+    int64_t          i_start;
+    int64_t          i_last;
+};
+
+struct cbtrace_reader_t {
+    FILE            *p_file;
+    bool             b_audio;
+    int64_t          i_time;
+    int16_t         *p_frames;
+    size_t           i_frames_size;
+};
+
+static int64_t now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static uint8_t *put_uint(uint8_t *p, uint64_t i_value)
+{
+    while (i_value >= 0x80) {
+        *p++ = (i_value & 0x7f) | 0x80;
+        i_value >>= 7;
+    }
+    *p++ = i_value;
+    return p;
+}
+
+static int get_uint(FILE *p_file, uint64_t *pi_value)
+{
+    uint64_t i_value = 0;
+    int      c;
+
+    for (int i_shift = 0; i_shift < 64; i_shift += 7) {
+        if ((c = getc(p_file)) == EOF)
+            return -1;
+        i_value |= (uint64_t) (c & 0x7f) << i_shift;
+        if ((c & 0x80) == 0) {
+            *pi_value = i_value;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+cbtrace_t *cbtrace_create(const char *psz_path, bool b_audio)
+{
+    cbtrace_t *p_trace = calloc(1, sizeof(*p_trace));
+
+    if (p_trace == NULL)
+        return NULL;
+
+    p_trace->p_file = fopen(psz_path, "wb");
+    if (p_trace->p_file == NULL) {
+        free(p_trace);
+        return NULL;
+    }
+
+    fwrite(CBTRACE_MAGIC, 1, strlen(CBTRACE_MAGIC), p_trace->p_file);
+    putc(b_audio ? CBTRACE_AUDIO : 0, p_trace->p_file);
+
+    pthread_mutex_init(&p_trace->lock, NULL);
+    p_trace->b_audio = b_audio;
+    p_trace->i_start = p_trace->i_last = now_us();
+    return p_trace;
+}
+
+void cbtrace_record(cbtrace_t *p_trace, const cbtrace_event_t *p_event)
+{
+    uint8_t  record[CBTRACE_MAX_RECORD];
+    uint8_t *p = record;
+    int64_t  i_now;
+    size_t   i_audio = 0;
+
+    pthread_mutex_lock(&p_trace->lock);
+    if (p_trace->b_failed) {
+        pthread_mutex_unlock(&p_trace->lock);
+        return;
+    }
+
+    // Taken under the lock so that the times never go backwards
+    i_now = now_us();
+    *p++ = p_event->type;
+    p = put_uint(p, i_now - p_trace->i_last);
+    p_trace->i_last = i_now;
+
+    switch (p_event->type) {
+    case CBTRACE_MUSIC_DELIVERY:
+        p = put_uint(p, p_event->i_rate);
+        p = put_uint(p, p_event->i_channels);
+        p = put_uint(p, p_event->i_frames);
+        p = put_uint(p, p_event->i_consumed);
+        if (p_trace->b_audio)
+            i_audio = (size_t) p_event->i_frames * p_event->i_channels * sizeof(int16_t);
+        break;
+    case CBTRACE_CONNECTION:
+        p = put_uint(p, p_event->i_state);
+        // Fall through
+    case CBTRACE_LOGGED_IN:
+    case CBTRACE_PLAY:
+    case CBTRACE_SEEK:
+        p = put_uint(p, p_event->i_value);
+        break;
+    default:
+        break;
+    }
+
+    if (fwrite(record, 1, p - record, p_trace->p_file) != (size_t) (p - record) ||
+        (i_audio > 0 && fwrite(p_event->p_frames, 1, i_audio, p_trace->p_file) != i_audio))
+        p_trace->b_failed = true;
+    pthread_mutex_unlock(&p_trace->lock);
+}
+
+void cbtrace_close(cbtrace_t *p_trace)
+{
+    if (p_trace == NULL)
+        return;
+
+    fclose(p_trace->p_file);
+    pthread_mutex_destroy(&p_trace->lock);
+    free(p_trace);
+}
+
+cbtrace_reader_t *cbtrace_open(const char *psz_path)
+{
+    cbtrace_reader_t *p_reader = calloc(1, sizeof(*p_reader));
+    char              magic[sizeof(CBTRACE_MAGIC) - 1];
+    int               i_flags;
+
+    if (p_reader == NULL)
+        return NULL;
+
+    p_reader->p_file = fopen(psz_path, "rb");
+    if (p_reader->p_file == NULL) {
+        free(p_reader);
+        return NULL;
+    }
+
+    if (fread(magic, 1, sizeof(magic), p_reader->p_file) != sizeof(magic) ||
+        memcmp(magic, CBTRACE_MAGIC, sizeof(magic)) ||
+        (i_flags = getc(p_reader->p_file)) == EOF) {
+        cbtrace_reader_close(p_reader);
+        return NULL;
+    }
+
+    p_reader->b_audio = i_flags & CBTRACE_AUDIO;
+    return p_reader;
+}
+
+bool cbtrace_has_audio(cbtrace_reader_t *p_reader)
+{
+    return p_reader->b_audio;
+}
+
+int cbtrace_read(cbtrace_reader_t *p_reader, cbtrace_event_t *p_event)
+{
+    FILE    *p_file = p_reader->p_file;
+    uint64_t i_delta, i_values[4] = { 0, 0, 0, 0 };
+    int      i_count = 0;
+    int      c;
+
+    if ((c = getc(p_file)) == EOF)
+        return 0;
+
+    memset(p_event, 0, sizeof(*p_event));
+    p_event->type = c;
+
+    switch (p_event->type) {
+    case CBTRACE_MUSIC_DELIVERY:
+        i_count = 4;
+        break;
+    case CBTRACE_CONNECTION:
+        i_count = 2;
+        break;
+    case CBTRACE_LOGGED_IN:
+    case CBTRACE_PLAY:
+    case CBTRACE_SEEK:
+        i_count = 1;
+        break;
+    case CBTRACE_METADATA_UPDATED:
+    case CBTRACE_END_OF_TRACK:
+    case CBTRACE_PLAY_TOKEN_LOST:
+    case CBTRACE_NOTIFY_MAIN_THREAD:
+        break;
+    default:
+        return -1;
+    }
+
+    if (get_uint(p_file, &i_delta))
+        return -1;
+    for (int i = 0; i < i_count; i++)
+        if (get_uint(p_file, &i_values[i]) || i_values[i] > UINT32_MAX)
+            return -1;
+
+    p_reader->i_time += i_delta;
+    p_event->i_time = p_reader->i_time;
+
+    if (p_event->type == CBTRACE_MUSIC_DELIVERY) {
+        p_event->i_rate = i_values[0];
+        p_event->i_channels = i_values[1];
+        p_event->i_frames = i_values[2];
+        p_event->i_consumed = i_values[3];
+
+        if (p_reader->b_audio) {
+            size_t i_size = (size_t) p_event->i_frames * p_event->i_channels * sizeof(int16_t);
+
+            if (i_size > p_reader->i_frames_size) {
+                int16_t *p_frames = realloc(p_reader->p_frames, i_size);
+                if (p_frames == NULL)
+                    return -1;
+                p_reader->p_frames = p_frames;
+                p_reader->i_frames_size = i_size;
+            }
+            if (fread(p_reader->p_frames, 1, i_size, p_file) != i_size)
+                return -1;
+            p_event->p_frames = p_reader->p_frames;
+        }
+    } else if (p_event->type == CBTRACE_CONNECTION) {
+        p_event->i_state = i_values[0];
+        p_event->i_value = i_values[1];
+    } else {
+        p_event->i_value = i_values[0];
+    }
+
+    return 1;
+}
+
+void cbtrace_reader_close(cbtrace_reader_t *p_reader)
+{
+    if (p_reader == NULL)
+        return;
+
+    fclose(p_reader->p_file);
+    free(p_reader->p_frames);
+    free(p_reader);
+}
@@ -0,0 +1,80 @@
+/*****************************************************************************
+ * Copyright (C) 2015 Jonas Lundqvist
+ *
+ * Author: Jonas Lundqvist <jonas@gannon.se>
+ *
+ * This file is part of vlc-spotify.
+ *
+ * vlc-spotify is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+// Traces of the libspotify callbacks as the session saw them.
+//
+// With the spotify-trace option the session writes every callback, with
+// when it happened and, for deliveries, the format, the number of frames
+// and how many of them the plugin took. The audio itself is optional. The
+// libspotify stand-in in tests/ replays such a trace to the plugin, so that
+// the timing of a real session can be reproduced offline.
+//
+// The file is a header followed by records of a type byte, the time since
+// the previous record in us and the fields of the type, all numbers but
+// the type as unsigned LEB128. The audio of a delivery, if recorded, is
+// the frames as given (S16N) right after the record.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define CBTRACE_MAGIC   "VLCSPTR1"
+#define CBTRACE_AUDIO   0x1         // Deliveries carry their frames
+
+typedef enum {
+    CBTRACE_LOGGED_IN = 1,          // i_value: sp_error
+    CBTRACE_METADATA_UPDATED,
+    CBTRACE_MUSIC_DELIVERY,         // i_rate, i_channels, i_frames, i_consumed
+    CBTRACE_END_OF_TRACK,
+    CBTRACE_PLAY_TOKEN_LOST,
+    CBTRACE_CONNECTION,             // i_state: sp_connectionstate, i_value: sp_error
+    CBTRACE_NOTIFY_MAIN_THREAD,
+    CBTRACE_PLAY,                   // i_value: play (1) or pause (0)
+    CBTRACE_SEEK,                   // i_value: offset in ms
+} cbtrace_type_e;
+
+typedef struct {
+    cbtrace_type_e  type;
+    int64_t         i_time;         // us since the trace was created
+    unsigned        i_rate;
+    unsigned        i_channels;
+    unsigned        i_frames;
+    unsigned        i_consumed;
+    unsigned        i_state;
+    unsigned        i_value;
+    const int16_t  *p_frames;       // Deliveries, NULL if not recorded
+} cbtrace_event_t;
+
+typedef struct cbtrace_t cbtrace_t;
+typedef struct cbtrace_reader_t cbtrace_reader_t;
+
+// Writer. Safe to call from any thread, i_time is set by cbtrace_record().
+// After a write error nothing more is recorded.
+cbtrace_t *cbtrace_create(const char *psz_path, bool b_audio);
+void cbtrace_record(cbtrace_t *p_trace, const cbtrace_event_t *p_event);
+void cbtrace_close(cbtrace_t *p_trace);
+
+// Reader. cbtrace_read() returns 1 with the next event, 0 at the end and -1
+// if the trace is damaged. p_frames is valid until the next read.
+cbtrace_reader_t *cbtrace_open(const char *psz_path);
+bool cbtrace_has_audio(cbtrace_reader_t *p_reader);
+int cbtrace_read(cbtrace_reader_t *p_reader, cbtrace_event_t *p_event);
+void cbtrace_reader_close(cbtrace_reader_t *p_reader);
@@ -0,0 +1,147 @@
+/*****************************************************************************
+ * Copyright (C) 2015 Jonas Lundqvist
+ *
+ * Author: Jonas Lundqvist <jonas@gannon.se>
+ *
+ * This file is part of vlc-spotify.
+ *
+ * vlc-spotify is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "exportfmt.h"
+
+static void json_string(FILE *p_file, const char *psz)
+{
+    if (psz == NULL) {
+        fputs("null", p_file);
+        return;
+    }
+
+    fputc('"', p_file);
+    for (; *psz != '\0'; psz++) {
+        unsigned char c = *psz;
+
+        if (c == '"' || c == '\\')
+            fprintf(p_file, "\\%c", c);
+        else if (c == '\n')
+            fputs("\\n", p_file);
+        else if (c == '\t')
+            fputs("\\t", p_file);
+        else if (c < 0x20)
+            fprintf(p_file, "\\u%04x", c);
+        else
+            fputc(c, p_file);   // UTF-8 as is
+    }
+    fputc('"', p_file);
+}
+
+// M3U is line based, a name must stay on one line
+static void m3u_string(FILE *p_file, const char *psz)
+{
+    for (; psz != NULL && *psz != '\0'; psz++)
+        fputc(*psz == '\n' || *psz == '\r' ? ' ' : *psz, p_file);
+}
+
+void export_header(FILE *p_file, export_format_e format)
+{
+    if (format == EXPORT_M3U)
+        fputs("#EXTM3U\n", p_file);
+}
+
+void export_entry(FILE *p_file, export_format_e format, const export_entry_t *p_entry)
+{
+    if (format == EXPORT_M3U) {
+        if (p_entry->psz_error != NULL) {
+            fputs("# ", p_file);
+            m3u_string(p_file, p_entry->psz_input);
+            fputs(": ", p_file);
+            m3u_string(p_file, p_entry->psz_error);
+            fputc('\n', p_file);
+            return;
+        }
+
+        // Whole seconds, rounded up so that no track is 0 s long
+        fprintf(p_file, "#EXTINF:%d,", (p_entry->i_duration_ms + 999) / 1000);
+        if (p_entry->psz_artist != NULL) {
+            m3u_string(p_file, p_entry->psz_artist);
+            fputs(" - ", p_file);
+        }
+        m3u_string(p_file, p_entry->psz_title);
+        fprintf(p_file, "\nspotify://%s\n", p_entry->psz_uri);
+        return;
+    }
+
+    fputs("{\"input\":", p_file);
+    json_string(p_file, p_entry->psz_input);
+    if (p_entry->psz_error != NULL) {
+        fputs(",\"error\":", p_file);
+        json_string(p_file, p_entry->psz_error);
+    } else {
+        fputs(",\"uri\":", p_file);
+        json_string(p_file, p_entry->psz_uri);
+        fputs(",\"title\":", p_file);
+        json_string(p_file, p_entry->psz_title);
+        fputs(",\"artist\":", p_file);
+        json_string(p_file, p_entry->psz_artist);
+        fputs(",\"album\":", p_file);
+        json_string(p_file, p_entry->psz_album);
+        fprintf(p_file, ",\"duration_ms\":%d", p_entry->i_duration_ms);
+    }
+    fputs("}\n", p_file);
+}
+
+int export_progress_read(const char *psz_path, export_progress_t *p_progress)
+{
+    FILE *p_file = fopen(psz_path, "r");
+    int   i_ret = -1;
+
+    if (p_file == NULL)
+        return -1;
+    if (fscanf(p_file, "%ld %ld", &p_progress->i_done, &p_progress->i_offset) == 2 &&
+        p_progress->i_done >= 0 && p_progress->i_offset >= 0)
+        i_ret = 0;
+    fclose(p_file);
+    return i_ret;
+}
+
+int export_progress_write(const char *psz_path, const export_progress_t *p_progress)
+{
+    size_t i_len = strlen(psz_path) + sizeof(".tmp");
+    char  *psz_tmp = malloc(i_len);
+    FILE  *p_file;
+    int    i_ret = -1;
+
+    if (psz_tmp == NULL)
+        return -1;
+    snprintf(psz_tmp, i_len, "%s.tmp", psz_path);
+
+    // Replaced in one go, an interrupted write leaves the old count
+    p_file = fopen(psz_tmp, "w");
+    if (p_file != NULL) {
+        int i_err = fprintf(p_file, "%ld %ld\n", p_progress->i_done, p_progress->i_offset) < 0;
+        i_err |= fclose(p_file) != 0;
+        if (!i_err && rename(psz_tmp, psz_path) == 0)
+            i_ret = 0;
+        else
+            remove(psz_tmp);
+    }
+
+    free(psz_tmp);
+    return i_ret;
+}
@@ -0,0 +1,57 @@
+/*****************************************************************************
+ * Copyright (C) 2015 Jonas Lundqvist
+ *
+ * Author: Jonas Lundqvist <jonas@gannon.se>
+ *
+ * This file is part of vlc-spotify.
+ *
+ * vlc-spotify is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+// Output of vlc-spotify-export: M3U or JSON lines, and the progress file
+// that lets an interrupted export be resumed.
+
+#include <stdio.h>
+
+typedef enum {
+    EXPORT_M3U,
+    EXPORT_JSON,    // One object per line
+} export_format_e;
+
+typedef struct {
+    const char *psz_input;      // As given, before parsing
+    const char *psz_uri;        // spotify:track:...
+    const char *psz_title;
+    const char *psz_artist;
+    const char *psz_album;
+    int         i_duration_ms;
+    const char *psz_error;      // Set if the input could not be resolved
+} export_entry_t;
+
+// Written once at the start of a new output
+void export_header(FILE *p_file, export_format_e format);
+void export_entry(FILE *p_file, export_format_e format, const export_entry_t *p_entry);
+
+// How far an export has got: the number of inputs that have been written
+// completely, and the size of the output at that point. Anything after it
+// is from inputs that were not finished. The read returns -1 if there is
+// no progress file.
+typedef struct {
+    long i_done;
+    long i_offset;
+} export_progress_t;
+
+int export_progress_read(const char *psz_path, export_progress_t *p_progress);
+int export_progress_write(const char *psz_path, const export_progress_t *p_progress);
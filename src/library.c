@@ -0,0 +1,451 @@
+/*****************************************************************************
+ * Copyright (C) 2015 Jonas Lundqvist
+ *
+ * Author: Jonas Lundqvist <jonas@gannon.se>
+ *
+ * This file is part of vlc-spotify.
+ *
+ * vlc-spotify is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// VLC includes
+#include <vlc_common.h>
+#include <vlc_messages.h>
+#include <vlc_threads.h>
+#include <vlc_input.h>
+
+#include <libspotify/api.h>
+
+#include "session.h"
+#include "library.h"
+#include "membudget.h"
+
+#define LIBRARY_PLAYLISTS_IN_RAM_MAX 64
+// What libspotify keeps in RAM per track of a playlist, roughly, charged
+// to the memory budget for the playlists that are kept
+#define LIBRARY_TRACK_BYTES 512
+
+typedef struct library_request_t library_request_t;
+struct library_request_t {
+    const library_client_t *p_client;   // NULL once cancelled
+    char                   *psz_uri;    // NULL for the top level
+    mtime_t                 i_since;    // When the container was first seen loaded
+    sp_playlist            *p_playlist; // Created, loading
+    bool                    b_failed;   // Not a playlist
+    library_request_t      *p_next;
+};
+
+static struct {
+    // Not held while calling the clients
+    vlc_mutex_t         lock;
+    vlc_cond_t          wait;
+    library_request_t  *p_first;
+    // Whose callback is running
+    const library_client_t *p_calling;
+
+    // Playlists that were read, kept in RAM, the most recently read first.
+    // One reference each.
+    struct {
+        sp_playlist    *p_playlist;
+        size_t          i_bytes;    // Charged to the memory budget
+    } kept[LIBRARY_PLAYLISTS_IN_RAM_MAX];
+    int                 i_kept;
+} g_library = {
+    .lock = VLC_STATIC_MUTEX,
+    .wait = VLC_STATIC_COND,
+};
+
+int library_read(const char *psz_uri, const library_client_t *p_client)
+{
+    library_request_t  *p_request = calloc(1, sizeof(*p_request));
+    library_request_t **pp_last;
+
+    if (unlikely(p_request == NULL))
+        return VLC_ENOMEM;
+    if (psz_uri != NULL && (p_request->psz_uri = strdup(psz_uri)) == NULL) {
+        free(p_request);
+        return VLC_ENOMEM;
+    }
+    p_request->p_client = p_client;
+
+    vlc_mutex_lock(&g_library.lock);
+    for (pp_last = &g_library.p_first; *pp_last != NULL; pp_last = &(*pp_last)->p_next);
+    *pp_last = p_request;
+    vlc_mutex_unlock(&g_library.lock);
+
+    spotify_session_notify();
+    return VLC_SUCCESS;
+}
+
+void library_cancel(const library_client_t *p_client)
+{
+    vlc_mutex_lock(&g_library.lock);
+    // Left for the session thread to release the playlists and free
+    for (library_request_t *p_request = g_library.p_first; p_request != NULL;
+         p_request = p_request->p_next)
+        if (p_request->p_client == p_client)
+            p_request->p_client = NULL;
+    while (g_library.p_calling == p_client)
+        vlc_cond_wait(&g_library.wait, &g_library.lock);
+    vlc_mutex_unlock(&g_library.lock);
+}
+
+// With the lock held. Whether the playlist is kept or still being loaded
+// for a request, and so should stay in RAM.
+static bool playlist_wanted(sp_playlist *p_playlist)
+{
+    for (int i = 0; i < g_library.i_kept; i++)
+        if (g_library.kept[i].p_playlist == p_playlist)
+            return true;
+    for (library_request_t *p_request = g_library.p_first; p_request != NULL;
+         p_request = p_request->p_next)
+        if (p_request->p_playlist == p_playlist)
+            return true;
+    return false;
+}
+
+// With the lock held, the reference is taken over
+static void playlist_drop(sp_session *p_session, sp_playlist *p_playlist)
+{
+    if (!playlist_wanted(p_playlist))
+        sp_playlist_set_in_ram(p_session, p_playlist, false);
+    sp_playlist_release(p_playlist);
+}
+
+// With the lock held. The least recently read playlist is no longer kept.
+static void playlist_unkeep_oldest(sp_session *p_session)
+{
+    g_library.i_kept--;
+    membudget_release(MEMBUDGET_PLAYLISTS, g_library.kept[g_library.i_kept].i_bytes);
+    playlist_drop(p_session, g_library.kept[g_library.i_kept].p_playlist);
+}
+
+// With the lock held, the reference is taken over. Keeps the playlist that
+// was just read in RAM, and unloads the least recently read ones beyond
+// i_max, or while the playlists are what is over the memory budget. The
+// one just read stays, it is about to be used.
+static void playlist_keep(sp_session *p_session, sp_playlist *p_playlist, int i_max)
+{
+    size_t i_bytes;
+    int i;
+
+    for (i = 0; i < g_library.i_kept && g_library.kept[i].p_playlist != p_playlist; i++);
+    if (i < g_library.i_kept) {
+        // Already kept, it only moves to the front
+        sp_playlist_release(p_playlist);
+        membudget_release(MEMBUDGET_PLAYLISTS, g_library.kept[i].i_bytes);
+    } else {
+        if (g_library.i_kept == LIBRARY_PLAYLISTS_IN_RAM_MAX)
+            playlist_unkeep_oldest(p_session);
+        i = g_library.i_kept++;
+    }
+    memmove(&g_library.kept[1], &g_library.kept[0], i * sizeof(g_library.kept[0]));
+    // Charged again, the playlist may have changed since
+    i_bytes = (size_t) sp_playlist_num_tracks(p_playlist) * LIBRARY_TRACK_BYTES;
+    membudget_charge(MEMBUDGET_PLAYLISTS, i_bytes);
+    g_library.kept[0].p_playlist = p_playlist;
+    g_library.kept[0].i_bytes = i_bytes;
+
+    while (g_library.i_kept > i_max ||
+           (g_library.i_kept > 1 && membudget_over_by(MEMBUDGET_PLAYLISTS)))
+        playlist_unkeep_oldest(p_session);
+}
+
+// The index of the first entry of the folder, or of the top level for 0.
+// -1 if there is no such folder.
+static int folder_start(sp_playlistcontainer *p_container, uint64_t i_folder)
+{
+    int i_count = sp_playlistcontainer_num_playlists(p_container);
+
+    if (i_folder == 0)
+        return 0;
+    for (int i = 0; i < i_count; i++)
+        if (sp_playlistcontainer_playlist_type(p_container, i) == SP_PLAYLIST_TYPE_START_FOLDER &&
+            sp_playlistcontainer_playlist_folder_id(p_container, i) == i_folder)
+            return i + 1;
+    return -1;
+}
+
+// Whether i is an entry of the folder being gone through, false at its end
+static bool is_entry(sp_playlistcontainer *p_container, int i)
+{
+    return i < sp_playlistcontainer_num_playlists(p_container) &&
+           sp_playlistcontainer_playlist_type(p_container, i) != SP_PLAYLIST_TYPE_END_FOLDER;
+}
+
+// The index after the entry i, past the whole subfolder if it starts one
+static int skip_entry(sp_playlistcontainer *p_container, int i)
+{
+    int i_count = sp_playlistcontainer_num_playlists(p_container);
+    int i_depth = 0;
+
+    do {
+        sp_playlist_type type = sp_playlistcontainer_playlist_type(p_container, i);
+        if (type == SP_PLAYLIST_TYPE_START_FOLDER)
+            i_depth++;
+        else if (type == SP_PLAYLIST_TYPE_END_FOLDER)
+            i_depth--;
+        i++;
+    } while (i_depth > 0 && i < i_count);
+    return i;
+}
+
+static bool names_loaded(sp_playlistcontainer *p_container, int i_start)
+{
+    for (int i = i_start; is_entry(p_container, i); i = skip_entry(p_container, i))
+        if (sp_playlistcontainer_playlist_type(p_container, i) == SP_PLAYLIST_TYPE_PLAYLIST &&
+            !sp_playlist_is_loaded(sp_playlistcontainer_playlist(p_container, i)))
+            return false;
+    return true;
+}
+
+// Session thread. The items of the folder starting at i_start, with the
+// starred tracks first at the top level. -1 if out of memory.
+static int list_folder(vlc_object_t *p_obj, sp_session *p_session,
+                       sp_playlistcontainer *p_container, int i_start,
+                       input_item_t ***ppp_items)
+{
+    int            i_count = sp_playlistcontainer_num_playlists(p_container);
+    input_item_t **pp_items;
+    int            i_items = 0;
+    char           psz_uri[256];
+
+    pp_items = calloc(i_count - i_start + 1, sizeof(*pp_items));
+    if (unlikely(pp_items == NULL))
+        return -1;
+
+    if (i_start == 0 && sp_session_user(p_session) != NULL) {
+        snprintf(psz_uri, sizeof(psz_uri), "spotify://spotify:user:%s:starred",
+                 sp_user_canonical_name(sp_session_user(p_session)));
+        pp_items[i_items] = input_item_NewWithType(psz_uri, "Starred", 0, NULL, 0, -1,
+                                                   ITEM_TYPE_PLAYLIST);
+        if (pp_items[i_items] != NULL)
+            i_items++;
+    }
+
+    for (int i = i_start; is_entry(p_container, i); i = skip_entry(p_container, i)) {
+        input_item_t *p_item = NULL;
+        sp_playlist  *p_playlist;
+        sp_link      *p_link;
+        char          psz_name[256];
+
+        switch (sp_playlistcontainer_playlist_type(p_container, i)) {
+        case SP_PLAYLIST_TYPE_PLAYLIST:
+            p_playlist = sp_playlistcontainer_playlist(p_container, i);
+            // Only there once the playlist has loaded
+            p_link = sp_link_create_from_playlist(p_playlist);
+            if (p_link == NULL) {
+                msg_Dbg(p_obj, "Playlist %d has not loaded, left out", i);
+                break;
+            }
+            strcpy(psz_uri, "spotify://");
+            sp_link_as_string(p_link, psz_uri + 10, sizeof(psz_uri) - 10);
+            sp_link_release(p_link);
+            p_item = input_item_NewWithType(psz_uri, sp_playlist_name(p_playlist), 0, NULL, 0, -1,
+                                            ITEM_TYPE_PLAYLIST);
+            break;
+        case SP_PLAYLIST_TYPE_START_FOLDER:
+            sp_playlistcontainer_playlist_folder_name(p_container, i, psz_name, sizeof(psz_name));
+            snprintf(psz_uri, sizeof(psz_uri), "spotify://" LIBRARY_FOLDER_URI "%016"PRIx64,
+                     sp_playlistcontainer_playlist_folder_id(p_container, i));
+            p_item = input_item_NewWithType(psz_uri, psz_name, 0, NULL, 0, -1,
+                                            ITEM_TYPE_DIRECTORY);
+            break;
+        default:
+            break;
+        }
+        if (p_item != NULL)
+            pp_items[i_items++] = p_item;
+    }
+
+    *ppp_items = pp_items;
+    return i_items;
+}
+
+static uint64_t folder_id(const char *psz_uri)
+{
+    if (psz_uri == NULL)
+        return 0;
+    return strtoull(psz_uri + strlen(LIBRARY_FOLDER_URI), NULL, 16);
+}
+
+// With the lock held. Whether the request can be answered, starting to
+// load its playlist if it has not yet.
+static bool request_ready(sp_session *p_session, sp_playlistcontainer *p_container,
+                          library_request_t *p_request, mtime_t i_now)
+{
+    sp_link *p_link;
+    int      i_start;
+
+    if (p_request->psz_uri == NULL ||
+        strncmp(p_request->psz_uri, LIBRARY_FOLDER_URI, strlen(LIBRARY_FOLDER_URI)) == 0) {
+        if (!sp_playlistcontainer_is_loaded(p_container))
+            return false;
+        if (p_request->i_since == 0)
+            p_request->i_since = i_now;
+        i_start = folder_start(p_container, folder_id(p_request->psz_uri));
+        // Without the names the playlists can not be listed, but some may
+        // never load
+        return i_start < 0 || names_loaded(p_container, i_start) ||
+               i_now - p_request->i_since >= LIBRARY_NAME_WAIT_US;
+    }
+
+    if (p_request->b_failed)
+        return true;
+
+    if (p_request->p_playlist == NULL) {
+        p_link = sp_link_create_from_string(p_request->psz_uri);
+        if (p_link != NULL && sp_link_type(p_link) == SP_LINKTYPE_STARRED)
+            p_request->p_playlist = sp_session_starred_create(p_session);
+        else if (p_link != NULL && sp_link_type(p_link) == SP_LINKTYPE_PLAYLIST)
+            p_request->p_playlist = sp_playlist_create(p_session, p_link);
+        if (p_link != NULL)
+            sp_link_release(p_link);
+        if (p_request->p_playlist == NULL) {
+            p_request->b_failed = true;
+            return true;
+        }
+        sp_playlist_set_in_ram(p_session, p_request->p_playlist, true);
+    }
+
+    return sp_playlist_is_loaded(p_request->p_playlist) &&
+           sp_playlist_is_in_ram(p_session, p_request->p_playlist);
+}
+
+// With the lock held
+static void request_delete(sp_session *p_session, library_request_t *p_request)
+{
+    sp_playlist *p_playlist = p_request->p_playlist;
+
+    p_request->p_playlist = NULL;
+    if (p_playlist != NULL)
+        playlist_drop(p_session, p_playlist);
+    free(p_request->psz_uri);
+    free(p_request);
+}
+
+void library_process(vlc_object_t *p_obj, sp_session *p_session)
+{
+    // Not there until logged in
+    sp_playlistcontainer *p_container = sp_session_playlistcontainer(p_session);
+
+    for (;;) {
+        library_request_t  *p_ready = NULL;
+        library_request_t **pp_request;
+        mtime_t             i_now = mdate();
+        input_item_t      **pp_items = NULL;
+        int                 i_items = -1;
+        int                 i_start;
+
+        vlc_mutex_lock(&g_library.lock);
+        pp_request = &g_library.p_first;
+        while (*pp_request != NULL) {
+            library_request_t *p_request = *pp_request;
+
+            if (p_request->p_client == NULL) {
+                *pp_request = p_request->p_next;
+                request_delete(p_session, p_request);
+            } else if (p_ready == NULL && p_container != NULL &&
+                       request_ready(p_session, p_container, p_request, i_now)) {
+                *pp_request = p_request->p_next;
+                p_ready = p_request;
+            } else {
+                pp_request = &p_request->p_next;
+            }
+        }
+        if (p_ready != NULL)
+            g_library.p_calling = p_ready->p_client;
+        vlc_mutex_unlock(&g_library.lock);
+
+        if (p_ready == NULL)
+            return;
+
+        if (p_ready->p_playlist != NULL || p_ready->b_failed) {
+            msg_Dbg(p_obj, "Read %s", p_ready->psz_uri);
+            p_ready->p_client->pf_playlist(p_ready->p_client->p_opaque, p_ready->p_playlist);
+        } else {
+            i_start = folder_start(p_container, folder_id(p_ready->psz_uri));
+            if (i_start >= 0)
+                i_items = list_folder(p_obj, p_session, p_container, i_start, &pp_items);
+            msg_Dbg(p_obj, "Listed %d items of %s", i_items,
+                    p_ready->psz_uri ? p_ready->psz_uri : "the library");
+            p_ready->p_client->pf_items(p_ready->p_client->p_opaque, pp_items, i_items);
+        }
+
+        if (p_ready->p_playlist != NULL) {
+            sp_playlist *p_playlist = p_ready->p_playlist;
+            int          i_max = var_InheritInteger(p_obj, "spotify-playlists-in-ram");
+
+            vlc_mutex_lock(&g_library.lock);
+            p_ready->p_playlist = NULL;
+            playlist_keep(p_session, p_playlist, __MIN(i_max, LIBRARY_PLAYLISTS_IN_RAM_MAX));
+            vlc_mutex_unlock(&g_library.lock);
+        }
+
+        vlc_mutex_lock(&g_library.lock);
+        g_library.p_calling = NULL;
+        vlc_cond_broadcast(&g_library.wait);
+        vlc_mutex_unlock(&g_library.lock);
+
+        free(p_ready->psz_uri);
+        free(p_ready);
+    }
+}
+
+void library_shrink(sp_session *p_session)
+{
+    vlc_mutex_lock(&g_library.lock);
+    while (g_library.i_kept > 0 && membudget_over_by(MEMBUDGET_PLAYLISTS))
+        playlist_unkeep_oldest(p_session);
+    vlc_mutex_unlock(&g_library.lock);
+}
+
+void library_flush(void)
+{
+    library_request_t **pp_request;
+
+    vlc_mutex_lock(&g_library.lock);
+    pp_request = &g_library.p_first;
+    while (*pp_request != NULL) {
+        library_request_t *p_request = *pp_request;
+
+        if (p_request->p_client == NULL) {
+            *pp_request = p_request->p_next;
+            free(p_request->psz_uri);
+            if (p_request->p_playlist != NULL)
+                sp_playlist_release(p_request->p_playlist);
+            free(p_request);
+            continue;
+        }
+        // Started over in the next session
+        if (p_request->p_playlist != NULL)
+            sp_playlist_release(p_request->p_playlist);
+        p_request->p_playlist = NULL;
+        p_request->b_failed = false;
+        p_request->i_since = 0;
+        pp_request = &p_request->p_next;
+    }
+    while (g_library.i_kept > 0) {
+        g_library.i_kept--;
+        membudget_release(MEMBUDGET_PLAYLISTS, g_library.kept[g_library.i_kept].i_bytes);
+        sp_playlist_release(g_library.kept[g_library.i_kept].p_playlist);
+    }
+    vlc_mutex_unlock(&g_library.lock);
+}
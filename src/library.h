@@ -0,0 +1,75 @@
+/*****************************************************************************
+ * Copyright (C) 2015 Jonas Lundqvist
+ *
+ * Author: Jonas Lundqvist <jonas@gannon.se>
+ *
+ * This file is part of vlc-spotify.
+ *
+ * vlc-spotify is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+// The user's library: the starred tracks and the playlists, in the folders
+// of the playlist container.
+//
+// Nothing is listed or loaded up front. The services discovery lists the
+// top level, and each folder and playlist is only read when its item is
+// opened, by the session thread, once the container or the playlist has
+// loaded. A few of the playlists that were read are kept in RAM, in case
+// they are opened again, the others are unloaded right away. With
+// spotify-unload-playlists (initially_unload_playlists) set, which it is
+// by default, this is all libspotify keeps of them.
+
+#define LIBRARY_PLAYLISTS_IN_RAM 4
+// How long a listing waits for the names of its playlists to load, well
+// within the time Open() waits
+#define LIBRARY_NAME_WAIT_US (2 * CLOCK_FREQ)
+
+#define LIBRARY_FOLDER_URI "spotify:folder:"
+
+typedef struct library_client_t library_client_t;
+
+// Callbacks from the session thread, never after library_cancel() returned
+struct library_client_t {
+    void *p_opaque;
+
+    // The items of the top level or a folder, handed over. i_items is -1 if
+    // the folder does not exist.
+    void (*pf_items)(void *p_opaque, input_item_t **pp_items, int i_items);
+    // A playlist, loaded and in RAM, only for the duration of the call.
+    // NULL if it could not be loaded. Not needed if no playlist is read.
+    void (*pf_playlist)(void *p_opaque, sp_playlist *p_playlist);
+};
+
+// Any thread. Read the top level (psz_uri NULL), a folder (spotify:folder:
+// followed by its id in hex) or a playlist (spotify:user:...:playlist:...
+// or spotify:user:...:starred) for p_client, which must stay valid until
+// library_cancel(). Returns VLC_ENOMEM or VLC_SUCCESS.
+int library_read(const char *psz_uri, const library_client_t *p_client);
+
+// Any thread. Forget what p_client asked for, waiting for a callback that
+// is running to return.
+void library_cancel(const library_client_t *p_client);
+
+// Session thread. Read what has loaded, called after each
+// sp_session_process_events().
+void library_process(vlc_object_t *p_obj, sp_session *p_session);
+
+// Session thread. Unload the least recently read playlists while they are
+// what is over the memory budget.
+void library_shrink(sp_session *p_session);
+
+// Session thread. Release the playlists, before the session is released.
+// What is still asked for is read again by the next session.
+void library_flush(void);
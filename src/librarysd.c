@@ -0,0 +1,89 @@
+/*****************************************************************************
+ * Copyright (C) 2015 Jonas Lundqvist
+ *
+ * Author: Jonas Lundqvist <jonas@gannon.se>
+ *
+ * This file is part of vlc-spotify.
+ *
+ * vlc-spotify is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include <stdlib.h>
+
+// VLC includes
+#include <vlc_common.h>
+#include <vlc_messages.h>
+#include <vlc_input.h>
+#include <vlc_services_discovery.h>
+
+#include <libspotify/api.h>
+
+#include "session.h"
+#include "library.h"
+#include "librarysd.h"
+
+struct services_discovery_sys_t {
+    library_client_t library;
+};
+
+// Session thread
+static void library_items(void *p_opaque, input_item_t **pp_items, int i_items)
+{
+    services_discovery_t *p_sd = (services_discovery_t *) p_opaque;
+
+    for (int i = 0; i < i_items; i++) {
+        services_discovery_AddItem(p_sd, pp_items[i], NULL);
+        vlc_gc_decref(pp_items[i]);
+    }
+    free(pp_items);
+}
+
+int LibraryOpen(vlc_object_t *p_obj)
+{
+    services_discovery_t     *p_sd = (services_discovery_t *) p_obj;
+    services_discovery_sys_t *p_sys = calloc(1, sizeof(*p_sys));
+
+    if (unlikely(p_sys == NULL))
+        return VLC_ENOMEM;
+
+    p_sys->library.p_opaque = p_sd;
+    p_sys->library.pf_items = library_items;
+    p_sd->p_sys = p_sys;
+
+    // Keeps the session logged in while the library is shown
+    if (spotify_session_acquire(p_obj, NULL) == NULL) {
+        free(p_sys);
+        return VLC_EGENERIC;
+    }
+
+    if (library_read(NULL, &p_sys->library) != VLC_SUCCESS) {
+        spotify_session_release();
+        free(p_sys);
+        return VLC_ENOMEM;
+    }
+
+    msg_Dbg(p_sd, "Listing the library once the session is logged in");
+    return VLC_SUCCESS;
+}
+
+void LibraryClose(vlc_object_t *p_obj)
+{
+    services_discovery_t     *p_sd = (services_discovery_t *) p_obj;
+    services_discovery_sys_t *p_sys = p_sd->p_sys;
+
+    library_cancel(&p_sys->library);
+    spotify_session_release();
+    free(p_sys);
+}
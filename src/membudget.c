@@ -0,0 +1,110 @@
+/*****************************************************************************
+ * Copyright (C) 2015 Jonas Lundqvist
+ *
+ * Author: Jonas Lundqvist <jonas@gannon.se>
+ *
+ * This file is part of vlc-spotify.
+ *
+ * vlc-spotify is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include <stdatomic.h>
+#include <stdio.h>
+
+#include "membudget.h"
+
+static const char *const ppsz_names[MEMBUDGET_COMPONENTS] = {
+    "audio", "metadata", "playlists",
+};
+
+static struct {
+    atomic_size_t   i_limit;
+    // Only the total is checked against the limit, the components are
+    // only read for the figures
+    atomic_size_t   i_total;
+    atomic_size_t   used[MEMBUDGET_COMPONENTS];
+} g_budget;
+
+void membudget_set_limit(size_t i_bytes)
+{
+    atomic_store(&g_budget.i_limit, i_bytes);
+}
+
+size_t membudget_limit(void)
+{
+    return atomic_load(&g_budget.i_limit);
+}
+
+bool membudget_fits(size_t i_bytes)
+{
+    size_t i_limit = atomic_load(&g_budget.i_limit);
+
+    return i_limit == 0 || atomic_load(&g_budget.i_total) + i_bytes <= i_limit;
+}
+
+void membudget_charge(membudget_component_e component, size_t i_bytes)
+{
+    atomic_fetch_add(&g_budget.i_total, i_bytes);
+    atomic_fetch_add(&g_budget.used[component], i_bytes);
+}
+
+void membudget_release(membudget_component_e component, size_t i_bytes)
+{
+    atomic_fetch_sub(&g_budget.used[component], i_bytes);
+    atomic_fetch_sub(&g_budget.i_total, i_bytes);
+}
+
+size_t membudget_used(membudget_component_e component)
+{
+    return atomic_load(&g_budget.used[component]);
+}
+
+size_t membudget_total(void)
+{
+    return atomic_load(&g_budget.i_total);
+}
+
+bool membudget_over(void)
+{
+    size_t i_limit = atomic_load(&g_budget.i_limit);
+
+    return i_limit != 0 && atomic_load(&g_budget.i_total) > i_limit;
+}
+
+bool membudget_over_by(membudget_component_e component)
+{
+    size_t i_limit = atomic_load(&g_budget.i_limit);
+    size_t i_total = atomic_load(&g_budget.i_total);
+
+    return i_limit != 0 && i_total > i_limit &&
+           i_total - atomic_load(&g_budget.used[component]) <= i_limit;
+}
+
+void membudget_format(char *psz_buf, size_t i_size)
+{
+    size_t i_limit = membudget_limit();
+    size_t i_len = 0;
+
+    psz_buf[0] = '\0';
+    for (int i = 0; i < MEMBUDGET_COMPONENTS && i_len < i_size; i++)
+        i_len += snprintf(psz_buf + i_len, i_size - i_len, "%s%s %zu kB",
+                          i > 0 ? ", " : "", ppsz_names[i], membudget_used(i) / 1024);
+    if (i_len >= i_size)
+        return;
+    if (i_limit != 0)
+        snprintf(psz_buf + i_len, i_size - i_len, ", of %zu kB", i_limit / 1024);
+    else
+        snprintf(psz_buf + i_len, i_size - i_len, ", no limit");
+}
@@ -0,0 +1,66 @@
+/*****************************************************************************
+ * Copyright (C) 2015 Jonas Lundqvist
+ *
+ * Author: Jonas Lundqvist <jonas@gannon.se>
+ *
+ * This file is part of vlc-spotify.
+ *
+ * vlc-spotify is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+// One memory budget for the whole process.
+//
+// The buffers and caches that grow with use charge what they hold to their
+// component here, and give it back when they let go of it. Each of them
+// has its own way of staying within the budget: the audio kept while
+// paused stops growing, the metadata cache drops its oldest tracks and
+// fewer playlists are kept in RAM. What VLC and libspotify hold on to is
+// not counted, only what the plugin keeps.
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define MEMBUDGET_MB 0          // No limit
+
+typedef enum {
+    MEMBUDGET_AUDIO,            // Kept while paused
+    MEMBUDGET_METADATA,         // The metadata cache
+    MEMBUDGET_PLAYLISTS,        // Items not posted yet, playlists kept in RAM
+    MEMBUDGET_COMPONENTS
+} membudget_component_e;
+
+// Any thread. 0 for no limit.
+void membudget_set_limit(size_t i_bytes);
+size_t membudget_limit(void);
+
+// Any thread. Whether i_bytes more would stay within the limit, for what
+// can wait until there is room.
+bool membudget_fits(size_t i_bytes);
+// Any thread. Charge i_bytes whether they fit or not, for what is already
+// taken. The component is expected to shrink if membudget_over().
+void membudget_charge(membudget_component_e component, size_t i_bytes);
+void membudget_release(membudget_component_e component, size_t i_bytes);
+
+size_t membudget_used(membudget_component_e component);
+size_t membudget_total(void);
+// More is charged than the limit
+bool membudget_over(void);
+// Over the limit because of component: without what it holds, the rest
+// would be within the limit. What a component may shrink for, so that it
+// does not give up all it holds for the others.
+bool membudget_over_by(membudget_component_e component);
+
+// "audio 0 kB, metadata 120 kB, playlists 4 kB, of 65536 kB"
+void membudget_format(char *psz_buf, size_t i_size);
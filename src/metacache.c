@@ -0,0 +1,243 @@
+/*****************************************************************************
+ * Copyright (C) 2015 Jonas Lundqvist
+ *
+ * Author: Jonas Lundqvist <jonas@gannon.se>
+ *
+ * This file is part of vlc-spotify.
+ *
+ * vlc-spotify is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "membudget.h"
+#include "metacache.h"
+
+#define META_CACHE_BUCKETS 1024     // A power of 2
+
+typedef struct cache_entry_t cache_entry_t;
+struct cache_entry_t {
+    char          *psz_uri;
+    track_meta_t   meta;
+    size_t         i_bytes;         // Charged to the memory budget
+    cache_entry_t *p_bucket_next;
+    // Most recently used first
+    cache_entry_t *p_newer;
+    cache_entry_t *p_older;
+};
+
+static struct {
+    pthread_mutex_t  lock;
+    pthread_cond_t   put;       // Broadcast whenever a track is put
+    cache_entry_t   *buckets[META_CACHE_BUCKETS];
+    cache_entry_t   *p_newest;
+    cache_entry_t   *p_oldest;
+    int              i_entries;
+} g_cache = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .put = PTHREAD_COND_INITIALIZER,
+};
+
+// FNV-1a
+static unsigned hash_uri(const char *psz_uri)
+{
+    uint32_t i_hash = 2166136261u;
+
+    for (; *psz_uri != '\0'; psz_uri++)
+        i_hash = (i_hash ^ (uint8_t) *psz_uri) * 16777619u;
+    return i_hash & (META_CACHE_BUCKETS - 1);
+}
+
+static char *strdup_null(const char *psz)
+{
+    return psz ? strdup(psz) : NULL;
+}
+
+static size_t strsize_null(const char *psz)
+{
+    return psz ? strlen(psz) + 1 : 0;
+}
+
+static void copy_meta(track_meta_t *p_dst, const track_meta_t *p_src)
+{
+    p_dst->b_available = p_src->b_available;
+    p_dst->psz_title = strdup_null(p_src->psz_title);
+    p_dst->psz_artist = strdup_null(p_src->psz_artist);
+    p_dst->psz_album = strdup_null(p_src->psz_album);
+    p_dst->psz_art_id = strdup_null(p_src->psz_art_id);
+    p_dst->i_duration = p_src->i_duration;
+}
+
+void track_meta_clean(track_meta_t *p_meta)
+{
+    free(p_meta->psz_title);
+    free(p_meta->psz_artist);
+    free(p_meta->psz_album);
+    free(p_meta->psz_art_id);
+    memset(p_meta, 0, sizeof(*p_meta));
+}
+
+static void unlink_lru(cache_entry_t *p_entry)
+{
+    if (p_entry->p_newer)
+        p_entry->p_newer->p_older = p_entry->p_older;
+    else
+        g_cache.p_newest = p_entry->p_older;
+    if (p_entry->p_older)
+        p_entry->p_older->p_newer = p_entry->p_newer;
+    else
+        g_cache.p_oldest = p_entry->p_newer;
+}
+
+static void link_newest(cache_entry_t *p_entry)
+{
+    p_entry->p_newer = NULL;
+    p_entry->p_older = g_cache.p_newest;
+    if (g_cache.p_newest)
+        g_cache.p_newest->p_newer = p_entry;
+    else
+        g_cache.p_oldest = p_entry;
+    g_cache.p_newest = p_entry;
+}
+
+static cache_entry_t **find_entry(const char *psz_uri)
+{
+    cache_entry_t **pp_entry = &g_cache.buckets[hash_uri(psz_uri)];
+
+    while (*pp_entry != NULL && strcmp((*pp_entry)->psz_uri, psz_uri))
+        pp_entry = &(*pp_entry)->p_bucket_next;
+    return pp_entry;
+}
+
+static void delete_entry(cache_entry_t **pp_entry)
+{
+    cache_entry_t *p_entry = *pp_entry;
+
+    *pp_entry = p_entry->p_bucket_next;
+    unlink_lru(p_entry);
+    g_cache.i_entries--;
+
+    membudget_release(MEMBUDGET_METADATA, p_entry->i_bytes);
+    track_meta_clean(&p_entry->meta);
+    free(p_entry->psz_uri);
+    free(p_entry);
+}
+
+void meta_cache_put(const char *psz_uri, const track_meta_t *p_meta)
+{
+    cache_entry_t  *p_entry = calloc(1, sizeof(*p_entry));
+    cache_entry_t **pp_entry;
+
+    if (p_entry == NULL)
+        return;
+    p_entry->psz_uri = strdup(psz_uri);
+    if (p_entry->psz_uri == NULL) {
+        free(p_entry);
+        return;
+    }
+    copy_meta(&p_entry->meta, p_meta);
+    p_entry->i_bytes = sizeof(*p_entry) + strsize_null(p_entry->psz_uri) +
+                       strsize_null(p_entry->meta.psz_title) + strsize_null(p_entry->meta.psz_artist) +
+                       strsize_null(p_entry->meta.psz_album) + strsize_null(p_entry->meta.psz_art_id);
+
+    pthread_mutex_lock(&g_cache.lock);
+
+    // The newer lookup wins
+    pp_entry = find_entry(psz_uri);
+    if (*pp_entry != NULL)
+        delete_entry(pp_entry);
+
+    pp_entry = find_entry(psz_uri);
+    *pp_entry = p_entry;
+    link_newest(p_entry);
+    g_cache.i_entries++;
+
+    // The oldest tracks make room for it, but only for what the cache
+    // itself takes. It stays, someone may be waiting for it.
+    membudget_charge(MEMBUDGET_METADATA, p_entry->i_bytes);
+    while (g_cache.p_oldest != p_entry &&
+           (g_cache.i_entries > META_CACHE_SIZE || membudget_over_by(MEMBUDGET_METADATA)))
+        delete_entry(find_entry(g_cache.p_oldest->psz_uri));
+
+    pthread_cond_broadcast(&g_cache.put);
+    pthread_mutex_unlock(&g_cache.lock);
+}
+
+// With the lock held
+static bool get_locked(const char *psz_uri, track_meta_t *p_meta)
+{
+    cache_entry_t *p_entry = *find_entry(psz_uri);
+
+    if (p_entry == NULL)
+        return false;
+
+    unlink_lru(p_entry);
+    link_newest(p_entry);
+    copy_meta(p_meta, &p_entry->meta);
+    return true;
+}
+
+bool meta_cache_get(const char *psz_uri, track_meta_t *p_meta)
+{
+    bool b_found;
+
+    pthread_mutex_lock(&g_cache.lock);
+    b_found = get_locked(psz_uri, p_meta);
+    pthread_mutex_unlock(&g_cache.lock);
+    return b_found;
+}
+
+bool meta_cache_wait(const char *psz_uri, track_meta_t *p_meta, int i_timeout_ms)
+{
+    struct timespec deadline;
+    bool            b_found;
+
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += i_timeout_ms / 1000;
+    deadline.tv_nsec += (i_timeout_ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    pthread_mutex_lock(&g_cache.lock);
+    while (!(b_found = get_locked(psz_uri, p_meta)))
+        if (pthread_cond_timedwait(&g_cache.put, &g_cache.lock, &deadline) == ETIMEDOUT) {
+            b_found = get_locked(psz_uri, p_meta);
+            break;
+        }
+    pthread_mutex_unlock(&g_cache.lock);
+    return b_found;
+}
+
+void meta_cache_clear(void)
+{
+    pthread_mutex_lock(&g_cache.lock);
+    while (g_cache.p_oldest != NULL)
+        delete_entry(find_entry(g_cache.p_oldest->psz_uri));
+    pthread_mutex_unlock(&g_cache.lock);
+}
+
+void meta_cache_shrink(void)
+{
+    pthread_mutex_lock(&g_cache.lock);
+    while (g_cache.p_oldest != g_cache.p_newest && membudget_over_by(MEMBUDGET_METADATA))
+        delete_entry(find_entry(g_cache.p_oldest->psz_uri));
+    pthread_mutex_unlock(&g_cache.lock);
+}
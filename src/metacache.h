@@ -0,0 +1,62 @@
+/*****************************************************************************
+ * Copyright (C) 2015 Jonas Lundqvist
+ *
+ * Author: Jonas Lundqvist <jonas@gannon.se>
+ *
+ * This file is part of vlc-spotify.
+ *
+ * vlc-spotify is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+// Metadata of tracks, by URI, for the whole process.
+//
+// Filled by the meta queue as it resolves tracks, and read when an item is
+// preparsed so that a track that already was looked up is answered without
+// the session. The least recently used tracks are dropped beyond
+// META_CACHE_SIZE, or while the cache is what exceeds the memory budget
+// (membudget.h). The track put last is always kept.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define META_CACHE_SIZE 4096
+
+typedef struct {
+    bool     b_available;   // False if the track could not be looked up
+    char    *psz_title;
+    char    *psz_artist;    // All the artists, comma separated
+    char    *psz_album;
+    char    *psz_art_id;    // Cover image id, 40 hex digits
+    int64_t  i_duration;    // us
+} track_meta_t;
+
+// Any thread. Stores a copy.
+void meta_cache_put(const char *psz_uri, const track_meta_t *p_meta);
+
+// Any thread. On a hit, fills in a copy that is to be cleaned by the caller.
+bool meta_cache_get(const char *psz_uri, track_meta_t *p_meta);
+
+// Any thread. Like meta_cache_get(), but waits up to i_timeout_ms for the
+// track to be put.
+bool meta_cache_wait(const char *psz_uri, track_meta_t *p_meta, int i_timeout_ms);
+
+// Drop everything
+void meta_cache_clear(void);
+
+// Drop the least recently used tracks while the cache is what is over the
+// memory budget
+void meta_cache_shrink(void);
+
+void track_meta_clean(track_meta_t *p_meta);
@@ -0,0 +1,444 @@
+/*****************************************************************************
+ * Copyright (C) 2015 Jonas Lundqvist
+ *
+ * Author: Jonas Lundqvist <jonas@gannon.se>
+ *
+ * This file is part of vlc-spotify.
+ *
+ * vlc-spotify is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+// VLC includes
+#include <vlc_common.h>
+#include <vlc_messages.h>
+#include <vlc_threads.h>
+#include <vlc_input.h>
+
+#include <libspotify/api.h>
+
+#include "artcache.h"
+#include "metacache.h"
+#include "metaqueue.h"
+
+#define META_QUEUE_BUCKETS 1024     // A power of 2
+
+typedef struct meta_entry_t meta_entry_t;
+struct meta_entry_t {
+    // The items of the track, usually one, a reference each
+    input_item_t   **pp_items;
+    int              i_items;
+    char            *psz_uri;
+    meta_priority_e  priority;
+    bool             b_inflight;
+    sp_track        *p_track;   // Set while the lookup is in flight
+    mtime_t          i_start;   // Of the lookup
+    meta_entry_t    *p_bucket_next;
+    // In the queue of its priority, or with the lookups in flight
+    meta_entry_t    *p_prev;
+    meta_entry_t    *p_next;
+    // All entries in the order they were added, which is the playlist order
+    meta_entry_t    *p_prev_added;
+    meta_entry_t    *p_next_added;
+};
+
+typedef struct {
+    meta_entry_t    *p_first;
+    meta_entry_t    *p_last;
+} meta_list_t;
+
+static struct {
+    // Never held while calling into libspotify or VLC
+    vlc_mutex_t      lock;
+
+    // By URI, one entry per track, queued or in flight
+    meta_entry_t    *buckets[META_QUEUE_BUCKETS];
+    // Waiting for a lookup, first come first served within a priority.
+    // Those on demand are only held there until they are raised.
+    meta_list_t      queues[META_PRIORITY_ON_DEMAND + 1];
+    meta_entry_t    *p_first_added;
+    meta_entry_t    *p_last_added;
+
+    // Session thread only, the lookups that have been started
+    meta_list_t      inflight;
+    int              i_inflight;
+} g_meta = {
+    .lock = VLC_STATIC_MUTEX,
+};
+
+// FNV-1a
+static unsigned hash_uri(const char *psz_uri)
+{
+    uint32_t i_hash = 2166136261u;
+
+    for (; *psz_uri != '\0'; psz_uri++)
+        i_hash = (i_hash ^ (uint8_t) *psz_uri) * 16777619u;
+    return i_hash & (META_QUEUE_BUCKETS - 1);
+}
+
+// With the lock held. Where the entry of the track is, or would go.
+static meta_entry_t **find_entry(const char *psz_uri)
+{
+    meta_entry_t **pp_entry = &g_meta.buckets[hash_uri(psz_uri)];
+
+    while (*pp_entry != NULL && strcmp((*pp_entry)->psz_uri, psz_uri) != 0)
+        pp_entry = &(*pp_entry)->p_bucket_next;
+    return pp_entry;
+}
+
+static void list_append(meta_list_t *p_list, meta_entry_t *p_entry)
+{
+    p_entry->p_next = NULL;
+    p_entry->p_prev = p_list->p_last;
+    if (p_list->p_last)
+        p_list->p_last->p_next = p_entry;
+    else
+        p_list->p_first = p_entry;
+    p_list->p_last = p_entry;
+}
+
+static void list_remove(meta_list_t *p_list, meta_entry_t *p_entry)
+{
+    if (p_entry->p_prev)
+        p_entry->p_prev->p_next = p_entry->p_next;
+    else
+        p_list->p_first = p_entry->p_next;
+    if (p_entry->p_next)
+        p_entry->p_next->p_prev = p_entry->p_prev;
+    else
+        p_list->p_last = p_entry->p_prev;
+    p_entry->p_prev = p_entry->p_next = NULL;
+}
+
+// With the lock held
+static void link_added(meta_entry_t *p_entry)
+{
+    p_entry->p_next_added = NULL;
+    p_entry->p_prev_added = g_meta.p_last_added;
+    if (g_meta.p_last_added)
+        g_meta.p_last_added->p_next_added = p_entry;
+    else
+        g_meta.p_first_added = p_entry;
+    g_meta.p_last_added = p_entry;
+}
+
+// With the lock held
+static void unlink_added(meta_entry_t *p_entry)
+{
+    if (p_entry->p_prev_added)
+        p_entry->p_prev_added->p_next_added = p_entry->p_next_added;
+    else
+        g_meta.p_first_added = p_entry->p_next_added;
+    if (p_entry->p_next_added)
+        p_entry->p_next_added->p_prev_added = p_entry->p_prev_added;
+    else
+        g_meta.p_last_added = p_entry->p_prev_added;
+}
+
+// With the lock held. Moves a queued entry to the end of the queue of the
+// priority, if that is a higher one.
+static void raise_priority(meta_entry_t *p_entry, meta_priority_e priority)
+{
+    if (p_entry->b_inflight || priority >= p_entry->priority)
+        return;
+    list_remove(&g_meta.queues[p_entry->priority], p_entry);
+    p_entry->priority = priority;
+    list_append(&g_meta.queues[priority], p_entry);
+}
+
+// With the lock held. The reference to the item is taken over, false if it
+// was not needed.
+static bool add_item(meta_entry_t *p_entry, input_item_t *p_item)
+{
+    input_item_t **pp_items;
+
+    for (int i = 0; i < p_entry->i_items; i++)
+        if (p_entry->pp_items[i] == p_item)
+            return false;
+    pp_items = realloc(p_entry->pp_items, (p_entry->i_items + 1) * sizeof(*pp_items));
+    if (unlikely(pp_items == NULL))
+        return false;
+    pp_items[p_entry->i_items++] = p_item;
+    p_entry->pp_items = pp_items;
+    return true;
+}
+
+static void delete_entry(meta_entry_t *p_entry)
+{
+    for (int i = 0; i < p_entry->i_items; i++)
+        vlc_gc_decref(p_entry->pp_items[i]);
+    free(p_entry->pp_items);
+    free(p_entry->psz_uri);
+    free(p_entry);
+}
+
+void meta_queue_add(input_item_t *p_item, const char *psz_uri, meta_priority_e priority)
+{
+    meta_entry_t **pp_entry;
+    meta_entry_t  *p_entry;
+    track_meta_t   meta;
+    bool           b_cached;
+
+    vlc_gc_incref(p_item);
+    vlc_mutex_lock(&g_meta.lock);
+
+    // Queued already, by this or by another item. One lookup does for all,
+    // as soon as the most wanted of them wants it.
+    pp_entry = find_entry(psz_uri);
+    if (*pp_entry != NULL) {
+        p_entry = *pp_entry;
+        raise_priority(p_entry, priority);
+        if (add_item(p_entry, p_item))
+            p_item = NULL;
+        vlc_mutex_unlock(&g_meta.lock);
+        if (p_item != NULL)
+            vlc_gc_decref(p_item);
+        return;
+    }
+
+    // Looked up before. Asked with the lock held, an entry only leaves the
+    // queue once its track is in the cache.
+    b_cached = meta_cache_get(psz_uri, &meta);
+    p_entry = b_cached ? NULL : calloc(1, sizeof(*p_entry));
+    if (p_entry != NULL) {
+        p_entry->psz_uri = strdup(psz_uri);
+        if (unlikely(p_entry->psz_uri == NULL || !add_item(p_entry, p_item))) {
+            free(p_entry->psz_uri);
+            free(p_entry);
+            p_entry = NULL;
+        }
+    }
+    if (p_entry != NULL) {
+        p_entry->priority = priority;
+        *pp_entry = p_entry;
+        link_added(p_entry);
+        list_append(&g_meta.queues[priority], p_entry);
+    }
+    vlc_mutex_unlock(&g_meta.lock);
+
+    if (b_cached) {
+        if (meta.b_available)
+            meta_set_item(p_item, &meta);
+        track_meta_clean(&meta);
+    }
+    if (p_entry == NULL)
+        vlc_gc_decref(p_item);
+}
+
+void meta_queue_prioritize(const char *psz_uri, int i_following)
+{
+    meta_entry_t *p_entry;
+
+    vlc_mutex_lock(&g_meta.lock);
+    p_entry = *find_entry(psz_uri);
+    if (p_entry != NULL) {
+        raise_priority(p_entry, META_PRIORITY_NOW);
+        for (p_entry = p_entry->p_next_added; p_entry != NULL && i_following > 0;
+             p_entry = p_entry->p_next_added, i_following--)
+            raise_priority(p_entry, META_PRIORITY_NEAR);
+    }
+    vlc_mutex_unlock(&g_meta.lock);
+}
+
+void meta_read_track(sp_track *p_track, track_meta_t *p_meta)
+{
+    const char *psz_track = sp_track_name(p_track);
+    sp_album   *album = sp_track_album(p_track);
+    const byte *p_cover = album ? sp_album_cover(album, SP_IMAGE_SIZE_NORMAL) : NULL;
+    size_t      i_artist = 0;
+
+    memset(p_meta, 0, sizeof(*p_meta));
+    p_meta->b_available = true;
+
+    if (psz_track != NULL)
+        p_meta->psz_title = strdup(psz_track);
+
+    for (int i = 0; i < sp_track_num_artists(p_track); i++) {
+        const char *psz_name = sp_artist_name(sp_track_artist(p_track, i));
+        size_t      i_name = psz_name ? strlen(psz_name) : 0;
+        char       *psz_artist;
+
+        if (i_name == 0)
+            continue;
+        psz_artist = realloc(p_meta->psz_artist, i_artist + i_name + 3);
+        if (unlikely(psz_artist == NULL))
+            break;
+        if (i_artist > 0) {
+            memcpy(psz_artist + i_artist, ", ", 2);
+            i_artist += 2;
+        }
+        memcpy(psz_artist + i_artist, psz_name, i_name + 1);
+        i_artist += i_name;
+        p_meta->psz_artist = psz_artist;
+    }
+
+    if (album != NULL && sp_album_name(album) != NULL)
+        p_meta->psz_album = strdup(sp_album_name(album));
+
+    if (p_cover != NULL) {
+        p_meta->psz_art_id = malloc(41);
+        if (p_meta->psz_art_id != NULL)
+            art_image_id(p_cover, p_meta->psz_art_id);
+    }
+
+    p_meta->i_duration = sp_track_duration(p_track) * INT64_C(1000);
+}
+
+void meta_set_item(input_item_t *p_item, const track_meta_t *p_meta)
+{
+    if (p_meta->psz_title != NULL)
+        input_item_SetTitle(p_item, p_meta->psz_title);
+    if (p_meta->psz_artist != NULL)
+        input_item_SetArtist(p_item, p_meta->psz_artist);
+    if (p_meta->psz_album != NULL)
+        input_item_SetAlbum(p_item, p_meta->psz_album);
+    if (p_meta->psz_art_id != NULL)
+        art_queue_add(p_item, p_meta->psz_art_id);
+    input_item_SetDuration(p_item, p_meta->i_duration);
+}
+
+// Session thread
+static sp_track *start_lookup(const char *psz_uri)
+{
+    sp_link  *link = sp_link_create_from_string(psz_uri);
+    sp_track *p_track = NULL;
+
+    if (link == NULL)
+        return NULL;
+
+    // The track belongs to the link, keep it after the link is gone
+    p_track = sp_link_as_track(link);
+    if (p_track != NULL)
+        sp_track_add_ref(p_track);
+    sp_link_release(link);
+
+    return p_track;
+}
+
+// Session thread. The lookup is over, whether the track loaded or not.
+static void finish_lookup(vlc_object_t *p_obj, meta_entry_t *p_entry)
+{
+    track_meta_t   meta = { .b_available = false };
+    meta_entry_t **pp_entry;
+
+    if (p_entry->p_track != NULL) {
+        if (sp_track_error(p_entry->p_track) == SP_ERROR_OK) {
+            meta_read_track(p_entry->p_track, &meta);
+        } else {
+            msg_Dbg(p_obj, "No metadata for %s: %s", p_entry->psz_uri,
+                    sp_error_message(sp_track_error(p_entry->p_track)));
+        }
+        sp_track_release(p_entry->p_track);
+    } else {
+        msg_Dbg(p_obj, "No track for %s", p_entry->psz_uri);
+    }
+    // Also when it failed, so that nobody waits for it in vain. Before the
+    // entry is unlinked, for meta_queue_add() to find the track in either.
+    meta_cache_put(p_entry->psz_uri, &meta);
+
+    vlc_mutex_lock(&g_meta.lock);
+    pp_entry = find_entry(p_entry->psz_uri);
+    *pp_entry = p_entry->p_bucket_next;
+    unlink_added(p_entry);
+    vlc_mutex_unlock(&g_meta.lock);
+
+    // Nobody adds items to it any more
+    if (meta.b_available)
+        for (int i = 0; i < p_entry->i_items; i++)
+            meta_set_item(p_entry->pp_items[i], &meta);
+    track_meta_clean(&meta);
+    delete_entry(p_entry);
+}
+
+void meta_queue_process(vlc_object_t *p_obj)
+{
+    bool b_progress;
+
+    // Tracks that are already in the cache are loaded as soon as they are
+    // looked up, so go on until no lookup finishes or starts. Only the few
+    // lookups in flight are gone through, never the whole queue.
+    do {
+        meta_entry_t *p_entry;
+        meta_entry_t *p_next;
+
+        b_progress = false;
+
+        // Only this thread touches the lookups in flight, and their tracks
+        for (p_entry = g_meta.inflight.p_first; p_entry != NULL; p_entry = p_next) {
+            p_next = p_entry->p_next;
+            if (p_entry->p_track != NULL &&
+                sp_track_error(p_entry->p_track) == SP_ERROR_IS_LOADING) {
+                if (mdate() < p_entry->i_start + META_QUEUE_TIMEOUT_US)
+                    continue;
+                msg_Warn(p_obj, "Giving up on %s, still loading", p_entry->psz_uri);
+            }
+            list_remove(&g_meta.inflight, p_entry);
+            g_meta.i_inflight--;
+            finish_lookup(p_obj, p_entry);
+            b_progress = true;
+        }
+
+        while (g_meta.i_inflight < META_QUEUE_MAX_INFLIGHT) {
+            meta_priority_e priority;
+
+            // The most wanted, and of those the first queued
+            vlc_mutex_lock(&g_meta.lock);
+            p_entry = NULL;
+            for (priority = META_PRIORITY_NOW; priority <= META_PRIORITY_BACKGROUND &&
+                 p_entry == NULL; priority++)
+                p_entry = g_meta.queues[priority].p_first;
+            if (p_entry != NULL) {
+                list_remove(&g_meta.queues[p_entry->priority], p_entry);
+                p_entry->b_inflight = true;
+            }
+            vlc_mutex_unlock(&g_meta.lock);
+
+            if (p_entry == NULL)
+                break;
+
+            // Finished on the next round if there is no such track
+            p_entry->p_track = start_lookup(p_entry->psz_uri);
+            p_entry->i_start = mdate();
+            list_append(&g_meta.inflight, p_entry);
+            g_meta.i_inflight++;
+            b_progress = true;
+        }
+    } while (b_progress);
+}
+
+void meta_queue_flush(void)
+{
+    meta_entry_t *p_entry;
+
+    vlc_mutex_lock(&g_meta.lock);
+    // Queued and in flight alike
+    p_entry = g_meta.p_first_added;
+    g_meta.p_first_added = g_meta.p_last_added = NULL;
+    memset(g_meta.buckets, 0, sizeof(g_meta.buckets));
+    memset(g_meta.queues, 0, sizeof(g_meta.queues));
+    memset(&g_meta.inflight, 0, sizeof(g_meta.inflight));
+    g_meta.i_inflight = 0;
+    vlc_mutex_unlock(&g_meta.lock);
+
+    while (p_entry != NULL) {
+        meta_entry_t *p_next = p_entry->p_next_added;
+        if (p_entry->p_track != NULL)
+            sp_track_release(p_entry->p_track);
+        delete_entry(p_entry);
+        p_entry = p_next;
+    }
+}
@@ -0,0 +1,67 @@
+/*****************************************************************************
+ * Copyright (C) 2015 Jonas Lundqvist
+ *
+ * Author: Jonas Lundqvist <jonas@gannon.se>
+ *
+ * This file is part of vlc-spotify.
+ *
+ * vlc-spotify is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+// Lazily resolved metadata of playlist items.
+//
+// Expanded albums and searches post their items with only the URI. The
+// title, artist, album and duration of each item are looked up later by the
+// session thread, most wanted first and only a few tracks at a time: by
+// default only once an item is opened, or is close after one that is. What
+// is found goes to the meta cache too (metacache.h, included before this),
+// and items of tracks that are in it already are filled in right away.
+
+#define META_QUEUE_MAX_INFLIGHT 4
+#define META_QUEUE_LOOKAHEAD 10
+// A track still loading after this long is given up on, so that it does
+// not keep its slot from the others
+#define META_QUEUE_TIMEOUT_US (10 * CLOCK_FREQ)
+
+typedef enum {
+    META_PRIORITY_NOW,          // The item is being opened (played or preparsed)
+    META_PRIORITY_NEAR,         // Close after an item that is being opened
+    META_PRIORITY_BACKGROUND,   // Whenever there is nothing else to do
+    META_PRIORITY_ON_DEMAND,    // Only once raised by meta_queue_prioritize()
+} meta_priority_e;
+
+// Any thread. Queue an item to get the metadata of the track psz_uri
+// (spotify:track:...). Holds a reference to the item until resolved. A
+// track that is queued already is looked up once for all its items, with
+// the highest priority any of them was added with.
+void meta_queue_add(input_item_t *p_item, const char *psz_uri, meta_priority_e priority);
+
+// Any thread. The track psz_uri is being opened: resolve it, and the
+// i_following items queued after it, before anything else.
+void meta_queue_prioritize(const char *psz_uri, int i_following);
+
+// Session thread. Start and finish lookups, called after each
+// sp_session_process_events().
+void meta_queue_process(vlc_object_t *p_obj);
+
+// Session thread. Drop everything that is queued, before the session is
+// released.
+void meta_queue_flush(void);
+
+// Session thread. The metadata of a loaded track, to be cleaned.
+void meta_read_track(sp_track *p_track, track_meta_t *p_meta);
+
+// Any thread
+void meta_set_item(input_item_t *p_item, const track_meta_t *p_meta);
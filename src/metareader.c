@@ -0,0 +1,225 @@
+/*****************************************************************************
+ * Copyright (C) 2015 Jonas Lundqvist
+ *
+ * Author: Jonas Lundqvist <jonas@gannon.se>
+ *
+ * This file is part of vlc-spotify.
+ *
+ * vlc-spotify is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+// VLC includes
+#include <vlc_common.h>
+#include <vlc_demux.h>
+#include <vlc_messages.h>
+#include <vlc_meta.h>
+#include <vlc_input.h>
+
+#include <libspotify/api.h>
+
+#include "uriparser.h"
+#include "session.h"
+#include "artcache.h"
+#include "metacache.h"
+#include "metaqueue.h"
+#include "metareader.h"
+#ifndef _WIN32
+#include "remote.h"
+#endif
+
+// How long to wait for a lookup, unless the user is logging in
+#define META_READER_TIMEOUT_US 5000000
+// How often the login is checked meanwhile
+#define META_READER_POLL_MS 100
+
+struct demux_sys_t {
+    track_meta_t meta;
+};
+
+static int MetaDemux(demux_t *p_demux);
+static int MetaControl(demux_t *p_demux, int i_query, va_list args);
+
+bool meta_reader_preparsing(demux_t *p_demux)
+{
+    return p_demux->p_input != NULL && p_demux->p_input->b_preparsing;
+}
+
+#ifndef _WIN32
+static bool lookup_remote(demux_t *p_demux, const char *psz_uri, track_meta_t *p_meta)
+{
+    char          *psz_socket = var_InheritString(p_demux, "spotify-daemon-socket");
+    remote_t      *p_remote;
+    remote_meta_t  meta;
+
+    if (psz_socket == NULL || *psz_socket == '\0') {
+        free(psz_socket);
+        psz_socket = remote_default_socket();
+    }
+    p_remote = psz_socket ? remote_connect(psz_socket) : NULL;
+    free(psz_socket);
+    if (p_remote == NULL)
+        return false;
+
+    msg_Dbg(p_demux, "> META %s", psz_uri);
+    if (remote_meta(p_remote, psz_uri, &meta)) {
+        msg_Dbg(p_demux, "Failed to look up %s: %s", psz_uri, remote_error(p_remote));
+        remote_close(p_remote);
+        return false;
+    }
+    remote_close(p_remote);
+
+    memset(p_meta, 0, sizeof(*p_meta));
+    p_meta->b_available = true;
+    p_meta->psz_title = meta.psz_title;
+    p_meta->psz_artist = meta.psz_artist;
+    p_meta->psz_album = meta.psz_album;
+    p_meta->i_duration = meta.i_duration_ms * INT64_C(1000);
+    meta_cache_put(psz_uri, p_meta);
+    return true;
+}
+#endif
+
+// A metadata-only lookup. The session is held without attaching to it, so
+// that a track that is playing keeps its callbacks.
+static bool lookup_session(demux_t *p_demux, const char *psz_uri, track_meta_t *p_meta)
+{
+    input_item_t *p_item = input_GetItem(p_demux->p_input);
+    mtime_t       deadline;
+    bool          b_found;
+
+    if (spotify_session_acquire(VLC_OBJECT(p_demux), NULL) == NULL)
+        return false;
+
+    // After the acquire, a session that was logging out would drop it
+    meta_queue_add(p_item, psz_uri, META_PRIORITY_NOW);
+    meta_queue_prioritize(psz_uri, var_InheritInteger(p_demux, "spotify-meta-lookahead"));
+    spotify_session_notify();
+
+    deadline = mdate() + META_READER_TIMEOUT_US;
+    while (!(b_found = meta_cache_wait(psz_uri, p_meta, META_READER_POLL_MS))) {
+        if (spotify_session_login_pending())
+            deadline = mdate() + META_READER_TIMEOUT_US;
+        else if (mdate() > deadline)
+            break;
+    }
+
+    spotify_session_release();
+    return b_found;
+}
+
+int MetaOpen(vlc_object_t *p_obj)
+{
+    demux_t      *p_demux = (demux_t *) p_obj;
+    demux_sys_t  *p_sys;
+    char         *psz_uri = NULL;
+    track_meta_t  meta;
+    bool          b_found;
+
+    if (!meta_reader_preparsing(p_demux))
+        return VLC_EGENERIC;
+
+    // Expanding albums and searches never plays anything, the demux does it
+    if (ParseURI(p_demux->psz_location, &psz_uri) != SPOTIFY_TRACK) {
+        free(psz_uri);
+        return VLC_EGENERIC;
+    }
+
+    b_found = meta_cache_get(psz_uri, &meta);
+    // The session lookup queues the cover itself, a cached one may be gone
+    if (b_found && meta.psz_art_id != NULL)
+        art_queue_add(input_GetItem(p_demux->p_input), meta.psz_art_id);
+#ifndef _WIN32
+    if (!b_found && var_InheritBool(p_obj, "spotify-daemon"))
+        b_found = lookup_remote(p_demux, psz_uri, &meta);
+#endif
+    if (!b_found)
+        b_found = lookup_session(p_demux, psz_uri, &meta);
+
+    if (!b_found || !meta.b_available) {
+        msg_Dbg(p_demux, "No metadata for %s", psz_uri);
+        if (b_found)
+            track_meta_clean(&meta);
+        free(psz_uri);
+        return VLC_EGENERIC;
+    }
+    free(psz_uri);
+
+    p_sys = malloc(sizeof(*p_sys));
+    if (!p_sys) {
+        track_meta_clean(&meta);
+        return VLC_ENOMEM;
+    }
+    p_sys->meta = meta;
+
+    p_demux->p_sys = p_sys;
+    p_demux->pf_demux = MetaDemux;
+    p_demux->pf_control = MetaControl;
+
+    return VLC_SUCCESS;
+}
+
+void MetaClose(vlc_object_t *p_obj)
+{
+    demux_t *p_demux = (demux_t *) p_obj;
+
+    track_meta_clean(&p_demux->p_sys->meta);
+    free(p_demux->p_sys);
+}
+
+static int MetaDemux(demux_t *p_demux)
+{
+    VLC_UNUSED(p_demux);
+
+    // Nothing to play
+    return 0;
+}
+
+static int MetaControl(demux_t *p_demux, int i_query, va_list args)
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    int64_t *pi64;
+    vlc_meta_t *p_meta;
+
+    switch(i_query)
+    {
+    case DEMUX_GET_LENGTH:
+        pi64 = (int64_t *) va_arg(args, int64_t *);
+        *pi64 = p_sys->meta.i_duration;
+        return VLC_SUCCESS;
+
+    case DEMUX_GET_META:
+        p_meta = (vlc_meta_t *) va_arg(args, vlc_meta_t *);
+        if (p_sys->meta.psz_title)
+            vlc_meta_Set(p_meta, vlc_meta_Title, p_sys->meta.psz_title);
+        if (p_sys->meta.psz_artist)
+            vlc_meta_Set(p_meta, vlc_meta_Artist, p_sys->meta.psz_artist);
+        if (p_sys->meta.psz_album)
+            vlc_meta_Set(p_meta, vlc_meta_Album, p_sys->meta.psz_album);
+        if (p_sys->meta.psz_art_id) {
+            char *psz_url = art_cached_url(p_sys->meta.psz_art_id);
+            if (psz_url) {
+                vlc_meta_Set(p_meta, vlc_meta_ArtworkURL, psz_url);
+                free(psz_url);
+            }
+        }
+        return VLC_SUCCESS;
+
+    default:
+        return VLC_EGENERIC;
+    }
+}
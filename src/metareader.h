@@ -0,0 +1,35 @@
+/*****************************************************************************
+ * Copyright (C) 2015 Jonas Lundqvist
+ *
+ * Author: Jonas Lundqvist <jonas@gannon.se>
+ *
+ * This file is part of vlc-spotify.
+ *
+ * vlc-spotify is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+// Preparsing of single tracks.
+//
+// VLC opens every item it preparses, and the demux in spotify.c would load
+// the player just to learn the title. This one is tried first and only
+// takes tracks that are being preparsed. It answers from the meta cache,
+// from vlc-spotifyd or from a lookup by the meta queue on the shared
+// session, and never touches the player.
+
+int MetaOpen(vlc_object_t *p_obj);
+void MetaClose(vlc_object_t *p_obj);
+
+// True if the demux is opened by the preparser
+bool meta_reader_preparsing(demux_t *p_demux);
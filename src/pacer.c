@@ -0,0 +1,62 @@
+/*****************************************************************************
+ * Copyright (C) 2015 Jonas Lundqvist
+ *
+ * Author: Jonas Lundqvist <jonas@gannon.se>
+ *
+ * This file is part of vlc-spotify.
+ *
+ * vlc-spotify is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "pacer.h"
+
+void pacer_init(pacer_t *p_pacer, int64_t i_now)
+{
+    p_pacer->i_start = i_now;
+    p_pacer->i_rate = PACER_RATE_DEFAULT;
+}
+
+int64_t pacer_time(const pacer_t *p_pacer, int64_t i_now)
+{
+    return pacer_media(p_pacer, i_now - p_pacer->i_start);
+}
+
+void pacer_set_time(pacer_t *p_pacer, int64_t i_time, int64_t i_now)
+{
+    p_pacer->i_start = i_now - pacer_wall(p_pacer, i_time);
+}
+
+void pacer_set_rate(pacer_t *p_pacer, int i_rate, int64_t i_now)
+{
+    int64_t i_time = pacer_time(p_pacer, i_now);
+
+    p_pacer->i_rate = i_rate;
+    pacer_set_time(p_pacer, i_time, i_now);
+}
+
+void pacer_delay(pacer_t *p_pacer, int64_t i_wall)
+{
+    p_pacer->i_start += i_wall;
+}
+
+int64_t pacer_media(const pacer_t *p_pacer, int64_t i_wall)
+{
+    return i_wall * PACER_RATE_DEFAULT / p_pacer->i_rate;
+}
+
+int64_t pacer_wall(const pacer_t *p_pacer, int64_t i_media)
+{
+    return i_media * p_pacer->i_rate / PACER_RATE_DEFAULT;
+}
@@ -0,0 +1,55 @@
+/*****************************************************************************
+ * Copyright (C) 2015 Jonas Lundqvist
+ *
+ * Author: Jonas Lundqvist <jonas@gannon.se>
+ *
+ * This file is part of vlc-spotify.
+ *
+ * vlc-spotify is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+// The pace of a track: which media time is being played at a given time,
+// at the playback rate.
+//
+// The deliveries are held back to a little ahead of it, so at twice the
+// speed the media time, and the audio to keep ahead, runs twice as fast.
+// A rate change moves the reference so that the media time goes on from
+// where it is, no seek needed.
+
+#include <stdint.h>
+
+// Same as VLC's INPUT_RATE_DEFAULT: the rate is the wall time per media
+// time, in thousandths. 500 is twice as fast.
+#define PACER_RATE_DEFAULT 1000
+
+typedef struct {
+    int64_t i_start;    // When the media time 0 was, or would have been, played
+    int     i_rate;
+} pacer_t;
+
+// The media time 0 is played at i_now, at the normal rate
+void pacer_init(pacer_t *p_pacer, int64_t i_now);
+// The media time played at i_now
+int64_t pacer_time(const pacer_t *p_pacer, int64_t i_now);
+// Make i_time the media time played at i_now
+void pacer_set_time(pacer_t *p_pacer, int64_t i_time, int64_t i_now);
+// From i_now on play at i_rate, going on from the media time played then
+void pacer_set_rate(pacer_t *p_pacer, int i_rate, int64_t i_now);
+// Nothing was played for the wall time i_wall
+void pacer_delay(pacer_t *p_pacer, int64_t i_wall);
+// The media time that plays in the wall time i_wall
+int64_t pacer_media(const pacer_t *p_pacer, int64_t i_wall);
+// The wall time that the media time i_media takes to play
+int64_t pacer_wall(const pacer_t *p_pacer, int64_t i_media);
@@ -0,0 +1,60 @@
+/*****************************************************************************
+ * Copyright (C) 2015 Jonas Lundqvist
+ *
+ * Author: Jonas Lundqvist <jonas@gannon.se>
+ *
+ * This file is part of vlc-spotify.
+ *
+ * vlc-spotify is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "playable.h"
+
+sp_track *track_playable(sp_session *p_session, sp_track *p_track,
+                         const char **ppsz_reason)
+{
+    sp_error   err = sp_track_error(p_track);
+    sp_track  *p_playable;
+
+    if (err != SP_ERROR_OK) {
+        *ppsz_reason = sp_error_message(err);
+        return NULL;
+    }
+
+    if (sp_track_is_local(p_session, p_track)) {
+        *ppsz_reason = "Local file, not streamed by Spotify";
+        return NULL;
+    }
+
+    // Relinked if the track itself is not available but an equal one is
+    p_playable = sp_track_get_playable(p_session, p_track);
+    if (p_playable == NULL)
+        p_playable = p_track;
+
+    switch (sp_track_get_availability(p_session, p_playable)) {
+    case SP_TRACK_AVAILABILITY_AVAILABLE:
+        return p_playable;
+    case SP_TRACK_AVAILABILITY_NOT_STREAMABLE:
+        *ppsz_reason = "Not streamable";
+        break;
+    case SP_TRACK_AVAILABILITY_BANNED_BY_ARTIST:
+        *ppsz_reason = "Banned by the artist";
+        break;
+    default:
+        *ppsz_reason = "Not available in this country";
+        break;
+    }
+    return NULL;
+}
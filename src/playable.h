@@ -0,0 +1,37 @@
+/*****************************************************************************
+ * Copyright (C) 2015 Jonas Lundqvist
+ *
+ * Author: Jonas Lundqvist <jonas@gannon.se>
+ *
+ * This file is part of vlc-spotify.
+ *
+ * vlc-spotify is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+// Whether a loaded track can be played, asked up front instead of loading
+// the player and waiting for audio that never comes.
+//
+// Only the session thread may call it, like any other libspotify call.
+
+#include <stdbool.h>
+#include <libspotify/api.h>
+
+// The track libspotify will play for p_track, which is another one when
+// it has been relinked, e.g. to the release in the user's country. NULL if
+// it can not be played, with the reason in *ppsz_reason. p_track must not
+// still be loading (sp_track_error() != SP_ERROR_IS_LOADING). The track
+// returned is owned by p_track, no reference is added.
+sp_track *track_playable(sp_session *p_session, sp_track *p_track,
+                         const char **ppsz_reason);
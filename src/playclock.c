@@ -0,0 +1,109 @@
+/*****************************************************************************
+ * Copyright (C) 2015 Jonas Lundqvist
+ *
+ * Author: Jonas Lundqvist <jonas@gannon.se>
+ *
+ * This file is part of vlc-spotify.
+ *
+ * vlc-spotify is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+
+#include "playclock.h"
+
+// The fields are atomics only so that the racing reads are defined, the
+// sequence count is what keeps them consistent
+struct playclock_t {
+    atomic_uint            i_seq;      // Odd while a publish is ongoing
+    atomic_int_least64_t   i_pts;
+    atomic_int_least64_t   i_start;
+    atomic_int             i_rate;
+    atomic_int_least64_t   i_offset;
+    atomic_int_least64_t   i_duration;
+    atomic_int_least64_t   i_track_start;
+    atomic_bool            b_paused;
+};
+
+playclock_t *playclock_new(void)
+{
+    playclock_t *p_clock = malloc(sizeof(*p_clock));
+
+    if (p_clock == NULL)
+        return NULL;
+
+    atomic_init(&p_clock->i_seq, 0);
+    atomic_init(&p_clock->i_pts, 0);
+    atomic_init(&p_clock->i_start, 0);
+    atomic_init(&p_clock->i_rate, 0);
+    atomic_init(&p_clock->i_offset, 0);
+    atomic_init(&p_clock->i_duration, 0);
+    atomic_init(&p_clock->i_track_start, 0);
+    atomic_init(&p_clock->b_paused, false);
+    return p_clock;
+}
+
+void playclock_delete(playclock_t *p_clock)
+{
+    free(p_clock);
+}
+
+void playclock_publish(playclock_t *p_clock, const playclock_snapshot_t *p_snapshot)
+{
+    unsigned i_seq = atomic_load_explicit(&p_clock->i_seq, memory_order_relaxed);
+
+    // Odd: readers retry until the fields below are all stored
+    atomic_store_explicit(&p_clock->i_seq, i_seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    atomic_store_explicit(&p_clock->i_pts, p_snapshot->i_pts, memory_order_relaxed);
+    atomic_store_explicit(&p_clock->i_start, p_snapshot->i_start, memory_order_relaxed);
+    atomic_store_explicit(&p_clock->i_rate, p_snapshot->i_rate, memory_order_relaxed);
+    atomic_store_explicit(&p_clock->i_offset, p_snapshot->i_offset, memory_order_relaxed);
+    atomic_store_explicit(&p_clock->i_duration, p_snapshot->i_duration, memory_order_relaxed);
+    atomic_store_explicit(&p_clock->i_track_start, p_snapshot->i_track_start, memory_order_relaxed);
+    atomic_store_explicit(&p_clock->b_paused, p_snapshot->b_paused, memory_order_relaxed);
+
+    atomic_store_explicit(&p_clock->i_seq, i_seq + 2, memory_order_release);
+}
+
+void playclock_read(playclock_t *p_clock, playclock_snapshot_t *p_snapshot)
+{
+    unsigned i_seq;
+
+    for (;;) {
+        i_seq = atomic_load_explicit(&p_clock->i_seq, memory_order_acquire);
+        if (i_seq & 1) {
+            // The writer is in the middle of it, which takes nanoseconds
+            // unless it was preempted
+            sched_yield();
+            continue;
+        }
+
+        p_snapshot->i_pts = atomic_load_explicit(&p_clock->i_pts, memory_order_relaxed);
+        p_snapshot->i_start = atomic_load_explicit(&p_clock->i_start, memory_order_relaxed);
+        p_snapshot->i_rate = atomic_load_explicit(&p_clock->i_rate, memory_order_relaxed);
+        p_snapshot->i_offset = atomic_load_explicit(&p_clock->i_offset, memory_order_relaxed);
+        p_snapshot->i_duration = atomic_load_explicit(&p_clock->i_duration, memory_order_relaxed);
+        p_snapshot->i_track_start = atomic_load_explicit(&p_clock->i_track_start, memory_order_relaxed);
+        p_snapshot->b_paused = atomic_load_explicit(&p_clock->b_paused, memory_order_relaxed);
+
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&p_clock->i_seq, memory_order_relaxed) == i_seq)
+            return;
+    }
+}
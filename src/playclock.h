@@ -0,0 +1,53 @@
+/*****************************************************************************
+ * Copyright (C) 2015 Jonas Lundqvist
+ *
+ * Author: Jonas Lundqvist <jonas@gannon.se>
+ *
+ * This file is part of vlc-spotify.
+ *
+ * vlc-spotify is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+// The playback clock of a track, for the demux control queries.
+//
+// The clock changes under audio_lock with every delivery, pause and seek,
+// while VLC polls the time and position many times a second. The writer
+// publishes a copy here under a sequence count and the queries read it
+// without any lock: a read that raced with a publish sees an odd or
+// changed count and is simply retried, so it is never torn and never
+// holds up a delivery.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct {
+    int64_t i_pts;          // Of the next sample to be delivered
+    int64_t i_start;        // When the PTS 0 was, or would have been, played
+    int     i_rate;         // Wall time per media time, 1000 is normal speed
+    int64_t i_offset;       // The PTS at the last pause or seek
+    int64_t i_duration;     // Of the track, 0 if not known yet
+    int64_t i_track_start;  // The PTS where the track begins, in an album
+    bool    b_paused;
+} playclock_snapshot_t;
+
+typedef struct playclock_t playclock_t;
+
+// Starts out all zero
+playclock_t *playclock_new(void);
+void playclock_delete(playclock_t *p_clock);
+// Only one writer at a time, the caller serialises them
+void playclock_publish(playclock_t *p_clock, const playclock_snapshot_t *p_snapshot);
+// Any thread, never blocks
+void playclock_read(playclock_t *p_clock, playclock_snapshot_t *p_snapshot);
@@ -0,0 +1,271 @@
+/*****************************************************************************
+ * Copyright (C) 2015 Jonas Lundqvist
+ *
+ * Author: Jonas Lundqvist <jonas@gannon.se>
+ *
+ * This file is part of vlc-spotify.
+ *
+ * vlc-spotify is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+#include "remote.h"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+#define REMOTE_LINE_MAX 4096
+
+struct remote_t {
+    int    fd;
+    char   psz_error[256];
+    // Received, not yet returned
+    char   buf[REMOTE_LINE_MAX];
+    size_t i_buf;
+};
+
+char *remote_default_socket(void)
+{
+    const char *psz_dir = getenv("XDG_RUNTIME_DIR");
+    size_t      i_len = (psz_dir ? strlen(psz_dir) : 0) + 64;
+    char       *psz_path = malloc(i_len);
+
+    if (psz_path == NULL)
+        return NULL;
+
+    if (psz_dir != NULL && *psz_dir != '\0')
+        snprintf(psz_path, i_len, "%s/vlc-spotifyd.sock", psz_dir);
+    else
+        snprintf(psz_path, i_len, "/tmp/vlc-spotifyd-%u.sock", (unsigned) getuid());
+    return psz_path;
+}
+
+remote_t *remote_connect(const char *psz_path)
+{
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    struct timeval     timeout = { .tv_sec = REMOTE_TIMEOUT_S };
+    remote_t          *p_remote;
+
+    if (strlen(psz_path) >= sizeof(addr.sun_path))
+        return NULL;
+    strcpy(addr.sun_path, psz_path);
+
+    p_remote = calloc(1, sizeof(*p_remote));
+    if (p_remote == NULL)
+        return NULL;
+
+    p_remote->fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (p_remote->fd < 0) {
+        free(p_remote);
+        return NULL;
+    }
+
+    // Loading a track can take a while, a daemon that hangs should not
+    // hang VLC forever though
+    setsockopt(p_remote->fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(p_remote->fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    if (connect(p_remote->fd, (struct sockaddr *) &addr, sizeof(addr))) {
+        close(p_remote->fd);
+        free(p_remote);
+        return NULL;
+    }
+
+    return p_remote;
+}
+
+void remote_close(remote_t *p_remote)
+{
+    if (p_remote == NULL)
+        return;
+    close(p_remote->fd);
+    free(p_remote);
+}
+
+const char *remote_error(remote_t *p_remote)
+{
+    return p_remote->psz_error;
+}
+
+void remote_meta_clean(remote_meta_t *p_meta)
+{
+    free(p_meta->psz_title);
+    free(p_meta->psz_artist);
+    free(p_meta->psz_album);
+    p_meta->psz_title = p_meta->psz_artist = p_meta->psz_album = NULL;
+}
+
+// Reads one line, without the '\n', into psz_line
+static int read_line(remote_t *p_remote, char *psz_line, size_t i_line)
+{
+    for (;;) {
+        char *p_end = memchr(p_remote->buf, '\n', p_remote->i_buf);
+        ssize_t i_read;
+
+        if (p_end != NULL) {
+            size_t i_len = p_end - p_remote->buf;
+
+            if (i_len >= i_line)
+                i_len = i_line - 1;
+            memcpy(psz_line, p_remote->buf, i_len);
+            psz_line[i_len] = '\0';
+
+            p_remote->i_buf -= p_end + 1 - p_remote->buf;
+            memmove(p_remote->buf, p_end + 1, p_remote->i_buf);
+            return 0;
+        }
+
+        if (p_remote->i_buf == sizeof(p_remote->buf))
+            return -1;
+
+        i_read = recv(p_remote->fd, p_remote->buf + p_remote->i_buf,
+                      sizeof(p_remote->buf) - p_remote->i_buf, 0);
+        if (i_read < 0 && errno == EINTR)
+            continue;
+        if (i_read <= 0)
+            return -1;
+        p_remote->i_buf += i_read;
+    }
+}
+
+// Sends a request and returns the arguments of the OK reply in psz_reply
+static int request(remote_t *p_remote, char *psz_reply, size_t i_reply,
+                   const char *psz_format, ...)
+{
+    char    psz_line[REMOTE_LINE_MAX];
+    va_list args;
+    int     i_len;
+    int     i_sent = 0;
+
+    va_start(args, psz_format);
+    i_len = vsnprintf(psz_line, sizeof(psz_line) - 1, psz_format, args);
+    va_end(args);
+    if (i_len < 0 || i_len >= (int) sizeof(psz_line) - 1) {
+        snprintf(p_remote->psz_error, sizeof(p_remote->psz_error), "Request too long");
+        return -1;
+    }
+    psz_line[i_len++] = '\n';
+
+    while (i_sent < i_len) {
+        ssize_t i_ret = send(p_remote->fd, psz_line + i_sent, i_len - i_sent, MSG_NOSIGNAL);
+        if (i_ret < 0 && errno == EINTR)
+            continue;
+        if (i_ret <= 0) {
+            snprintf(p_remote->psz_error, sizeof(p_remote->psz_error),
+                     "Lost the connection to the daemon");
+            return -1;
+        }
+        i_sent += i_ret;
+    }
+
+    if (read_line(p_remote, psz_line, sizeof(psz_line))) {
+        snprintf(p_remote->psz_error, sizeof(p_remote->psz_error),
+                 "No reply from the daemon");
+        return -1;
+    }
+
+    if (strncmp(psz_line, "OK", 2) == 0 && (psz_line[2] == '\0' || psz_line[2] == ' ')) {
+        if (psz_reply != NULL)
+            snprintf(psz_reply, i_reply, "%s", psz_line[2] ? psz_line + 3 : "");
+        return 0;
+    }
+
+    snprintf(p_remote->psz_error, sizeof(p_remote->psz_error), "%.255s",
+             strncmp(psz_line, "ERR ", 4) == 0 ? psz_line + 4 : psz_line);
+    return -1;
+}
+
+static char *next_field(char **ppsz)
+{
+    char *psz_field = *ppsz;
+    char *psz_tab;
+
+    if (psz_field == NULL)
+        return NULL;
+
+    psz_tab = strchr(psz_field, '\t');
+    if (psz_tab != NULL) {
+        *psz_tab = '\0';
+        *ppsz = psz_tab + 1;
+    } else {
+        *ppsz = NULL;
+    }
+
+    return *psz_field ? strdup(psz_field) : NULL;
+}
+
+int remote_meta(remote_t *p_remote, const char *psz_uri, remote_meta_t *p_meta)
+{
+    char  psz_reply[REMOTE_LINE_MAX];
+    char *psz_fields;
+
+    memset(p_meta, 0, sizeof(*p_meta));
+    if (request(p_remote, psz_reply, sizeof(psz_reply), "META %s", psz_uri))
+        return -1;
+
+    p_meta->i_duration_ms = strtol(psz_reply, &psz_fields, 10);
+    if (*psz_fields == '\t')
+        psz_fields++;
+    else
+        psz_fields = NULL;
+
+    p_meta->psz_title = next_field(&psz_fields);
+    p_meta->psz_artist = next_field(&psz_fields);
+    p_meta->psz_album = next_field(&psz_fields);
+    return 0;
+}
+
+int remote_play(remote_t *p_remote, const char *psz_uri, const char *psz_ring,
+                int *pi_duration_ms)
+{
+    char psz_reply[64];
+
+    if (request(p_remote, psz_reply, sizeof(psz_reply), "PLAY %s %s", psz_uri, psz_ring))
+        return -1;
+
+    *pi_duration_ms = atoi(psz_reply);
+    return 0;
+}
+
+int remote_pause(remote_t *p_remote, bool b_pause)
+{
+    return request(p_remote, NULL, 0, "PAUSE %d", b_pause);
+}
+
+int remote_seek(remote_t *p_remote, int i_ms, uint64_t *pi_head)
+{
+    char psz_reply[64];
+
+    if (request(p_remote, psz_reply, sizeof(psz_reply), "SEEK %d", i_ms))
+        return -1;
+
+    *pi_head = strtoull(psz_reply, NULL, 10);
+    return 0;
+}
+
+int remote_stop(remote_t *p_remote)
+{
+    return request(p_remote, NULL, 0, "STOP");
+}
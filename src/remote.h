@@ -0,0 +1,68 @@
+/*****************************************************************************
+ * Copyright (C) 2015 Jonas Lundqvist
+ *
+ * Author: Jonas Lundqvist <jonas@gannon.se>
+ *
+ * This file is part of vlc-spotify.
+ *
+ * vlc-spotify is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+// Client side of the vlc-spotifyd protocol.
+//
+// The daemon owns the Spotify session and serves requests on a Unix socket.
+// Each request is one line and gets one line back, "OK [args]" or
+// "ERR <message>":
+//
+//   META <uri>            -> OK <duration ms>\t<title>\t<artist>\t<album>
+//   PLAY <uri> <ring>     -> OK <duration ms>    PCM goes to the shmring <ring>
+//   PAUSE <0|1>           -> OK
+//   SEEK <ms>             -> OK <ring head>      Discard the ring up to <ring head>
+//   STOP                  -> OK
+//
+// Only one client plays at a time. A PLAY from another client stops the
+// current one, which sees SHMRING_STOPPED in its ring.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define REMOTE_TIMEOUT_S 15
+
+typedef struct remote_t remote_t;
+
+typedef struct {
+    int   i_duration_ms;
+    char *psz_title;
+    char *psz_artist;
+    char *psz_album;
+} remote_meta_t;
+
+// The socket used when none is given: $XDG_RUNTIME_DIR/vlc-spotifyd.sock,
+// or /tmp/vlc-spotifyd-<uid>.sock. To be freed.
+char *remote_default_socket(void);
+
+remote_t *remote_connect(const char *psz_path);
+void remote_close(remote_t *p_remote);
+
+// All return 0 on success. On failure remote_error() tells why.
+int remote_meta(remote_t *p_remote, const char *psz_uri, remote_meta_t *p_meta);
+int remote_play(remote_t *p_remote, const char *psz_uri, const char *psz_ring,
+                int *pi_duration_ms);
+int remote_pause(remote_t *p_remote, bool b_pause);
+int remote_seek(remote_t *p_remote, int i_ms, uint64_t *pi_head);
+int remote_stop(remote_t *p_remote);
+const char *remote_error(remote_t *p_remote);
+
+void remote_meta_clean(remote_meta_t *p_meta);
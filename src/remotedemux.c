@@ -0,0 +1,342 @@
+/*****************************************************************************
+ * Copyright (C) 2015 Jonas Lundqvist
+ *
+ * Author: Jonas Lundqvist <jonas@gannon.se>
+ *
+ * This file is part of vlc-spotify.
+ *
+ * vlc-spotify is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// VLC includes
+#include <vlc_common.h>
+#include <vlc_demux.h>
+#include <vlc_messages.h>
+#include <vlc_meta.h>
+#include <vlc_atomic.h>
+
+#include "uriparser.h"
+#include "remote.h"
+#include "remotedemux.h"
+#include "metareader.h"
+#include "shmring.h"
+
+// About 6 s of 44.1 kHz stereo. The ring is the only buffer between the
+// daemon and VLC, the daemon only decodes as fast as this is emptied.
+#define REMOTE_RING_SIZE (1 << 20)
+// How long RemoteDemux() waits when the ring is empty
+#define REMOTE_POLL_INTERVAL_US 20000
+// Largest block sent at once
+#define REMOTE_MAX_FRAMES 4096
+
+struct demux_sys_t {
+    remote_t    *p_remote;
+    shmring_t   *p_ring;
+    char        *psz_uri;
+
+    es_out_id_t *p_es_audio;
+    unsigned     i_frame_size;
+    date_t       pts;
+    mtime_t      duration;
+
+    char        *psz_meta_track;
+    char        *psz_meta_artist;
+    char        *psz_meta_album;
+};
+
+static int RemoteDemux(demux_t *p_demux);
+static int RemoteControl(demux_t *p_demux, int i_query, va_list args);
+
+int RemoteOpen(vlc_object_t *p_obj)
+{
+    static atomic_uint i_rings = ATOMIC_VAR_INIT(0);
+    demux_t       *p_demux = (demux_t *) p_obj;
+    demux_sys_t   *p_sys;
+    char          *psz_uri = NULL;
+    char          *psz_socket;
+    char           psz_ring[64];
+    remote_meta_t  meta;
+    int            i_duration_ms;
+
+    // Preparsing is left to the meta reader, which never plays
+    if (!var_InheritBool(p_obj, "spotify-daemon") || meta_reader_preparsing(p_demux))
+        return VLC_EGENERIC;
+
+    // Albums and searches are expanded by the session in this process
+    if (ParseURI(p_demux->psz_location, &psz_uri) != SPOTIFY_TRACK) {
+        free(psz_uri);
+        return VLC_EGENERIC;
+    }
+
+    p_sys = calloc(1, sizeof(*p_sys));
+    if (!p_sys) {
+        free(psz_uri);
+        return VLC_ENOMEM;
+    }
+    p_sys->psz_uri = psz_uri;
+
+    psz_socket = var_InheritString(p_obj, "spotify-daemon-socket");
+    if (psz_socket == NULL || *psz_socket == '\0') {
+        free(psz_socket);
+        psz_socket = remote_default_socket();
+    }
+    p_sys->p_remote = psz_socket ? remote_connect(psz_socket) : NULL;
+    if (p_sys->p_remote == NULL) {
+        msg_Warn(p_demux, "vlc-spotifyd is not running on %s, not using it", psz_socket);
+        free(psz_socket);
+        goto error;
+    }
+    msg_Dbg(p_demux, "Connected to vlc-spotifyd on %s", psz_socket);
+    free(psz_socket);
+
+    msg_Dbg(p_demux, "> META %s", p_sys->psz_uri);
+    if (remote_meta(p_sys->p_remote, p_sys->psz_uri, &meta)) {
+        msg_Err(p_demux, "Failed to look up %s: %s", p_sys->psz_uri,
+                remote_error(p_sys->p_remote));
+        goto error;
+    }
+    p_sys->psz_meta_track = meta.psz_title;
+    p_sys->psz_meta_artist = meta.psz_artist;
+    p_sys->psz_meta_album = meta.psz_album;
+
+    snprintf(psz_ring, sizeof(psz_ring), "/vlc-spotify-%d-%u", (int) getpid(),
+             atomic_fetch_add(&i_rings, 1));
+    p_sys->p_ring = shmring_create(psz_ring, REMOTE_RING_SIZE);
+    if (p_sys->p_ring == NULL) {
+        msg_Err(p_demux, "Failed to create the shared memory %s", psz_ring);
+        goto error;
+    }
+
+    msg_Dbg(p_demux, "> PLAY %s %s", p_sys->psz_uri, psz_ring);
+    if (remote_play(p_sys->p_remote, p_sys->psz_uri, psz_ring, &i_duration_ms)) {
+        msg_Err(p_demux, "Failed to play %s: %s", p_sys->psz_uri,
+                remote_error(p_sys->p_remote));
+        shmring_unlink(psz_ring);
+        goto error;
+    }
+    // Both sides have it mapped now, and nothing is left behind if either dies
+    shmring_unlink(psz_ring);
+    p_sys->duration = (mtime_t) i_duration_ms * 1000;
+
+    p_demux->p_sys = p_sys;
+    p_demux->pf_demux = RemoteDemux;
+    p_demux->pf_control = RemoteControl;
+
+    return VLC_SUCCESS;
+
+error:
+    if (p_sys->p_ring)
+        shmring_close(p_sys->p_ring);
+    remote_close(p_sys->p_remote);
+    free(p_sys->psz_meta_track);
+    free(p_sys->psz_meta_artist);
+    free(p_sys->psz_meta_album);
+    free(p_sys->psz_uri);
+    free(p_sys);
+    return VLC_EGENERIC;
+}
+
+void RemoteClose(vlc_object_t *p_obj)
+{
+    demux_t     *p_demux = (demux_t *) p_obj;
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    // Fails if another client has taken over the player, which is fine
+    msg_Dbg(p_demux, "> STOP");
+    remote_stop(p_sys->p_remote);
+    remote_close(p_sys->p_remote);
+    shmring_close(p_sys->p_ring);
+
+    if (p_sys->p_es_audio)
+        es_out_Del(p_demux->out, p_sys->p_es_audio);
+
+    free(p_sys->psz_meta_track);
+    free(p_sys->psz_meta_artist);
+    free(p_sys->psz_meta_album);
+    free(p_sys->psz_uri);
+    free(p_sys);
+}
+
+static int create_es(demux_t *p_demux)
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    unsigned     i_rate, i_channels;
+    es_format_t  fmt;
+
+    if (!shmring_get_format(p_sys->p_ring, &i_rate, &i_channels))
+        return VLC_EGENERIC;
+
+    es_format_Init(&fmt, AUDIO_ES, VLC_CODEC_S16N);
+    fmt.audio.i_channels = i_channels;
+    fmt.audio.i_rate = i_rate;
+    fmt.audio.i_bitspersample = 8 * sizeof(int16_t);
+    fmt.audio.i_blockalign = fmt.audio.i_bitspersample * i_channels / 8;
+    fmt.i_bitrate = fmt.audio.i_rate * fmt.audio.i_bitspersample * fmt.audio.i_channels;
+
+    p_sys->p_es_audio = es_out_Add(p_demux->out, &fmt);
+    if (p_sys->p_es_audio == NULL)
+        return VLC_EGENERIC;
+
+    p_sys->i_frame_size = fmt.audio.i_blockalign;
+    date_Init(&p_sys->pts, i_rate, 1);
+    date_Set(&p_sys->pts, VLC_TS_0);
+    return VLC_SUCCESS;
+}
+
+static int RemoteDemux(demux_t *p_demux)
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    // Before peeking: everything written before a flag was set is seen then
+    unsigned     i_flags = shmring_flags(p_sys->p_ring);
+    const void  *p_data;
+    size_t       i_size = shmring_peek(p_sys->p_ring, &p_data);
+    block_t     *p_block;
+    mtime_t      pts;
+
+    if (i_size == 0) {
+        if (i_flags & SHMRING_STOPPED) {
+            msg_Warn(p_demux, "vlc-spotifyd stopped playing %s", p_sys->psz_uri);
+            return 0;
+        }
+        if (i_flags & SHMRING_EOS)
+            return 0;
+
+#undef msleep
+        // Nothing from the daemon yet, do not hammer the CPU
+        msleep(REMOTE_POLL_INTERVAL_US);
+        return 1;
+    }
+
+    if (p_sys->p_es_audio == NULL && create_es(p_demux)) {
+        msg_Err(p_demux, "No audio format from vlc-spotifyd");
+        return -1;
+    }
+
+    // The daemon writes whole frames and the ring size is a multiple of
+    // every stereo or mono frame size, so frames never wrap around
+    if (i_size > REMOTE_MAX_FRAMES * p_sys->i_frame_size)
+        i_size = REMOTE_MAX_FRAMES * p_sys->i_frame_size;
+    i_size -= i_size % p_sys->i_frame_size;
+    if (i_size == 0)
+        return 1;
+
+    p_block = block_Alloc(i_size);
+    if (unlikely(p_block == NULL))
+        return 1;
+
+    // The only copy of the samples on this side, straight out of the
+    // mapping into the block
+    memcpy(p_block->p_buffer, p_data, i_size);
+    shmring_consume(p_sys->p_ring, i_size);
+
+    pts = date_Get(&p_sys->pts);
+    p_block->i_pts = p_block->i_dts = pts;
+    p_block->i_length = date_Increment(&p_sys->pts, i_size / p_sys->i_frame_size) - pts;
+    p_block->i_nb_samples = i_size / p_sys->i_frame_size;
+
+    es_out_Control(p_demux->out, ES_OUT_SET_PCR, pts);
+    es_out_Send(p_demux->out, p_sys->p_es_audio, p_block);
+
+    return 1;
+}
+
+static int remote_seek_to(demux_t *p_demux, mtime_t time)
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    uint64_t     i_head;
+
+    msg_Dbg(p_demux, "> SEEK %"PRId64, time / 1000);
+    if (remote_seek(p_sys->p_remote, time / 1000, &i_head)) {
+        msg_Err(p_demux, "Seek failed: %s", remote_error(p_sys->p_remote));
+        return VLC_EGENERIC;
+    }
+
+    // What is in the ring up to the head at the time of the seek is from
+    // the old position
+    shmring_discard(p_sys->p_ring, i_head);
+    if (p_sys->p_es_audio != NULL)
+        date_Set(&p_sys->pts, VLC_TS_0 + time);
+    es_out_Control(p_demux->out, ES_OUT_RESET_PCR);
+    return VLC_SUCCESS;
+}
+
+static int RemoteControl(demux_t *p_demux, int i_query, va_list args)
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    bool *pb;
+    bool b;
+    int64_t *pi64;
+    double *pd;
+    vlc_meta_t *p_meta;
+
+    switch(i_query)
+    {
+    case DEMUX_CAN_PAUSE:
+    case DEMUX_CAN_SEEK:
+    case DEMUX_CAN_CONTROL_PACE:
+        pb = (bool *) va_arg(args, bool *);
+        *pb = true;
+        return VLC_SUCCESS;
+
+    case DEMUX_SET_PAUSE_STATE:
+        b = (bool) va_arg(args, int);
+        msg_Dbg(p_demux, "> PAUSE %d", b);
+        return remote_pause(p_sys->p_remote, b) ? VLC_EGENERIC : VLC_SUCCESS;
+
+    case DEMUX_SET_TIME:
+        return remote_seek_to(p_demux, (int64_t) va_arg(args, int64_t));
+
+    case DEMUX_SET_POSITION:
+        return remote_seek_to(p_demux, (double) va_arg(args, double) * p_sys->duration);
+
+    case DEMUX_GET_TIME:
+        pi64 = (int64_t *) va_arg(args, int64_t *);
+        *pi64 = p_sys->p_es_audio ? date_Get(&p_sys->pts) - VLC_TS_0 : 0;
+        return VLC_SUCCESS;
+
+    case DEMUX_GET_POSITION:
+        pd = (double *) va_arg(args, double *);
+        *pd = p_sys->duration > 0 && p_sys->p_es_audio ?
+              (double) (date_Get(&p_sys->pts) - VLC_TS_0) / p_sys->duration : 0.0;
+        return VLC_SUCCESS;
+
+    case DEMUX_GET_LENGTH:
+        pi64 = (int64_t *) va_arg(args, int64_t *);
+        *pi64 = p_sys->duration;
+        return VLC_SUCCESS;
+
+    case DEMUX_GET_PTS_DELAY:
+        pi64 = (int64_t *) va_arg(args, int64_t *);
+        *pi64 = INT64_C(1000) * var_InheritInteger(p_demux, "live-caching");
+        return VLC_SUCCESS;
+
+    case DEMUX_GET_META:
+        p_meta = (vlc_meta_t *) va_arg(args, vlc_meta_t *);
+        if (p_sys->psz_meta_track)
+            vlc_meta_Set(p_meta, vlc_meta_Title, p_sys->psz_meta_track);
+        if (p_sys->psz_meta_artist)
+            vlc_meta_Set(p_meta, vlc_meta_Artist, p_sys->psz_meta_artist);
+        if (p_sys->psz_meta_album)
+            vlc_meta_Set(p_meta, vlc_meta_Album, p_sys->psz_meta_album);
+        return VLC_SUCCESS;
+
+    default:
+        return VLC_EGENERIC;
+    }
+}
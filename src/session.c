@@ -0,0 +1,1246 @@
+/*****************************************************************************
+ * Copyright (C) 2015 Jonas Lundqvist
+ *
+ * Author: Jonas Lundqvist <jonas@gannon.se>
+ *
+ * This file is part of vlc-spotify.
+ *
+ * vlc-spotify is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+#define HAVE_EPOLL 1
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#endif
+
+// VLC includes
+#include <vlc_common.h>
+#include <vlc_messages.h>
+#include <vlc_threads.h>
+#include <vlc_atomic.h>
+#include <vlc_dialog.h>
+
+#include <libspotify/api.h>
+
+#include "session.h"
+#include "artcache.h"
+#include "metacache.h"
+#include "metaqueue.h"
+#include "cbtrace.h"
+#include "library.h"
+#include "membudget.h"
+#include "startlog.h"
+#include "spsession.h"
+
+typedef enum {
+    SESSION_STOPPED,    // No thread and no sp_session
+    SESSION_RUNNING,    // Thread running, logging in or logged in
+    SESSION_LOGOUT,     // sp_session_logout() called, waiting for logged_out
+    SESSION_EXITED,     // Thread has returned and needs to be joined
+} session_state_e;
+
+typedef enum {
+    CMD_PLAY,
+    CMD_SEEK,
+    CMD_LOAD,
+    CMD_PREFETCH,
+    CMD_RECHECK,
+    CMD_RELEASE,
+} session_cmd_e;
+
+// A request from another thread, executed by the session thread
+typedef struct session_cmd_t session_cmd_t;
+struct session_cmd_t {
+    session_cmd_e      type;
+    spotify_release_e  release;
+    spotify_client_t  *p_client;    // Who asked, for CMD_LOAD and CMD_RECHECK
+    union {
+        bool           b;
+        int            i;
+        void          *p;
+    } arg;
+    session_cmd_t     *p_next;
+};
+
+static struct {
+    // Protects everything except the client and the wakeup
+    vlc_mutex_t        lock;
+    vlc_cond_t         wait;
+
+    // Coalesces notifications: only the first one since the session thread
+    // last woke up does the actual wakeup.
+    atomic_bool        wakeup_pending;
+
+    // Set from the connection callbacks, handled by the session thread
+    atomic_bool        connection_changed;
+    atomic_int         connection_error;
+#ifdef HAVE_EPOLL
+    int                epoll_fd;
+    int                event_fd;
+    int                timer_fd;
+#endif
+
+    // Protects the clients and the player owner. Held while calling into a
+    // client.
+    vlc_mutex_t        client_lock;
+    spotify_client_t  *p_clients;
+    // Whose callback is running, for spotify_session_player_load_now()
+    spotify_client_t  *p_calling;
+
+    vlc_object_t      *p_obj;
+    vlc_thread_t       thread;
+    session_state_e    state;
+    sp_session        *p_session;
+
+    bool               logged_in;
+    bool               start_pending;
+    bool               manual_login_ongoing;
+    int                refs;
+
+    // The time when the session should log out, 0 when not scheduled
+    mtime_t            logout_deadline;
+    mtime_t            logout_delay;
+    // When sp_session_logout() was called, logged_out is not waited for
+    // longer than SPOTIFY_LOGOUT_TIMEOUT_S after it
+    mtime_t            logout_started;
+    // The plugin is being unloaded, log out now and end the thread
+    bool               shutdown;
+
+    char              *psz_username;
+    sp_bitrate         bitrate;
+
+    session_cmd_t     *p_cmd_first;
+    session_cmd_t    **pp_cmd_last;
+
+    // The callbacks of this session are recorded here, if asked for. Set
+    // before the session is created and closed after it is released.
+    cbtrace_t         *p_trace;
+
+    // When this session was started, from the acquire that created it
+    startlog_t         startup;
+    // The timelines of the tracks opened in this session, created by the
+    // first one if spotify-startup-stats is set
+    startlog_stats_t  *p_startup_stats;
+
+    // Session thread. As last logged.
+    bool               over_budget;
+
+    // Session thread. The track in the player and the client that loaded
+    // it, written with the client lock held. The client is NULL once it has
+    // detached, and the player callbacks go nowhere until the next load.
+    sp_track          *p_player_track;
+    spotify_client_t  *p_player_client;
+} g_spotify = {
+    .lock = VLC_STATIC_MUTEX,
+    .wait = VLC_STATIC_COND,
+    .client_lock = VLC_STATIC_MUTEX,
+    .state = SESSION_STOPPED,
+};
+
+static char *credentials = NULL;
+
+static void *spotify_main_loop(void *data);
+static bool client_attached(const spotify_client_t *p_client);
+static void start_clients(sp_error error);
+static void dispatch_connection_change(void);
+static void run_commands(void);
+static void post_command(session_cmd_t *p_cmd);
+static int  wakeup_init(void);
+static void wakeup_clean(void);
+static void wakeup_signal(void);
+static void wakeup_wait(mtime_t deadline);
+static void trace_event(cbtrace_type_e type, unsigned i_state, unsigned i_value);
+static void trace_open(vlc_object_t *p_obj);
+
+static SP_CALLCONV void spotify_logged_in(sp_session *session, sp_error error);
+static SP_CALLCONV void spotify_logged_out(sp_session *session);
+static SP_CALLCONV void spotify_log_message(sp_session *session, const char *msg);
+static SP_CALLCONV void spotify_notify_main_thread(sp_session *session);
+static SP_CALLCONV int spotify_music_delivery(sp_session *session,
+                                              const sp_audioformat *format,
+                                              const void *frames, int num_frames);
+static SP_CALLCONV void spotify_metadata_updated(sp_session *session);
+static SP_CALLCONV void spotify_message_to_user(sp_session *session, const char *msg);
+static SP_CALLCONV void spotify_play_token_lost(sp_session *session);
+static SP_CALLCONV void spotify_end_of_track(sp_session *session);
+static SP_CALLCONV void spotify_credentials_blob_updated(sp_session *session,
+                                                         const char *blob);
+static SP_CALLCONV void spotify_connectionstate_updated(sp_session *session);
+static SP_CALLCONV void spotify_userinfo_updated(sp_session *session);
+
+static SP_CALLCONV void spotify_connection_error(sp_session *session, sp_error error);
+static SP_CALLCONV void spotify_streaming_error(sp_session *session, sp_error error);
+
+static sp_session_callbacks spotify_session_callbacks = {
+    .logged_in = &spotify_logged_in,
+    .logged_out = &spotify_logged_out,
+    .notify_main_thread = &spotify_notify_main_thread,
+    .music_delivery = &spotify_music_delivery,
+    .metadata_updated = &spotify_metadata_updated,
+    .play_token_lost = &spotify_play_token_lost,
+    .log_message = &spotify_log_message,
+    .message_to_user = &spotify_message_to_user,
+    .end_of_track = &spotify_end_of_track,
+    .credentials_blob_updated = &spotify_credentials_blob_updated,
+    .connectionstate_updated = &spotify_connectionstate_updated,
+    .userinfo_updated = &spotify_userinfo_updated,
+    .connection_error = &spotify_connection_error,
+    .streaming_error = &spotify_streaming_error
+};
+
+sp_session *spotify_session_acquire(vlc_object_t *p_obj, spotify_client_t *p_client)
+{
+    sp_session *p_session = NULL;
+    mtime_t     deadline;
+
+    vlc_mutex_lock(&g_spotify.lock);
+
+    // The previous session has logged out, reap its thread before starting over
+    if (g_spotify.state == SESSION_EXITED) {
+        vlc_mutex_unlock(&g_spotify.lock);
+        vlc_join(g_spotify.thread, NULL);
+        vlc_mutex_lock(&g_spotify.lock);
+        g_spotify.state = SESSION_STOPPED;
+    }
+
+    // A logout is already on its way, wait for it to finish. The session
+    // thread gives up on logged_out after SPOTIFY_LOGOUT_TIMEOUT_S, so this
+    // is only a guard against a thread stuck in libspotify.
+    deadline = mdate() + (SPOTIFY_LOGOUT_TIMEOUT_S + 1) * CLOCK_FREQ;
+    while (g_spotify.state == SESSION_LOGOUT) {
+        if (vlc_cond_timedwait(&g_spotify.wait, &g_spotify.lock, deadline) &&
+            g_spotify.state == SESSION_LOGOUT) {
+            msg_Err(p_obj, "The previous session did not finish logging out");
+            vlc_mutex_unlock(&g_spotify.lock);
+            return NULL;
+        }
+    }
+
+    if (g_spotify.state == SESSION_EXITED) {
+        vlc_mutex_unlock(&g_spotify.lock);
+        vlc_join(g_spotify.thread, NULL);
+        vlc_mutex_lock(&g_spotify.lock);
+        g_spotify.state = SESSION_STOPPED;
+    }
+
+    // Attach before the thread is started so that an early login failure
+    // reaches the client
+    if (p_client != NULL) {
+        spotify_client_t **pp_last;
+
+        vlc_mutex_lock(&g_spotify.client_lock);
+        for (pp_last = &g_spotify.p_clients; *pp_last != NULL; pp_last = &(*pp_last)->p_next);
+        p_client->p_next = NULL;
+        p_client->b_started = false;
+        *pp_last = p_client;
+        vlc_mutex_unlock(&g_spotify.client_lock);
+    }
+
+    // Process wide, as set for the latest item
+    membudget_set_limit((size_t) var_InheritInteger(p_obj, "spotify-memory-budget") * 1024 * 1024);
+
+    if (g_spotify.state == SESSION_STOPPED) {
+        // The session outlives the demux, so anything that needs an object
+        // after Open() (dialogs, logging) uses the libvlc instance.
+        g_spotify.p_obj = VLC_OBJECT(p_obj->p_libvlc);
+        g_spotify.psz_username = var_InheritString(p_obj, "spotify-username");
+        g_spotify.bitrate = var_InheritInteger(p_obj, "preferred_bitrate");
+        g_spotify.logged_in = false;
+        g_spotify.p_cmd_first = NULL;
+        g_spotify.pp_cmd_last = &g_spotify.p_cmd_first;
+        g_spotify.p_session = NULL;
+        startlog_begin(&g_spotify.startup, mdate());
+
+        if (wakeup_init()) {
+            msg_Err(p_obj, "Failed to set up the session event loop");
+            spotify_session_detach(p_client);
+            free(g_spotify.psz_username);
+            g_spotify.psz_username = NULL;
+            vlc_mutex_unlock(&g_spotify.lock);
+            return NULL;
+        }
+
+        trace_open(p_obj);
+
+        sp_session_config spconfig;
+        spsession_config(&spconfig, "vlc-spotify", &spotify_session_callbacks);
+        // TODO: cache and settings under the vlc data directory?
+        spconfig.compress_playlists = var_InheritBool(p_obj, "spotify-compress-playlists");
+        spconfig.dont_save_metadata_for_playlists =
+            !var_InheritBool(p_obj, "spotify-save-playlist-metadata");
+        spconfig.initially_unload_playlists = var_InheritBool(p_obj, "spotify-unload-playlists");
+        msg_Dbg(p_obj, "> sp_session_create()");
+        sp_error err = sp_session_create(&spconfig, &g_spotify.p_session);
+        startlog_mark(&g_spotify.startup, STARTLOG_SESSION_CREATE, mdate());
+        if (SP_ERROR_OK != err) {
+            dialog_Fatal(p_obj, "Spotify session error: ", "%s", sp_error_message(err));
+            cbtrace_close(g_spotify.p_trace);
+            g_spotify.p_trace = NULL;
+            wakeup_clean();
+            spotify_session_detach(p_client);
+            free(g_spotify.psz_username);
+            g_spotify.psz_username = NULL;
+            vlc_mutex_unlock(&g_spotify.lock);
+            return NULL;
+        }
+
+        g_spotify.state = SESSION_RUNNING;
+        if (vlc_clone(&g_spotify.thread, spotify_main_loop, NULL, VLC_THREAD_PRIORITY_LOW)) {
+            sp_session_release(g_spotify.p_session);
+            g_spotify.p_session = NULL;
+            g_spotify.state = SESSION_STOPPED;
+            cbtrace_close(g_spotify.p_trace);
+            g_spotify.p_trace = NULL;
+            wakeup_clean();
+            spotify_session_detach(p_client);
+            free(g_spotify.psz_username);
+            g_spotify.psz_username = NULL;
+            vlc_mutex_unlock(&g_spotify.lock);
+            return NULL;
+        }
+    } else {
+        msg_Dbg(p_obj, "Reusing the running spotify session");
+    }
+
+    g_spotify.logout_delay = CLOCK_FREQ * var_InheritInteger(p_obj, "spotify-logout-delay");
+    g_spotify.logout_deadline = 0;
+    g_spotify.refs++;
+    p_session = g_spotify.p_session;
+
+    // Let the session thread tell the client when it is logged in. This is
+    // done right away if the session already is.
+    g_spotify.start_pending = true;
+    vlc_mutex_unlock(&g_spotify.lock);
+
+    wakeup_signal();
+
+    return p_session;
+}
+
+void spotify_session_detach(spotify_client_t *p_client)
+{
+    vlc_mutex_lock(&g_spotify.client_lock);
+    for (spotify_client_t **pp = &g_spotify.p_clients; *pp != NULL; pp = &(*pp)->p_next)
+        if (*pp == p_client) {
+            *pp = p_client->p_next;
+            break;
+        }
+    // The player is left to be unloaded when its track is released
+    if (g_spotify.p_player_client == p_client)
+        g_spotify.p_player_client = NULL;
+    vlc_mutex_unlock(&g_spotify.client_lock);
+}
+
+// With the client lock held
+static bool client_attached(const spotify_client_t *p_client)
+{
+    for (spotify_client_t *p = g_spotify.p_clients; p != NULL; p = p->p_next)
+        if (p == p_client)
+            return true;
+    return false;
+}
+
+bool spotify_session_lock_client(spotify_client_t *p_client)
+{
+    vlc_mutex_lock(&g_spotify.client_lock);
+    if (p_client != NULL && client_attached(p_client))
+        return true;
+    vlc_mutex_unlock(&g_spotify.client_lock);
+    return false;
+}
+
+void spotify_session_unlock_client(void)
+{
+    vlc_mutex_unlock(&g_spotify.client_lock);
+}
+
+void spotify_session_release(void)
+{
+    vlc_mutex_lock(&g_spotify.lock);
+    // Coalesce the logout: a release only moves the deadline forward and an
+    // acquire cancels it.
+    if (--g_spotify.refs == 0) {
+        g_spotify.start_pending = false;
+        g_spotify.logout_deadline = mdate() + g_spotify.logout_delay;
+    }
+    vlc_mutex_unlock(&g_spotify.lock);
+
+    wakeup_signal();
+}
+
+void spotify_session_shutdown(void)
+{
+    bool b_running;
+
+    vlc_mutex_lock(&g_spotify.lock);
+    if (g_spotify.state == SESSION_STOPPED) {
+        vlc_mutex_unlock(&g_spotify.lock);
+        return;
+    }
+    // An exited thread only needs the join
+    b_running = g_spotify.state != SESSION_EXITED;
+    g_spotify.shutdown = true;
+    vlc_mutex_unlock(&g_spotify.lock);
+
+    if (b_running)
+        wakeup_signal();
+    vlc_join(g_spotify.thread, NULL);
+
+    vlc_mutex_lock(&g_spotify.lock);
+    g_spotify.state = SESSION_STOPPED;
+    g_spotify.shutdown = false;
+    vlc_mutex_unlock(&g_spotify.lock);
+}
+
+void spotify_session_defer_release(spotify_release_e type, void *p_object)
+{
+    session_cmd_t *p_cmd;
+
+    if (p_object == NULL)
+        return;
+
+    p_cmd = calloc(1, sizeof(*p_cmd));
+    if (unlikely(p_cmd == NULL))
+        return;
+
+    p_cmd->type = CMD_RELEASE;
+    p_cmd->release = type;
+    p_cmd->arg.p = p_object;
+    post_command(p_cmd);
+}
+
+void spotify_session_player_play(bool b_play)
+{
+    session_cmd_t *p_cmd = calloc(1, sizeof(*p_cmd));
+
+    if (unlikely(p_cmd == NULL))
+        return;
+
+    p_cmd->type = CMD_PLAY;
+    p_cmd->arg.b = b_play;
+    post_command(p_cmd);
+}
+
+void spotify_session_player_seek(int i_offset_ms)
+{
+    session_cmd_t *p_cmd = calloc(1, sizeof(*p_cmd));
+
+    if (unlikely(p_cmd == NULL))
+        return;
+
+    p_cmd->type = CMD_SEEK;
+    p_cmd->arg.i = i_offset_ms;
+    post_command(p_cmd);
+}
+
+void spotify_session_player_load(spotify_client_t *p_client, sp_track *p_track)
+{
+    session_cmd_t *p_cmd = calloc(1, sizeof(*p_cmd));
+
+    if (unlikely(p_cmd == NULL))
+        return;
+
+    p_cmd->type = CMD_LOAD;
+    p_cmd->p_client = p_client;
+    p_cmd->arg.p = p_track;
+    post_command(p_cmd);
+}
+
+void spotify_session_player_prefetch(sp_track *p_track)
+{
+    session_cmd_t *p_cmd = calloc(1, sizeof(*p_cmd));
+
+    if (unlikely(p_cmd == NULL))
+        return;
+
+    p_cmd->type = CMD_PREFETCH;
+    p_cmd->arg.p = p_track;
+    post_command(p_cmd);
+}
+
+void spotify_session_metadata_recheck(spotify_client_t *p_client)
+{
+    session_cmd_t *p_cmd = calloc(1, sizeof(*p_cmd));
+
+    if (unlikely(p_cmd == NULL))
+        return;
+
+    p_cmd->type = CMD_RECHECK;
+    p_cmd->p_client = p_client;
+    post_command(p_cmd);
+}
+
+// Session thread, with the client lock held
+sp_error spotify_session_player_load_now(sp_track *p_track)
+{
+    sp_error error = sp_session_player_load(g_spotify.p_session, p_track);
+
+    if (error == SP_ERROR_OK) {
+        g_spotify.p_player_track = p_track;
+        g_spotify.p_player_client = g_spotify.p_calling;
+    }
+    return error;
+}
+
+static void post_command(session_cmd_t *p_cmd)
+{
+    vlc_mutex_lock(&g_spotify.lock);
+    *g_spotify.pp_cmd_last = p_cmd;
+    g_spotify.pp_cmd_last = &p_cmd->p_next;
+    vlc_mutex_unlock(&g_spotify.lock);
+
+    wakeup_signal();
+}
+
+void spotify_session_notify(void)
+{
+    wakeup_signal();
+}
+
+void spotify_session_startup(startlog_t *p_log)
+{
+    static const startlog_phase_e phases[] = {
+        STARTLOG_SESSION_CREATE, STARTLOG_THREAD_SPAWN, STARTLOG_LOGIN, STARTLOG_LOGGED_IN,
+    };
+
+    vlc_mutex_lock(&g_spotify.lock);
+    for (size_t i = 0; i < sizeof(phases) / sizeof(phases[0]); i++)
+        if (startlog_reached(&g_spotify.startup, phases[i]))
+            startlog_mark_at(p_log, phases[i], g_spotify.startup.pi_time[phases[i]]);
+    vlc_mutex_unlock(&g_spotify.lock);
+}
+
+void spotify_session_startup_done(vlc_object_t *p_obj, const startlog_t *p_log)
+{
+    char psz_stats[1024];
+
+    vlc_mutex_lock(&g_spotify.lock);
+    if (g_spotify.p_startup_stats == NULL && var_InheritBool(p_obj, "spotify-startup-stats"))
+        g_spotify.p_startup_stats = startlog_stats_new();
+    if (g_spotify.p_startup_stats == NULL) {
+        vlc_mutex_unlock(&g_spotify.lock);
+        return;
+    }
+    startlog_stats_add(g_spotify.p_startup_stats, p_log);
+    startlog_stats_format(g_spotify.p_startup_stats, psz_stats, sizeof(psz_stats));
+    vlc_mutex_unlock(&g_spotify.lock);
+
+    msg_Info(p_obj, "%s", psz_stats);
+}
+
+bool spotify_session_login_pending(void)
+{
+    bool b;
+
+    vlc_mutex_lock(&g_spotify.lock);
+    b = g_spotify.manual_login_ongoing;
+    vlc_mutex_unlock(&g_spotify.lock);
+
+    return b;
+}
+
+#ifdef HAVE_EPOLL
+// The session thread sleeps in epoll_wait() on an eventfd, that any thread
+// can poke, and a timerfd armed with the next libspotify timeout or the
+// logout deadline, whichever comes first.
+static int wakeup_init(void)
+{
+    struct epoll_event ev = { .events = EPOLLIN };
+
+    atomic_store(&g_spotify.wakeup_pending, false);
+    atomic_store(&g_spotify.connection_changed, false);
+    g_spotify.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    g_spotify.event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    g_spotify.timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (g_spotify.epoll_fd < 0 || g_spotify.event_fd < 0 || g_spotify.timer_fd < 0)
+        goto error;
+
+    ev.data.fd = g_spotify.event_fd;
+    if (epoll_ctl(g_spotify.epoll_fd, EPOLL_CTL_ADD, g_spotify.event_fd, &ev))
+        goto error;
+    ev.data.fd = g_spotify.timer_fd;
+    if (epoll_ctl(g_spotify.epoll_fd, EPOLL_CTL_ADD, g_spotify.timer_fd, &ev))
+        goto error;
+
+    return VLC_SUCCESS;
+
+error:
+    wakeup_clean();
+    return VLC_EGENERIC;
+}
+
+static void wakeup_clean(void)
+{
+    if (g_spotify.epoll_fd >= 0)
+        close(g_spotify.epoll_fd);
+    if (g_spotify.event_fd >= 0)
+        close(g_spotify.event_fd);
+    if (g_spotify.timer_fd >= 0)
+        close(g_spotify.timer_fd);
+    g_spotify.epoll_fd = g_spotify.event_fd = g_spotify.timer_fd = -1;
+}
+
+// Any thread, lock-free
+static void wakeup_signal(void)
+{
+    static const uint64_t one = 1;
+
+    if (atomic_exchange(&g_spotify.wakeup_pending, true))
+        return;
+
+    if (write(g_spotify.event_fd, &one, sizeof(one)) != sizeof(one))
+        msg_Err(g_spotify.p_obj, "Failed to wake up the session thread");
+}
+
+// Session thread. A deadline of 0 means no timeout.
+static void wakeup_wait(mtime_t deadline)
+{
+    struct itimerspec  timer = { .it_value = { 0, 0 } };
+    struct epoll_event events[2];
+    uint64_t           counter;
+
+    if (deadline != 0) {
+        mtime_t delay = __MAX(deadline - mdate(), 1);
+        timer.it_value.tv_sec = delay / CLOCK_FREQ;
+        timer.it_value.tv_nsec = (delay % CLOCK_FREQ) * 1000;
+    }
+    timerfd_settime(g_spotify.timer_fd, 0, &timer, NULL);
+
+    if (atomic_load(&g_spotify.wakeup_pending) == false)
+        while (epoll_wait(g_spotify.epoll_fd, events, 2, -1) < 0);
+
+    // Both are non-blocking, just empty them
+    if (read(g_spotify.event_fd, &counter, sizeof(counter)) < 0) {}
+    if (read(g_spotify.timer_fd, &counter, sizeof(counter)) < 0) {}
+
+    // Anything signalled from here on wakes up the next wait
+    atomic_store(&g_spotify.wakeup_pending, false);
+}
+#else
+// Fallback for platforms without eventfd, using the session lock and
+// condition variable
+static int wakeup_init(void)
+{
+    atomic_store(&g_spotify.wakeup_pending, false);
+    atomic_store(&g_spotify.connection_changed, false);
+    return VLC_SUCCESS;
+}
+
+static void wakeup_clean(void)
+{
+}
+
+static void wakeup_signal(void)
+{
+    if (atomic_exchange(&g_spotify.wakeup_pending, true))
+        return;
+
+    vlc_mutex_lock(&g_spotify.lock);
+    vlc_cond_signal(&g_spotify.wait);
+    vlc_mutex_unlock(&g_spotify.lock);
+}
+
+static void wakeup_wait(mtime_t deadline)
+{
+    vlc_mutex_lock(&g_spotify.lock);
+    while (atomic_load(&g_spotify.wakeup_pending) == false) {
+        if (deadline == 0)
+            vlc_cond_wait(&g_spotify.wait, &g_spotify.lock);
+        else if (vlc_cond_timedwait(&g_spotify.wait, &g_spotify.lock, deadline))
+            break;
+    }
+    vlc_mutex_unlock(&g_spotify.lock);
+
+    atomic_store(&g_spotify.wakeup_pending, false);
+}
+#endif
+
+static void start_login(void)
+{
+    vlc_object_t *p_obj = g_spotify.p_obj;
+    sp_session   *p_session = g_spotify.p_session;
+    char         *psz_username = g_spotify.psz_username;
+    char         *psz_password = NULL;
+    sp_error      err;
+
+    msg_Dbg(p_obj, "> sp_session_preferred_bitrate(%d)", g_spotify.bitrate);
+    err = sp_session_preferred_bitrate(p_session, g_spotify.bitrate);
+    if (SP_ERROR_OK != err) {
+        msg_Dbg(p_obj, "Error setting the preferred bitrate");
+    }
+
+    vlc_mutex_lock(&g_spotify.lock);
+    startlog_mark(&g_spotify.startup, STARTLOG_LOGIN, mdate());
+    vlc_mutex_unlock(&g_spotify.lock);
+
+    switch (spsession_login(p_session, psz_username, NULL, credentials)) {
+    case SPSESSION_RELOGIN:
+        msg_Dbg(p_obj, "Username remembered -> sp_session_relogin()");
+        break;
+    case SPSESSION_LOGIN_BLOB:
+        msg_Dbg(p_obj, "> sp_session_login() via blob");
+        break;
+    default:
+        msg_Dbg(p_obj, "> sp_session_login() with user/pass");
+        vlc_mutex_lock(&g_spotify.lock);
+        g_spotify.manual_login_ongoing = true;
+        g_spotify.psz_username = NULL;
+        vlc_mutex_unlock(&g_spotify.lock);
+        dialog_Login(p_obj, &psz_username, &psz_password,
+                     "Spotify login", "%s",
+                     "Please enter valid username and password");
+        if (spsession_login(p_session, psz_username, psz_password, NULL)
+                == SPSESSION_NO_LOGIN) {
+            msg_Dbg(p_obj, "Login dialog failed");
+            vlc_mutex_lock(&g_spotify.lock);
+            g_spotify.manual_login_ongoing = false;
+            vlc_mutex_unlock(&g_spotify.lock);
+            spotify_logged_in(p_session, SP_ERROR_BAD_USERNAME_OR_PASSWORD);
+        }
+        free(psz_password);
+        vlc_mutex_lock(&g_spotify.lock);
+        g_spotify.psz_username = psz_username;
+        vlc_mutex_unlock(&g_spotify.lock);
+        break;
+    }
+}
+
+// Session thread. Make room in the metadata cache and among the playlists
+// kept in RAM while over the memory budget, and log when it is exceeded
+// and when it no longer is.
+static void check_budget(vlc_object_t *p_obj, sp_session *p_session)
+{
+    char psz_memory[128];
+    bool b_over;
+
+    if (membudget_over()) {
+        meta_cache_shrink();
+        library_shrink(p_session);
+    }
+
+    b_over = membudget_over();
+    if (b_over == g_spotify.over_budget)
+        return;
+    g_spotify.over_budget = b_over;
+
+    membudget_format(psz_memory, sizeof(psz_memory));
+    if (b_over)
+        msg_Warn(p_obj, "Over the memory budget: %s", psz_memory);
+    else
+        msg_Dbg(p_obj, "Within the memory budget again: %s", psz_memory);
+}
+
+static void *spotify_main_loop(void *data)
+{
+    vlc_object_t *p_obj = g_spotify.p_obj;
+    sp_session   *p_session = g_spotify.p_session;
+    int           spotify_timeout = 0;
+    mtime_t       deadline;
+    bool          start_client;
+    VLC_UNUSED(data);
+
+    vlc_mutex_lock(&g_spotify.lock);
+    startlog_mark(&g_spotify.startup, STARTLOG_THREAD_SPAWN, mdate());
+    vlc_mutex_unlock(&g_spotify.lock);
+
+    art_queue_open();
+    start_login();
+
+    for (;;) {
+        // Commands first: whatever the previous client left behind is
+        // released before the next one loads anything
+        run_commands();
+
+        vlc_mutex_lock(&g_spotify.lock);
+
+        // Start the deferred logout once nobody has needed the session
+        // for the whole delay, or at once when the plugin is unloaded
+        if (g_spotify.state == SESSION_RUNNING &&
+            (g_spotify.shutdown ||
+             (g_spotify.refs == 0 && g_spotify.logout_deadline != 0 &&
+              mdate() >= g_spotify.logout_deadline))) {
+            g_spotify.logout_deadline = 0;
+            g_spotify.logout_started = mdate();
+            g_spotify.state = SESSION_LOGOUT;
+            // Without a login there will be no logged_out either
+            if (g_spotify.logged_in) {
+                vlc_mutex_unlock(&g_spotify.lock);
+                msg_Dbg(p_obj, "> sp_session_logout()");
+                sp_session_logout(p_session);
+                vlc_mutex_lock(&g_spotify.lock);
+            }
+        }
+
+        // Set from logged_out, or if the login never got anywhere. The
+        // logged_out does not always come (see TODO), give up on it after
+        // a while.
+        if (g_spotify.state == SESSION_LOGOUT &&
+            ((g_spotify.logged_in == false && g_spotify.manual_login_ongoing == false) ||
+             mdate() >= g_spotify.logout_started + SPOTIFY_LOGOUT_TIMEOUT_S * CLOCK_FREQ)) {
+            if (g_spotify.logged_in)
+                msg_Warn(p_obj, "No logged_out after %d s, releasing the session anyway",
+                         SPOTIFY_LOGOUT_TIMEOUT_S);
+            vlc_mutex_unlock(&g_spotify.lock);
+            break;
+        }
+
+        start_client = g_spotify.start_pending && g_spotify.logged_in;
+        if (start_client)
+            g_spotify.start_pending = false;
+        vlc_mutex_unlock(&g_spotify.lock);
+
+        if (start_client)
+            start_clients(SP_ERROR_OK);
+
+        sp_session_process_events(p_session, &spotify_timeout);
+
+        if (atomic_exchange(&g_spotify.connection_changed, false))
+            dispatch_connection_change();
+
+        meta_queue_process(p_obj);
+        art_queue_process(p_obj, p_session);
+        library_process(p_obj, p_session);
+        check_budget(p_obj, p_session);
+
+        // More work is due right away, go around again without sleeping.
+        // Commands posted meanwhile get served in between.
+        if (spotify_timeout == 0)
+            continue;
+
+        vlc_mutex_lock(&g_spotify.lock);
+        deadline = mdate() + spotify_timeout * 1000;
+        if (g_spotify.logout_deadline != 0 && g_spotify.logout_deadline < deadline)
+            deadline = g_spotify.logout_deadline;
+        if (g_spotify.state == SESSION_LOGOUT)
+            deadline = __MIN(deadline, g_spotify.logout_started +
+                                       SPOTIFY_LOGOUT_TIMEOUT_S * CLOCK_FREQ);
+        vlc_mutex_unlock(&g_spotify.lock);
+
+        wakeup_wait(deadline);
+    }
+
+    run_commands();
+    meta_queue_flush();
+    art_queue_flush();
+    library_flush();
+
+    msg_Dbg(p_obj, "> sp_session_release()");
+    sp_session_release(p_session);
+    g_spotify.p_player_track = NULL;
+    g_spotify.p_player_client = NULL;
+
+    // No callbacks after the release
+    cbtrace_close(g_spotify.p_trace);
+    g_spotify.p_trace = NULL;
+
+    vlc_mutex_lock(&g_spotify.lock);
+    wakeup_clean();
+    g_spotify.p_session = NULL;
+    free(g_spotify.psz_username);
+    g_spotify.psz_username = NULL;
+    if (g_spotify.p_startup_stats != NULL) {
+        char psz_stats[1024];
+        startlog_stats_format(g_spotify.p_startup_stats, psz_stats, sizeof(psz_stats));
+        msg_Info(p_obj, "%s", psz_stats);
+        startlog_stats_delete(g_spotify.p_startup_stats);
+        g_spotify.p_startup_stats = NULL;
+    }
+    g_spotify.state = SESSION_EXITED;
+    vlc_cond_broadcast(&g_spotify.wait);
+    vlc_mutex_unlock(&g_spotify.lock);
+
+    msg_Dbg(p_obj, "Session thread done");
+
+    return NULL;
+}
+
+// Session thread
+static void dispatch_connection_change(void)
+{
+    sp_connectionstate state = sp_session_connectionstate(g_spotify.p_session);
+    sp_error           error = atomic_exchange(&g_spotify.connection_error, SP_ERROR_OK);
+
+    msg_Dbg(g_spotify.p_obj, "Connection state %d, error %d", state, error);
+    trace_event(CBTRACE_CONNECTION, state, error);
+
+    // Only the player is recovered from an outage
+    vlc_mutex_lock(&g_spotify.client_lock);
+    g_spotify.p_calling = g_spotify.p_player_client;
+    if (g_spotify.p_calling)
+        g_spotify.p_calling->pf_connection_changed(g_spotify.p_calling->p_opaque,
+                                                   state, error);
+    g_spotify.p_calling = NULL;
+    vlc_mutex_unlock(&g_spotify.client_lock);
+}
+
+// Session thread. pf_logged_in of the clients that have not had it yet.
+static void start_clients(sp_error error)
+{
+    vlc_mutex_lock(&g_spotify.client_lock);
+    for (spotify_client_t *p = g_spotify.p_clients; p != NULL; p = p->p_next) {
+        if (p->b_started)
+            continue;
+        p->b_started = true;
+        g_spotify.p_calling = p;
+        p->pf_logged_in(p->p_opaque, error);
+    }
+    g_spotify.p_calling = NULL;
+    vlc_mutex_unlock(&g_spotify.client_lock);
+}
+
+// Session thread
+static void run_commands(void)
+{
+    session_cmd_t *p_cmd;
+    session_cmd_t *p_next;
+
+    vlc_mutex_lock(&g_spotify.lock);
+    p_cmd = g_spotify.p_cmd_first;
+    g_spotify.p_cmd_first = NULL;
+    g_spotify.pp_cmd_last = &g_spotify.p_cmd_first;
+    vlc_mutex_unlock(&g_spotify.lock);
+
+    for (; p_cmd != NULL; p_cmd = p_next) {
+        p_next = p_cmd->p_next;
+
+        switch (p_cmd->type) {
+        case CMD_PLAY:
+            msg_Dbg(g_spotify.p_obj, "> sp_session_player_play(%d)", p_cmd->arg.b);
+            trace_event(CBTRACE_PLAY, 0, p_cmd->arg.b);
+            sp_session_player_play(g_spotify.p_session, p_cmd->arg.b);
+            break;
+        case CMD_SEEK:
+            msg_Dbg(g_spotify.p_obj, "> sp_session_player_seek(%d)", p_cmd->arg.i);
+            trace_event(CBTRACE_SEEK, 0, p_cmd->arg.i);
+            sp_session_player_seek(g_spotify.p_session, p_cmd->arg.i);
+            break;
+        case CMD_LOAD: {
+            sp_error error;
+
+            vlc_mutex_lock(&g_spotify.client_lock);
+            if (!client_attached(p_cmd->p_client)) {
+                vlc_mutex_unlock(&g_spotify.client_lock);
+                msg_Dbg(g_spotify.p_obj, "Not loading the track of a detached client");
+                break;
+            }
+            msg_Dbg(g_spotify.p_obj, "> sp_session_player_load()");
+            g_spotify.p_calling = p_cmd->p_client;
+            error = spotify_session_player_load_now(p_cmd->arg.p);
+            if (error != SP_ERROR_OK) {
+                msg_Err(g_spotify.p_obj, "Failed to load the track: %s",
+                        sp_error_message(error));
+            } else {
+                msg_Dbg(g_spotify.p_obj, "> sp_session_player_play(1)");
+                trace_event(CBTRACE_PLAY, 0, 1);
+                sp_session_player_play(g_spotify.p_session, 1);
+            }
+            if (p_cmd->p_client->pf_player_loaded)
+                p_cmd->p_client->pf_player_loaded(p_cmd->p_client->p_opaque, error);
+            g_spotify.p_calling = NULL;
+            vlc_mutex_unlock(&g_spotify.client_lock);
+            break;
+        }
+        case CMD_PREFETCH:
+            msg_Dbg(g_spotify.p_obj, "> sp_session_player_prefetch()");
+            sp_session_player_prefetch(g_spotify.p_session, p_cmd->arg.p);
+            break;
+        case CMD_RECHECK:
+            vlc_mutex_lock(&g_spotify.client_lock);
+            if (client_attached(p_cmd->p_client)) {
+                g_spotify.p_calling = p_cmd->p_client;
+                p_cmd->p_client->pf_metadata_updated(p_cmd->p_client->p_opaque);
+                g_spotify.p_calling = NULL;
+            }
+            vlc_mutex_unlock(&g_spotify.client_lock);
+            break;
+        case CMD_RELEASE:
+            switch (p_cmd->release) {
+            case SPOTIFY_RELEASE_PLAYER_TRACK:
+                // Only if the track still is in the player and the client
+                // that loaded it is gone. Another client may have taken the
+                // player over since, with this very track even.
+                vlc_mutex_lock(&g_spotify.client_lock);
+                if (g_spotify.p_player_track == p_cmd->arg.p &&
+                    g_spotify.p_player_client == NULL) {
+                    msg_Dbg(g_spotify.p_obj, "> sp_session_player_unload()");
+                    sp_session_player_play(g_spotify.p_session, 0);
+                    sp_session_player_unload(g_spotify.p_session);
+                    g_spotify.p_player_track = NULL;
+                    g_spotify.p_player_client = NULL;
+                } else {
+                    msg_Dbg(g_spotify.p_obj, "The player has been taken over, not unloading it");
+                }
+                vlc_mutex_unlock(&g_spotify.client_lock);
+                // Fall through
+            case SPOTIFY_RELEASE_TRACK:
+                msg_Dbg(g_spotify.p_obj, "> sp_track_release()");
+                sp_track_release(p_cmd->arg.p);
+                break;
+            case SPOTIFY_RELEASE_ALBUM:
+                msg_Dbg(g_spotify.p_obj, "> sp_album_release()");
+                sp_album_release(p_cmd->arg.p);
+                break;
+            case SPOTIFY_RELEASE_ALBUMBROWSE:
+                msg_Dbg(g_spotify.p_obj, "> sp_albumbrowse_release()");
+                sp_albumbrowse_release(p_cmd->arg.p);
+                break;
+            case SPOTIFY_RELEASE_SEARCH:
+                msg_Dbg(g_spotify.p_obj, "> sp_search_release()");
+                sp_search_release(p_cmd->arg.p);
+                break;
+            }
+            break;
+        }
+        free(p_cmd);
+    }
+}
+
+// Called from sp_session_process_events()
+static SP_CALLCONV void spotify_logged_in(sp_session *session, sp_error error)
+{
+    VLC_UNUSED(session);
+
+    msg_Dbg(g_spotify.p_obj, "< logged_in()");
+    trace_event(CBTRACE_LOGGED_IN, 0, error);
+
+    vlc_mutex_lock(&g_spotify.lock);
+    g_spotify.manual_login_ongoing = false;
+    g_spotify.logged_in = (SP_ERROR_OK == error);
+    if (g_spotify.logged_in)
+        startlog_mark(&g_spotify.startup, STARTLOG_LOGGED_IN, mdate());
+    g_spotify.start_pending = false;
+    vlc_mutex_unlock(&g_spotify.lock);
+
+    // TODO: Trigger relogin if username/password is incorrect
+    if (SP_ERROR_OK != error) {
+        dialog_Fatal(g_spotify.p_obj, "Login Error: ","%s", sp_error_message(error));
+        // There is nothing to log out from, let the thread finish
+        vlc_mutex_lock(&g_spotify.lock);
+        g_spotify.state = SESSION_LOGOUT;
+        vlc_mutex_unlock(&g_spotify.lock);
+        wakeup_signal();
+    }
+
+    start_clients(error);
+}
+
+// Called from sp_session_process_events()
+static SP_CALLCONV void spotify_logged_out(sp_session *session)
+{
+    VLC_UNUSED(session);
+
+    msg_Dbg(g_spotify.p_obj, "< logged_out()");
+
+    vlc_mutex_lock(&g_spotify.lock);
+    g_spotify.logged_in = false;
+    g_spotify.state = SESSION_LOGOUT;
+    vlc_mutex_unlock(&g_spotify.lock);
+
+    wakeup_signal();
+}
+
+// Called from sp_session_process_events()
+static SP_CALLCONV void spotify_metadata_updated(sp_session *session)
+{
+    VLC_UNUSED(session);
+
+    msg_Dbg(g_spotify.p_obj, "< metadata_updated()");
+    trace_event(CBTRACE_METADATA_UPDATED, 0, 0);
+
+    // Only to the clients that know they are logged in
+    vlc_mutex_lock(&g_spotify.client_lock);
+    for (spotify_client_t *p = g_spotify.p_clients; p != NULL; p = p->p_next) {
+        if (!p->b_started)
+            continue;
+        g_spotify.p_calling = p;
+        p->pf_metadata_updated(p->p_opaque);
+    }
+    g_spotify.p_calling = NULL;
+    vlc_mutex_unlock(&g_spotify.client_lock);
+}
+
+// Called from sp_session_process_events()
+static SP_CALLCONV void spotify_log_message(sp_session *session, const char *msg)
+{
+    VLC_UNUSED(session);
+
+    msg_Dbg(g_spotify.p_obj, "< log_message(): %s", msg);
+}
+
+// Called from sp_session_process_events()
+static SP_CALLCONV void spotify_message_to_user(sp_session *session, const char *msg)
+{
+    VLC_UNUSED(session);
+
+    // TODO: What kind of messages is this?
+    // Is perhaps a dialog needed?
+    msg_Dbg(g_spotify.p_obj, "< message_to_user(): %s", msg);
+}
+
+static SP_CALLCONV void spotify_streaming_error(sp_session *session, sp_error error)
+{
+    VLC_UNUSED(session);
+
+    msg_Dbg(g_spotify.p_obj, "< streaming_error(): %s", sp_error_message(error));
+
+    atomic_store(&g_spotify.connection_error, error);
+    atomic_store(&g_spotify.connection_changed, true);
+    wakeup_signal();
+}
+
+static SP_CALLCONV void spotify_connection_error(sp_session *session, sp_error error)
+{
+    VLC_UNUSED(session);
+
+    msg_Dbg(g_spotify.p_obj, "< connection_error(): %s", sp_error_message(error));
+
+    atomic_store(&g_spotify.connection_error, error);
+    atomic_store(&g_spotify.connection_changed, true);
+    wakeup_signal();
+}
+
+// libspotify context
+static SP_CALLCONV void spotify_userinfo_updated(sp_session *session)
+{
+    VLC_UNUSED(session);
+
+    msg_Dbg(g_spotify.p_obj, "< userinfo_updated()");
+}
+
+// libspotify context
+static SP_CALLCONV void spotify_credentials_blob_updated(sp_session *session,
+                                                         const char *blob)
+{
+    VLC_UNUSED(session);
+
+    msg_Dbg(g_spotify.p_obj, "< credentials_blobupdated() %s", blob);
+
+    if (credentials != NULL)
+        free(credentials);
+
+    // TODO: Save the blob to a file
+    credentials = strdup(blob);
+}
+
+// libspotify context
+static SP_CALLCONV void spotify_connectionstate_updated(sp_session *session)
+{
+    VLC_UNUSED(session);
+
+    msg_Dbg(g_spotify.p_obj, "< connectionstate_updated()");
+
+    atomic_store(&g_spotify.connection_changed, true);
+    wakeup_signal();
+}
+
+// libspotify context
+static SP_CALLCONV void spotify_notify_main_thread(sp_session *session)
+{
+    VLC_UNUSED(session);
+
+    // Called in bursts, keep it to a single write
+    wakeup_signal();
+    trace_event(CBTRACE_NOTIFY_MAIN_THREAD, 0, 0);
+}
+
+// libspotify context
+static SP_CALLCONV void spotify_play_token_lost(sp_session *session)
+{
+    VLC_UNUSED(session);
+
+    msg_Dbg(g_spotify.p_obj, "< play_token_lost()");
+    trace_event(CBTRACE_PLAY_TOKEN_LOST, 0, 0);
+
+    vlc_mutex_lock(&g_spotify.client_lock);
+    if (g_spotify.p_player_client)
+        g_spotify.p_player_client->pf_play_token_lost(g_spotify.p_player_client->p_opaque);
+    vlc_mutex_unlock(&g_spotify.client_lock);
+}
+
+// libspotify context
+static SP_CALLCONV void spotify_end_of_track(sp_session *session)
+{
+    VLC_UNUSED(session);
+
+    msg_Dbg(g_spotify.p_obj, "< end_of_track()");
+    trace_event(CBTRACE_END_OF_TRACK, 0, 0);
+
+    vlc_mutex_lock(&g_spotify.client_lock);
+    if (g_spotify.p_player_client)
+        g_spotify.p_player_client->pf_end_of_track(g_spotify.p_player_client->p_opaque);
+    vlc_mutex_unlock(&g_spotify.client_lock);
+}
+
+// libspotify context
+static SP_CALLCONV int spotify_music_delivery(sp_session *session,
+                                              const sp_audioformat *format,
+                                              const void *frames, int num_frames)
+{
+    int ret;
+    VLC_UNUSED(session);
+
+    vlc_mutex_lock(&g_spotify.client_lock);
+    if (g_spotify.p_player_client)
+        ret = g_spotify.p_player_client->pf_music_delivery(g_spotify.p_player_client->p_opaque,
+                                                           format, frames, num_frames);
+    else
+        ret = num_frames; // Nobody is listening, drop it until the unload
+    vlc_mutex_unlock(&g_spotify.client_lock);
+
+    if (unlikely(g_spotify.p_trace != NULL)) {
+        cbtrace_event_t event = {
+            .type = CBTRACE_MUSIC_DELIVERY,
+            .i_rate = format->sample_rate,
+            .i_channels = format->channels,
+            .i_frames = num_frames,
+            .i_consumed = ret,
+            .p_frames = frames,
+        };
+        cbtrace_record(g_spotify.p_trace, &event);
+    }
+
+    return ret;
+}
+
+// Any thread
+static void trace_event(cbtrace_type_e type, unsigned i_state, unsigned i_value)
+{
+    cbtrace_event_t event = { .type = type, .i_state = i_state, .i_value = i_value };
+
+    if (unlikely(g_spotify.p_trace != NULL))
+        cbtrace_record(g_spotify.p_trace, &event);
+}
+
+// Before the session is created
+static void trace_open(vlc_object_t *p_obj)
+{
+    char *psz_path = var_InheritString(p_obj, "spotify-trace");
+
+    g_spotify.p_trace = NULL;
+    if (psz_path != NULL && *psz_path != '\0') {
+        g_spotify.p_trace = cbtrace_create(psz_path, var_InheritBool(p_obj, "spotify-trace-audio"));
+        if (g_spotify.p_trace == NULL)
+            msg_Warn(p_obj, "Failed to create the trace %s", psz_path);
+        else
+            msg_Info(p_obj, "Recording the session callbacks to %s", psz_path);
+    }
+    free(psz_path);
+}
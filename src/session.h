@@ -0,0 +1,146 @@
+/*****************************************************************************
+ * Copyright (C) 2015 Jonas Lundqvist
+ *
+ * Author: Jonas Lundqvist <jonas@gannon.se>
+ *
+ * This file is part of vlc-spotify.
+ *
+ * vlc-spotify is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+// The process wide Spotify session.
+//
+// libspotify only allows one sp_session per process, so it is owned by this
+// module instead of by each demux. The session thread outlives the demux
+// instances: Close() only detaches its client and hands over the objects
+// that should be released, and the logout is deferred so that a following
+// Open() can reuse the session that is still logged in.
+
+#define SPOTIFY_LOGOUT_DELAY_S 30
+// How long the session thread waits for logged_out before it releases the
+// session anyway
+#define SPOTIFY_LOGOUT_TIMEOUT_S 5
+
+typedef struct spotify_client_t spotify_client_t;
+
+// Callbacks from the session to the attached clients. Any number of them
+// can be attached: every one gets pf_logged_in and pf_metadata_updated, but
+// the player callbacks only go to the client that loaded the track in the
+// player, so that a playlist being expanded does not take the audio of the
+// track that is playing. All of them are called with the client lock held,
+// which means that once spotify_session_detach() returns none of them is
+// running or will be called again. For the same reason they must not call
+// any of the spotify_session_*() functions, but for
+// spotify_session_player_load_now().
+struct spotify_client_t {
+    void *p_opaque;
+
+    // Session thread. Called when the session is logged in, or directly when
+    // attaching to a session that already is logged in.
+    void (*pf_logged_in)(void *p_opaque, sp_error error);
+    // Session thread
+    void (*pf_metadata_updated)(void *p_opaque);
+    // libspotify context
+    int  (*pf_music_delivery)(void *p_opaque, const sp_audioformat *format,
+                              const void *frames, int num_frames);
+    void (*pf_end_of_track)(void *p_opaque);
+    void (*pf_play_token_lost)(void *p_opaque);
+    // Session thread. After any connection state change, connection error
+    // or streaming error (SP_ERROR_OK if there was none).
+    void (*pf_connection_changed)(void *p_opaque, sp_connectionstate state,
+                                  sp_error error);
+    // Session thread. After spotify_session_player_load(), once libspotify
+    // plays the new track and no longer the one before it.
+    void (*pf_player_loaded)(void *p_opaque, sp_error error);
+
+    // Owned by session.c, with the client lock
+    spotify_client_t *p_next;
+    bool              b_started;    // pf_logged_in has been called
+};
+
+typedef enum {
+    SPOTIFY_RELEASE_TRACK,          // sp_track_release()
+    SPOTIFY_RELEASE_PLAYER_TRACK,   // player unload if still loaded, then sp_track_release()
+    SPOTIFY_RELEASE_ALBUM,          // sp_album_release()
+    SPOTIFY_RELEASE_ALBUMBROWSE,    // sp_albumbrowse_release()
+    SPOTIFY_RELEASE_SEARCH,         // sp_search_release()
+} spotify_release_e;
+
+// Attach a client to the session, creating the session and starting the
+// login if needed. A deferred logout is cancelled, one that has started is
+// waited for, but not for long. Returns NULL on failure.
+// p_client may be NULL to only keep the session running, for the meta queue.
+sp_session *spotify_session_acquire(vlc_object_t *p_obj, spotify_client_t *p_client);
+
+// Detach the client. No callbacks are running or will be made once this
+// returns, so the objects the client used can be handed over with
+// spotify_session_defer_release().
+void spotify_session_detach(spotify_client_t *p_client);
+
+// For callbacks of asynchronous requests (albumbrowse and such) that carry
+// the client as userdata. Returns true, with the client lock held, if the
+// client still is attached.
+bool spotify_session_lock_client(spotify_client_t *p_client);
+void spotify_session_unlock_client(void);
+
+// Queue a libspotify object to be released by the session thread.
+void spotify_session_defer_release(spotify_release_e type, void *p_object);
+
+// Player control. Queued and executed in order by the session thread, which
+// is the only thread calling libspotify.
+void spotify_session_player_play(bool b_play);
+void spotify_session_player_seek(int i_offset_ms);
+// Load and play the track for p_client, which must be kept referenced until
+// it has been handed back with spotify_session_defer_release(). Not done if
+// p_client has been detached by then.
+void spotify_session_player_load(spotify_client_t *p_client, sp_track *p_track);
+// Session thread, from the callbacks only. sp_session_player_load() for the
+// client being called, at once, which then gets the player callbacks. The
+// player is only unloaded when the track is released as
+// SPOTIFY_RELEASE_PLAYER_TRACK if it still is the track of a client that is
+// gone, not when another client has taken the player over.
+sp_error spotify_session_player_load_now(sp_track *p_track);
+// Let libspotify start fetching the track that will be loaded next
+void spotify_session_player_prefetch(sp_track *p_track);
+
+// Call pf_metadata_updated of p_client from the session thread, if it still
+// is attached, for what waits on metadata that may never be updated again
+void spotify_session_metadata_recheck(spotify_client_t *p_client);
+
+// Wake the session thread up for work that was queued from another thread,
+// like meta queue lookups.
+void spotify_session_notify(void);
+
+// Drop the reference taken by spotify_session_acquire() and schedule the
+// deferred logout. Never blocks on libspotify.
+void spotify_session_release(void);
+
+// Log out at once, without waiting for the deferred logout, and join the
+// session thread. For when the plugin is unloaded, after the last Close():
+// the thread must neither outlive the plugin code nor the libvlc instance
+// it logs to.
+void spotify_session_shutdown(void);
+
+// True while the user is being asked for username and password
+bool spotify_session_login_pending(void);
+
+struct startlog_t;
+
+// Add the session phases of the startup timeline (see startlog.h), if the
+// session was started after the timeline was
+void spotify_session_startup(struct startlog_t *p_log);
+// A timeline is complete. Gathered into the percentiles of the session,
+// which are logged, if spotify-startup-stats is set.
+void spotify_session_startup_done(vlc_object_t *p_obj, const struct startlog_t *p_log);
@@ -0,0 +1,245 @@
+/*****************************************************************************
+ * Copyright (C) 2015 Jonas Lundqvist
+ *
+ * Author: Jonas Lundqvist <jonas@gannon.se>
+ *
+ * This file is part of vlc-spotify.
+ *
+ * vlc-spotify is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "shmring.h"
+
+#define SHMRING_MAGIC   0x53505243  // "SPRC"
+#define SHMRING_VERSION 1
+
+// Shared by both processes. The positions are on cache lines of their own
+// since they are written by different processes.
+typedef struct {
+    uint32_t          i_magic;
+    uint32_t          i_version;
+    uint64_t          i_size;       // Of the data, following the header
+    _Atomic uint32_t  i_format;     // rate << 8 | channels, 0 until set
+    _Atomic uint32_t  i_flags;
+    char              pad1[40];
+    _Atomic uint64_t  i_head;       // Bytes written, only stored by the writer
+    char              pad2[56];
+    _Atomic uint64_t  i_tail;       // Bytes read, only stored by the reader
+    char              pad3[56];
+} shmring_header_t;
+
+struct shmring_t {
+    shmring_header_t *p_header;
+    uint8_t          *p_data;
+    size_t            i_map_size;
+};
+
+static shmring_t *map_ring(int fd, size_t i_map_size)
+{
+    shmring_t *p_ring = malloc(sizeof(*p_ring));
+    void      *p_map;
+
+    if (p_ring == NULL)
+        return NULL;
+
+    p_map = mmap(NULL, i_map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p_map == MAP_FAILED) {
+        free(p_ring);
+        return NULL;
+    }
+
+    p_ring->p_header = p_map;
+    p_ring->p_data = (uint8_t *) p_map + sizeof(shmring_header_t);
+    p_ring->i_map_size = i_map_size;
+    return p_ring;
+}
+
+shmring_t *shmring_create(const char *psz_name, size_t i_size)
+{
+    long       i_page = sysconf(_SC_PAGESIZE);
+    size_t     i_map_size;
+    shmring_t *p_ring;
+    int        fd;
+
+    if (i_page <= 0)
+        i_page = 4096;
+    i_map_size = sizeof(shmring_header_t) + i_size;
+    i_map_size = (i_map_size + i_page - 1) / i_page * i_page;
+
+    fd = shm_open(psz_name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0)
+        return NULL;
+
+    if (ftruncate(fd, i_map_size)) {
+        close(fd);
+        shm_unlink(psz_name);
+        return NULL;
+    }
+
+    p_ring = map_ring(fd, i_map_size);
+    close(fd);
+    if (p_ring == NULL) {
+        shm_unlink(psz_name);
+        return NULL;
+    }
+
+    p_ring->p_header->i_magic = SHMRING_MAGIC;
+    p_ring->p_header->i_version = SHMRING_VERSION;
+    p_ring->p_header->i_size = i_map_size - sizeof(shmring_header_t);
+    atomic_init(&p_ring->p_header->i_format, 0);
+    atomic_init(&p_ring->p_header->i_flags, 0);
+    atomic_init(&p_ring->p_header->i_head, 0);
+    atomic_init(&p_ring->p_header->i_tail, 0);
+
+    return p_ring;
+}
+
+shmring_t *shmring_open(const char *psz_name)
+{
+    struct stat st;
+    shmring_t  *p_ring;
+    int         fd;
+
+    fd = shm_open(psz_name, O_RDWR, 0);
+    if (fd < 0)
+        return NULL;
+
+    if (fstat(fd, &st) || (size_t) st.st_size <= sizeof(shmring_header_t)) {
+        close(fd);
+        return NULL;
+    }
+
+    p_ring = map_ring(fd, st.st_size);
+    close(fd);
+    if (p_ring == NULL)
+        return NULL;
+
+    if (p_ring->p_header->i_magic != SHMRING_MAGIC ||
+        p_ring->p_header->i_version != SHMRING_VERSION ||
+        p_ring->p_header->i_size != st.st_size - sizeof(shmring_header_t)) {
+        shmring_close(p_ring);
+        return NULL;
+    }
+
+    return p_ring;
+}
+
+void shmring_unlink(const char *psz_name)
+{
+    shm_unlink(psz_name);
+}
+
+void shmring_close(shmring_t *p_ring)
+{
+    munmap(p_ring->p_header, p_ring->i_map_size);
+    free(p_ring);
+}
+
+bool shmring_write(shmring_t *p_ring, const void *p_data, size_t i_size)
+{
+    shmring_header_t *p_header = p_ring->p_header;
+    uint64_t          i_head = atomic_load_explicit(&p_header->i_head, memory_order_relaxed);
+    uint64_t          i_tail = atomic_load_explicit(&p_header->i_tail, memory_order_acquire);
+    size_t            i_offset = i_head % p_header->i_size;
+    size_t            i_first;
+
+    if (p_header->i_size - (i_head - i_tail) < i_size)
+        return false;
+
+    i_first = p_header->i_size - i_offset;
+    if (i_first > i_size)
+        i_first = i_size;
+    memcpy(p_ring->p_data + i_offset, p_data, i_first);
+    memcpy(p_ring->p_data, (const uint8_t *) p_data + i_first, i_size - i_first);
+
+    // Publish the data together with the new head
+    atomic_store_explicit(&p_header->i_head, i_head + i_size, memory_order_release);
+    return true;
+}
+
+void shmring_set_format(shmring_t *p_ring, unsigned i_rate, unsigned i_channels)
+{
+    atomic_store(&p_ring->p_header->i_format, i_rate << 8 | (i_channels & 0xff));
+}
+
+void shmring_set_flags(shmring_t *p_ring, unsigned i_flags)
+{
+    atomic_fetch_or(&p_ring->p_header->i_flags, i_flags);
+}
+
+uint64_t shmring_head(shmring_t *p_ring)
+{
+    return atomic_load(&p_ring->p_header->i_head);
+}
+
+size_t shmring_peek(shmring_t *p_ring, const void **pp_data)
+{
+    shmring_header_t *p_header = p_ring->p_header;
+    uint64_t          i_tail = atomic_load_explicit(&p_header->i_tail, memory_order_relaxed);
+    uint64_t          i_head = atomic_load_explicit(&p_header->i_head, memory_order_acquire);
+    size_t            i_offset = i_tail % p_header->i_size;
+    size_t            i_avail = i_head - i_tail;
+
+    if (i_avail > p_header->i_size - i_offset)
+        i_avail = p_header->i_size - i_offset;
+
+    *pp_data = p_ring->p_data + i_offset;
+    return i_avail;
+}
+
+void shmring_consume(shmring_t *p_ring, size_t i_size)
+{
+    shmring_header_t *p_header = p_ring->p_header;
+    uint64_t          i_tail = atomic_load_explicit(&p_header->i_tail, memory_order_relaxed);
+
+    // Done with the data, the writer may overwrite it
+    atomic_store_explicit(&p_header->i_tail, i_tail + i_size, memory_order_release);
+}
+
+void shmring_discard(shmring_t *p_ring, uint64_t i_head)
+{
+    shmring_header_t *p_header = p_ring->p_header;
+    uint64_t          i_tail = atomic_load_explicit(&p_header->i_tail, memory_order_relaxed);
+
+    if (i_head > atomic_load(&p_header->i_head))
+        i_head = atomic_load(&p_header->i_head);
+    if (i_head > i_tail)
+        atomic_store_explicit(&p_header->i_tail, i_head, memory_order_release);
+}
+
+bool shmring_get_format(shmring_t *p_ring, unsigned *pi_rate, unsigned *pi_channels)
+{
+    uint32_t i_format = atomic_load(&p_ring->p_header->i_format);
+
+    if (i_format == 0)
+        return false;
+
+    *pi_rate = i_format >> 8;
+    *pi_channels = i_format & 0xff;
+    return true;
+}
+
+unsigned shmring_flags(shmring_t *p_ring)
+{
+    return atomic_load(&p_ring->p_header->i_flags);
+}
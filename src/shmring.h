@@ -0,0 +1,61 @@
+/*****************************************************************************
+ * Copyright (C) 2015 Jonas Lundqvist
+ *
+ * Author: Jonas Lundqvist <jonas@gannon.se>
+ *
+ * This file is part of vlc-spotify.
+ *
+ * vlc-spotify is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+// Single producer, single consumer ring of PCM in POSIX shared memory.
+//
+// The vlc-spotifyd daemon writes the audio of the track it is playing and
+// the plugin reads it straight out of the mapping. The read and write
+// positions only grow (they are byte counts since the start), so the fill
+// level is head - tail and nothing is ever ambiguous about a full ring.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SHMRING_EOS     0x1     // The whole track has been written
+#define SHMRING_STOPPED 0x2     // Nothing more will be written (taken over, error)
+
+typedef struct shmring_t shmring_t;
+
+// Create (reader) or open (writer) the ring named psz_name ("/name").
+// i_size is rounded up to whole pages.
+shmring_t *shmring_create(const char *psz_name, size_t i_size);
+shmring_t *shmring_open(const char *psz_name);
+// The mapping stays valid after the name is gone
+void shmring_unlink(const char *psz_name);
+void shmring_close(shmring_t *p_ring);
+
+// Writer. Writes all of p_data, or nothing if it does not fit.
+bool shmring_write(shmring_t *p_ring, const void *p_data, size_t i_size);
+void shmring_set_format(shmring_t *p_ring, unsigned i_rate, unsigned i_channels);
+void shmring_set_flags(shmring_t *p_ring, unsigned i_flags);
+uint64_t shmring_head(shmring_t *p_ring);
+
+// Reader. shmring_peek() returns the readable bytes that are contiguous in
+// memory, without copying, and shmring_consume() releases them.
+size_t shmring_peek(shmring_t *p_ring, const void **pp_data);
+void shmring_consume(shmring_t *p_ring, size_t i_size);
+// Drop everything written before the position i_head
+void shmring_discard(shmring_t *p_ring, uint64_t i_head);
+// False until the writer has set the format
+bool shmring_get_format(shmring_t *p_ring, unsigned *pi_rate, unsigned *pi_channels);
+unsigned shmring_flags(shmring_t *p_ring);
@@ -0,0 +1,87 @@
+/*****************************************************************************
+ * Copyright (C) 2015 Jonas Lundqvist
+ *
+ * Author: Jonas Lundqvist <jonas@gannon.se>
+ *
+ * This file is part of vlc-spotify.
+ *
+ * vlc-spotify is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "silence.h"
+
+// p_dst may be NULL to only scan. Always inlined, so that the check of it
+// goes away in both of the callers.
+static inline __attribute__((always_inline))
+void scan(int16_t *p_dst, const int16_t *p_src, size_t i_samples, int i_level,
+          silence_span_t *p_span)
+{
+    size_t i = 0;
+
+    p_span->b_sound = false;
+    p_span->i_first = p_span->i_end = 0;
+
+#ifdef __SSE2__
+    const __m128i above = _mm_set1_epi16((int16_t) i_level);
+    const __m128i below = _mm_set1_epi16((int16_t) -i_level);
+
+    for (; i + 8 <= i_samples; i += 8) {
+        __m128i x = _mm_loadu_si128((const __m128i *) (p_src + i));
+        // Two bits per sample, set for the loud ones
+        int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpgt_epi16(x, above),
+                                                  _mm_cmplt_epi16(x, below)));
+
+        if (p_dst != NULL)
+            _mm_storeu_si128((__m128i *) (p_dst + i), x);
+        if (mask == 0)
+            continue;
+        if (!p_span->b_sound) {
+            p_span->b_sound = true;
+            p_span->i_first = i + __builtin_ctz(mask) / 2;
+        }
+        p_span->i_end = i + (31 - __builtin_clz(mask)) / 2 + 1;
+    }
+#endif
+
+    // The rest, or all of it without SSE2
+    if (p_dst != NULL)
+        memcpy(p_dst + i, p_src + i, (i_samples - i) * sizeof(*p_src));
+    for (; i < i_samples; i++) {
+        if (p_src[i] <= i_level && p_src[i] >= -i_level)
+            continue;
+        if (!p_span->b_sound) {
+            p_span->b_sound = true;
+            p_span->i_first = i;
+        }
+        p_span->i_end = i + 1;
+    }
+}
+
+void silence_scan(const int16_t *p_src, size_t i_samples, int i_level,
+                  silence_span_t *p_span)
+{
+    scan(NULL, p_src, i_samples, i_level, p_span);
+}
+
+void silence_copy(int16_t *p_dst, const int16_t *p_src, size_t i_samples,
+                  int i_level, silence_span_t *p_span)
+{
+    scan(p_dst, p_src, i_samples, i_level, p_span);
+}
@@ -0,0 +1,45 @@
+/*****************************************************************************
+ * Copyright (C) 2015 Jonas Lundqvist
+ *
+ * Author: Jonas Lundqvist <jonas@gannon.se>
+ *
+ * This file is part of vlc-spotify.
+ *
+ * vlc-spotify is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+// Silence in S16 audio: where the sound starts and ends in a buffer.
+//
+// Meant for the delivery path, where every sample already goes through a
+// copy into the block: silence_copy() does the copy and the scan in one
+// pass. With SSE2 eight samples are compared, against the level on both
+// sides of zero, per instruction.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+    bool   b_sound;     // False if all of the buffer is silence
+    size_t i_first;     // The first sample louder than the level
+    size_t i_end;       // One past the last one
+} silence_span_t;
+
+// Samples up to i_level, 0 to 32767, either side of zero are silence
+void silence_scan(const int16_t *p_src, size_t i_samples, int i_level,
+                  silence_span_t *p_span);
+// The same, copying the samples to p_dst on the way
+void silence_copy(int16_t *p_dst, const int16_t *p_src, size_t i_samples,
+                  int i_level, silence_span_t *p_span);
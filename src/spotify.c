@@ -35,75 +35,185 @@
 #include <vlc_meta.h>
 #include <vlc_dialog.h>
 #include <vlc_input.h>
+#include <vlc_services_discovery.h>
 
 #include <libspotify/api.h>
 
 #include "uriparser.h"
+#include "session.h"
+#include "artcache.h"
+#include "metacache.h"
+#include "metaqueue.h"
+#include "metareader.h"
+#include "library.h"
+#include "librarysd.h"
+#include "membudget.h"
+#include "pacer.h"
+#include "playable.h"
+#include "playclock.h"
+#include "silence.h"
+#include "startlog.h"
+#include "tracklist.h"
+#ifndef _WIN32
+#include "remotedemux.h"
+#endif
 
 #define START_STOP_PROCEDURE_TIMEOUT_US 5000000
 
-#ifndef _WIN32
-#define VLC_SPOTIFY_CACHE_DIR "/tmp/vlc-spotify/cache"
-#define VLC_SPOTIFY_SETTINGS_DIR "/tmp/vlc-spotify/settings"
-#else
-#define VLC_SPOTIFY_CACHE_DIR "C:\\temp\\vlc-spotify\\cache"
-#define VLC_SPOTIFY_SETTINGS_DIR "C:\\temp\\vlc-spotify\\settings"
-#endif
+// Give up resuming after this many reloads without any audio in between
+#define MAX_RESUME_ATTEMPTS 5
+
+#define SEARCH_PAGE_SIZE 50
+
+// What an item waiting to be posted takes, roughly: the input_item_t with
+// its URI and options. Charged to the memory budget.
+#define PLAYLIST_ITEM_BYTES 1024
+
+// Audio kept while paused, in kB. About 12 s of 44.1 kHz stereo.
+#define PAUSE_BUFFER_KB 2048
 
-typedef enum {
-    CLEANUP_NOT_STARTED,
-    CLEANUP_PENDING,
-    CLEANUP_STARTED,
-    CLEANUP_DONE,
-} cleanup_state_e;
+// Only feed this far ahead of what is being played to the ES, in wall
+// time: at twice the speed twice as much audio is kept ahead
+#define PACE_AHEAD_US 250000
+
+// Duration of the audio blocks sent to the ES, filled across deliveries
+#define AUDIO_BLOCK_MS 40
+
+// The fastest rate kept up with, 4x
+#define MIN_RATE (INPUT_RATE_DEFAULT / 4)
+
+// Of an album played as one input, the next track is prefetched this long,
+// in media time, before the current one ends
+#define ALBUM_PREFETCH_US 10000000
+// How long the titles of an album wait for the tracks that are still
+// loading, well within START_STOP_PROCEDURE_TIMEOUT_US. They are kept
+// anyway after that, to be checked when they are played.
+#define ALBUM_TRACKS_WAIT_US 2000000
+// How often metadata_updated is asked for meanwhile, in case libspotify
+// does not call it again
+#define ALBUM_TRACKS_RECHECK_US 500000
+
+// Samples up to this amplitude are silence when trimming, about -60 dBFS
+#define SILENCE_LEVEL 32
+// Silence this long in the last SILENCE_TAIL_US of a track ends it
+#define SILENCE_MIN_MS 1000
+#define SILENCE_TAIL_US 10000000
 
 struct demux_sys_t {
-    vlc_thread_t    thread;
     vlc_cond_t      wait;
-    vlc_cond_t      spotify_wait;
 
     vlc_mutex_t     lock;
     vlc_mutex_t     audio_lock;
-    vlc_mutex_t     cleanup_lock;
     vlc_mutex_t     playlist_lock;
 
-    bool            spotify_notification;
     bool            play_started;
     bool            format_set;
     bool            start_procedure_done;
     bool            start_procedure_succesful;
-    bool            manual_login_ongoing;
+    const char     *psz_start_error;    // Why the start failed, if known
 
-    cleanup_state_e cleanup;
+    spotify_client_t client;
 
     spotify_type_e  spotify_type;
     char           *psz_uri;
     bool            playlist_meta_set;
 
+    // Album, playlist or folder entries, created by the session thread and
+    // posted by PlaylistDemux()
+    input_item_t  **pp_tracks;
+    int             i_tracks;
+
     char           *psz_meta_artist;
     char           *psz_meta_track;
     char           *psz_meta_album;
+    char            psz_meta_art_id[41];  // Empty if there is no cover
 
     es_out_id_t    *p_es_audio;
     date_t          pts;
-    date_t          starttime;
+    pacer_t         pace;
     mtime_t         duration;
     mtime_t         pts_offset;
-
-    // TODO: Due to libspotify limitations there can be only one
-    // sp_session. This one could be made persistant in the future.
-    // That way we could handle loading of meta data for tracks/albums/etc
-    // while playing one track.
+    bool            paused;
+    // The audio goes out in blocks of block_frames, filled across
+    // deliveries. Only their first sample has its PTS in the block.
+    block_t        *p_pending;
+    int             pending_frames;
+    int             pending_capacity;
+    mtime_t         pending_pts;
+    bool            pending_flush;      // Out with the delivery, after a start or seek
+    int             block_ms;
+    int             block_frames;       // 0 for a block per delivery
+    int             frame_bytes;
+    // A copy of the above for the control queries, published under
+    // audio_lock whenever any of it changes
+    playclock_t    *p_clock;
+
+    // While paused the deliveries go on into this chain, up to the cap,
+    // instead of to the ES. The resume sends it at once and goes on from
+    // the sample after it. Protected by audio_lock.
+    block_t        *p_retained;
+    block_t       **pp_retained_last;
+    size_t          retained_bytes;
+    size_t          retain_max;
+    bool            retain_full;        // A delivery did not fit
+    bool            player_paused;      // libspotify was told to pause
+    bool            eos_pending;        // The track ended into the chain
+    mtime_t         resume_time;        // Of the last resume, until audio is sent
+
+    // Connection loss recovery, protected by audio_lock
+    mtime_t         outage_start;       // 0 while connected
+    mtime_t         outage_buffered;    // Wall time sent ahead of playback at the loss
+    int             skip_frames;        // Dropped after a resume to splice exactly
+    int             resume_attempts;
+    bool            resume_retry;       // The reload failed, the outage goes on
+    int             outages;
+
+    // An album played as one input, with a title per track. The tracks are
+    // set up by the session thread before Open() returns and then only read.
+    // The current title and where it began are protected by audio_lock.
+    bool            album_titles;
+    bool            album_loading;      // Session thread, waiting for the tracks
+    mtime_t         album_wait_end;
+    sp_track      **pp_album_tracks;    // Referenced, p_track is one of them
+    track_meta_t   *p_album_meta;
+    int             i_album_tracks;
+    int             i_title;
+    mtime_t         track_start;        // The PTS of the first sample of the title
+    bool            album_next;         // The title ended, load the next one
+    bool            album_prefetched;
+    bool            load_pending;       // Until libspotify plays the new title
+    vlc_cond_t      track_ended;
+
+    // Silence trimming, see spotify-trim-silence. Protected by audio_lock.
+    int             silence_level;      // -1 if not trimming
+    mtime_t         silence_min;
+    bool            trim_leading;       // Until the first sound of the track
+    bool            tail_cut;           // Ended early, the rest is refused
+    mtime_t         silence_run;        // Up to the last delivery, in the tail
+    mtime_t         silence_lead;       // Trimmed from the start of the track
+    mtime_t         silence_tail;       // Cut from its end
+
+    // Of a track, until its first audio. Protected by audio_lock, logged
+    // by the demux thread.
+    startlog_t      startlog;
+    bool            startup_reported;
+
+    // Owned by session.c and shared with any other instance
     sp_session     *p_session;
     sp_track       *p_track;
     sp_album       *p_album;
     sp_albumbrowse *p_albumbrowse;
-};
+    sp_search      *p_search;
 
-static char *credentials = NULL;
+    // Playlists and folders are read by library.c
+    library_client_t library;
 
-extern const uint8_t g_appkey[];
-extern const size_t g_appkey_size;
+    // Search results are posted one page at a time. The last item of a
+    // page, if there are more results, opens the next page.
+    int             search_offset;
+    int             search_page_size;
+    int             search_next_offset;
+};
 
 // Needed for VLC module
 static int Open(vlc_object_t *object);
@@ -115,66 +225,44 @@ static int PlaylistControl(demux_t *p_demux, int i_query, va_list args);
 static int TrackDemux(demux_t *p_demux);
 static int PlaylistDemux(demux_t *p_demux);
 
-static void *spotify_main_loop(void *data);
-static void cleanup_spotify_main_loop(void *data);
+static void publish_clock(demux_sys_t *p_sys);
+static mtime_t playing_time(const playclock_snapshot_t *p_clock);
+static void send_block(demux_t *p_demux, block_t *p_block);
+static void emit_pending(demux_t *p_demux);
+static void drain_retained(demux_t *p_demux);
+static void drop_retained(demux_sys_t *p_sys);
+static void report_startup(demux_t *p_demux, const char *psz_result);
+static bool plays_tracks(const demux_sys_t *p_sys);
+static void album_switch(demux_t *p_demux, int i_title, bool b_jump);
 void set_track_meta(demux_sys_t *p_sys);
 void clear_track_meta(demux_sys_t *p_sys);
 input_item_t *get_current_item(demux_t *p_demux);
 static SP_CALLCONV void playlist_meta_done(sp_albumbrowse *result, void *userdata);
-
-static SP_CALLCONV void spotify_logged_in(sp_session *session, sp_error error);
-static SP_CALLCONV void spotify_logged_out(sp_session *session);
-static SP_CALLCONV void spotify_log_message(sp_session *session, const char *msg);
-static SP_CALLCONV void spotify_notify_main_thread(sp_session *session);
-static SP_CALLCONV int spotify_music_delivery(sp_session *session,
-                                              const sp_audioformat *format,
-                                              const void *frames, int num_frames);
-static SP_CALLCONV void spotify_metadata_updated(sp_session *session);
-static SP_CALLCONV void spotify_message_to_user(sp_session *session, const char *msg);
-static SP_CALLCONV void spotify_play_token_lost(sp_session *session);
-static SP_CALLCONV void spotify_end_of_track(sp_session *session);
-static SP_CALLCONV void spotify_credentials_blob_updated(sp_session *session,
-                                                         const char *blob);
-static SP_CALLCONV void spotify_connectionstate_updated(sp_session *session);
-static SP_CALLCONV void spotify_userinfo_updated(sp_session *session);
-
-static SP_CALLCONV void spotify_connection_error(sp_session *session, sp_error error);
-static SP_CALLCONV void spotify_streaming_error(sp_session *session, sp_error error);
-
-static sp_session_callbacks spotify_session_callbacks = {
-    .logged_in = &spotify_logged_in,
-    .logged_out = &spotify_logged_out,
-    .notify_main_thread = &spotify_notify_main_thread,
-    .music_delivery = &spotify_music_delivery,
-    .metadata_updated = &spotify_metadata_updated,
-    .play_token_lost = &spotify_play_token_lost,
-    .log_message = &spotify_log_message,
-    .message_to_user = &spotify_message_to_user,
-    .end_of_track = &spotify_end_of_track,
-    .credentials_blob_updated = &spotify_credentials_blob_updated,
-    .connectionstate_updated = &spotify_connectionstate_updated,
-    .userinfo_updated = &spotify_userinfo_updated,
-    .connection_error = &spotify_connection_error,
-    .streaming_error = &spotify_streaming_error
-};
-
-static sp_session_config spconfig = {
-    .api_version = SPOTIFY_API_VERSION,
-    .cache_location = VLC_SPOTIFY_CACHE_DIR, // TODO: path to vlc data?
-    .settings_location = VLC_SPOTIFY_SETTINGS_DIR,
-    .application_key = g_appkey,
-    .application_key_size = 0,
-    .user_agent = "vlc-spotify",
-    .callbacks = &spotify_session_callbacks,
-    .compress_playlists = false,
-    .dont_save_metadata_for_playlists = false,
-    .initially_unload_playlists = false,
-    NULL
-};
+static void album_tracks_ready(demux_t *p_demux, sp_albumbrowse *result);
+static SP_CALLCONV void search_page_done(sp_search *result, void *userdata);
+static void playlist_items_ready(demux_t *p_demux, input_item_t **pp_tracks, int i_tracks);
+static void library_items(void *p_opaque, input_item_t **pp_items, int i_items);
+static void library_playlist(void *p_opaque, sp_playlist *p_playlist);
+
+// Called from session.c
+static void spotify_logged_in(void *p_opaque, sp_error error);
+static int spotify_music_delivery(void *p_opaque, const sp_audioformat *format,
+                                  const void *frames, int num_frames);
+static void spotify_metadata_updated(void *p_opaque);
+static void start_failed(demux_t *p_demux, const char *psz_reason);
+static void resume_stream(demux_t *p_demux);
+static void spotify_play_token_lost(void *p_opaque);
+static void spotify_end_of_track(void *p_opaque);
+static void track_ended(demux_t *p_demux);
+static void spotify_player_loaded(void *p_opaque, sp_error error);
+static void spotify_connection_changed(void *p_opaque, sp_connectionstate state,
+                                       sp_error error);
 
 static const char * const pref_bitrate_text[] = { "96 kbps", "160 kbps", "320 kbps" };
 static const sp_bitrate pref_bitrate[] = { SP_BITRATE_96k, SP_BITRATE_160k, SP_BITRATE_320k };
 
+VLC_SD_PROBE_HELPER("spotify", "Spotify", SD_CAT_INTERNET)
+
 vlc_module_begin()
     set_shortname("Spotify")
     set_description("Stream from Spotify")
@@ -190,9 +278,89 @@ vlc_module_begin()
                "Username", "Spotify Username", false)
     add_integer("preferred_bitrate", SP_BITRATE_320k, "Preferred bitrate", "The preferred bitrate of the audio", true)
         change_integer_list(pref_bitrate, pref_bitrate_text)
+    add_integer_with_range("spotify-logout-delay", SPOTIFY_LOGOUT_DELAY_S, 0, 3600,
+                           "Logout delay", "Seconds to keep the Spotify session logged in after the last track is closed", true)
+    add_integer_with_range("spotify-search-page-size", SEARCH_PAGE_SIZE, 10, 200,
+                           "Search page size", "Number of search results fetched and added to the playlist at a time", true)
+    // Set on the item that continues a search, not meant for the user
+    add_integer("spotify-search-offset", 0, "Search offset", "Index of the first search result to fetch", true)
+        change_private()
+    add_integer_with_range("spotify-meta-lookahead", META_QUEUE_LOOKAHEAD, 0, 100,
+                           "Metadata lookahead", "Number of playlist items after the playing one to look up metadata for first", true)
+    add_bool("spotify-meta-background", false, "Look up all metadata",
+             "Look up the metadata of every track of an expanded album, search or playlist in the background, instead of only of the items that are opened and those after them", true)
+    add_bool("spotify-startup-stats", false, "Startup percentiles",
+             "Log the percentiles of each startup phase over the tracks opened in the session", true)
+    add_integer_with_range("spotify-pause-buffer", PAUSE_BUFFER_KB, 0, 65536,
+                           "Pause buffer (kB)", "Audio kept coming in while paused, so that playing resumes at once from the same sample. 0 pauses the stream right away", true)
+    add_integer_with_range("spotify-block-ms", AUDIO_BLOCK_MS, 0, 100,
+                           "Audio block (ms)", "Duration of the audio blocks passed on to the decoder. 0 passes each delivery of libspotify on as it is", true)
+    add_string("spotify-trace", "", "Callback trace",
+               "Record the libspotify callbacks of the session to this file, to replay them offline", true)
+    add_bool("spotify-album-titles", false, "Albums as titles",
+             "Play an album as one item with a title per track, without gaps between the tracks, instead of adding its tracks to the playlist", true)
+    add_bool("spotify-trim-silence", false, "Trim silence",
+             "Skip the silence at the start of tracks, and end them once only silence is left, for tighter transitions", true)
+    add_integer_with_range("spotify-silence-level", SILENCE_LEVEL, 0, 32767,
+                           "Silence level", "Samples up to this amplitude, out of 32767, count as silence when trimming", true)
+    add_integer_with_range("spotify-silence-min", SILENCE_MIN_MS, 100, 10000,
+                           "Trailing silence (ms)", "Silence this long in the last 10 seconds of a track ends it when trimming", true)
+    add_bool("spotify-trace-audio", false, "Trace the audio",
+             "Include the delivered audio in the callback trace", true)
+    add_integer_with_range("spotify-memory-budget", MEMBUDGET_MB, 0, 4096,
+                           "Memory budget (MB)", "What is kept in memory for all the Spotify items together: audio while paused, metadata and playlists. When it is reached less is kept. 0 for no limit", true)
+    add_bool("spotify-unload-playlists", true, "Load playlists when opened",
+             "Only load the tracks of a playlist when it is opened, instead of all of them at login", true)
+    add_integer_with_range("spotify-playlists-in-ram", LIBRARY_PLAYLISTS_IN_RAM, 0, 64,
+                           "Playlists kept in memory", "Number of the most recently opened playlists kept loaded, the others are unloaded", true)
+    add_bool("spotify-compress-playlists", false, "Compress playlists",
+             "Compress the playlists that are stored on disk", true)
+    add_bool("spotify-save-playlist-metadata", true, "Store playlist metadata",
+             "Store the metadata of the tracks in playlists on disk, which makes loading them faster", true)
+#ifndef _WIN32
+    add_bool("spotify-daemon", false, "Use vlc-spotifyd",
+             "Play tracks through the vlc-spotifyd daemon when it is running, sharing its session with other VLC instances", false)
+    add_string("spotify-daemon-socket", "", "vlc-spotifyd socket",
+               "Unix socket of vlc-spotifyd, $XDG_RUNTIME_DIR/vlc-spotifyd.sock if empty", true)
+#endif
     // TODO: Add 'spotify social'
+    // Tried before anything else, only takes the tracks being preparsed
+    add_submodule()
+        set_shortname("Spotify")
+        set_description("Spotify metadata for preparsing")
+        set_capability("access_demux", 12)
+        set_callbacks(MetaOpen, MetaClose)
+        add_shortcut("spotify", "http", "https")
+    // The playlists and starred tracks of the user
+    add_submodule()
+        set_shortname("Spotify")
+        set_description("Spotify library")
+        set_category(CAT_PLAYLIST)
+        set_subcategory(SUBCAT_PLAYLIST_SD)
+        set_capability("services_discovery", 0)
+        set_callbacks(LibraryOpen, LibraryClose)
+        add_shortcut("spotify")
+        VLC_SD_PROBE_SUBMODULE
+#ifndef _WIN32
+    // Tried before the session in this process, gives way to it when the
+    // daemon is not used
+    add_submodule()
+        set_shortname("Spotify")
+        set_description("Stream from Spotify through vlc-spotifyd")
+        set_capability("access_demux", 11)
+        set_callbacks(RemoteOpen, RemoteClose)
+        add_shortcut("spotify", "http", "https")
+#endif
 vlc_module_end ()
 
+// The session thread stays for the deferred logout after the last Close(),
+// it must be gone before the plugin is
+__attribute__((destructor))
+static void spotify_unload(void)
+{
+    spotify_session_shutdown();
+}
+
 static int Open(vlc_object_t *obj)
 {
     demux_t     *p_demux = (demux_t *)obj;
@@ -202,20 +370,32 @@ static int Open(vlc_object_t *obj)
     if (!p_sys)
         return VLC_ENOMEM;
 
+    startlog_begin(&p_sys->startlog, mdate());
     p_demux->p_sys = p_sys;
 
     p_sys->spotify_type = ParseURI(p_demux->psz_location, &p_sys->psz_uri);
 
     msg_Dbg(p_demux, "URI is %s", p_sys->psz_uri);
 
-    // TODO: Support playlists (and more?)
-    if (p_sys->spotify_type != SPOTIFY_TRACK && p_sys->spotify_type != SPOTIFY_ALBUM) {
+    if (p_sys->spotify_type != SPOTIFY_TRACK && p_sys->spotify_type != SPOTIFY_ALBUM &&
+        p_sys->spotify_type != SPOTIFY_SEARCH && p_sys->spotify_type != SPOTIFY_PLAYLIST &&
+        p_sys->spotify_type != SPOTIFY_FOLDER) {
         free(p_sys->psz_uri);
         free(p_sys);
         return VLC_EGENERIC;
     }
 
-    if (p_sys->spotify_type == SPOTIFY_TRACK) {
+    p_sys->album_titles = p_sys->spotify_type == SPOTIFY_ALBUM &&
+                          var_InheritBool(p_demux, "spotify-album-titles");
+
+    // Left to the meta reader, which never loads the player
+    if (plays_tracks(p_sys) && meta_reader_preparsing(p_demux)) {
+        free(p_sys->psz_uri);
+        free(p_sys);
+        return VLC_EGENERIC;
+    }
+
+    if (plays_tracks(p_sys)) {
         p_demux->pf_demux = TrackDemux;
         p_demux->pf_control = TrackControl;
     } else {
@@ -225,50 +405,121 @@ static int Open(vlc_object_t *obj)
 
     p_sys->start_procedure_done = false;
     p_sys->start_procedure_succesful = false;
-    p_sys->manual_login_ongoing = false;
 
     vlc_mutex_init(&p_sys->lock);
-    vlc_mutex_init(&p_sys->cleanup_lock);
     vlc_mutex_init(&p_sys->audio_lock);
     vlc_mutex_init(&p_sys->playlist_lock);
     vlc_cond_init(&p_sys->wait);
+    vlc_cond_init(&p_sys->track_ended);
 
     p_sys->play_started = false;
-    p_sys->cleanup = CLEANUP_NOT_STARTED;
     p_sys->format_set = false;
     p_sys->p_session = NULL;
     p_sys->p_es_audio = NULL;
     p_sys->pts_offset = 0;
     p_sys->playlist_meta_set = false;
+    pacer_init(&p_sys->pace, 0);
+    p_sys->pp_retained_last = &p_sys->p_retained;
+    p_sys->retain_max = 1024 * var_InheritInteger(p_demux, "spotify-pause-buffer");
+    p_sys->block_ms = var_InheritInteger(p_demux, "spotify-block-ms");
+    p_sys->pending_flush = true;
+    p_sys->silence_level = -1;
+    if (var_InheritBool(p_demux, "spotify-trim-silence")) {
+        p_sys->silence_level = var_InheritInteger(p_demux, "spotify-silence-level");
+        p_sys->silence_min = 1000 * var_InheritInteger(p_demux, "spotify-silence-min");
+        p_sys->trim_leading = true;
+    }
+
+    p_sys->p_clock = playclock_new();
+    if (p_sys->p_clock == NULL) {
+        vlc_cond_destroy(&p_sys->wait);
+        vlc_cond_destroy(&p_sys->track_ended);
+        vlc_mutex_destroy(&p_sys->lock);
+        vlc_mutex_destroy(&p_sys->audio_lock);
+        vlc_mutex_destroy(&p_sys->playlist_lock);
+        free(p_sys->psz_uri);
+        free(p_sys);
+        return VLC_ENOMEM;
+    }
 
     p_sys->psz_meta_track = p_sys->psz_meta_artist = p_sys->psz_meta_album = NULL;
+    p_sys->psz_meta_art_id[0] = '\0';
+
+    // Expanded items only have their URI until the metadata is looked up.
+    // Get this one, and the ones that probably will be played next, first.
+    if (p_sys->spotify_type == SPOTIFY_TRACK)
+        meta_queue_prioritize(p_sys->psz_uri, var_InheritInteger(p_demux, "spotify-meta-lookahead"));
+
+    if (p_sys->spotify_type == SPOTIFY_SEARCH) {
+        p_sys->search_offset = var_InheritInteger(p_demux, "spotify-search-offset");
+        p_sys->search_page_size = var_InheritInteger(p_demux, "spotify-search-page-size");
+    }
 
-    // Create the thread that will handle the spotify activities
-    if (vlc_clone(&p_sys->thread, spotify_main_loop, p_demux, VLC_THREAD_PRIORITY_LOW)) {
+    p_sys->client.p_opaque = p_demux;
+    p_sys->client.pf_logged_in = spotify_logged_in;
+    p_sys->client.pf_metadata_updated = spotify_metadata_updated;
+    p_sys->client.pf_music_delivery = spotify_music_delivery;
+    p_sys->client.pf_end_of_track = spotify_end_of_track;
+    p_sys->client.pf_play_token_lost = spotify_play_token_lost;
+    p_sys->client.pf_connection_changed = spotify_connection_changed;
+    p_sys->client.pf_player_loaded = spotify_player_loaded;
+
+    p_sys->library.p_opaque = p_demux;
+    p_sys->library.pf_items = library_items;
+    p_sys->library.pf_playlist = library_playlist;
+
+    // Attach to the spotify session. It is created, and the login started,
+    // if no other instance is using it or it has logged out.
+    p_sys->p_session = spotify_session_acquire(obj, &p_sys->client);
+    if (p_sys->p_session == NULL) {
+        playclock_delete(p_sys->p_clock);
         vlc_cond_destroy(&p_sys->wait);
+        vlc_cond_destroy(&p_sys->track_ended);
         vlc_mutex_destroy(&p_sys->lock);
-        vlc_mutex_destroy(&p_sys->cleanup_lock);
         vlc_mutex_destroy(&p_sys->audio_lock);
         vlc_mutex_destroy(&p_sys->playlist_lock);
         free(p_sys->psz_uri);
         free(p_sys);
-        return VLC_ENOMEM;
+        return VLC_EGENERIC;
     }
 
+    // Read by the session thread once it is logged in
+    if ((p_sys->spotify_type == SPOTIFY_PLAYLIST || p_sys->spotify_type == SPOTIFY_FOLDER) &&
+        library_read(p_sys->psz_uri, &p_sys->library) != VLC_SUCCESS)
+        start_failed(p_demux, NULL);
+
     // Wait until we are logged in and playing until we return SUCCESS
     // Or bail out after START_STOP_PROCEDURE_TIMEOUT_US
     // Unless login is ongoing
     deadline = mdate() + START_STOP_PROCEDURE_TIMEOUT_US;
     vlc_mutex_lock(&p_sys->lock);
-    do {
-        vlc_cond_timedwait(&p_sys->wait, &p_sys->lock, deadline);
-    } while((p_sys->manual_login_ongoing) ||
-            (mdate() < deadline && p_sys->start_procedure_done == false));
-
+    while (p_sys->start_procedure_done == false) {
+        mtime_t wake;
+
+        if (spotify_session_login_pending())
+            deadline = mdate() + START_STOP_PROCEDURE_TIMEOUT_US;
+        // The tracks of an album may be waited for without any
+        // metadata_updated coming
+        wake = p_sys->album_titles ? __MIN(deadline, mdate() + ALBUM_TRACKS_RECHECK_US)
+                                   : deadline;
+        if (vlc_cond_timedwait(&p_sys->wait, &p_sys->lock, wake) == 0)
+            continue;
+        if (wake < deadline) {
+            vlc_mutex_unlock(&p_sys->lock);
+            spotify_session_metadata_recheck(&p_sys->client);
+            vlc_mutex_lock(&p_sys->lock);
+        } else if (spotify_session_login_pending() == false) {
+            break;
+        }
+    }
     vlc_mutex_unlock(&p_sys->lock);
 
     if (p_sys->start_procedure_succesful == false) {
-        msg_Dbg(p_demux, "Failed to start...");
+        if (p_sys->psz_start_error != NULL)
+            msg_Err(p_demux, "Can not play %s: %s", p_sys->psz_uri, p_sys->psz_start_error);
+        else
+            msg_Dbg(p_demux, "Failed to start...");
+        report_startup(p_demux, p_sys->psz_start_error ? "unplayable" : "failed");
         Close(obj);
 
         return VLC_EGENERIC;
@@ -283,45 +534,73 @@ static void Close(vlc_object_t *obj)
 {
     demux_t *p_demux = (demux_t*)obj;
     demux_sys_t *p_sys = p_demux->p_sys;
-    mtime_t deadline;
+    char psz_memory[128];
+    int i;
 
     msg_Dbg(p_demux, "Closing down");
 
-    vlc_mutex_lock(&p_sys->cleanup_lock);
-    // Tell the thread to start the cleanup
-    if (p_sys->cleanup != CLEANUP_DONE) {
-        deadline = mdate() + (START_STOP_PROCEDURE_TIMEOUT_US);
-        p_sys->cleanup = CLEANUP_PENDING;
-        spotify_notify_main_thread(p_sys->p_session);
-        while(p_sys->cleanup != CLEANUP_DONE && mdate() < deadline) {
-            vlc_cond_timedwait(&p_sys->wait, &p_sys->cleanup_lock, deadline);
-        }
-    }
-    vlc_mutex_unlock(&p_sys->cleanup_lock);
+    // Closed before any audio was sent
+    if (p_sys->start_procedure_succesful)
+        report_startup(p_demux, "closed");
 
-    // Cancel the thread
-    vlc_cancel(p_sys->thread);
-    vlc_join(p_sys->thread, NULL);
+    // No callbacks will reach this instance after this
+    library_cancel(&p_sys->library);
+    spotify_session_detach(&p_sys->client);
 
-    if (p_sys->p_session) {
-        msg_Dbg(p_demux, "> sp_session_release()");
-        sp_session_release(p_sys->p_session);
+    // Leave the unloading and releasing to the session thread and keep the
+    // session logged in for a while, the next item is likely to need it.
+    if (p_sys->spotify_type == SPOTIFY_TRACK) {
+        spotify_session_defer_release(p_sys->play_started ?
+                                      SPOTIFY_RELEASE_PLAYER_TRACK :
+                                      SPOTIFY_RELEASE_TRACK,
+                                      p_sys->p_track);
+    } else if (p_sys->spotify_type == SPOTIFY_ALBUM) {
+        // The current title is the one in the player
+        for (i = 0; i < p_sys->i_album_tracks; i++)
+            spotify_session_defer_release(p_sys->play_started && i == p_sys->i_title ?
+                                          SPOTIFY_RELEASE_PLAYER_TRACK :
+                                          SPOTIFY_RELEASE_TRACK,
+                                          p_sys->pp_album_tracks[i]);
+        spotify_session_defer_release(SPOTIFY_RELEASE_ALBUMBROWSE, p_sys->p_albumbrowse);
+        spotify_session_defer_release(SPOTIFY_RELEASE_ALBUM, p_sys->p_album);
+    } else if (p_sys->spotify_type == SPOTIFY_SEARCH) {
+        spotify_session_defer_release(SPOTIFY_RELEASE_SEARCH, p_sys->p_search);
     }
+    p_sys->p_track = NULL;
+    p_sys->p_album = NULL;
+    p_sys->p_albumbrowse = NULL;
+    p_sys->p_search = NULL;
 
+    spotify_session_release();
+
+    drop_retained(p_sys);
     if (p_sys->p_es_audio)
         es_out_Del(p_demux->out, p_sys->p_es_audio);
 
     vlc_cond_destroy(&p_sys->wait);
+    vlc_cond_destroy(&p_sys->track_ended);
     vlc_mutex_destroy(&p_sys->lock);
-    vlc_mutex_destroy(&p_sys->cleanup_lock);
     vlc_mutex_destroy(&p_sys->audio_lock);
     vlc_mutex_destroy(&p_sys->playlist_lock);
+    playclock_delete(p_sys->p_clock);
 
     clear_track_meta(p_sys);
 
+    for (i = 0; i < p_sys->i_album_tracks; i++)
+        track_meta_clean(&p_sys->p_album_meta[i]);
+    free(p_sys->p_album_meta);
+    free(p_sys->pp_album_tracks);
+
+    for (i = 0; i < p_sys->i_tracks; i++)
+        vlc_gc_decref(p_sys->pp_tracks[i]);
+    free(p_sys->pp_tracks);
+    membudget_release(MEMBUDGET_PLAYLISTS, p_sys->i_tracks * PLAYLIST_ITEM_BYTES);
+
     free(p_sys->psz_uri);
     free(p_sys);
-    msg_Dbg(p_demux, "Closed succesfully");
+
+    membudget_format(psz_memory, sizeof(psz_memory));
+    msg_Dbg(p_demux, "Closed succesfully, memory: %s", psz_memory);
 }
 
 static int TrackDemux(demux_t *p_demux)
@@ -333,9 +612,57 @@ static int TrackDemux(demux_t *p_demux)
     if (p_sys->p_es_audio == NULL && p_sys->format_set == true)
         return 0; // EOF, will close the module
 
-#undef msleep
-    // Sleep for 100 ms to not hammer the CPU
-    msleep(100000);
+    vlc_mutex_lock(&p_sys->audio_lock);
+    // What was kept while paused, as the playing gets to it
+    if (!p_sys->paused)
+        drain_retained(p_demux);
+    // Paused with as much kept as allowed, stop the stream until the resume
+    if (p_sys->paused && p_sys->retain_full && !p_sys->player_paused) {
+        msg_Dbg(p_demux, "Pausing the stream with %zu kB kept", p_sys->retained_bytes / 1024);
+        spotify_session_player_play(false);
+        p_sys->player_paused = true;
+    }
+    // The end of the track, once the audio kept while paused has been sent
+    if (p_sys->eos_pending && !p_sys->paused && p_sys->p_retained == NULL) {
+        es_out_id_t *p_es = p_sys->p_es_audio;
+        p_sys->p_es_audio = NULL;
+        p_sys->eos_pending = false;
+        vlc_mutex_unlock(&p_sys->audio_lock);
+        // Waits for the decoder to play it all
+        es_out_Del(p_demux->out, p_es);
+        return 1;
+    }
+    // The next title follows on the last sample of this one
+    if (p_sys->album_next) {
+        int i_next = p_sys->i_title + 1;
+        p_sys->album_next = false;
+        vlc_mutex_unlock(&p_sys->audio_lock);
+        album_switch(p_demux, i_next, false);
+        return 1;
+    }
+    // Have libspotify fetch the next title while this one still plays
+    if (p_sys->i_title + 1 < p_sys->i_album_tracks && !p_sys->album_prefetched &&
+        p_sys->format_set &&
+        date_Get(&p_sys->pts) - p_sys->track_start > p_sys->duration - ALBUM_PREFETCH_US) {
+        spotify_session_player_prefetch(p_sys->pp_album_tracks[p_sys->i_title + 1]);
+        p_sys->album_prefetched = true;
+    }
+    vlc_mutex_unlock(&p_sys->audio_lock);
+
+    if (p_sys->startup_reported == false) {
+        bool b_started;
+        vlc_mutex_lock(&p_sys->audio_lock);
+        b_started = startlog_reached(&p_sys->startlog, STARTLOG_ES_OUT_SEND);
+        vlc_mutex_unlock(&p_sys->audio_lock);
+        if (b_started)
+            report_startup(p_demux, "ok");
+    }
+
+    // Sleep for 100 ms to not hammer the CPU, or until a title ends
+    vlc_mutex_lock(&p_sys->audio_lock);
+    if (!p_sys->album_next)
+        vlc_cond_timedwait(&p_sys->track_ended, &p_sys->audio_lock, mdate() + 100000);
+    vlc_mutex_unlock(&p_sys->audio_lock);
     return 1;
 }
 
@@ -345,52 +672,38 @@ static int PlaylistDemux(demux_t *p_demux)
 
     vlc_mutex_lock(&p_sys->playlist_lock);
     if (p_sys->playlist_meta_set == true) {
-        int num_tracks = sp_albumbrowse_num_tracks(p_sys->p_albumbrowse);
         int i;
-        char track_uri[255];
-        sp_link *track_link;
 
-        msg_Dbg(p_demux, "Demuxing an album! %d num of tracks", num_tracks);
-        input_item_t *p_new_input;
+        msg_Dbg(p_demux, "Demuxing a playlist! %d num of tracks", p_sys->i_tracks);
         input_item_t *p_current_input = get_current_item(p_demux);
 
         input_item_node_t *p_input_node = NULL;
         p_input_node = input_item_node_Create(p_current_input);
 
-        for(i = 0; i < num_tracks; i++) {
-            char complete_uri[255] = "spotify://";
-            p_sys->p_track = sp_albumbrowse_track(p_sys->p_albumbrowse, i);
-            set_track_meta(p_sys);
-            track_link = sp_link_create_from_track(p_sys->p_track, 0);
-            sp_link_as_string(track_link, track_uri, 255);
-
-            p_new_input = input_item_New(strcat(complete_uri, track_uri),
-                                         p_sys->psz_meta_track);
-
-            if (p_sys->psz_meta_artist)
-                input_item_SetArtist(p_new_input, p_sys->psz_meta_artist);
-
-            if (p_sys->psz_meta_album)
-                input_item_SetMeta(p_new_input, vlc_meta_Album, p_sys->psz_meta_album);
-
-            input_item_SetDuration(p_new_input,
-                                   sp_track_duration(p_sys->p_track)*1000);
+        for(i = 0; i < p_sys->i_tracks; i++) {
+            input_item_t *p_new_input = p_sys->pp_tracks[i];
 
             input_item_CopyOptions(p_input_node->p_item, p_new_input);
+            // After the copy, so that it overrides the offset of this page
+            if (p_sys->search_next_offset > 0 && i == p_sys->i_tracks - 1) {
+                char psz_option[64];
+                snprintf(psz_option, sizeof(psz_option), "spotify-search-offset=%d",
+                         p_sys->search_next_offset);
+                input_item_AddOption(p_new_input, psz_option, VLC_INPUT_OPTION_TRUSTED);
+            }
             input_item_node_AppendItem(p_input_node, p_new_input);
             vlc_gc_decref(p_new_input);
-            msg_Dbg(p_demux, "Added %s to playlist with URI %s", p_sys->psz_meta_track, complete_uri);
-            clear_track_meta(p_sys);
         }
+        free(p_sys->pp_tracks);
+        p_sys->pp_tracks = NULL;
+        membudget_release(MEMBUDGET_PLAYLISTS, p_sys->i_tracks * PLAYLIST_ITEM_BYTES);
+        p_sys->i_tracks = 0;
 
         input_item_node_PostAndDelete(p_input_node);
         p_input_node = NULL;
         vlc_gc_decref(p_current_input);
 
-        vlc_mutex_unlock(&p_sys->playlist_lock);
-
-        msg_Dbg(p_demux, "< sp_albumbrowse_release()");
-        sp_albumbrowse_release(p_sys->p_albumbrowse);
+        p_sys->playlist_meta_set = false;
     }
     vlc_mutex_unlock(&p_sys->playlist_lock);
 
@@ -404,9 +717,13 @@ static int TrackControl(demux_t *p_demux, int i_query, va_list args)
     bool b;
     int64_t i64;
     int64_t *pi64;
+    int *pi;
     double *pd;
     double d;
     vlc_meta_t *p_meta;
+    input_title_t ***ppp_title;
+    int i;
+    playclock_snapshot_t clock;
 
     switch(i_query)
     {
@@ -419,53 +736,90 @@ static int TrackControl(demux_t *p_demux, int i_query, va_list args)
     case DEMUX_SET_PAUSE_STATE:
         b = (bool) va_arg(args, int);
         if (b) {
-            // Pause
+            // Pause. The clock stops where the playing is, the stream goes
+            // on into the retained chain until it is full.
             vlc_mutex_lock(&p_sys->audio_lock);
-            p_sys->pts_offset = p_sys->pts.date;
-            msg_Dbg(p_demux, "> sp_session_player_play(%d)", !b);
-            sp_session_player_play(p_sys->p_session, !b);
+            // Published under this lock, so it is current
+            playclock_read(p_sys->p_clock, &clock);
+            p_sys->pts_offset = playing_time(&clock);
+            p_sys->paused = true;
+            p_sys->retain_full = false;
+            if (p_sys->retain_max == 0 && !p_sys->player_paused) {
+                spotify_session_player_play(false);
+                p_sys->player_paused = true;
+            }
+            publish_clock(p_sys);
             vlc_mutex_unlock(&p_sys->audio_lock);
         } else {
-            // Unpause
+            // Unpause. The PTS goes on from the last sample received, so
+            // whatever was kept follows on exactly. It goes out as if it
+            // was being delivered, at the pace of the pacer.
             vlc_mutex_lock(&p_sys->audio_lock);
-            date_Set(&p_sys->pts, VLC_TS_0 + p_sys->pts_offset);
-            date_Set(&p_sys->starttime, mdate() - p_sys->pts_offset);
-            msg_Dbg(p_demux, "> sp_session_player_play(%d)", !b);
-            sp_session_player_play(p_sys->p_session, !b);
+            if (!p_sys->paused) {
+                vlc_mutex_unlock(&p_sys->audio_lock);
+                return VLC_SUCCESS;
+            }
+            pacer_set_time(&p_sys->pace, p_sys->pts_offset, mdate());
+            p_sys->paused = false;
+            p_sys->resume_time = mdate();
+            msg_Dbg(p_demux, "Resuming with %zu kB kept", p_sys->retained_bytes / 1024);
+
+            p_sys->retain_full = false;
+            drain_retained(p_demux);
+
+            if (p_sys->player_paused) {
+                spotify_session_player_play(true);
+                p_sys->player_paused = false;
+            }
+            publish_clock(p_sys);
             vlc_mutex_unlock(&p_sys->audio_lock);
         }
 
         return VLC_SUCCESS;
 
+    // Times are within the title, the PTS goes on from the start of the album
     case DEMUX_SET_TIME:
         i64 = (int64_t) va_arg(args, int64_t);
         vlc_mutex_lock(&p_sys->audio_lock);
-        p_sys->pts_offset = i64;
-        msg_Dbg(p_demux, "> sp_session_player_seek()");
-        sp_session_player_seek(p_sys->p_session, p_sys->pts_offset / 1000);
+        drop_retained(p_sys);
+        p_sys->pts_offset = p_sys->track_start + i64;
+        p_sys->trim_leading = false;
+        p_sys->silence_run = 0;
+        p_sys->pending_flush = true;
+        spotify_session_player_seek(i64 / 1000);
         date_Set(&p_sys->pts, p_sys->pts_offset);
-        date_Set(&p_sys->starttime, mdate() - p_sys->pts_offset);
+        pacer_set_time(&p_sys->pace, p_sys->pts_offset, mdate());
+        publish_clock(p_sys);
         vlc_mutex_unlock(&p_sys->audio_lock);
         return VLC_SUCCESS;
 
+    // Polled all the time, these never wait for a delivery to finish
     case DEMUX_GET_TIME:
         pi64 = (int64_t *) va_arg(args, int64_t *);
-        *pi64 = date_Get(&p_sys->pts);
+        playclock_read(p_sys->p_clock, &clock);
+        *pi64 = __MAX(playing_time(&clock) - clock.i_track_start, 0);
         return VLC_SUCCESS;
 
     case DEMUX_GET_POSITION:
         pd = (double *) va_arg(args, double *);
-        *pd = (double) (p_sys->pts.date) / p_sys->duration;
+        playclock_read(p_sys->p_clock, &clock);
+        i64 = __MAX(playing_time(&clock) - clock.i_track_start, 0);
+        *pd = clock.i_duration > 0 ? (double) i64 / clock.i_duration : 0.0;
         return VLC_SUCCESS;
 
     case DEMUX_SET_POSITION:
         d = (double) va_arg(args, double);
         vlc_mutex_lock(&p_sys->audio_lock);
-        p_sys->pts_offset = (d * (p_sys->duration));
-        msg_Dbg(p_demux, "> sp_session_player_seek()");
-        sp_session_player_seek(p_sys->p_session, p_sys->pts_offset / 1000);
+        drop_retained(p_sys);
+        i64 = d * p_sys->duration;
+        p_sys->pts_offset = p_sys->track_start + i64;
+        p_sys->trim_leading = false;
+        p_sys->silence_run = 0;
+        p_sys->pending_flush = true;
+        spotify_session_player_seek(i64 / 1000);
         date_Set(&p_sys->pts, p_sys->pts_offset);
-        date_Set(&p_sys->starttime, mdate() - p_sys->pts_offset);
+        pacer_set_time(&p_sys->pace, p_sys->pts_offset, mdate());
+        publish_clock(p_sys);
         vlc_mutex_unlock(&p_sys->audio_lock);
         return VLC_SUCCESS;
 
@@ -476,24 +830,94 @@ static int TrackControl(demux_t *p_demux, int i_query, va_list args)
 
     case DEMUX_GET_LENGTH:
         pi64 = (int64_t*) va_arg(args, int64_t *);
-        *pi64 = p_sys->duration;
+        playclock_read(p_sys->p_clock, &clock);
+        *pi64 = clock.i_duration;
         return VLC_SUCCESS;
 
+    // The audio comes at the pace of libspotify, held back to the rate
     case DEMUX_CAN_CONTROL_PACE:
+        pb = (bool*) va_arg(args, bool *);
+        *pb = false;
+        return VLC_SUCCESS;
+
     case DEMUX_CAN_CONTROL_RATE:
+        pb = (bool*) va_arg(args, bool *);
+        *pb = true;
         pb = (bool*) va_arg(args, bool *);
         *pb = true;
         return VLC_SUCCESS;
 
+    case DEMUX_SET_RATE:
+        pi = (int*) va_arg(args, int *);
+        *pi = __MAX(*pi, MIN_RATE);
+        vlc_mutex_lock(&p_sys->audio_lock);
+        // Paused, the pace is set again from pts_offset when resuming. Before
+        // the first delivery there is no pace yet, only the rate to start at.
+        if (p_sys->format_set)
+            pacer_set_rate(&p_sys->pace, *pi, mdate());
+        else
+            p_sys->pace.i_rate = *pi;
+        publish_clock(p_sys);
+        vlc_mutex_unlock(&p_sys->audio_lock);
+        msg_Dbg(p_demux, "Playing at %.2fx", (double) INPUT_RATE_DEFAULT / *pi);
+        return VLC_SUCCESS;
+
+    case DEMUX_GET_TITLE_INFO:
+        if (p_sys->i_album_tracks == 0)
+            return VLC_EGENERIC;
+        ppp_title = (input_title_t ***) va_arg(args, input_title_t ***);
+        *ppp_title = malloc(p_sys->i_album_tracks * sizeof(**ppp_title));
+        if (*ppp_title == NULL)
+            return VLC_ENOMEM;
+        for (i = 0; i < p_sys->i_album_tracks; i++) {
+            const track_meta_t *p_track_meta = &p_sys->p_album_meta[i];
+            input_title_t *p_title = vlc_input_title_New();
+
+            if (unlikely(p_title == NULL)) {
+                while (i > 0)
+                    vlc_input_title_Delete((*ppp_title)[--i]);
+                free(*ppp_title);
+                return VLC_ENOMEM;
+            }
+            if (p_track_meta->psz_title != NULL)
+                p_title->psz_name = strdup(p_track_meta->psz_title);
+            p_title->i_length = p_track_meta->i_duration;
+            (*ppp_title)[i] = p_title;
+        }
+        pi = (int *) va_arg(args, int *);
+        *pi = p_sys->i_album_tracks;
+        // No title or seekpoint offsets
+        pi = (int *) va_arg(args, int *);
+        *pi = 0;
+        pi = (int *) va_arg(args, int *);
+        *pi = 0;
+        return VLC_SUCCESS;
+
+    case DEMUX_SET_TITLE:
+        i = (int) va_arg(args, int);
+        if (i < 0 || i >= p_sys->i_album_tracks)
+            return VLC_EGENERIC;
+        album_switch(p_demux, i, true);
+        return VLC_SUCCESS;
+
     case DEMUX_GET_META:
         p_meta = (vlc_meta_t*) va_arg(args, vlc_meta_t*);
-        set_track_meta(p_sys);
+        // Filled in by the session thread when the track was loaded
+        vlc_mutex_lock(&p_sys->lock);
         if (p_sys->psz_meta_track)
             vlc_meta_Set(p_meta, vlc_meta_Title, p_sys->psz_meta_track);
         if (p_sys->psz_meta_artist)
             vlc_meta_Set(p_meta, vlc_meta_Artist, p_sys->psz_meta_artist);
         if(p_sys->psz_meta_album)
             vlc_meta_Set(p_meta, vlc_meta_Album, p_sys->psz_meta_album);
+        if (p_sys->psz_meta_art_id[0] != '\0') {
+            char *psz_url = art_cached_url(p_sys->psz_meta_art_id);
+            if (psz_url) {
+                vlc_meta_Set(p_meta, vlc_meta_ArtworkURL, psz_url);
+                free(psz_url);
+            }
+        }
+        vlc_mutex_unlock(&p_sys->lock);
         return VLC_SUCCESS;
 
     default:
@@ -509,155 +933,16 @@ static int PlaylistControl(demux_t *p_demux, int i_query, va_list args)
 }
 
 
-// TODO: Put the login and creation of the Spotify session somewhere else.
-static void *spotify_main_loop(void *data)
+// Session thread
+static void spotify_logged_in(void *p_opaque, sp_error error)
 {
-    demux_t *p_demux = (demux_t *) data;
-    demux_sys_t *p_sys = p_demux->p_sys;
-    sp_error     err;
-    int          canc = vlc_savecancel();
-    char        *psz_username;
-    char        *psz_password;
-    int          spotify_timeout = 0;
-    mtime_t      spotify_timeout_us;
-    sp_bitrate   spotify_bitrate;
-    char         stored_username[255];
-
-    p_sys->spotify_notification = false;
-    vlc_cond_init(&p_sys->spotify_wait);
-
-    psz_username = var_InheritString(p_demux, "spotify-username");
-
-    spconfig.application_key_size = g_appkey_size;
-    spconfig.userdata = p_demux;
-    msg_Dbg(p_demux, "> sp_session_create()");
-    err = sp_session_create(&spconfig, &p_sys->p_session);
-
-    if (SP_ERROR_OK != err) {
-        dialog_Fatal(p_demux, "Spotify session error: ", "%s", sp_error_message(err));
-    }
-
-    spotify_bitrate = var_InheritInteger(p_demux, "preferred_bitrate");
-    msg_Dbg(p_demux, "> sp_session_preferred_bitrate(%d)", spotify_bitrate);
-    err = sp_session_preferred_bitrate(p_sys->p_session, spotify_bitrate);
-    if (SP_ERROR_OK != err) {
-        msg_Dbg(p_demux, "Error setting the preferred bitrate");
-    }
-
-    if (sp_session_remembered_user(p_sys->p_session, stored_username, 255) != -1) {
-        msg_Dbg(p_demux, "Username \"%s\" remembered -> sp_session_relogin()", stored_username);
-        sp_session_relogin(p_sys->p_session);
-    } else if (credentials != NULL) {
-        msg_Dbg(p_demux, "> sp_session_login() via blob");
-        sp_session_login(p_sys->p_session, psz_username, NULL, 1, credentials);
-    } else {
-        msg_Dbg(p_demux, "> sp_session_login() with user/pass");
-        vlc_mutex_lock(&p_sys->lock);
-        p_sys->manual_login_ongoing = true;
-        vlc_mutex_unlock(&p_sys->lock);
-        dialog_Login(p_demux, &psz_username, &psz_password,
-                     "Spotify login", "%s",
-                     "Please enter valid username and password");
-        if(psz_username != NULL && psz_password != NULL) {
-            sp_session_login(p_sys->p_session, psz_username, psz_password, 1, NULL);
-            free(psz_username);
-            free(psz_password);
-        } else {
-            msg_Dbg(p_demux, "Login dialog failed");
-        }
-    }
-
-    for (;;) {
-        vlc_mutex_lock(&p_sys->lock);
-        vlc_cleanup_push(cleanup_spotify_main_loop, p_demux);
-
-        // Allow cancelation from here.
-        vlc_restorecancel(canc);
-
-        // Wait here until we get some expected spotify activity
-        if (spotify_timeout == 0) {
-            while (p_sys->spotify_notification == false) {
-                msg_Dbg(p_demux, "Waiting for spotify activity");
-                vlc_cond_wait(&p_sys->spotify_wait, &p_sys->lock);
-            }
-        } else if(p_sys->spotify_notification == false) {
-            msg_Dbg(p_demux, "Waiting for timed spotify activity, %d ms", spotify_timeout);
-            spotify_timeout_us = mdate() + spotify_timeout * 1000;
-            vlc_cond_timedwait(&p_sys->spotify_wait, &p_sys->lock, spotify_timeout_us);
-        }
-
-        canc = vlc_savecancel();
-        vlc_cleanup_pop();
-
-        vlc_mutex_unlock(&p_sys->lock);
-
-        // CLEANUP_PENDING is set from Close()
-        vlc_mutex_lock(&p_sys->cleanup_lock);
-        if (p_sys->cleanup == CLEANUP_PENDING) {
-            sp_session_player_play(p_sys->p_session, 0);
-            if (p_sys->spotify_type == SPOTIFY_TRACK) {
-                msg_Dbg(p_demux, "> sp_track_release()");
-                sp_track_release(p_sys->p_track);
-                p_sys->p_track = NULL;
-                msg_Dbg(p_demux, "> sp_player_unload()");
-                sp_session_player_unload(p_sys->p_session);
-            } else if (p_sys->spotify_type == SPOTIFY_ALBUM) {
-                msg_Dbg(p_demux, "> sp_album_release()");
-                sp_album_release(p_sys->p_album);
-                p_sys->p_album = NULL;
-            }
-
-            msg_Dbg(p_demux, "> sp_session_logout()");
-            sp_session_logout(p_sys->p_session);
-            p_sys->cleanup = CLEANUP_STARTED;
-        }
-        // CLEANUP_DONE is set from the logout callback
-        if (p_sys->cleanup == CLEANUP_DONE) {
-            vlc_cond_signal(&p_sys->wait);
-        }
-        vlc_mutex_unlock(&p_sys->cleanup_lock);
-
-        p_sys->spotify_notification = false;
-
-        do {
-            msg_Dbg(p_demux, "> sp_session_process_events()");
-            sp_session_process_events(p_sys->p_session, &spotify_timeout);
-        } while(spotify_timeout == 0);
-    }
-
-    return NULL;
-}
-
-static void cleanup_spotify_main_loop(void *data)
-{
-    demux_t *p_demux = (demux_t *) data;
-    demux_sys_t *p_sys = p_demux->p_sys;
-
-    vlc_mutex_unlock(&p_sys->lock);
-    msg_Dbg(p_demux, "Cleaning up the thread");
-
-    vlc_cond_destroy(&p_sys->spotify_wait);
-}
-
-// Called from sp_session_process_events()
-static SP_CALLCONV void spotify_logged_in(sp_session *session, sp_error error)
-{
-    demux_t *p_demux = (demux_t *) sp_session_userdata(session);
+    demux_t *p_demux = (demux_t *) p_opaque;
     demux_sys_t *p_sys = p_demux->p_sys;
 
     sp_link *link;
-    msg_Dbg(p_demux, "< logged_in()");
 
-    // TODO: Trigger relogin if username/password is incorrect
     if (SP_ERROR_OK != error) {
-        dialog_Fatal(p_demux, "Login Error: ","%s", sp_error_message(error));
-        vlc_mutex_lock(&p_sys->lock);
-        p_sys->start_procedure_done = true;
-        p_sys->start_procedure_succesful = false;
-        p_sys->manual_login_ongoing = false;
-        vlc_cond_signal(&p_sys->wait);
-        vlc_mutex_unlock(&p_sys->lock);
-
+        start_failed(p_demux, NULL);
         return;
     }
 
@@ -667,183 +952,309 @@ static SP_CALLCONV void spotify_logged_in(sp_session *session, sp_error error)
         sp_track_add_ref(p_sys->p_track = sp_link_as_track(link));
         msg_Dbg(p_demux, "> sp_link_release()");
         sp_link_release(link);
+        // With a reused session the track is often already loaded and
+        // there will be no metadata_updated for it
+        spotify_metadata_updated(p_demux);
     } else if (p_sys->spotify_type == SPOTIFY_ALBUM) {
-        link = sp_link_create_from_string(p_sys->psz_uri);
-        msg_Dbg(p_demux, "> sp_album_add_ref(sp_link_as_album())");
-        sp_album_add_ref(p_sys->p_album = sp_link_as_album(link));
         msg_Dbg(p_demux, "> sp_albumbrowse_create()");
-        p_sys->p_albumbrowse = sp_albumbrowse_create(p_sys->p_session, p_sys->p_album, playlist_meta_done, p_demux);
+        p_sys->p_albumbrowse = tracklist_browse(p_sys->p_session, p_sys->psz_uri, &p_sys->p_album,
+                                                playlist_meta_done, &p_sys->client);
+        if (p_sys->p_albumbrowse == NULL)
+            start_failed(p_demux, "Invalid link");
+    } else if (p_sys->spotify_type == SPOTIFY_SEARCH) {
+        msg_Dbg(p_demux, "> sp_search_create(\"%s\", %d, %d)", p_sys->psz_uri,
+                p_sys->search_offset, p_sys->search_page_size);
+        // One page
+        p_sys->p_search = tracklist_search(p_sys->p_session, p_sys->psz_uri,
+                                           p_sys->search_offset, p_sys->search_page_size,
+                                           search_page_done, &p_sys->client);
     }
 
     p_sys->format_set = false;
 }
 
-// Called from sp_session_process_events()
-static SP_CALLCONV void spotify_logged_out(sp_session *session)
+// Session thread
+static void spotify_metadata_updated(void *p_opaque)
 {
-    demux_t *p_demux = (demux_t *) sp_session_userdata(session);
+    demux_t *p_demux = (demux_t *) p_opaque;
     demux_sys_t *p_sys = p_demux->p_sys;
+    bool resume;
 
-    msg_Dbg(p_demux, "< logged_out()");
-
-    p_sys->spotify_notification = true;
-    p_sys->cleanup = CLEANUP_DONE;
-}
+    // Starts playing once they have loaded
+    if (p_sys->album_loading) {
+        album_tracks_ready(p_demux, p_sys->p_albumbrowse);
+        return;
+    }
 
-// Called from sp_session_process_events()
-static SP_CALLCONV void spotify_metadata_updated(sp_session *session)
-{
-    demux_t *p_demux = (demux_t *) sp_session_userdata(session);
-    demux_sys_t *p_sys = p_demux->p_sys;
+    // A failed reload is tried again as libspotify gets further
+    vlc_mutex_lock(&p_sys->audio_lock);
+    resume = p_sys->resume_retry && p_sys->outage_start != 0;
+    vlc_mutex_unlock(&p_sys->audio_lock);
+    if (resume) {
+        resume_stream(p_demux);
+        return;
+    }
 
-    msg_Dbg(p_demux, "< metadata_updated()");
+    if (plays_tracks(p_sys) && p_sys->play_started == false &&
+        p_sys->p_track != NULL && sp_track_error(p_sys->p_track) != SP_ERROR_IS_LOADING) {
+        const char *psz_reason = NULL;
+        sp_track   *p_playable;
+        sp_error    err;
+
+        // Fail at once, the player would only never deliver anything
+        p_playable = track_playable(p_sys->p_session, p_sys->p_track, &psz_reason);
+        if (p_playable == NULL) {
+            start_failed(p_demux, psz_reason);
+            return;
+        }
+        if (p_playable != p_sys->p_track)
+            msg_Dbg(p_demux, "Relinked, playing another release of the track");
 
-    if (p_sys->spotify_type == SPOTIFY_TRACK && p_sys->play_started == false) {
         msg_Dbg(p_demux, "> sp_session_player_load()");
         vlc_mutex_lock(&p_sys->audio_lock);
-        sp_session_player_load(p_sys->p_session, p_sys->p_track);
+        startlog_mark(&p_sys->startlog, STARTLOG_METADATA_UPDATED, mdate());
+        err = spotify_session_player_load_now(p_sys->p_track);
+        if (err != SP_ERROR_OK) {
+            vlc_mutex_unlock(&p_sys->audio_lock);
+            start_failed(p_demux, sp_error_message(err));
+            return;
+        }
+        startlog_mark(&p_sys->startlog, STARTLOG_PLAYER_LOAD, mdate());
         msg_Dbg(p_demux, "> sp_session_player_play()");
         sp_session_player_play(p_sys->p_session, 1);
         p_sys->duration = sp_track_duration(p_sys->p_track)*1000;
+        publish_clock(p_sys);
         vlc_mutex_unlock(&p_sys->audio_lock);
 
-        if (p_sys->play_started == false) {
-            // Signal back that the start is done so Open() can return
-            vlc_mutex_lock(&p_sys->lock);
-            p_sys->start_procedure_done = true;
-            p_sys->start_procedure_succesful = true;
-            p_sys->manual_login_ongoing = false;
-            vlc_cond_signal(&p_sys->wait);
-            p_sys->play_started = true;
-            vlc_mutex_unlock(&p_sys->lock);
+        // Signal back that the start is done so Open() can return
+        vlc_mutex_lock(&p_sys->lock);
+        set_track_meta(p_sys);
+        p_sys->start_procedure_done = true;
+        p_sys->start_procedure_succesful = true;
+        vlc_cond_signal(&p_sys->wait);
+        p_sys->play_started = true;
+        vlc_mutex_unlock(&p_sys->lock);
+
+        // Fetched by the session thread once this callback returns
+        if (p_sys->psz_meta_art_id[0] != '\0') {
+            input_item_t *p_item = get_current_item(p_demux);
+            art_queue_add(p_item, p_sys->psz_meta_art_id);
+            vlc_gc_decref(p_item);
         }
     } else {
         msg_Dbg(p_demux, "Ignored...");
     }
 }
 
-// Called from sp_session_process_events()
-static SP_CALLCONV void spotify_log_message(sp_session *session, const char *msg)
-{
-    demux_t *p_demux = (demux_t *) sp_session_userdata(session);
-
-    msg_Dbg(p_demux, "< log_message(): %s", msg);
-}
-
-// Called from sp_session_process_events()
-static SP_CALLCONV void spotify_message_to_user(sp_session *session, const char *msg)
+// Session thread
+// Lets Open() return with the failure. psz_reason is a static string, or
+// NULL if there is nothing to tell beyond what has been logged.
+static void start_failed(demux_t *p_demux, const char *psz_reason)
 {
-    demux_t *p_demux = (demux_t *) sp_session_userdata(session);
+    demux_sys_t *p_sys = p_demux->p_sys;
 
-    // TODO: What kind of messages is this?
-    // Is perhaps a dialog needed?
-    msg_Dbg(p_demux, "< message_to_user(): %s", msg);
+    vlc_mutex_lock(&p_sys->lock);
+    p_sys->psz_start_error = psz_reason;
+    p_sys->start_procedure_done = true;
+    p_sys->start_procedure_succesful = false;
+    vlc_cond_signal(&p_sys->wait);
+    vlc_mutex_unlock(&p_sys->lock);
 }
 
-static SP_CALLCONV void spotify_streaming_error(sp_session *session, sp_error error)
+// Session thread
+// Reload the track and continue from the next sample that was never
+// delivered. The PTS keeps counting from where it stopped, so VLC sees one
+// continuous stream with, at worst, a late block.
+static void resume_stream(demux_t *p_demux)
 {
-    demux_t *p_demux = (demux_t *) sp_session_userdata(session);
-
-    msg_Dbg(p_demux, "< streaming_error(): %s", sp_error_message(error));
-}
+    demux_sys_t *p_sys = p_demux->p_sys;
+    mtime_t resume_at;
+    mtime_t outage;
+    mtime_t gap;
+    int resume_ms;
+    bool paused;
+    sp_track *p_track;
+    sp_error error;
 
-static SP_CALLCONV void spotify_connection_error(sp_session *session, sp_error error)
-{
-    demux_t *p_demux = (demux_t *) sp_session_userdata(session);
+    vlc_mutex_lock(&p_sys->audio_lock);
+    p_sys->resume_retry = false;
+    if (p_sys->resume_attempts >= MAX_RESUME_ATTEMPTS) {
+        msg_Err(p_demux, "Giving up resuming after %d attempts", p_sys->resume_attempts);
+        p_sys->outage_start = 0;
+        vlc_mutex_unlock(&p_sys->audio_lock);
+        return;
+    }
+    p_sys->resume_attempts++;
+    p_track = p_sys->p_track;
+    vlc_mutex_unlock(&p_sys->audio_lock);
 
-    msg_Dbg(p_demux, "< connection_error(): %s", sp_error_message(error));
-}
+    msg_Dbg(p_demux, "> sp_session_player_load()");
+    error = spotify_session_player_load_now(p_track);
+    if (error != SP_ERROR_OK) {
+        // Still in the outage, tried again on the next update
+        msg_Warn(p_demux, "Failed to reload the track: %s", sp_error_message(error));
+        vlc_mutex_lock(&p_sys->audio_lock);
+        p_sys->resume_retry = true;
+        vlc_mutex_unlock(&p_sys->audio_lock);
+        return;
+    }
 
-// libspotify context
-static SP_CALLCONV void spotify_userinfo_updated(sp_session *session)
-{
-    demux_t *p_demux = (demux_t *) sp_session_userdata(session);
+    vlc_mutex_lock(&p_sys->audio_lock);
+    resume_at = p_sys->format_set ? date_Get(&p_sys->pts) - p_sys->track_start : 0;
+    resume_ms = resume_at / 1000;
+    // libspotify seeks in ms, drop the remaining part of the ms after the seek
+    p_sys->skip_frames = p_sys->format_set ?
+        (resume_at - resume_ms * INT64_C(1000)) * p_sys->pts.i_divider_num / CLOCK_FREQ : 0;
+
+    // What was queued ahead covered part of the outage, the rest was heard
+    outage = mdate() - p_sys->outage_start;
+    gap = __MAX(outage - p_sys->outage_buffered, 0);
+    // Keep the pacing in line with what actually has been played
+    if (p_sys->format_set)
+        pacer_delay(&p_sys->pace, gap);
+    publish_clock(p_sys);
+    p_sys->outage_start = 0;
+    p_sys->outages++;
+
+    msg_Info(p_demux, "Resuming at %d ms after a %"PRId64" ms outage, audible gap %"PRId64" ms (outage #%d)",
+             resume_ms, outage / 1000, gap / 1000, p_sys->outages);
+
+    // Paused but still keeping the audio coming in counts as playing
+    paused = p_sys->player_paused;
+    vlc_mutex_unlock(&p_sys->audio_lock);
 
-    msg_Dbg(p_demux, "< userinfo_updated()");
+    msg_Dbg(p_demux, "> sp_session_player_seek(%d)", resume_ms);
+    sp_session_player_seek(p_sys->p_session, resume_ms);
+    if (!paused)
+        sp_session_player_play(p_sys->p_session, 1);
 }
 
-// libspotify context
-static SP_CALLCONV void spotify_credentials_blob_updated(sp_session *session,
-                                                         const char *blob)
+// Session thread
+static void spotify_connection_changed(void *p_opaque, sp_connectionstate state,
+                                       sp_error error)
 {
-    demux_t *p_demux = (demux_t *) sp_session_userdata(session);
+    demux_t *p_demux = (demux_t *) p_opaque;
+    demux_sys_t *p_sys = p_demux->p_sys;
+    bool lost = (error != SP_ERROR_OK) ||
+                (state != SP_CONNECTION_STATE_LOGGED_IN &&
+                 state != SP_CONNECTION_STATE_OFFLINE);
+    bool resume;
 
-    msg_Dbg(p_demux, "< credentials_blobupdated() %s", blob);
+    if (!plays_tracks(p_sys) || p_sys->play_started == false ||
+        p_sys->p_track == NULL)
+        return;
 
-    if (credentials != NULL)
-        free(credentials);
+    vlc_mutex_lock(&p_sys->audio_lock);
+    if (lost && p_sys->outage_start == 0) {
+        p_sys->outage_start = mdate();
+        p_sys->outage_buffered = p_sys->format_set ?
+            pacer_wall(&p_sys->pace, date_Get(&p_sys->pts) -
+                       pacer_time(&p_sys->pace, p_sys->outage_start)) : 0;
+        p_sys->outage_buffered = __MAX(p_sys->outage_buffered, 0);
+        msg_Warn(p_demux, "Connection lost (state %d, %s), %"PRId64" ms buffered",
+                 state, sp_error_message(error), p_sys->outage_buffered / 1000);
+    }
+    // Offline, the reload waits for the login instead of the next update
+    if (state != SP_CONNECTION_STATE_LOGGED_IN)
+        p_sys->resume_retry = false;
+    // A streaming error while still logged in is retried right away
+    resume = p_sys->outage_start != 0 && state == SP_CONNECTION_STATE_LOGGED_IN;
+    vlc_mutex_unlock(&p_sys->audio_lock);
 
-    // TODO: Save the blob to a file
-    credentials = strdup(blob);
+    if (resume)
+        resume_stream(p_demux);
 }
 
 // libspotify context
-static SP_CALLCONV void spotify_connectionstate_updated(sp_session *session)
+static void spotify_play_token_lost(void *p_opaque)
 {
-    demux_t *p_demux = (demux_t *) sp_session_userdata(session);
+    demux_t *p_demux = (demux_t *) p_opaque;
+    demux_sys_t *p_sys = p_demux->p_sys;
+    VLC_UNUSED(p_sys);
 
-    msg_Dbg(p_demux, "< connectionstate_updated()");
-}
+    dialog_Fatal(p_demux, "Playtoken lost!", "Someone else is using your spotify account");
 
+    // TODO: Any way to signal pause state to vlc core?
+}
 
 // libspotify context
-static SP_CALLCONV void spotify_notify_main_thread(sp_session *session)
+static void spotify_end_of_track(void *p_opaque)
 {
-    demux_t *p_demux = (demux_t *) sp_session_userdata(session);
+    demux_t *p_demux = (demux_t *) p_opaque;
     demux_sys_t *p_sys = p_demux->p_sys;
 
-    msg_Dbg(p_demux, "< notify_main_thread()");
-    vlc_mutex_lock(&p_sys->lock);
-    p_sys->spotify_notification = true;
-    vlc_cond_signal(&p_sys->spotify_wait);
-    vlc_mutex_unlock(&p_sys->lock);
+    vlc_mutex_lock(&p_sys->audio_lock);
+    // Already ended at its trailing silence, or the title before a jump
+    if (!p_sys->tail_cut && !p_sys->load_pending)
+        track_ended(p_demux);
+    vlc_mutex_unlock(&p_sys->audio_lock);
 }
 
-// libspotify context
-static SP_CALLCONV void spotify_play_token_lost(sp_session *session)
+// With audio_lock held
+static void track_ended(demux_t *p_demux)
 {
-    demux_t *p_demux = (demux_t *) sp_session_userdata(session);
     demux_sys_t *p_sys = p_demux->p_sys;
-    VLC_UNUSED(p_sys);
 
-    msg_Dbg(p_demux, "< play_token_lost()");
-    dialog_Fatal(p_demux, "Playtoken lost!", "Someone else is using your spotify account");
+    // The end of the track, however short, goes out before the ES does
+    emit_pending(p_demux);
 
-    // TODO: Any way to signal pause state to vlc core?
+    if (p_sys->silence_level >= 0) {
+        if (p_sys->album_titles)
+            msg_Info(p_demux, "Trimmed %"PRId64" ms of leading and %"PRId64" ms of trailing silence from title %d",
+                     p_sys->silence_lead / 1000, p_sys->silence_tail / 1000, p_sys->i_title + 1);
+        else
+            msg_Info(p_demux, "Trimmed %"PRId64" ms of leading and %"PRId64" ms of trailing silence from %s",
+                     p_sys->silence_lead / 1000, p_sys->silence_tail / 1000, p_sys->psz_uri);
+    }
+
+    // Not the last title, TrackDemux() loads the next one
+    if (p_sys->i_title + 1 < p_sys->i_album_tracks) {
+        p_sys->album_next = true;
+        vlc_cond_signal(&p_sys->track_ended);
+    // Ended while paused, TrackDemux() ends it once the rest was sent
+    } else if (p_sys->p_retained != NULL) {
+        p_sys->eos_pending = true;
+    } else if (p_sys->p_es_audio) {
+        es_out_Del(p_demux->out, p_sys->p_es_audio);
+        p_sys->p_es_audio = NULL;
+    }
 }
 
-// libspotify context
-static SP_CALLCONV void spotify_end_of_track(sp_session *session)
+// Session thread
+static void spotify_player_loaded(void *p_opaque, sp_error error)
 {
-    demux_t *p_demux = (demux_t *) sp_session_userdata(session);
+    demux_t *p_demux = (demux_t *) p_opaque;
     demux_sys_t *p_sys = p_demux->p_sys;
 
-    msg_Dbg(p_demux, "< end_of_track()");
-
     vlc_mutex_lock(&p_sys->audio_lock);
-    if (p_sys->p_es_audio) {
-        es_out_Del(p_demux->out, p_sys->p_es_audio);
-        p_sys->p_es_audio = NULL;
-    }
+    p_sys->load_pending = false;
+    // Nothing will come of this title, go on with the next one
+    if (error != SP_ERROR_OK)
+        track_ended(p_demux);
     vlc_mutex_unlock(&p_sys->audio_lock);
 }
 
 // libspotify context
-static SP_CALLCONV int spotify_music_delivery(sp_session *session,
-                                              const sp_audioformat *format,
-                                              const void *frames, int num_frames)
+static int spotify_music_delivery(void *p_opaque, const sp_audioformat *format,
+                                  const void *frames, int num_frames)
 {
-    demux_t *p_demux = (demux_t *) sp_session_userdata(session);
+    demux_t *p_demux = (demux_t *) p_opaque;
     demux_sys_t *p_sys = p_demux->p_sys;
     mtime_t pts;
-    block_t *p_block;
     int delivery_bytes;
+    int i_done;
+    int i_sound_end = -1;       // One past the last frame with sound in it
+    bool b_scan;
+    bool b_cut = false;
 
     if (unlikely(num_frames == 0))
         return 0;
 
     vlc_mutex_lock(&p_sys->audio_lock);
 
+    if (unlikely(!startlog_reached(&p_sys->startlog, STARTLOG_ES_OUT_SEND)))
+        startlog_mark(&p_sys->startlog, STARTLOG_MUSIC_DELIVERY, mdate());
+
     if (unlikely(p_sys->format_set == false)) {
         es_format_t fmt;
         es_format_Init(&fmt, AUDIO_ES, VLC_CODEC_S16N);
@@ -859,44 +1270,331 @@ static SP_CALLCONV int spotify_music_delivery(sp_session *session,
         p_sys->p_es_audio = es_out_Add(p_demux->out, &fmt);
         date_Init(&p_sys->pts, fmt.audio.i_rate, 1);
         date_Set(&p_sys->pts, VLC_TS_0);
-        date_Set(&p_sys->starttime, mdate());
+        pacer_set_time(&p_sys->pace, 0, mdate());
+        p_sys->frame_bytes = format->channels * sizeof(int16_t);
+        p_sys->block_frames = p_sys->block_ms * format->sample_rate / 1000;
         p_sys->format_set = true;
+        publish_clock(p_sys);
     }
 
     pts = date_Get(&p_sys->pts);
-    // Pace control, only feed up to 250 ms to ES
-    if (pts - (mdate() - p_sys->starttime.date) > 250000) {
+    delivery_bytes = num_frames * format->channels * sizeof(int16_t);
+
+    if (p_sys->paused) {
+        // Keep what fits, also in the memory budget, the demux thread pauses
+        // the stream once it is full
+        if (p_sys->retained_bytes + delivery_bytes > p_sys->retain_max ||
+            !membudget_fits(delivery_bytes)) {
+            p_sys->retain_full = true;
+            vlc_mutex_unlock(&p_sys->audio_lock);
+            return 0;
+        }
+    } else if (pts - pacer_time(&p_sys->pace, mdate()) >
+               pacer_media(&p_sys->pace, PACE_AHEAD_US)) {
+        // Pace control, only feed up to PACE_AHEAD_US to ES
         vlc_mutex_unlock(&p_sys->audio_lock);
         return 0;
     }
 
-    delivery_bytes = num_frames * format->channels * sizeof(int16_t);
-
     if (unlikely(p_sys->p_es_audio == NULL)) {
         vlc_mutex_unlock(&p_sys->audio_lock);
         return 0;
     }
 
-    p_block = block_Alloc(delivery_bytes);
-
-    if (unlikely(!p_block)) {
+    // Cut short, or what is left of the title before a jump
+    if (unlikely(p_sys->tail_cut || p_sys->load_pending)) {
         vlc_mutex_unlock(&p_sys->audio_lock);
         return 0;
     }
 
-    memcpy(p_block->p_buffer, frames, delivery_bytes);
+    // The start of a resumed track, already delivered before the outage
+    if (unlikely(p_sys->skip_frames > 0)) {
+        int skip = __MIN(p_sys->skip_frames, num_frames);
+        p_sys->skip_frames -= skip;
+        vlc_mutex_unlock(&p_sys->audio_lock);
+        return skip;
+    }
+    p_sys->resume_attempts = 0;
+
+    // Silence at the start of the track is dropped. The track begins that
+    // much earlier in the PTS instead, so that its times stay right.
+    if (unlikely(p_sys->trim_leading)) {
+        silence_span_t span;
+        int skip;
+        mtime_t skipped;
+
+        silence_scan(frames, num_frames * format->channels, p_sys->silence_level, &span);
+        skip = span.b_sound ? (int) span.i_first / format->channels : num_frames;
+        skipped = skip * CLOCK_FREQ / format->sample_rate;
+        p_sys->silence_lead += skipped;
+        p_sys->track_start -= skipped;
+        p_sys->trim_leading = !span.b_sound;
+        if (skip > 0) {
+            publish_clock(p_sys);
+            vlc_mutex_unlock(&p_sys->audio_lock);
+            return skip;
+        }
+    }
+
+    // In the last seconds of the track, look for the silence it ends in
+    b_scan = p_sys->silence_level >= 0 && p_sys->duration > 0 &&
+             pts - p_sys->track_start >= p_sys->duration - SILENCE_TAIL_US;
+
+    // Copied into the pending block, which goes out each time it is full
+    for (i_done = 0; i_done < num_frames; ) {
+        const int16_t *p_src = (const int16_t *) frames + i_done * format->channels;
+        int16_t *p_dst;
+        int i_frames;
+
+        if (p_sys->p_pending == NULL) {
+            // A delivery larger than a block goes out whole
+            p_sys->pending_capacity = __MAX(p_sys->block_frames, num_frames - i_done);
+            p_sys->p_pending = block_Alloc(p_sys->pending_capacity * p_sys->frame_bytes);
+            if (unlikely(p_sys->p_pending == NULL))
+                break;
+            p_sys->pending_frames = 0;
+            p_sys->pending_pts = date_Get(&p_sys->pts);
+        }
 
-    p_block->i_pts = p_block->i_dts = pts;
-    p_block->i_length = date_Increment(&p_sys->pts, num_frames) - pts;
-    p_block->i_buffer = delivery_bytes;
-    p_block->i_nb_samples = num_frames * format->channels;
+        i_frames = __MIN(num_frames - i_done, p_sys->pending_capacity - p_sys->pending_frames);
+        p_dst = (int16_t *) p_sys->p_pending->p_buffer + p_sys->pending_frames * format->channels;
+        if (b_scan) {
+            silence_span_t span;
 
-    es_out_Control(p_demux->out, ES_OUT_SET_PCR, pts);
+            silence_copy(p_dst, p_src, i_frames * format->channels, p_sys->silence_level, &span);
+            if (span.b_sound)
+                i_sound_end = i_done + ((int) span.i_end + format->channels - 1) / format->channels;
+        } else {
+            memcpy(p_dst, p_src, i_frames * p_sys->frame_bytes);
+        }
+        p_sys->pending_frames += i_frames;
+        date_Increment(&p_sys->pts, i_frames);
+        i_done += i_frames;
+
+        if (p_sys->pending_frames >= p_sys->block_frames)
+            emit_pending(p_demux);
+    }
+    // Not to hold up the first audio after a start or seek
+    if (p_sys->pending_flush)
+        emit_pending(p_demux);
+    publish_clock(p_sys);
+
+    if (b_scan) {
+        if (i_sound_end >= 0)
+            p_sys->silence_run = 0;
+        else
+            i_sound_end = 0;
+        p_sys->silence_run += (i_done - i_sound_end) * CLOCK_FREQ / format->sample_rate;
+        b_cut = p_sys->silence_run >= p_sys->silence_min;
+    }
+
+    // Only silence is left, the next track can start
+    if (unlikely(b_cut)) {
+        p_sys->silence_tail = __MAX(p_sys->duration - (date_Get(&p_sys->pts) - p_sys->track_start), 0);
+        p_sys->tail_cut = true;
+        track_ended(p_demux);
+    }
+
+    vlc_mutex_unlock(&p_sys->audio_lock);
+
+    return i_done;
+}
+
+// With audio_lock held
+static void send_block(demux_t *p_demux, block_t *p_block)
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    es_out_Control(p_demux->out, ES_OUT_SET_PCR, p_block->i_pts);
     es_out_Send(p_demux->out, p_sys->p_es_audio, p_block);
+    if (unlikely(!startlog_reached(&p_sys->startlog, STARTLOG_ES_OUT_SEND)))
+        startlog_mark(&p_sys->startlog, STARTLOG_ES_OUT_SEND, mdate());
+
+    if (unlikely(p_sys->resume_time != 0)) {
+        msg_Dbg(p_demux, "Audio %"PRId64" ms after the resume",
+                (mdate() - p_sys->resume_time) / 1000);
+        p_sys->resume_time = 0;
+    }
+}
+
+// With audio_lock held. The pending block goes out as far as it is filled,
+// to the ES or, while paused, to the retained chain.
+static void emit_pending(demux_t *p_demux)
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    block_t *p_block = p_sys->p_pending;
+
+    if (p_block == NULL)
+        return;
+    p_sys->p_pending = NULL;
+    p_sys->pending_flush = false;
+
+    // Every sample since the pending PTS is in it
+    p_block->i_pts = p_block->i_dts = p_sys->pending_pts;
+    p_block->i_length = date_Get(&p_sys->pts) - p_sys->pending_pts;
+    p_block->i_buffer = p_sys->pending_frames * p_sys->frame_bytes;
+    p_block->i_nb_samples = p_sys->pending_frames * (p_sys->frame_bytes / sizeof(int16_t));
+
+    // After what is kept, if anything is
+    if (p_sys->paused || p_sys->p_retained != NULL) {
+        block_ChainLastAppend(&p_sys->pp_retained_last, p_block);
+        p_sys->retained_bytes += p_block->i_buffer;
+        membudget_charge(MEMBUDGET_AUDIO, p_block->i_buffer);
+        if (!p_sys->paused)
+            drain_retained(p_demux);
+    } else {
+        send_block(p_demux, p_block);
+    }
+}
+
+// With audio_lock held, not paused. What was kept while paused goes out up
+// to PACE_AHEAD_US ahead of the pacer, like the deliveries do, and not all
+// at once: a burst of PCRs far ahead of the wall clock would skew the
+// clock of the input and flood the decoder.
+static void drain_retained(demux_t *p_demux)
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    mtime_t      ahead = pacer_time(&p_sys->pace, mdate()) +
+                         pacer_media(&p_sys->pace, PACE_AHEAD_US);
+
+    while (p_sys->p_retained != NULL && p_sys->p_retained->i_pts <= ahead) {
+        block_t *p_block = p_sys->p_retained;
+
+        p_sys->p_retained = p_block->p_next;
+        if (p_sys->p_retained == NULL)
+            p_sys->pp_retained_last = &p_sys->p_retained;
+        p_block->p_next = NULL;
+        p_sys->retained_bytes -= p_block->i_buffer;
+        membudget_release(MEMBUDGET_AUDIO, p_block->i_buffer);
+        send_block(p_demux, p_block);
+    }
+}
+
+// With audio_lock held. After a seek the audio kept is from before it, also
+// what is pending.
+static void drop_retained(demux_sys_t *p_sys)
+{
+    if (p_sys->p_pending != NULL) {
+        block_Release(p_sys->p_pending);
+        p_sys->p_pending = NULL;
+    }
+    block_ChainRelease(p_sys->p_retained);
+    p_sys->p_retained = NULL;
+    p_sys->pp_retained_last = &p_sys->p_retained;
+    membudget_release(MEMBUDGET_AUDIO, p_sys->retained_bytes);
+    p_sys->retained_bytes = 0;
+    p_sys->retain_full = false;
+}
+
+// Any thread. Where the playing is: frozen while paused, otherwise the
+// paced position, which is behind the last sample sent to the ES.
+static mtime_t playing_time(const playclock_snapshot_t *p_clock)
+{
+    pacer_t pace = { .i_start = p_clock->i_start, .i_rate = p_clock->i_rate };
+
+    if (p_clock->b_paused)
+        return p_clock->i_offset;
+    if (p_clock->i_start == 0)
+        return p_clock->i_pts;
+    return __MIN(p_clock->i_pts, pacer_time(&pace, mdate()));
+}
+
+// With audio_lock held
+static void publish_clock(demux_sys_t *p_sys)
+{
+    playclock_snapshot_t clock = {
+        .i_pts = p_sys->pts.date,
+        .i_start = p_sys->pace.i_start,
+        .i_rate = p_sys->pace.i_rate,
+        .i_offset = p_sys->pts_offset,
+        .i_duration = p_sys->duration,
+        .i_track_start = p_sys->track_start,
+        .b_paused = p_sys->paused,
+    };
+
+    playclock_publish(p_sys->p_clock, &clock);
+}
+
+// Demux thread. Log the startup timeline of a track, once.
+static void report_startup(demux_t *p_demux, const char *psz_result)
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    startlog_t   log;
+    char         psz_record[512];
+
+    if (!plays_tracks(p_sys) || p_sys->startup_reported)
+        return;
+    p_sys->startup_reported = true;
 
+    vlc_mutex_lock(&p_sys->audio_lock);
+    log = p_sys->startlog;
     vlc_mutex_unlock(&p_sys->audio_lock);
 
-    return num_frames;
+    spotify_session_startup(&log);
+    startlog_format(&log, psz_result, p_sys->psz_uri, psz_record, sizeof(psz_record));
+    msg_Info(p_demux, "%s", psz_record);
+    spotify_session_startup_done(VLC_OBJECT(p_demux), &log);
+}
+
+// A track, or an album played as one input
+static bool plays_tracks(const demux_sys_t *p_sys)
+{
+    return p_sys->spotify_type == SPOTIFY_TRACK || p_sys->album_titles;
+}
+
+// Demux thread. Go on to another title of the album, either when the last
+// one ended or, b_jump, right away in the middle of it. In both cases the
+// PTS goes on from the last sample delivered, so VLC sees one stream.
+static void album_switch(demux_t *p_demux, int i_title, bool b_jump)
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    const track_meta_t *p_meta = &p_sys->p_album_meta[i_title];
+
+    msg_Dbg(p_demux, "%s title %d of %d", b_jump ? "Jumping to" : "Going on to",
+            i_title + 1, p_sys->i_album_tracks);
+
+    vlc_mutex_lock(&p_sys->audio_lock);
+    if (b_jump) {
+        drop_retained(p_sys);
+        p_sys->eos_pending = false;
+        p_sys->album_next = false;
+        p_sys->pending_flush = true;
+    }
+    p_sys->track_start = p_sys->format_set ? date_Get(&p_sys->pts) : 0;
+    if (b_jump) {
+        p_sys->pts_offset = p_sys->track_start;
+        if (p_sys->format_set)
+            pacer_set_time(&p_sys->pace, p_sys->pts_offset, mdate());
+    }
+    p_sys->i_title = i_title;
+    p_sys->p_track = p_sys->pp_album_tracks[i_title];
+    p_sys->duration = p_meta->i_duration;
+    p_sys->album_prefetched = false;
+    p_sys->load_pending = true;
+    p_sys->trim_leading = p_sys->silence_level >= 0;
+    p_sys->tail_cut = false;
+    p_sys->silence_run = p_sys->silence_lead = p_sys->silence_tail = 0;
+    // The load plays, any pause is kept up by the retained chain
+    p_sys->player_paused = false;
+    p_sys->retain_full = false;
+    spotify_session_player_load(&p_sys->client, p_sys->p_track);
+    publish_clock(p_sys);
+    vlc_mutex_unlock(&p_sys->audio_lock);
+
+    vlc_mutex_lock(&p_sys->lock);
+    clear_track_meta(p_sys);
+    if (p_meta->psz_title != NULL)
+        p_sys->psz_meta_track = strdup(p_meta->psz_title);
+    if (p_meta->psz_artist != NULL)
+        p_sys->psz_meta_artist = strdup(p_meta->psz_artist);
+    if (p_meta->psz_album != NULL)
+        p_sys->psz_meta_album = strdup(p_meta->psz_album);
+    if (p_meta->psz_art_id != NULL)
+        snprintf(p_sys->psz_meta_art_id, sizeof(p_sys->psz_meta_art_id), "%s", p_meta->psz_art_id);
+    vlc_mutex_unlock(&p_sys->lock);
+
+    p_demux->info.i_update |= INPUT_UPDATE_TITLE | INPUT_UPDATE_META;
+    p_demux->info.i_title = i_title;
 }
 
 void set_track_meta(demux_sys_t *p_sys)
@@ -916,6 +1614,9 @@ void set_track_meta(demux_sys_t *p_sys)
     if (p_sys->psz_meta_album == NULL && sp_album_name(album) != NULL)
         p_sys->psz_meta_album = strdup(sp_album_name(album));
 
+    if (p_sys->psz_meta_art_id[0] == '\0' && sp_album_cover(album, SP_IMAGE_SIZE_NORMAL))
+        art_image_id(sp_album_cover(album, SP_IMAGE_SIZE_NORMAL), p_sys->psz_meta_art_id);
+
     // Only fetch the 1st artist
     // TODO: Concatenate all artists
     artist = sp_track_artist(p_sys->p_track, 0);
@@ -938,28 +1639,276 @@ void clear_track_meta(demux_sys_t *p_sys)
         free(p_sys->psz_meta_artist);
         p_sys->psz_meta_artist = NULL;
     }
+    p_sys->psz_meta_art_id[0] = '\0';
 }
 
-static SP_CALLCONV void playlist_meta_done(sp_albumbrowse *result, void *userdata)
+// Session thread
+// Creates a playlist item with only the URI of the track. The rest of the
+// metadata is looked up by the meta queue, when it is needed. Returns NULL
+// for tracks that are known not to be playable, they are left out.
+static input_item_t *create_track_item(demux_t *p_demux, sp_track *p_track)
 {
-    demux_t *p_demux = (demux_t *) userdata;
     demux_sys_t *p_sys = p_demux->p_sys;
+    char complete_uri[255] = "spotify://";
+    char track_uri[255];
+    const char *psz_reason;
+    sp_link *track_link;
+    input_item_t *p_new_input;
+
+    track_link = sp_link_create_from_track(p_track, 0);
+    sp_link_as_string(track_link, track_uri, 255);
+    sp_link_release(track_link);
+
+    // Browsed and searched tracks are usually loaded, the others are
+    // checked when they are opened
+    if (sp_track_error(p_track) != SP_ERROR_IS_LOADING &&
+        track_playable(p_sys->p_session, p_track, &psz_reason) == NULL) {
+        msg_Warn(p_demux, "Leaving out %s: %s", track_uri, psz_reason);
+        return NULL;
+    }
 
-    msg_Dbg(p_demux, "< playlist_meta_done! Waiting for Demux");
+    // No name, the URI is shown until the title is known
+    p_new_input = input_item_New(strcat(complete_uri, track_uri), NULL);
+    if (p_new_input != NULL) {
+        meta_queue_add(p_new_input, track_uri,
+                       var_InheritBool(p_demux, "spotify-meta-background") ?
+                       META_PRIORITY_BACKGROUND : META_PRIORITY_ON_DEMAND);
+        msg_Dbg(p_demux, "Added %s to playlist", complete_uri);
+    }
+
+    return p_new_input;
+}
+
+// Session thread, from library.c
+static void library_items(void *p_opaque, input_item_t **pp_items, int i_items)
+{
+    demux_t *p_demux = (demux_t *) p_opaque;
+
+    if (i_items < 0) {
+        start_failed(p_demux, "No such folder");
+        return;
+    }
+    playlist_items_ready(p_demux, pp_items, i_items);
+}
+
+// Session thread, from library.c
+static void library_playlist(void *p_opaque, sp_playlist *p_playlist)
+{
+    demux_t *p_demux = (demux_t *) p_opaque;
+    input_item_t **pp_tracks;
+    int i_tracks = 0;
+    int num_tracks;
+
+    if (p_playlist == NULL) {
+        start_failed(p_demux, "Not a playlist");
+        return;
+    }
+
+    num_tracks = sp_playlist_num_tracks(p_playlist);
+    msg_Dbg(p_demux, "Playlist \"%s\" with %d tracks", sp_playlist_name(p_playlist), num_tracks);
+    pp_tracks = calloc(num_tracks > 0 ? num_tracks : 1, sizeof(*pp_tracks));
+    for (int i = 0; pp_tracks != NULL && i < num_tracks; i++) {
+        input_item_t *p_new_input = create_track_item(p_demux, sp_playlist_track(p_playlist, i));
+        if (p_new_input != NULL)
+            pp_tracks[i_tracks++] = p_new_input;
+    }
+
+    playlist_items_ready(p_demux, pp_tracks, i_tracks);
+}
+
+// Session thread
+// Hands the items over to PlaylistDemux() and lets Open() return
+static void playlist_items_ready(demux_t *p_demux, input_item_t **pp_tracks, int i_tracks)
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
 
     vlc_mutex_lock(&p_sys->playlist_lock);
+    p_sys->pp_tracks = pp_tracks;
+    p_sys->i_tracks = i_tracks;
+    membudget_charge(MEMBUDGET_PLAYLISTS, i_tracks * PLAYLIST_ITEM_BYTES);
     p_sys->playlist_meta_set = true;
     vlc_mutex_unlock(&p_sys->playlist_lock);
 
     vlc_mutex_lock(&p_sys->lock);
     p_sys->start_procedure_done = true;
     p_sys->start_procedure_succesful = true;
-    p_sys->manual_login_ongoing = false;
     vlc_cond_signal(&p_sys->wait);
     p_sys->play_started = true;
     vlc_mutex_unlock(&p_sys->lock);
 }
 
+// Session thread
+// The items of the tracks of an album or a search, in pp_tracks. Returns
+// how many.
+static int create_track_items(demux_t *p_demux, const tracklist_t *p_list,
+                              input_item_t **pp_tracks)
+{
+    int i_tracks = 0;
+
+    for (int i = 0; i < tracklist_count(p_list); i++) {
+        input_item_t *p_new_input = create_track_item(p_demux, tracklist_track(p_list, i));
+        if (p_new_input != NULL)
+            pp_tracks[i_tracks++] = p_new_input;
+    }
+    return i_tracks;
+}
+
+static SP_CALLCONV void playlist_meta_done(sp_albumbrowse *result, void *userdata)
+{
+    spotify_client_t *p_client = (spotify_client_t *) userdata;
+    tracklist_t list = { .p_browse = result };
+    demux_t *p_demux;
+    input_item_t **pp_tracks;
+    int i_tracks = 0;
+    int num_tracks;
+
+    // Close() may already have detached the instance
+    if (!spotify_session_lock_client(p_client))
+        return;
+
+    p_demux = (demux_t *) p_client->p_opaque;
+
+    msg_Dbg(p_demux, "< playlist_meta_done! Waiting for Demux");
+
+    if (p_demux->p_sys->album_titles) {
+        album_tracks_ready(p_demux, result);
+        spotify_session_unlock_client();
+        return;
+    }
+
+    // Everything libspotify is done here on the session thread, the demux
+    // thread only posts the finished items
+    num_tracks = tracklist_count(&list);
+    pp_tracks = calloc(num_tracks > 0 ? num_tracks : 1, sizeof(*pp_tracks));
+    if (pp_tracks != NULL)
+        i_tracks = create_track_items(p_demux, &list, pp_tracks);
+
+    playlist_items_ready(p_demux, pp_tracks, i_tracks);
+
+    spotify_session_unlock_client();
+}
+
+// Session thread
+// Keeps the playable tracks of the album, with the metadata of their titles
+// read while it is at hand, and starts playing the first one. Waits for the
+// tracks that are still loading, for up to ALBUM_TRACKS_WAIT_US.
+static void album_tracks_ready(demux_t *p_demux, sp_albumbrowse *result)
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    tracklist_t list = { .p_browse = result };
+    int num_tracks = tracklist_count(&list);
+    int i_tracks = 0;
+    int i;
+
+    if (tracklist_loading(&list)) {
+        if (!p_sys->album_loading) {
+            msg_Dbg(p_demux, "Waiting for the tracks of the album to load");
+            p_sys->album_loading = true;
+            p_sys->album_wait_end = mdate() + ALBUM_TRACKS_WAIT_US;
+        }
+        if (mdate() < p_sys->album_wait_end)
+            return;
+        msg_Warn(p_demux, "Some tracks of the album are still loading");
+    }
+    p_sys->album_loading = false;
+
+    p_sys->pp_album_tracks = calloc(num_tracks > 0 ? num_tracks : 1, sizeof(*p_sys->pp_album_tracks));
+    p_sys->p_album_meta = calloc(num_tracks > 0 ? num_tracks : 1, sizeof(*p_sys->p_album_meta));
+    if (unlikely(p_sys->pp_album_tracks == NULL || p_sys->p_album_meta == NULL)) {
+        start_failed(p_demux, NULL);
+        return;
+    }
+
+    for (i = 0; i < num_tracks; i++) {
+        sp_track *p_track = tracklist_track(&list, i);
+        const char *psz_reason;
+
+        // Like in the playlist, what is still loading is checked when played
+        if (sp_track_error(p_track) != SP_ERROR_IS_LOADING &&
+            track_playable(p_sys->p_session, p_track, &psz_reason) == NULL) {
+            msg_Warn(p_demux, "Leaving out track %d: %s", i + 1, psz_reason);
+            continue;
+        }
+        msg_Dbg(p_demux, "> sp_track_add_ref()");
+        sp_track_add_ref(p_track);
+        meta_read_track(p_track, &p_sys->p_album_meta[i_tracks]);
+        p_sys->pp_album_tracks[i_tracks++] = p_track;
+    }
+    p_sys->i_album_tracks = i_tracks;
+    msg_Dbg(p_demux, "Playing the album as %d titles", i_tracks);
+
+    if (i_tracks == 0) {
+        start_failed(p_demux, "No playable tracks");
+        return;
+    }
+    p_sys->p_track = p_sys->pp_album_tracks[0];
+    spotify_metadata_updated(p_demux);
+}
+
+static SP_CALLCONV void search_page_done(sp_search *result, void *userdata)
+{
+    spotify_client_t *p_client = (spotify_client_t *) userdata;
+    tracklist_t list = { .p_search = result };
+    demux_t *p_demux;
+    demux_sys_t *p_sys;
+    input_item_t **pp_tracks;
+    int i_tracks = 0;
+    int num_tracks;
+    int total_tracks;
+
+    // Close() may already have detached the instance
+    if (!spotify_session_lock_client(p_client))
+        return;
+
+    p_demux = (demux_t *) p_client->p_opaque;
+    p_sys = p_demux->p_sys;
+
+    if (tracklist_error(&list) != SP_ERROR_OK) {
+        msg_Err(p_demux, "Search failed: %s", sp_error_message(tracklist_error(&list)));
+        vlc_mutex_lock(&p_sys->lock);
+        p_sys->start_procedure_done = true;
+        vlc_cond_signal(&p_sys->wait);
+        vlc_mutex_unlock(&p_sys->lock);
+        spotify_session_unlock_client();
+        return;
+    }
+
+    num_tracks = tracklist_count(&list);
+    total_tracks = sp_search_total_tracks(result);
+    msg_Dbg(p_demux, "< search_page_done: %d-%d of %d", p_sys->search_offset,
+            p_sys->search_offset + num_tracks, total_tracks);
+
+    // Room for the page and the item leading to the next page
+    pp_tracks = calloc(num_tracks + 1, sizeof(*pp_tracks));
+    if (pp_tracks != NULL)
+        i_tracks = create_track_items(p_demux, &list, pp_tracks);
+
+    // Only a placeholder for the rest, the next page is searched for when
+    // (if ever) the playlist gets to it
+    if (pp_tracks != NULL && num_tracks > 0 &&
+        p_sys->search_offset + num_tracks < total_tracks) {
+        char *psz_more_uri;
+        char psz_name[64];
+        input_item_t *p_more = NULL;
+
+        snprintf(psz_name, sizeof(psz_name), "More results (%d of %d)...",
+                 p_sys->search_offset + num_tracks + 1, total_tracks);
+        // However long the query is
+        if (asprintf(&psz_more_uri, "spotify://%s", p_sys->psz_uri) != -1) {
+            p_more = input_item_New(psz_more_uri, psz_name);
+            free(psz_more_uri);
+        }
+        if (p_more != NULL) {
+            pp_tracks[i_tracks++] = p_more;
+            p_sys->search_next_offset = p_sys->search_offset + num_tracks;
+        }
+    }
+
+    playlist_items_ready(p_demux, pp_tracks, i_tracks);
+
+    spotify_session_unlock_client();
+}
+
 input_item_t *get_current_item(demux_t *p_demux)
 {
     input_thread_t *p_input_thread = demux_GetParentInput( p_demux );
@@ -0,0 +1,556 @@
+/*****************************************************************************
+ * Copyright (C) 2015 Jonas Lundqvist
+ *
+ * Author: Jonas Lundqvist <jonas@gannon.se>
+ *
+ * This file is part of vlc-spotify.
+ *
+ * vlc-spotify is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+// vlc-spotify-export, resolves Spotify links to M3U or JSON lines without
+// VLC.
+//
+// The links are parsed with ParseURI(), like the plugin does, and resolved
+// on one session with up to -j requests in flight. The results are written
+// in the order of the input as soon as they are known. Albums expand to
+// their tracks and searches to their first page of tracks, like in the
+// playlist.
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <libspotify/api.h>
+
+#include "exportfmt.h"
+#include "spsession.h"
+#include "tracklist.h"
+#include "uriparser.h"
+
+#define EXPORT_DEFAULT_JOBS 16
+#define EXPORT_DEFAULT_TIMEOUT_S 30
+#define EXPORT_SEARCH_RESULTS 50
+#define EXPORT_REPORT_INTERVAL_S 5
+
+typedef struct request_t request_t;
+struct request_t {
+    char            *psz_input;
+    spotify_type_e   type;
+    char            *psz_uri;
+    double           deadline;
+
+    sp_track        *p_track;
+    tracklist_t      list;          // Of an album or a search
+    bool             b_done;        // Set by the browse and search callbacks
+    const char      *psz_error;
+
+    request_t       *p_next;
+};
+
+static struct {
+    sp_session      *p_session;
+    bool             logged_in;
+    sp_error         login_error;
+    int              notify_pipe[2];
+    volatile sig_atomic_t quit;
+
+    export_format_e  format;
+    FILE            *p_out;
+    const char      *psz_progress;
+    int              i_jobs;
+    int              i_timeout_s;
+
+    // In the order of the input
+    request_t       *p_first;
+    request_t      **pp_last;
+    int              i_pending;
+
+    // Where the links come from, the arguments or else stdin
+    char           **pp_args;
+    int              i_args;
+    bool             b_stdin;
+
+    long             i_done;        // Inputs written, including skipped ones
+    long             i_tracks;      // Entries written
+    long             i_errors;
+    double           start;
+    double           last_progress;
+    double           last_report;
+} g = {
+    .pp_last = &g.p_first,
+};
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void notify(void)
+{
+    spsession_notify(g.notify_pipe);
+}
+
+static SP_CALLCONV void export_logged_in(sp_session *session, sp_error error)
+{
+    (void) session;
+    g.login_error = error;
+    g.logged_in = error == SP_ERROR_OK;
+}
+
+static SP_CALLCONV void export_notify_main_thread(sp_session *session)
+{
+    (void) session;
+    notify();
+}
+
+static SP_CALLCONV void export_log_message(sp_session *session, const char *msg)
+{
+    (void) session; (void) msg;
+}
+
+static sp_session_callbacks export_callbacks = {
+    .logged_in = &export_logged_in,
+    .notify_main_thread = &export_notify_main_thread,
+    .log_message = &export_log_message,
+};
+
+static SP_CALLCONV void browse_done(sp_albumbrowse *result, void *userdata)
+{
+    (void) result;
+    ((request_t *) userdata)->b_done = true;
+}
+
+static SP_CALLCONV void search_done(sp_search *result, void *userdata)
+{
+    (void) result;
+    ((request_t *) userdata)->b_done = true;
+}
+
+static void start_request(request_t *p_req)
+{
+    sp_link *link;
+
+    if (p_req->type == SPOTIFY_SEARCH) {
+        p_req->list.p_search = tracklist_search(g.p_session, p_req->psz_uri,
+                                                0, EXPORT_SEARCH_RESULTS, search_done, p_req);
+        return;
+    }
+
+    if (p_req->type == SPOTIFY_PLAYLIST || p_req->type == SPOTIFY_FOLDER) {
+        p_req->psz_error = "Playlists are not supported";
+        return;
+    }
+
+    if (p_req->type == SPOTIFY_TRACK) {
+        link = sp_link_create_from_string(p_req->psz_uri);
+        if (link != NULL) {
+            p_req->p_track = sp_link_as_track(link);
+            if (p_req->p_track != NULL)
+                sp_track_add_ref(p_req->p_track);
+            sp_link_release(link);
+        }
+    } else {
+        p_req->list.p_browse = tracklist_browse(g.p_session, p_req->psz_uri, NULL,
+                                                browse_done, p_req);
+    }
+
+    if (p_req->p_track == NULL && p_req->list.p_browse == NULL)
+        p_req->psz_error = "Invalid link";
+}
+
+static void add_request(char *psz_input)
+{
+    static const char *const schemes[] = { "spotify://", "https://", "http://" };
+    request_t  *p_req = calloc(1, sizeof(*p_req));
+    const char *psz_location = psz_input;
+
+    if (p_req == NULL) {
+        free(psz_input);
+        return;
+    }
+
+    // ParseURI() gets the location without the scheme from VLC
+    for (size_t i = 0; i < sizeof(schemes) / sizeof(*schemes); i++)
+        if (strncmp(psz_location, schemes[i], strlen(schemes[i])) == 0)
+            psz_location += strlen(schemes[i]);
+
+    p_req->psz_input = psz_input;
+    p_req->type = ParseURI(psz_location, &p_req->psz_uri);
+    p_req->deadline = now() + g.i_timeout_s;
+    if (p_req->type == SPOTIFY_UNKNOWN)
+        p_req->psz_error = "Not a Spotify link";
+    else
+        start_request(p_req);
+
+    *g.pp_last = p_req;
+    g.pp_last = &p_req->p_next;
+    g.i_pending++;
+}
+
+// Done when everything that is going to be written is loaded
+static bool request_done(request_t *p_req)
+{
+    if (p_req->psz_error != NULL)
+        return true;
+
+    if (p_req->p_track != NULL)
+        return sp_track_error(p_req->p_track) != SP_ERROR_IS_LOADING;
+
+    if (p_req->list.p_browse != NULL || p_req->list.p_search != NULL)
+        return p_req->b_done && !tracklist_loading(&p_req->list);
+
+    return true;
+}
+
+static void write_track(request_t *p_req, sp_track *p_track)
+{
+    export_entry_t entry = { .psz_input = p_req->psz_input };
+    char           psz_uri[256];
+    sp_link       *link;
+    sp_album      *p_album;
+
+    if (sp_track_error(p_track) != SP_ERROR_OK) {
+        entry.psz_error = sp_error_message(sp_track_error(p_track));
+        export_entry(g.p_out, g.format, &entry);
+        g.i_errors++;
+        return;
+    }
+
+    link = sp_link_create_from_track(p_track, 0);
+    if (link == NULL)
+        return;
+    sp_link_as_string(link, psz_uri, sizeof(psz_uri));
+    sp_link_release(link);
+
+    p_album = sp_track_album(p_track);
+    entry.psz_uri = psz_uri;
+    entry.psz_title = sp_track_name(p_track);
+    // Only the 1st artist, like the plugin
+    if (sp_track_num_artists(p_track) > 0)
+        entry.psz_artist = sp_artist_name(sp_track_artist(p_track, 0));
+    entry.psz_album = p_album ? sp_album_name(p_album) : NULL;
+    entry.i_duration_ms = sp_track_duration(p_track);
+
+    export_entry(g.p_out, g.format, &entry);
+    g.i_tracks++;
+}
+
+static void write_request(request_t *p_req)
+{
+    sp_error err = SP_ERROR_OK;
+
+    if (p_req->psz_error == NULL)
+        err = tracklist_error(&p_req->list);
+    if (err != SP_ERROR_OK)
+        p_req->psz_error = sp_error_message(err);
+
+    if (p_req->psz_error != NULL) {
+        export_entry_t entry = {
+            .psz_input = p_req->psz_input,
+            .psz_error = p_req->psz_error,
+        };
+        export_entry(g.p_out, g.format, &entry);
+        g.i_errors++;
+    } else if (p_req->p_track != NULL) {
+        write_track(p_req, p_req->p_track);
+    } else {
+        for (int i = 0; i < tracklist_count(&p_req->list); i++)
+            write_track(p_req, tracklist_track(&p_req->list, i));
+    }
+}
+
+static void free_request(request_t *p_req)
+{
+    if (p_req->p_track)
+        sp_track_release(p_req->p_track);
+    if (p_req->list.p_browse)
+        sp_albumbrowse_release(p_req->list.p_browse);
+    if (p_req->list.p_search)
+        sp_search_release(p_req->list.p_search);
+    free(p_req->psz_uri);
+    free(p_req->psz_input);
+    free(p_req);
+}
+
+static void save_progress(void)
+{
+    export_progress_t progress = { .i_done = g.i_done };
+
+    // Only what has reached the file counts
+    fflush(g.p_out);
+    g.last_progress = now();
+    if (g.psz_progress == NULL)
+        return;
+
+    progress.i_offset = ftell(g.p_out);
+    if (progress.i_offset < 0 || export_progress_write(g.psz_progress, &progress))
+        fprintf(stderr, "vlc-spotify-export: cannot write %s\n", g.psz_progress);
+}
+
+// Write what is done, in the order of the input
+static void flush_done(void)
+{
+    double t = now();
+
+    while (g.p_first != NULL) {
+        request_t *p_req = g.p_first;
+
+        if (!request_done(p_req)) {
+            if (t < p_req->deadline)
+                break;
+            p_req->psz_error = "Timed out";
+        }
+
+        write_request(p_req);
+        g.p_first = p_req->p_next;
+        if (g.p_first == NULL)
+            g.pp_last = &g.p_first;
+        g.i_pending--;
+        g.i_done++;
+        free_request(p_req);
+    }
+
+    if (t - g.last_progress >= 1.0)
+        save_progress();
+}
+
+static void report(bool b_final)
+{
+    double t = now();
+    double elapsed = t - g.start;
+
+    if (!b_final && t - g.last_report < EXPORT_REPORT_INTERVAL_S)
+        return;
+    g.last_report = t;
+
+    fprintf(stderr, "vlc-spotify-export: %ld inputs, %ld tracks, %ld errors in %.1f s"
+            " (%.1f inputs/s, %.1f tracks/s)\n",
+            g.i_done, g.i_tracks, g.i_errors, elapsed,
+            elapsed > 0 ? g.i_done / elapsed : 0.0,
+            elapsed > 0 ? g.i_tracks / elapsed : 0.0);
+}
+
+// The next input: an argument, or a line of stdin. Empty lines and
+// comments are skipped.
+static char *next_input(void)
+{
+    char    *psz_line = NULL;
+    size_t   i_size = 0;
+    ssize_t  i_len;
+
+    if (!g.b_stdin) {
+        if (g.i_args == 0)
+            return NULL;
+        g.i_args--;
+        return strdup(*g.pp_args++);
+    }
+
+    while ((i_len = getline(&psz_line, &i_size, stdin)) >= 0) {
+        while (i_len > 0 && (psz_line[i_len - 1] == '\n' || psz_line[i_len - 1] == '\r' ||
+                             psz_line[i_len - 1] == ' '))
+            psz_line[--i_len] = '\0';
+        if (i_len > 0 && psz_line[0] != '#')
+            return psz_line;
+    }
+    free(psz_line);
+    return NULL;
+}
+
+static void on_signal(int signum)
+{
+    (void) signum;
+    g.quit = 1;
+    notify();
+}
+
+static void usage(const char *psz_name)
+{
+    fprintf(stderr,
+            "Usage: %s [-f m3u|json] [-o output] [-r] [-j jobs] [-t timeout]\n"
+            "          [-u username] [-c cache dir] [-S settings dir] [link...]\n"
+            "Resolves Spotify links, given as arguments or one per line on stdin.\n"
+            "  -r  Resume an interrupted export to the same output\n"
+            "The password is read from $SPOTIFY_PASSWORD, when there is no\n"
+            "remembered login.\n", psz_name);
+}
+
+int main(int argc, char **argv)
+{
+    sp_session_config config;
+    const char *psz_output = NULL;
+    const char *psz_username = NULL;
+    char       *psz_progress = NULL;
+    bool        b_resume = false;
+    bool        b_inputs_left = true;
+    export_progress_t progress = { 0, 0 };
+    int         opt;
+    sp_error    err;
+
+    spsession_config(&config, "vlc-spotify-export", &export_callbacks);
+    g.format = EXPORT_M3U;
+    g.i_jobs = EXPORT_DEFAULT_JOBS;
+    g.i_timeout_s = EXPORT_DEFAULT_TIMEOUT_S;
+
+    while ((opt = getopt(argc, argv, "f:o:rj:t:u:c:S:h")) != -1) {
+        switch (opt) {
+        case 'f':
+            if (!strcmp(optarg, "json"))
+                g.format = EXPORT_JSON;
+            else if (strcmp(optarg, "m3u")) {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'o': psz_output = optarg; break;
+        case 'r': b_resume = true; break;
+        case 'j': g.i_jobs = atoi(optarg) > 0 ? atoi(optarg) : 1; break;
+        case 't': g.i_timeout_s = atoi(optarg) > 0 ? atoi(optarg) : 1; break;
+        case 'u': psz_username = optarg; break;
+        case 'c': config.cache_location = optarg; break;
+        case 'S': config.settings_location = optarg; break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    if (b_resume && psz_output == NULL) {
+        fprintf(stderr, "vlc-spotify-export: -r needs -o\n");
+        return 1;
+    }
+
+    g.p_out = stdout;
+    if (psz_output != NULL) {
+        size_t i_len = strlen(psz_output) + sizeof(".progress");
+
+        psz_progress = malloc(i_len);
+        if (psz_progress == NULL)
+            return 1;
+        snprintf(psz_progress, i_len, "%s.progress", psz_output);
+        g.psz_progress = psz_progress;
+
+        if (b_resume && export_progress_read(psz_progress, &progress) == 0) {
+            // Anything after the saved progress is from inputs that were
+            // not finished, they are done again
+            if (truncate(psz_output, progress.i_offset)) {
+                fprintf(stderr, "vlc-spotify-export: cannot resume %s: %s\n", psz_output,
+                        strerror(errno));
+                return 1;
+            }
+            fprintf(stderr, "vlc-spotify-export: resuming after %ld inputs\n", progress.i_done);
+        } else {
+            progress.i_done = 0;
+        }
+
+        g.p_out = fopen(psz_output, progress.i_done > 0 ? "a" : "w");
+        if (g.p_out == NULL) {
+            fprintf(stderr, "vlc-spotify-export: cannot open %s: %s\n", psz_output,
+                    strerror(errno));
+            return 1;
+        }
+    }
+    if (progress.i_done == 0)
+        export_header(g.p_out, g.format);
+
+    if (spsession_pipe_open(g.notify_pipe)) {
+        perror("vlc-spotify-export: pipe");
+        return 1;
+    }
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    err = sp_session_create(&config, &g.p_session);
+    if (err != SP_ERROR_OK) {
+        fprintf(stderr, "vlc-spotify-export: %s\n", sp_error_message(err));
+        return 1;
+    }
+
+    if (spsession_login(g.p_session, psz_username, getenv("SPOTIFY_PASSWORD"), NULL)
+            == SPSESSION_NO_LOGIN) {
+        fprintf(stderr, "vlc-spotify-export: no remembered login, give -u and $SPOTIFY_PASSWORD\n");
+        sp_session_release(g.p_session);
+        return 1;
+    }
+
+    // Links on the command line, or else on stdin
+    g.pp_args = argv + optind;
+    g.i_args = argc - optind;
+    g.b_stdin = g.i_args == 0;
+
+    // The inputs that are done already are only counted
+    for (; progress.i_done > 0; progress.i_done--) {
+        char *psz_input = next_input();
+        if (psz_input == NULL)
+            break;
+        free(psz_input);
+        g.i_done++;
+    }
+
+    g.start = g.last_report = g.last_progress = now();
+
+    while (!g.quit && (b_inputs_left || g.p_first != NULL) &&
+           g.login_error == SP_ERROR_OK) {
+        struct pollfd pfd;
+        int           i_timeout = spsession_process(g.p_session, &g.quit);
+
+        if (g.logged_in) {
+            // Keep the pipeline full
+            while (b_inputs_left && g.i_pending < g.i_jobs) {
+                char *psz_input = next_input();
+                if (psz_input == NULL) {
+                    b_inputs_left = false;
+                    break;
+                }
+                add_request(psz_input);
+            }
+            flush_done();
+            report(false);
+        }
+
+        // Wake up at least every second for the timeouts
+        if (i_timeout > 1000)
+            i_timeout = 1000;
+        if (spsession_wait(g.notify_pipe, &pfd, 1, i_timeout) < 0 && errno != EINTR)
+            break;
+    }
+
+    if (g.login_error != SP_ERROR_OK)
+        fprintf(stderr, "vlc-spotify-export: login failed: %s\n",
+                sp_error_message(g.login_error));
+
+    // Interrupted: what is not written yet is done again on -r
+    while (g.p_first != NULL) {
+        request_t *p_req = g.p_first;
+        g.p_first = p_req->p_next;
+        free_request(p_req);
+    }
+    save_progress();
+    report(true);
+
+    sp_session_release(g.p_session);
+    if (g.p_out != stdout)
+        fclose(g.p_out);
+    free(psz_progress);
+
+    return g.quit || g.login_error != SP_ERROR_OK ? 1 : 0;
+}
@@ -0,0 +1,622 @@
+/*****************************************************************************
+ * Copyright (C) 2015 Jonas Lundqvist
+ *
+ * Author: Jonas Lundqvist <jonas@gannon.se>
+ *
+ * This file is part of vlc-spotify.
+ *
+ * vlc-spotify is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+// vlc-spotifyd, a local daemon owning the Spotify session.
+//
+// libspotify only allows one session per process, and one player per
+// session. The daemon keeps that session logged in and serves any number
+// of VLC processes over a Unix socket (see remote.h for the protocol). The
+// track being played is delivered as PCM into a shmring that the playing
+// client created.
+//
+// Everything but music_delivery, end_of_track and play_token_lost runs on
+// the main thread, which is the only one calling libspotify.
+
+#include <errno.h>
+#include <poll.h>
+#include <stdarg.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <libspotify/api.h>
+
+#include "playable.h"
+#include "remote.h"
+#include "shmring.h"
+#include "spsession.h"
+
+#define SPOTIFYD_MAX_CLIENTS 32
+#define SPOTIFYD_LINE_MAX 1024
+
+typedef enum {
+    REQ_NONE,
+    REQ_META,   // Waiting for p_track to load
+    REQ_PLAY,   // Waiting for p_track to load, then play it into p_ring
+} request_e;
+
+typedef struct {
+    int         fd;             // -1 when the slot is free
+    char        line[SPOTIFYD_LINE_MAX];
+    size_t      i_line;
+
+    request_e   request;
+    sp_track   *p_track;
+    shmring_t  *p_ring;         // Until the player takes it over
+} client_t;
+
+static struct {
+    sp_session     *p_session;
+    bool            logged_in;
+    bool            verbose;
+
+    // Wakes up poll() from the libspotify threads and the signal handler
+    int             notify_pipe[2];
+    int             listen_fd;
+    volatile sig_atomic_t quit;
+
+    // Protects p_ring, which the libspotify threads write to
+    pthread_mutex_t lock;
+    shmring_t      *p_ring;
+    client_t       *p_player;
+    sp_track       *p_player_track;
+
+    client_t        clients[SPOTIFYD_MAX_CLIENTS];
+} g = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .listen_fd = -1,
+};
+
+static void notify(void)
+{
+    spsession_notify(g.notify_pipe);
+}
+
+static SP_CALLCONV void spotifyd_logged_in(sp_session *session, sp_error error)
+{
+    (void) session;
+    if (error != SP_ERROR_OK) {
+        fprintf(stderr, "vlc-spotifyd: login failed: %s\n", sp_error_message(error));
+        g.quit = 1;
+        return;
+    }
+    fprintf(stderr, "vlc-spotifyd: logged in\n");
+    g.logged_in = true;
+}
+
+static SP_CALLCONV void spotifyd_logged_out(sp_session *session)
+{
+    (void) session;
+    g.logged_in = false;
+}
+
+static SP_CALLCONV void spotifyd_notify_main_thread(sp_session *session)
+{
+    (void) session;
+    notify();
+}
+
+// libspotify thread
+static SP_CALLCONV int spotifyd_music_delivery(sp_session *session,
+                                               const sp_audioformat *format,
+                                               const void *frames, int num_frames)
+{
+    int i_ret = num_frames;
+    (void) session;
+
+    if (num_frames == 0)
+        return 0;
+
+    pthread_mutex_lock(&g.lock);
+    if (g.p_ring != NULL) {
+        shmring_set_format(g.p_ring, format->sample_rate, format->channels);
+        // A full ring makes libspotify deliver the frames again later,
+        // which paces the decoding to the playback of the client
+        if (!shmring_write(g.p_ring, frames, num_frames * format->channels * sizeof(int16_t)))
+            i_ret = 0;
+    }
+    // Nobody is listening, throw them away
+    pthread_mutex_unlock(&g.lock);
+
+    return i_ret;
+}
+
+static void set_player_flags(unsigned i_flags)
+{
+    pthread_mutex_lock(&g.lock);
+    if (g.p_ring != NULL)
+        shmring_set_flags(g.p_ring, i_flags);
+    pthread_mutex_unlock(&g.lock);
+}
+
+static SP_CALLCONV void spotifyd_end_of_track(sp_session *session)
+{
+    (void) session;
+    set_player_flags(SHMRING_EOS);
+}
+
+static SP_CALLCONV void spotifyd_play_token_lost(sp_session *session)
+{
+    (void) session;
+    fprintf(stderr, "vlc-spotifyd: play token lost\n");
+    set_player_flags(SHMRING_STOPPED);
+}
+
+static SP_CALLCONV void spotifyd_log_message(sp_session *session, const char *msg)
+{
+    (void) session;
+    if (g.verbose)
+        fprintf(stderr, "libspotify: %s", msg);
+}
+
+static SP_CALLCONV void spotifyd_message_to_user(sp_session *session, const char *msg)
+{
+    (void) session;
+    fprintf(stderr, "vlc-spotifyd: %s\n", msg);
+}
+
+static sp_session_callbacks spotifyd_callbacks = {
+    .logged_in = &spotifyd_logged_in,
+    .logged_out = &spotifyd_logged_out,
+    .notify_main_thread = &spotifyd_notify_main_thread,
+    .music_delivery = &spotifyd_music_delivery,
+    .end_of_track = &spotifyd_end_of_track,
+    .play_token_lost = &spotifyd_play_token_lost,
+    .log_message = &spotifyd_log_message,
+    .message_to_user = &spotifyd_message_to_user,
+};
+
+static void reply(client_t *p_client, const char *psz_format, ...)
+    __attribute__((format(printf, 2, 3)));
+
+static void reply(client_t *p_client, const char *psz_format, ...)
+{
+    char    psz_line[SPOTIFYD_LINE_MAX + 16];
+    va_list args;
+    int     i_len;
+
+    va_start(args, psz_format);
+    i_len = vsnprintf(psz_line, sizeof(psz_line) - 1, psz_format, args);
+    va_end(args);
+    if (i_len < 0)
+        return;
+    if (i_len > (int) sizeof(psz_line) - 2)
+        i_len = sizeof(psz_line) - 2;
+    psz_line[i_len++] = '\n';
+
+    // Replies are short and the client is waiting for them, a client that
+    // does not read is dropped when its socket is found dead
+    if (send(p_client->fd, psz_line, i_len, MSG_NOSIGNAL) != i_len && g.verbose)
+        fprintf(stderr, "vlc-spotifyd: failed to reply to client %d\n", p_client->fd);
+}
+
+// Names go in tab separated fields
+static void append_field(char *psz_dst, size_t i_dst, const char *psz_src)
+{
+    size_t i_len = strlen(psz_dst);
+
+    if (i_len + 1 < i_dst)
+        psz_dst[i_len++] = '\t';
+    for (; psz_src != NULL && *psz_src != '\0' && i_len + 1 < i_dst; psz_src++)
+        psz_dst[i_len++] = (*psz_src == '\t' || *psz_src == '\n') ? ' ' : *psz_src;
+    psz_dst[i_len] = '\0';
+}
+
+static sp_track *track_from_uri(const char *psz_uri)
+{
+    sp_link  *link = sp_link_create_from_string(psz_uri);
+    sp_track *p_track = NULL;
+
+    if (link == NULL)
+        return NULL;
+
+    p_track = sp_link_as_track(link);
+    if (p_track != NULL)
+        sp_track_add_ref(p_track);
+    sp_link_release(link);
+
+    return p_track;
+}
+
+static void stop_player(void)
+{
+    shmring_t *p_ring;
+
+    if (g.p_player == NULL)
+        return;
+
+    sp_session_player_play(g.p_session, 0);
+    sp_session_player_unload(g.p_session);
+
+    pthread_mutex_lock(&g.lock);
+    p_ring = g.p_ring;
+    g.p_ring = NULL;
+    pthread_mutex_unlock(&g.lock);
+
+    if (p_ring != NULL)
+        shmring_close(p_ring);
+    sp_track_release(g.p_player_track);
+    g.p_player_track = NULL;
+    g.p_player = NULL;
+}
+
+static void start_player(client_t *p_client)
+{
+    const char *psz_reason = NULL;
+    sp_error err;
+
+    // Refused before taking the player from anyone, the player would only
+    // never deliver anything
+    if (track_playable(g.p_session, p_client->p_track, &psz_reason) == NULL) {
+        err = SP_ERROR_TRACK_NOT_PLAYABLE;
+    } else {
+        // Only one player per session, the last one to ask wins
+        if (g.p_player != NULL) {
+            set_player_flags(SHMRING_STOPPED);
+            stop_player();
+        }
+
+        err = sp_session_player_load(g.p_session, p_client->p_track);
+        psz_reason = sp_error_message(err);
+    }
+    if (err != SP_ERROR_OK) {
+        reply(p_client, "ERR %s", psz_reason);
+        shmring_close(p_client->p_ring);
+        p_client->p_ring = NULL;
+        sp_track_release(p_client->p_track);
+        p_client->p_track = NULL;
+        return;
+    }
+
+    // The ring now belongs to the player
+    pthread_mutex_lock(&g.lock);
+    g.p_ring = p_client->p_ring;
+    pthread_mutex_unlock(&g.lock);
+    p_client->p_ring = NULL;
+
+    g.p_player = p_client;
+    g.p_player_track = p_client->p_track;
+    p_client->p_track = NULL;
+
+    sp_session_player_play(g.p_session, 1);
+    reply(p_client, "OK %d", sp_track_duration(g.p_player_track));
+}
+
+// Answer the requests whose tracks have finished loading
+static void check_pending(void)
+{
+    if (!g.logged_in)
+        return;
+
+    for (int i = 0; i < SPOTIFYD_MAX_CLIENTS; i++) {
+        client_t *p_client = &g.clients[i];
+        sp_error  err;
+
+        if (p_client->fd < 0 || p_client->request == REQ_NONE)
+            continue;
+
+        err = sp_track_error(p_client->p_track);
+        if (err == SP_ERROR_IS_LOADING)
+            continue;
+
+        if (err != SP_ERROR_OK) {
+            reply(p_client, "ERR %s", sp_error_message(err));
+            if (p_client->p_ring != NULL) {
+                shmring_close(p_client->p_ring);
+                p_client->p_ring = NULL;
+            }
+            sp_track_release(p_client->p_track);
+            p_client->p_track = NULL;
+        } else if (p_client->request == REQ_META) {
+            sp_track  *p_track = p_client->p_track;
+            sp_album  *album = sp_track_album(p_track);
+            char       psz_meta[SPOTIFYD_LINE_MAX];
+
+            snprintf(psz_meta, sizeof(psz_meta), "%d", sp_track_duration(p_track));
+            append_field(psz_meta, sizeof(psz_meta), sp_track_name(p_track));
+            append_field(psz_meta, sizeof(psz_meta), sp_track_num_artists(p_track) > 0 ?
+                         sp_artist_name(sp_track_artist(p_track, 0)) : NULL);
+            append_field(psz_meta, sizeof(psz_meta), album ? sp_album_name(album) : NULL);
+            reply(p_client, "OK %s", psz_meta);
+
+            sp_track_release(p_track);
+            p_client->p_track = NULL;
+        } else {
+            start_player(p_client);
+        }
+        p_client->request = REQ_NONE;
+    }
+}
+
+static void drop_client(client_t *p_client)
+{
+    if (g.p_player == p_client)
+        stop_player();
+    if (p_client->p_ring != NULL)
+        shmring_close(p_client->p_ring);
+    if (p_client->p_track != NULL)
+        sp_track_release(p_client->p_track);
+    close(p_client->fd);
+    memset(p_client, 0, sizeof(*p_client));
+    p_client->fd = -1;
+}
+
+static void handle_line(client_t *p_client, char *psz_line)
+{
+    char *psz_save = NULL;
+    char *psz_cmd = strtok_r(psz_line, " ", &psz_save);
+    char *psz_arg = strtok_r(NULL, " ", &psz_save);
+
+    if (psz_cmd == NULL)
+        return;
+
+    if (p_client->request != REQ_NONE) {
+        reply(p_client, "ERR Busy");
+        return;
+    }
+
+    if (!strcmp(psz_cmd, "META") || !strcmp(psz_cmd, "PLAY")) {
+        bool        b_play = !strcmp(psz_cmd, "PLAY");
+        const char *psz_ring = strtok_r(NULL, " ", &psz_save);
+
+        if (psz_arg == NULL || (b_play && psz_ring == NULL)) {
+            reply(p_client, "ERR Missing argument");
+            return;
+        }
+
+        p_client->p_track = track_from_uri(psz_arg);
+        if (p_client->p_track == NULL) {
+            reply(p_client, "ERR Not a track: %s", psz_arg);
+            return;
+        }
+
+        if (b_play) {
+            p_client->p_ring = shmring_open(psz_ring);
+            if (p_client->p_ring == NULL) {
+                reply(p_client, "ERR Cannot open %s", psz_ring);
+                sp_track_release(p_client->p_track);
+                p_client->p_track = NULL;
+                return;
+            }
+        }
+
+        // Answered by check_pending() once the track is loaded
+        p_client->request = b_play ? REQ_PLAY : REQ_META;
+        check_pending();
+    } else if (g.p_player != p_client &&
+               (!strcmp(psz_cmd, "PAUSE") || !strcmp(psz_cmd, "SEEK") ||
+                !strcmp(psz_cmd, "STOP"))) {
+        reply(p_client, "ERR Not playing");
+    } else if (!strcmp(psz_cmd, "PAUSE") && psz_arg != NULL) {
+        sp_session_player_play(g.p_session, atoi(psz_arg) == 0);
+        reply(p_client, "OK");
+    } else if (!strcmp(psz_cmd, "SEEK") && psz_arg != NULL) {
+        sp_session_player_seek(g.p_session, atoi(psz_arg));
+        // What was written before this is from before the seek
+        pthread_mutex_lock(&g.lock);
+        reply(p_client, "OK %llu", (unsigned long long) shmring_head(g.p_ring));
+        pthread_mutex_unlock(&g.lock);
+    } else if (!strcmp(psz_cmd, "STOP")) {
+        stop_player();
+        reply(p_client, "OK");
+    } else {
+        reply(p_client, "ERR Unknown request");
+    }
+}
+
+static void read_client(client_t *p_client)
+{
+    ssize_t i_read = recv(p_client->fd, p_client->line + p_client->i_line,
+                          sizeof(p_client->line) - p_client->i_line, 0);
+    char   *p_end;
+
+    if (i_read < 0 && (errno == EINTR || errno == EAGAIN))
+        return;
+    if (i_read <= 0) {
+        drop_client(p_client);
+        return;
+    }
+    p_client->i_line += i_read;
+
+    while (p_client->fd >= 0 &&
+           (p_end = memchr(p_client->line, '\n', p_client->i_line)) != NULL) {
+        size_t i_len = p_end - p_client->line;
+
+        *p_end = '\0';
+        handle_line(p_client, p_client->line);
+        p_client->i_line -= i_len + 1;
+        memmove(p_client->line, p_end + 1, p_client->i_line);
+    }
+
+    if (p_client->i_line == sizeof(p_client->line)) {
+        fprintf(stderr, "vlc-spotifyd: request too long, dropping client\n");
+        drop_client(p_client);
+    }
+}
+
+static void accept_client(void)
+{
+    int fd = accept(g.listen_fd, NULL, NULL);
+
+    if (fd < 0)
+        return;
+
+    for (int i = 0; i < SPOTIFYD_MAX_CLIENTS; i++) {
+        if (g.clients[i].fd < 0) {
+            memset(&g.clients[i], 0, sizeof(g.clients[i]));
+            g.clients[i].fd = fd;
+            fcntl(fd, F_SETFD, FD_CLOEXEC);
+            return;
+        }
+    }
+
+    fprintf(stderr, "vlc-spotifyd: too many clients\n");
+    close(fd);
+}
+
+static int listen_socket(const char *psz_path)
+{
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    int fd;
+
+    if (strlen(psz_path) >= sizeof(addr.sun_path))
+        return -1;
+    strcpy(addr.sun_path, psz_path);
+
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return -1;
+
+    // A socket nobody answers on is left over from a daemon that died
+    if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) == 0) {
+        fprintf(stderr, "vlc-spotifyd: already running on %s\n", psz_path);
+        close(fd);
+        return -1;
+    }
+    unlink(psz_path);
+
+    if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) || listen(fd, 8)) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void on_signal(int signum)
+{
+    (void) signum;
+    g.quit = 1;
+    notify();
+}
+
+static void usage(const char *psz_name)
+{
+    fprintf(stderr,
+            "Usage: %s [-v] [-s socket] [-u username] [-c cache dir] [-S settings dir]\n"
+            "The password is read from $SPOTIFY_PASSWORD, when there is no\n"
+            "remembered login.\n", psz_name);
+}
+
+int main(int argc, char **argv)
+{
+    sp_session_config config;
+    struct pollfd fds[SPOTIFYD_MAX_CLIENTS + 2];
+    char         *psz_socket = NULL;
+    const char   *psz_username = NULL;
+    sp_error      err;
+    int           opt;
+
+    spsession_config(&config, "vlc-spotifyd", &spotifyd_callbacks);
+    while ((opt = getopt(argc, argv, "vs:u:c:S:h")) != -1) {
+        switch (opt) {
+        case 'v': g.verbose = true; break;
+        case 's': psz_socket = strdup(optarg); break;
+        case 'u': psz_username = optarg; break;
+        case 'c': config.cache_location = optarg; break;
+        case 'S': config.settings_location = optarg; break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    if (psz_socket == NULL)
+        psz_socket = remote_default_socket();
+    if (psz_socket == NULL)
+        return 1;
+
+    for (int i = 0; i < SPOTIFYD_MAX_CLIENTS; i++)
+        g.clients[i].fd = -1;
+
+    if (spsession_pipe_open(g.notify_pipe)) {
+        perror("vlc-spotifyd: pipe");
+        return 1;
+    }
+
+    g.listen_fd = listen_socket(psz_socket);
+    if (g.listen_fd < 0) {
+        fprintf(stderr, "vlc-spotifyd: cannot listen on %s\n", psz_socket);
+        return 1;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    err = sp_session_create(&config, &g.p_session);
+    if (err != SP_ERROR_OK) {
+        fprintf(stderr, "vlc-spotifyd: %s\n", sp_error_message(err));
+        unlink(psz_socket);
+        return 1;
+    }
+
+    if (spsession_login(g.p_session, psz_username, getenv("SPOTIFY_PASSWORD"), NULL)
+            == SPSESSION_NO_LOGIN) {
+        fprintf(stderr, "vlc-spotifyd: no remembered login, give -u and $SPOTIFY_PASSWORD\n");
+        sp_session_release(g.p_session);
+        unlink(psz_socket);
+        return 1;
+    }
+
+    fprintf(stderr, "vlc-spotifyd: listening on %s\n", psz_socket);
+
+    while (!g.quit) {
+        int i_timeout = spsession_process(g.p_session, &g.quit);
+        int i_fds = 1;
+
+        check_pending();
+
+        fds[i_fds++] = (struct pollfd) { .fd = g.listen_fd, .events = POLLIN };
+        for (int i = 0; i < SPOTIFYD_MAX_CLIENTS; i++)
+            fds[i_fds++] = (struct pollfd) { .fd = g.clients[i].fd, .events = POLLIN };
+
+        if (spsession_wait(g.notify_pipe, fds, i_fds, i_timeout) < 0 && errno != EINTR)
+            break;
+
+        if (fds[1].revents & POLLIN)
+            accept_client();
+
+        for (int i = 0; i < SPOTIFYD_MAX_CLIENTS; i++)
+            if (g.clients[i].fd >= 0 && fds[2 + i].fd == g.clients[i].fd &&
+                fds[2 + i].revents & (POLLIN | POLLHUP | POLLERR))
+                read_client(&g.clients[i]);
+    }
+
+    for (int i = 0; i < SPOTIFYD_MAX_CLIENTS; i++)
+        if (g.clients[i].fd >= 0)
+            drop_client(&g.clients[i]);
+
+    // No sp_session_logout(), see the known issues in TODO. The login is
+    // remembered for the next start anyway.
+    sp_session_release(g.p_session);
+    close(g.listen_fd);
+    unlink(psz_socket);
+    free(psz_socket);
+
+    return 0;
+}
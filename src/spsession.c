@@ -0,0 +1,113 @@
+/*****************************************************************************
+ * Copyright (C) 2015 Jonas Lundqvist
+ *
+ * Author: Jonas Lundqvist <jonas@gannon.se>
+ *
+ * This file is part of vlc-spotify.
+ *
+ * vlc-spotify is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "spsession.h"
+
+extern const uint8_t g_appkey[];
+extern const size_t g_appkey_size;
+
+void spsession_config(sp_session_config *p_config, const char *psz_user_agent,
+                      sp_session_callbacks *p_callbacks)
+{
+    memset(p_config, 0, sizeof(*p_config));
+    p_config->api_version = SPOTIFY_API_VERSION;
+    p_config->cache_location = VLC_SPOTIFY_CACHE_DIR;
+    p_config->settings_location = VLC_SPOTIFY_SETTINGS_DIR;
+    p_config->application_key = g_appkey;
+    p_config->application_key_size = g_appkey_size;
+    p_config->user_agent = psz_user_agent;
+    p_config->callbacks = p_callbacks;
+}
+
+spsession_login_e spsession_login(sp_session *p_session, const char *psz_username,
+                                  const char *psz_password, const char *psz_blob)
+{
+    char stored_username[255];
+
+    if (sp_session_remembered_user(p_session, stored_username, sizeof(stored_username)) != -1) {
+        sp_session_relogin(p_session);
+        return SPSESSION_RELOGIN;
+    }
+    if (psz_blob != NULL) {
+        sp_session_login(p_session, psz_username, NULL, 1, psz_blob);
+        return SPSESSION_LOGIN_BLOB;
+    }
+    if (psz_username != NULL && psz_password != NULL) {
+        sp_session_login(p_session, psz_username, psz_password, 1, NULL);
+        return SPSESSION_LOGIN_PASSWORD;
+    }
+    return SPSESSION_NO_LOGIN;
+}
+
+#ifndef _WIN32
+int spsession_pipe_open(int pi_pipe[2])
+{
+    if (pipe(pi_pipe))
+        return -1;
+    fcntl(pi_pipe[0], F_SETFL, O_NONBLOCK);
+    fcntl(pi_pipe[1], F_SETFL, O_NONBLOCK);
+    fcntl(pi_pipe[0], F_SETFD, FD_CLOEXEC);
+    fcntl(pi_pipe[1], F_SETFD, FD_CLOEXEC);
+    return 0;
+}
+
+void spsession_notify(const int pi_pipe[2])
+{
+    // Full pipe means a wakeup is pending anyway
+    if (write(pi_pipe[1], "x", 1) < 0) {}
+}
+
+int spsession_process(sp_session *p_session, volatile sig_atomic_t *p_quit)
+{
+    int i_timeout = 0;
+
+    do {
+        sp_session_process_events(p_session, &i_timeout);
+    } while (i_timeout == 0 && !*p_quit);
+
+    return i_timeout;
+}
+
+int spsession_wait(const int pi_pipe[2], struct pollfd *p_fds, int i_fds, int i_timeout)
+{
+    char drain[64];
+    int  i_ret;
+    int  i_errno;
+
+    p_fds[0] = (struct pollfd) { .fd = pi_pipe[0], .events = POLLIN };
+    i_ret = poll(p_fds, i_fds, i_timeout);
+    // For the caller to tell EINTR apart
+    i_errno = errno;
+    while (read(pi_pipe[0], drain, sizeof(drain)) > 0);
+    errno = i_errno;
+
+    return i_ret;
+}
+#endif
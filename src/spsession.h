@@ -0,0 +1,80 @@
+/*****************************************************************************
+ * Copyright (C) 2015 Jonas Lundqvist
+ *
+ * Author: Jonas Lundqvist <jonas@gannon.se>
+ *
+ * This file is part of vlc-spotify.
+ *
+ * vlc-spotify is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+// What every owner of a libspotify session does the same way: the session
+// thread of the plugin, vlc-spotifyd and vlc-spotify-export. The config and
+// the login for all of them, and for the two programs the loop of their
+// main thread, woken up through a pipe.
+//
+// Only the thread calling libspotify may call these, but for
+// spsession_notify(). No VLC in here.
+
+#include <signal.h>
+#include <stdbool.h>
+#include <libspotify/api.h>
+
+// One cache for all of them, so that a session started by either is warm
+// for the others
+#ifndef _WIN32
+#define VLC_SPOTIFY_CACHE_DIR "/tmp/vlc-spotify/cache"
+#define VLC_SPOTIFY_SETTINGS_DIR "/tmp/vlc-spotify/settings"
+#else
+#define VLC_SPOTIFY_CACHE_DIR "C:\\temp\\vlc-spotify\\cache"
+#define VLC_SPOTIFY_SETTINGS_DIR "C:\\temp\\vlc-spotify\\settings"
+#endif
+
+typedef enum {
+    SPSESSION_RELOGIN,          // As the remembered user
+    SPSESSION_LOGIN_BLOB,       // With the credentials blob
+    SPSESSION_LOGIN_PASSWORD,
+    SPSESSION_NO_LOGIN,         // Nothing to log in with, nothing done
+} spsession_login_e;
+
+// The application key, the cache and the settings directories. The rest is
+// zeroed, for the caller to set.
+void spsession_config(sp_session_config *p_config, const char *psz_user_agent,
+                      sp_session_callbacks *p_callbacks);
+
+// Start logging in, the first way there is of: as the remembered user, with
+// the credentials blob or with the password. Any of them may be NULL, the
+// password needs the username.
+spsession_login_e spsession_login(sp_session *p_session, const char *psz_username,
+                                  const char *psz_password, const char *psz_blob);
+
+#ifndef _WIN32
+#include <poll.h>
+
+// The wakeup of the main thread of a program, from notify_main_thread, the
+// other libspotify callbacks and signal handlers. Non-blocking both ends.
+int spsession_pipe_open(int pi_pipe[2]);
+// Any thread, async-signal-safe
+void spsession_notify(const int pi_pipe[2]);
+
+// sp_session_process_events() until libspotify wants to be called later, or
+// *p_quit is set. Returns the ms until then.
+int spsession_process(sp_session *p_session, volatile sig_atomic_t *p_quit);
+
+// Sleep in poll() for at most i_timeout ms, on the pipe and the other i_fds
+// - 1 descriptors after p_fds[0], which is set to the pipe. The pipe is
+// emptied. Returns what poll() returned.
+int spsession_wait(const int pi_pipe[2], struct pollfd *p_fds, int i_fds, int i_timeout);
+#endif
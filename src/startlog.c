@@ -0,0 +1,218 @@
+/*****************************************************************************
+ * Copyright (C) 2015 Jonas Lundqvist
+ *
+ * Author: Jonas Lundqvist <jonas@gannon.se>
+ *
+ * This file is part of vlc-spotify.
+ *
+ * vlc-spotify is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "startlog.h"
+
+struct startlog_stats_t {
+    startlog_t  logs[STARTLOG_STATS_SIZE];
+    unsigned    i_count;
+    unsigned    i_next;     // Replaced next once full
+};
+
+static const char * const phase_names[STARTLOG_PHASES] = {
+    [STARTLOG_OPEN]             = "open",
+    [STARTLOG_SESSION_CREATE]   = "session_create",
+    [STARTLOG_THREAD_SPAWN]     = "thread_spawn",
+    [STARTLOG_LOGIN]            = "login",
+    [STARTLOG_LOGGED_IN]        = "logged_in",
+    [STARTLOG_METADATA_UPDATED] = "metadata_updated",
+    [STARTLOG_PLAYER_LOAD]      = "player_load",
+    [STARTLOG_MUSIC_DELIVERY]   = "music_delivery",
+    [STARTLOG_ES_OUT_SEND]      = "es_out_send",
+};
+
+void startlog_begin(startlog_t *p_log, int64_t i_now)
+{
+    memset(p_log, 0, sizeof(*p_log));
+    p_log->pi_time[STARTLOG_OPEN] = i_now;
+}
+
+bool startlog_mark(startlog_t *p_log, startlog_phase_e phase, int64_t i_now)
+{
+    if (p_log->pi_time[phase] != 0)
+        return false;
+    p_log->pi_time[phase] = i_now;
+    return true;
+}
+
+void startlog_mark_at(startlog_t *p_log, startlog_phase_e phase, int64_t i_time)
+{
+    if (i_time >= p_log->pi_time[STARTLOG_OPEN])
+        startlog_mark(p_log, phase, i_time);
+}
+
+bool startlog_reached(const startlog_t *p_log, startlog_phase_e phase)
+{
+    return p_log->pi_time[phase] != 0;
+}
+
+const char *startlog_phase_name(startlog_phase_e phase)
+{
+    return phase_names[phase];
+}
+
+// Keeps counting past the end of the buffer, like snprintf()
+typedef struct {
+    char   *psz;
+    size_t  i_size;
+    int     i_len;
+} appender_t;
+
+static void append(appender_t *p_out, const char *psz_format, ...)
+{
+    size_t  i_left = (size_t) p_out->i_len < p_out->i_size ?
+                     p_out->i_size - p_out->i_len : 0;
+    va_list args;
+    int     i;
+
+    va_start(args, psz_format);
+    i = vsnprintf(i_left ? p_out->psz + p_out->i_len : NULL, i_left, psz_format, args);
+    va_end(args);
+    if (i > 0)
+        p_out->i_len += i;
+}
+
+static void append_ms(appender_t *p_out, const char *psz_name, int64_t i_us)
+{
+    append(p_out, " %s_ms=%"PRId64".%"PRId64, psz_name, i_us / 1000, i_us % 1000 / 100);
+}
+
+int startlog_format(const startlog_t *p_log, const char *psz_result,
+                    const char *psz_uri, char *psz, size_t i_size)
+{
+    appender_t out = { psz, i_size, 0 };
+    int64_t    i_open = p_log->pi_time[STARTLOG_OPEN];
+    int64_t    i_last = i_open;
+
+    if (i_size > 0)
+        *psz = '\0';
+
+    // A session that was already logged in leaves no session phases
+    append(&out, "startup result=%s session=%s", psz_result,
+           startlog_reached(p_log, STARTLOG_SESSION_CREATE) ? "new" : "reused");
+
+    for (int i = STARTLOG_OPEN + 1; i < STARTLOG_PHASES; i++)
+        if (p_log->pi_time[i] > i_last)
+            i_last = p_log->pi_time[i];
+    append_ms(&out, "total", i_last - i_open);
+
+    for (int i = STARTLOG_OPEN + 1; i < STARTLOG_PHASES; i++)
+        if (startlog_reached(p_log, i))
+            append_ms(&out, phase_names[i], p_log->pi_time[i] - i_open);
+
+    if (psz_uri != NULL)
+        append(&out, " uri=%s", psz_uri);
+    return out.i_len;
+}
+
+startlog_stats_t *startlog_stats_new(void)
+{
+    return calloc(1, sizeof(startlog_stats_t));
+}
+
+void startlog_stats_delete(startlog_stats_t *p_stats)
+{
+    free(p_stats);
+}
+
+void startlog_stats_add(startlog_stats_t *p_stats, const startlog_t *p_log)
+{
+    p_stats->logs[p_stats->i_next] = *p_log;
+    p_stats->i_next = (p_stats->i_next + 1) % STARTLOG_STATS_SIZE;
+    if (p_stats->i_count < STARTLOG_STATS_SIZE)
+        p_stats->i_count++;
+}
+
+unsigned startlog_stats_count(const startlog_stats_t *p_stats)
+{
+    return p_stats->i_count;
+}
+
+static int compare_times(const void *p_a, const void *p_b)
+{
+    int64_t a = *(const int64_t *) p_a;
+    int64_t b = *(const int64_t *) p_b;
+
+    return (a > b) - (a < b);
+}
+
+// The times the phase was reached at, sorted. Returns how many there are.
+static unsigned collect(const startlog_stats_t *p_stats, startlog_phase_e phase,
+                        int64_t *pi_times)
+{
+    unsigned n = 0;
+
+    for (unsigned i = 0; i < p_stats->i_count; i++) {
+        const startlog_t *p_log = &p_stats->logs[i];
+        if (startlog_reached(p_log, phase))
+            pi_times[n++] = p_log->pi_time[phase] - p_log->pi_time[STARTLOG_OPEN];
+    }
+    qsort(pi_times, n, sizeof(*pi_times), compare_times);
+    return n;
+}
+
+static int64_t nearest_rank(const int64_t *pi_times, unsigned n, unsigned i_percent)
+{
+    unsigned i_rank = (i_percent * n + 99) / 100;
+
+    if (n == 0)
+        return -1;
+    return pi_times[i_rank > 0 ? i_rank - 1 : 0];
+}
+
+int64_t startlog_stats_percentile(const startlog_stats_t *p_stats,
+                                  startlog_phase_e phase, unsigned i_percent)
+{
+    int64_t times[STARTLOG_STATS_SIZE];
+
+    return nearest_rank(times, collect(p_stats, phase, times), i_percent);
+}
+
+int startlog_stats_format(const startlog_stats_t *p_stats, char *psz, size_t i_size)
+{
+    static const unsigned percents[] = { 50, 90, 99 };
+    appender_t out = { psz, i_size, 0 };
+    int64_t    times[STARTLOG_STATS_SIZE];
+
+    if (i_size > 0)
+        *psz = '\0';
+
+    append(&out, "startup percentiles n=%u", p_stats->i_count);
+    for (int i = STARTLOG_OPEN + 1; i < STARTLOG_PHASES; i++) {
+        unsigned n = collect(p_stats, i, times);
+        if (n == 0)
+            continue;
+        append(&out, " %s_ms=", phase_names[i]);
+        for (unsigned j = 0; j < sizeof(percents) / sizeof(percents[0]); j++) {
+            int64_t i_us = nearest_rank(times, n, percents[j]);
+            append(&out, "%sp%u:%"PRId64".%"PRId64, j ? "," : "", percents[j],
+                   i_us / 1000, i_us % 1000 / 100);
+        }
+    }
+    return out.i_len;
+}
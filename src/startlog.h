@@ -0,0 +1,83 @@
+/*****************************************************************************
+ * Copyright (C) 2015 Jonas Lundqvist
+ *
+ * Author: Jonas Lundqvist <jonas@gannon.se>
+ *
+ * This file is part of vlc-spotify.
+ *
+ * vlc-spotify is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+// The startup timeline of a track.
+//
+// Open() waits for a chain of events before the first audio is heard, most
+// of them on other threads. Each one is stamped the first time it happens,
+// relative to the start of Open(), and the whole timeline is logged as one
+// record once the audio has started or the start failed. The records of a
+// session can also be gathered into percentiles per phase.
+//
+// Nothing here locks, the callers serialise the access.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define STARTLOG_STATS_SIZE 512
+
+typedef enum {
+    STARTLOG_OPEN = 0,
+    STARTLOG_SESSION_CREATE,    // sp_session_create() returned
+    STARTLOG_THREAD_SPAWN,      // The session thread runs
+    STARTLOG_LOGIN,             // sp_session_relogin() or sp_session_login()
+    STARTLOG_LOGGED_IN,
+    STARTLOG_METADATA_UPDATED,  // The track is loaded
+    STARTLOG_PLAYER_LOAD,       // sp_session_player_load() returned
+    STARTLOG_MUSIC_DELIVERY,    // The first one
+    STARTLOG_ES_OUT_SEND,       // The first block is sent
+    STARTLOG_PHASES
+} startlog_phase_e;
+
+typedef struct startlog_t {
+    int64_t pi_time[STARTLOG_PHASES];   // us, 0 if not reached
+} startlog_t;
+
+void startlog_begin(startlog_t *p_log, int64_t i_now);
+// Only the first mark of a phase counts. Returns true if this was it.
+bool startlog_mark(startlog_t *p_log, startlog_phase_e phase, int64_t i_now);
+// Marks before the start of the timeline, from a session that already
+// was running, are ignored
+void startlog_mark_at(startlog_t *p_log, startlog_phase_e phase, int64_t i_time);
+bool startlog_reached(const startlog_t *p_log, startlog_phase_e phase);
+const char *startlog_phase_name(startlog_phase_e phase);
+
+// One line of key=value pairs, the times in ms since the start of Open():
+// "startup result=ok session=new total_ms=812.3 session_create_ms=1.2 ...
+// uri=spotify:track:...". Returns what snprintf() returns.
+int startlog_format(const startlog_t *p_log, const char *psz_result,
+                    const char *psz_uri, char *psz, size_t i_size);
+
+// The last STARTLOG_STATS_SIZE timelines
+typedef struct startlog_stats_t startlog_stats_t;
+
+startlog_stats_t *startlog_stats_new(void);
+void startlog_stats_delete(startlog_stats_t *p_stats);
+void startlog_stats_add(startlog_stats_t *p_stats, const startlog_t *p_log);
+unsigned startlog_stats_count(const startlog_stats_t *p_stats);
+// Nearest rank, in us since the start of Open(). -1 if no timeline got to
+// the phase.
+int64_t startlog_stats_percentile(const startlog_stats_t *p_stats,
+                                  startlog_phase_e phase, unsigned i_percent);
+// "startup percentiles n=12 logged_in_ms=p50:540.2,p90:...,p99:... ..."
+int startlog_stats_format(const startlog_stats_t *p_stats, char *psz, size_t i_size);
@@ -0,0 +1,99 @@
+/*****************************************************************************
+ * Copyright (C) 2015 Jonas Lundqvist
+ *
+ * Author: Jonas Lundqvist <jonas@gannon.se>
+ *
+ * This file is part of vlc-spotify.
+ *
+ * vlc-spotify is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include <stdlib.h>
+
+#include "tracklist.h"
+#include "uriparser.h"
+
+sp_albumbrowse *tracklist_browse(sp_session *p_session, const char *psz_uri,
+                                 sp_album **pp_album,
+                                 albumbrowse_complete_cb *pf_done, void *p_userdata)
+{
+    sp_link        *link = sp_link_create_from_string(psz_uri);
+    sp_album       *p_album;
+    sp_albumbrowse *p_browse = NULL;
+
+    if (link == NULL)
+        return NULL;
+
+    // The album belongs to the link, referenced if it is kept after it
+    p_album = sp_link_as_album(link);
+    if (p_album != NULL) {
+        p_browse = sp_albumbrowse_create(p_session, p_album, pf_done, p_userdata);
+        if (pp_album != NULL) {
+            sp_album_add_ref(p_album);
+            *pp_album = p_album;
+        }
+    }
+    sp_link_release(link);
+
+    return p_browse;
+}
+
+sp_search *tracklist_search(sp_session *p_session, const char *psz_uri,
+                            int i_offset, int i_count,
+                            search_complete_cb *pf_done, void *p_userdata)
+{
+    char      *psz_query = ParseSearchQuery(psz_uri);
+    sp_search *p_search;
+
+    p_search = sp_search_create(p_session, psz_query ? psz_query : "",
+                                i_offset, i_count, 0, 0, 0, 0, 0, 0,
+                                SP_SEARCH_STANDARD, pf_done, p_userdata);
+    free(psz_query);
+
+    return p_search;
+}
+
+sp_error tracklist_error(const tracklist_t *p_list)
+{
+    if (p_list->p_browse != NULL)
+        return sp_albumbrowse_error(p_list->p_browse);
+    if (p_list->p_search != NULL)
+        return sp_search_error(p_list->p_search);
+    return SP_ERROR_OK;
+}
+
+int tracklist_count(const tracklist_t *p_list)
+{
+    if (p_list->p_browse != NULL)
+        return sp_albumbrowse_num_tracks(p_list->p_browse);
+    if (p_list->p_search != NULL)
+        return sp_search_num_tracks(p_list->p_search);
+    return 0;
+}
+
+sp_track *tracklist_track(const tracklist_t *p_list, int i)
+{
+    if (p_list->p_browse != NULL)
+        return sp_albumbrowse_track(p_list->p_browse, i);
+    return sp_search_track(p_list->p_search, i);
+}
+
+bool tracklist_loading(const tracklist_t *p_list)
+{
+    for (int i = 0; i < tracklist_count(p_list); i++)
+        if (sp_track_error(tracklist_track(p_list, i)) == SP_ERROR_IS_LOADING)
+            return true;
+    return false;
+}
@@ -0,0 +1,55 @@
+/*****************************************************************************
+ * Copyright (C) 2015 Jonas Lundqvist
+ *
+ * Author: Jonas Lundqvist <jonas@gannon.se>
+ *
+ * This file is part of vlc-spotify.
+ *
+ * vlc-spotify is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+// The tracks an album or a search expands to, the same in the playlist of
+// the plugin and in vlc-spotify-export.
+//
+// Only the thread calling libspotify may call these, like any other
+// libspotify call. No VLC in here.
+
+#include <stdbool.h>
+#include <libspotify/api.h>
+
+// Loaded by one of the two
+typedef struct {
+    sp_albumbrowse *p_browse;
+    sp_search      *p_search;
+} tracklist_t;
+
+// Browse the album psz_uri (spotify:album:...). NULL if it is not an album.
+// The album is referenced in *pp_album, if not NULL, for whoever keeps it.
+sp_albumbrowse *tracklist_browse(sp_session *p_session, const char *psz_uri,
+                                 sp_album **pp_album,
+                                 albumbrowse_complete_cb *pf_done, void *p_userdata);
+
+// Search for a page of i_count tracks from i_offset, and nothing but
+// tracks, with the query of psz_uri (spotify:search:...)
+sp_search *tracklist_search(sp_session *p_session, const char *psz_uri,
+                            int i_offset, int i_count,
+                            search_complete_cb *pf_done, void *p_userdata);
+
+// Once the browse or the search is complete
+sp_error  tracklist_error(const tracklist_t *p_list);
+int       tracklist_count(const tracklist_t *p_list);
+sp_track *tracklist_track(const tracklist_t *p_list, int i);
+// Whether some of the tracks are still loading, and have no metadata yet
+bool      tracklist_loading(const tracklist_t *p_list);
@@ -33,15 +33,15 @@ spotify_type_e ParseURI(const char *uri_in, char **uri_out)
 
     spotify_type_e spotify_type = SPOTIFY_UNKNOWN;
 
-    // TODO: The 36 needs to be adjusted when dealing with user playlists
-    *uri_out = (char *) malloc(36);
-    strcpy(*uri_out, "");
-
     if (psz_parser == NULL) {
-        free(psz_dup);
+        *uri_out = strdup("");
         return SPOTIFY_UNKNOWN;
     }
 
+    // The output is never longer than the input with 'spotify:' prepended
+    *uri_out = (char *) malloc(strlen(uri_in) + sizeof("spotify:"));
+    strcpy(*uri_out, "");
+
     // Find 'spotify:' and make sure it is in the start
     tmp = strstr(psz_parser, "spotify:");
     if (tmp == psz_parser) {
@@ -70,6 +70,61 @@ spotify_type_e ParseURI(const char *uri_in, char **uri_out)
         spotify_type = SPOTIFY_ALBUM;
         psz_parser += 6;
         strcat(*uri_out, "album:");
+    } else if (((tmp = strstr(psz_parser, "search:")) == psz_parser) ||
+               ((tmp = strstr(psz_parser, "search/")) == psz_parser)) {
+        psz_parser += 7;
+        // Any non-empty query will do, it is not an id
+        if (strlen(psz_parser) == 0) {
+            *uri_out[0] = (char) '\0';
+            free(psz_dup);
+            return SPOTIFY_UNKNOWN;
+        }
+        strcat(*uri_out, "search:");
+        strcat(*uri_out, psz_parser);
+        free(psz_dup);
+        return SPOTIFY_SEARCH;
+    } else if (((tmp = strstr(psz_parser, "user:")) == psz_parser) ||
+               ((tmp = strstr(psz_parser, "user/")) == psz_parser)) {
+        // user:<name>:playlist:<id> or user:<name>:starred
+        size_t i_name;
+
+        psz_parser += 5;
+        i_name = strcspn(psz_parser, ":/");
+        if (i_name == 0 || psz_parser[i_name] == '\0') {
+            *uri_out[0] = (char) '\0';
+            free(psz_dup);
+            return SPOTIFY_UNKNOWN;
+        }
+        strcat(*uri_out, "user:");
+        strncat(*uri_out, psz_parser, i_name);
+        strcat(*uri_out, ":");
+        psz_parser += i_name + 1;
+
+        if (strcmp(psz_parser, "starred") == 0) {
+            strcat(*uri_out, "starred");
+            free(psz_dup);
+            return SPOTIFY_PLAYLIST;
+        }
+        if (((tmp = strstr(psz_parser, "playlist:")) == psz_parser) ||
+            ((tmp = strstr(psz_parser, "playlist/")) == psz_parser)) {
+            spotify_type = SPOTIFY_PLAYLIST;
+            psz_parser += 9;
+            strcat(*uri_out, "playlist:");
+        } else {
+            spotify_type = SPOTIFY_UNKNOWN;
+        }
+    } else if ((tmp = strstr(psz_parser, "folder:")) == psz_parser) {
+        // Only made up by the services discovery, 64 bits in hex
+        psz_parser += 7;
+        if (strlen(psz_parser) != 16 || strspn(psz_parser, "0123456789abcdef") != 16) {
+            *uri_out[0] = (char) '\0';
+            free(psz_dup);
+            return SPOTIFY_UNKNOWN;
+        }
+        strcat(*uri_out, "folder:");
+        strcat(*uri_out, psz_parser);
+        free(psz_dup);
+        return SPOTIFY_FOLDER;
     } else {
         spotify_type = SPOTIFY_UNKNOWN;
     }
@@ -86,3 +141,46 @@ spotify_type_e ParseURI(const char *uri_in, char **uri_out)
 
     return spotify_type;
 }
+
+static int hex_value(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+char *ParseSearchQuery(const char *uri)
+{
+    const char *psz_query;
+    char       *psz_out;
+    char       *psz_dst;
+
+    if (uri == NULL || strstr(uri, "spotify:search:") != uri)
+        return NULL;
+
+    psz_query = uri + 15; // strlen("spotify:search:")
+    psz_out = psz_dst = (char *) malloc(strlen(psz_query) + 1);
+    if (psz_out == NULL)
+        return NULL;
+
+    // Search URIs are form encoded: '+' is a space and %XX an escaped byte
+    while (*psz_query != '\0') {
+        if (*psz_query == '+') {
+            *psz_dst++ = ' ';
+            psz_query++;
+        } else if (*psz_query == '%' && hex_value(psz_query[1]) >= 0 &&
+                   hex_value(psz_query[2]) >= 0) {
+            *psz_dst++ = (char) (hex_value(psz_query[1]) * 16 + hex_value(psz_query[2]));
+            psz_query += 3;
+        } else {
+            *psz_dst++ = *psz_query++;
+        }
+    }
+    *psz_dst = '\0';
+
+    return psz_out;
+}
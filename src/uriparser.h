@@ -24,8 +24,13 @@
 typedef enum {
     SPOTIFY_TRACK,
     SPOTIFY_ALBUM,
-    SPOTIFY_PLAYLIST, // Not supported yet
+    SPOTIFY_PLAYLIST, // Including spotify:user:...:starred
+    SPOTIFY_SEARCH,
+    SPOTIFY_FOLDER,   // A folder of the playlist container, spotify:folder:<hex id>
     SPOTIFY_UNKNOWN
 } spotify_type_e;
 
 spotify_type_e ParseURI(const char *uri_in, char **uri_out);
+
+// Returns the decoded search query of a spotify:search: URI, or NULL
+char *ParseSearchQuery(const char *uri);
@@ -0,0 +1,818 @@
+/*****************************************************************************
+ * Copyright (C) 2015 Jonas Lundqvist
+ *
+ * Author: Jonas Lundqvist <jonas@gannon.se>
+ *
+ * This file is part of vlc-spotify.
+ *
+ * vlc-spotify is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+// A stand-in for libspotify, enough of it to run vlc-spotifyd without an
+// account or a network.
+//
+// Logging in always works. Every spotify:track: URI is a track named
+// "Fake track" that loads on the next sp_session_process_events() and
+// plays FAKE_TRACK_MS of 44.1 kHz stereo, where both channels of frame n
+// are n & 0x7fff, so that a reader can check that nothing was lost. The
+// audio is delivered from a thread of its own, like libspotify does.
+//
+// Every spotify:album: URI is an album of FAKE_ALBUM_TRACKS such tracks,
+// and every search finds FAKE_SEARCH_TRACKS of them. Both complete on the
+// next sp_session_process_events() too.
+//
+// With FAKE_REPLAY_ENV set to a trace recorded with the spotify-trace
+// option, the player plays nothing. Instead the deliveries, and the other
+// callbacks libspotify makes by itself, are made as in the trace: at the
+// same times, or back to back with FAKE_REPLAY_FAST_ENV set. Built as a
+// shared library (make replay), this drives the plugin offline.
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <libspotify/api.h>
+
+#include "cbtrace.h"
+#include "fake_libspotify.h"
+
+#define FAKE_RATE 44100
+#define FAKE_FRAMES_PER_DELIVERY 1024
+
+struct sp_session {
+    sp_session_config    config;
+    bool                 login_pending;
+    bool                 logout_pending;
+    sp_connectionstate   connectionstate;
+
+    pthread_mutex_t      lock;
+    pthread_cond_t       wait;
+    pthread_t            thread;
+    bool                 quit;
+    sp_track            *p_track;   // Loaded in the player
+    bool                 playing;
+    int                  i_frame;   // Next frame to deliver
+    unsigned             i_generation;  // Bumped by loads and seeks
+
+    cbtrace_reader_t    *p_replay;  // Replaces the player thread
+    bool                 b_replay_fast;
+};
+
+struct sp_link {
+    sp_track *p_track;
+    bool      b_album;
+};
+
+struct sp_track {
+    int  refs;
+    bool loaded;
+    char uri[64];
+};
+
+struct sp_artist { int unused; };
+struct sp_album { int unused; };
+
+// What sp_albumbrowse and sp_search have in common here
+typedef struct {
+    sp_track  *tracks[FAKE_ALBUM_TRACKS > FAKE_SEARCH_TRACKS ?
+                      FAKE_ALBUM_TRACKS : FAKE_SEARCH_TRACKS];
+    int        i_tracks;
+    bool       loaded;
+    void      (*pf_done)(void *p_result, void *userdata);
+    void      *userdata;
+} fake_result_t;
+
+struct sp_albumbrowse { fake_result_t result; };
+struct sp_search { fake_result_t result; };
+
+#ifndef FAKE_LIBSPOTIFY_SHARED
+// vlc-spotifyd links with the key in appkey.c, which the stand-in ignores
+const uint8_t g_appkey[] = { 0 };
+const size_t g_appkey_size = sizeof(g_appkey);
+#endif
+
+static sp_artist fake_artist;
+static sp_album  fake_album;
+// Tracks and results that are loading, for sp_session_process_events()
+static sp_track      *loading[64];
+static fake_result_t *loading_results[16];
+
+const char *sp_error_message(sp_error error)
+{
+    return error == SP_ERROR_OK ? "No error" : "Fake error";
+}
+
+static void *player_thread(void *data)
+{
+    sp_session *p_session = data;
+    int16_t     frames[FAKE_FRAMES_PER_DELIVERY * 2];
+    int         i_total = FAKE_TRACK_MS * FAKE_RATE / 1000;
+    sp_audioformat format = { SP_SAMPLETYPE_INT16_NATIVE_ENDIAN, FAKE_RATE, 2 };
+
+    pthread_mutex_lock(&p_session->lock);
+    while (!p_session->quit) {
+        int      i_frames, i_done;
+        unsigned i_generation = p_session->i_generation;
+
+        if (!p_session->playing || p_session->p_track == NULL ||
+            p_session->i_frame > i_total) {
+            pthread_cond_wait(&p_session->wait, &p_session->lock);
+            continue;
+        }
+
+        if (p_session->i_frame == i_total) {
+            p_session->i_frame++;
+            pthread_mutex_unlock(&p_session->lock);
+            p_session->config.callbacks->end_of_track(p_session);
+            pthread_mutex_lock(&p_session->lock);
+            continue;
+        }
+
+        i_frames = i_total - p_session->i_frame;
+        if (i_frames > FAKE_FRAMES_PER_DELIVERY)
+            i_frames = FAKE_FRAMES_PER_DELIVERY;
+        for (int i = 0; i < i_frames; i++)
+            frames[2 * i] = frames[2 * i + 1] = (p_session->i_frame + i) & 0x7fff;
+
+        pthread_mutex_unlock(&p_session->lock);
+        i_done = p_session->config.callbacks->music_delivery(p_session, &format,
+                                                             frames, i_frames);
+        pthread_mutex_lock(&p_session->lock);
+
+        // Anything else than the frames that were delivered has to be
+        // delivered again, unless the player was told otherwise meanwhile
+        if (i_generation == p_session->i_generation)
+            p_session->i_frame += i_done;
+        if (i_done == 0) {
+            pthread_mutex_unlock(&p_session->lock);
+            usleep(1000);
+            pthread_mutex_lock(&p_session->lock);
+        }
+    }
+    pthread_mutex_unlock(&p_session->lock);
+
+    return NULL;
+}
+
+static void add_us(struct timespec *p_ts, int64_t i_us)
+{
+    p_ts->tv_sec += i_us / 1000000;
+    p_ts->tv_nsec += (i_us % 1000000) * 1000;
+    if (p_ts->tv_nsec >= 1000000000) {
+        p_ts->tv_sec++;
+        p_ts->tv_nsec -= 1000000000;
+    }
+}
+
+static double seconds_since(const struct timespec *p_start)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - p_start->tv_sec) + (now.tv_nsec - p_start->tv_nsec) / 1e9;
+}
+
+static void *replay_thread(void *data)
+{
+    sp_session                 *p_session = data;
+    const sp_session_callbacks *p_cb = p_session->config.callbacks;
+    cbtrace_event_t             event;
+    struct timespec             start, deadline;
+    int16_t                    *p_pattern = NULL;
+    size_t                      i_pattern_size = 0;
+    long                        i_frame = 0;
+    long                        i_events = 0, i_deliveries = 0, i_differ = 0;
+    long long                   i_offered = 0, i_taken = 0, i_recorded = 0;
+    int64_t                     i_last = 0;
+    int                         i_read = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    pthread_mutex_lock(&p_session->lock);
+    while (!p_session->quit && (i_read = cbtrace_read(p_session->p_replay, &event)) > 0) {
+        if (!p_session->b_replay_fast) {
+            deadline = start;
+            add_us(&deadline, event.i_time);
+            while (!p_session->quit &&
+                   pthread_cond_timedwait(&p_session->wait, &p_session->lock, &deadline) != ETIMEDOUT)
+                ;
+            if (p_session->quit)
+                break;
+        }
+        if (event.type == CBTRACE_CONNECTION)
+            p_session->connectionstate = event.i_state;
+        pthread_mutex_unlock(&p_session->lock);
+
+        i_events++;
+        i_last = event.i_time;
+
+        switch (event.type) {
+        case CBTRACE_MUSIC_DELIVERY: {
+            sp_audioformat format = { SP_SAMPLETYPE_INT16_NATIVE_ENDIAN, event.i_rate,
+                                      event.i_channels };
+            const int16_t *p_frames = event.p_frames;
+            size_t         i_size = (size_t) event.i_frames * event.i_channels;
+            int            i_done;
+
+            // Without the audio in the trace, the counting pattern
+            if (p_frames == NULL) {
+                if (i_size > i_pattern_size) {
+                    int16_t *p_new = realloc(p_pattern, i_size * sizeof(int16_t));
+                    if (p_new == NULL)
+                        break;
+                    p_pattern = p_new;
+                    i_pattern_size = i_size;
+                }
+                for (size_t i = 0; i < i_size; i++)
+                    p_pattern[i] = (i_frame + i / event.i_channels) & 0x7fff;
+                p_frames = p_pattern;
+            }
+
+            i_done = p_cb->music_delivery(p_session, &format, p_frames, event.i_frames);
+            i_frame += i_done;
+            i_deliveries++;
+            i_offered += event.i_frames;
+            i_taken += i_done;
+            i_recorded += event.i_consumed;
+            if (i_done != (int) event.i_consumed)
+                i_differ++;
+            break;
+        }
+        case CBTRACE_END_OF_TRACK:
+            if (p_cb->end_of_track)
+                p_cb->end_of_track(p_session);
+            i_frame = 0;
+            break;
+        case CBTRACE_PLAY_TOKEN_LOST:
+            if (p_cb->play_token_lost)
+                p_cb->play_token_lost(p_session);
+            break;
+        case CBTRACE_NOTIFY_MAIN_THREAD:
+            if (p_cb->notify_main_thread)
+                p_cb->notify_main_thread(p_session);
+            break;
+        case CBTRACE_CONNECTION:
+            if (event.i_value != SP_ERROR_OK && p_cb->connection_error)
+                p_cb->connection_error(p_session, event.i_value);
+            else if (p_cb->connectionstate_updated)
+                p_cb->connectionstate_updated(p_session);
+            break;
+        default:
+            // Made by the stand-in itself (logged_in, metadata_updated) or
+            // by the plugin (play, seek)
+            break;
+        }
+
+        pthread_mutex_lock(&p_session->lock);
+    }
+    pthread_mutex_unlock(&p_session->lock);
+
+    fprintf(stderr, "fake libspotify: replayed %ld events (%.3f s recorded) in %.3f s%s, "
+            "%ld deliveries, %lld of %lld frames taken (%lld when recorded), "
+            "%ld deliveries taken differently\n",
+            i_events, i_last / 1e6, seconds_since(&start),
+            i_read < 0 ? ", the rest of the trace is damaged" : "",
+            i_deliveries, i_taken, i_offered, i_recorded, i_differ);
+
+    free(p_pattern);
+    return NULL;
+}
+
+sp_error sp_session_create(const sp_session_config *config, sp_session **sess)
+{
+    sp_session        *p_session = calloc(1, sizeof(*p_session));
+    const char        *psz_replay = getenv(FAKE_REPLAY_ENV);
+    pthread_condattr_t attr;
+
+    if (p_session == NULL)
+        return SP_ERROR_OTHER_PERMANENT;
+
+    if (psz_replay != NULL && *psz_replay != '\0') {
+        p_session->p_replay = cbtrace_open(psz_replay);
+        if (p_session->p_replay == NULL) {
+            fprintf(stderr, "fake libspotify: can't replay %s\n", psz_replay);
+            free(p_session);
+            return SP_ERROR_OTHER_PERMANENT;
+        }
+        p_session->b_replay_fast = getenv(FAKE_REPLAY_FAST_ENV) != NULL;
+    }
+
+    p_session->config = *config;
+    pthread_mutex_init(&p_session->lock, NULL);
+    // The replay waits for absolute times of this clock
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&p_session->wait, &attr);
+    pthread_condattr_destroy(&attr);
+    if (pthread_create(&p_session->thread, NULL,
+                       p_session->p_replay ? replay_thread : player_thread, p_session)) {
+        cbtrace_reader_close(p_session->p_replay);
+        free(p_session);
+        return SP_ERROR_OTHER_PERMANENT;
+    }
+
+    *sess = p_session;
+    return SP_ERROR_OK;
+}
+
+sp_error sp_session_release(sp_session *p_session)
+{
+    pthread_mutex_lock(&p_session->lock);
+    p_session->quit = true;
+    pthread_cond_signal(&p_session->wait);
+    pthread_mutex_unlock(&p_session->lock);
+    pthread_join(p_session->thread, NULL);
+
+    cbtrace_reader_close(p_session->p_replay);
+    pthread_cond_destroy(&p_session->wait);
+    pthread_mutex_destroy(&p_session->lock);
+    free(p_session);
+    return SP_ERROR_OK;
+}
+
+sp_error sp_session_login(sp_session *p_session, const char *username,
+                          const char *password, bool remember_me, const char *blob)
+{
+    (void) username; (void) password; (void) remember_me; (void) blob;
+    p_session->login_pending = true;
+    return SP_ERROR_OK;
+}
+
+sp_error sp_session_relogin(sp_session *p_session)
+{
+    p_session->login_pending = true;
+    return SP_ERROR_OK;
+}
+
+sp_error sp_session_logout(sp_session *p_session)
+{
+    p_session->logout_pending = true;
+    return SP_ERROR_OK;
+}
+
+sp_connectionstate sp_session_connectionstate(sp_session *p_session)
+{
+    sp_connectionstate state;
+
+    pthread_mutex_lock(&p_session->lock);
+    state = p_session->connectionstate;
+    pthread_mutex_unlock(&p_session->lock);
+    return state;
+}
+
+sp_error sp_session_preferred_bitrate(sp_session *p_session, sp_bitrate bitrate)
+{
+    (void) p_session; (void) bitrate;
+    return SP_ERROR_OK;
+}
+
+int sp_session_remembered_user(sp_session *p_session, char *buffer, size_t buffer_size)
+{
+    (void) p_session; (void) buffer; (void) buffer_size;
+    return -1;
+}
+
+sp_error sp_session_process_events(sp_session *p_session, int *next_timeout)
+{
+    if (p_session->login_pending) {
+        p_session->login_pending = false;
+        pthread_mutex_lock(&p_session->lock);
+        p_session->connectionstate = SP_CONNECTION_STATE_LOGGED_IN;
+        pthread_mutex_unlock(&p_session->lock);
+        p_session->config.callbacks->logged_in(p_session, SP_ERROR_OK);
+    }
+
+    if (p_session->logout_pending) {
+        p_session->logout_pending = false;
+        pthread_mutex_lock(&p_session->lock);
+        p_session->connectionstate = SP_CONNECTION_STATE_LOGGED_OUT;
+        pthread_mutex_unlock(&p_session->lock);
+        if (p_session->config.callbacks->logged_out)
+            p_session->config.callbacks->logged_out(p_session);
+    }
+
+    for (size_t i = 0; i < sizeof(loading) / sizeof(*loading); i++) {
+        if (loading[i] != NULL) {
+            loading[i]->loaded = true;
+            loading[i] = NULL;
+        }
+    }
+
+    for (size_t i = 0; i < sizeof(loading_results) / sizeof(*loading_results); i++) {
+        fake_result_t *p_result = loading_results[i];
+        if (p_result != NULL) {
+            loading_results[i] = NULL;
+            p_result->loaded = true;
+            for (int j = 0; j < p_result->i_tracks; j++)
+                p_result->tracks[j]->loaded = true;
+            p_result->pf_done(p_result, p_result->userdata);
+        }
+    }
+
+    *next_timeout = 10;
+    return SP_ERROR_OK;
+}
+
+sp_error sp_session_player_load(sp_session *p_session, sp_track *p_track)
+{
+    if (sp_track_get_availability(p_session, p_track) != SP_TRACK_AVAILABILITY_AVAILABLE)
+        return SP_ERROR_TRACK_NOT_PLAYABLE;
+    pthread_mutex_lock(&p_session->lock);
+    p_session->p_track = p_track;
+    p_session->playing = false;
+    p_session->i_frame = 0;
+    p_session->i_generation++;
+    pthread_mutex_unlock(&p_session->lock);
+    return SP_ERROR_OK;
+}
+
+sp_error sp_session_player_play(sp_session *p_session, bool play)
+{
+    pthread_mutex_lock(&p_session->lock);
+    p_session->playing = play;
+    pthread_cond_signal(&p_session->wait);
+    pthread_mutex_unlock(&p_session->lock);
+    return SP_ERROR_OK;
+}
+
+sp_error sp_session_player_seek(sp_session *p_session, int offset)
+{
+    pthread_mutex_lock(&p_session->lock);
+    p_session->i_frame = offset * FAKE_RATE / 1000;
+    p_session->i_generation++;
+    pthread_cond_signal(&p_session->wait);
+    pthread_mutex_unlock(&p_session->lock);
+    return SP_ERROR_OK;
+}
+
+sp_error sp_session_player_unload(sp_session *p_session)
+{
+    pthread_mutex_lock(&p_session->lock);
+    p_session->p_track = NULL;
+    p_session->playing = false;
+    pthread_mutex_unlock(&p_session->lock);
+    return SP_ERROR_OK;
+}
+
+sp_error sp_session_player_prefetch(sp_session *p_session, sp_track *p_track)
+{
+    (void) p_session; (void) p_track;
+    return SP_ERROR_OK;
+}
+
+static sp_track *create_track(const char *psz_uri)
+{
+    sp_track *p_track = calloc(1, sizeof(*p_track));
+
+    if (p_track == NULL)
+        return NULL;
+
+    p_track->refs = 1;
+    snprintf(p_track->uri, sizeof(p_track->uri), "%s", psz_uri);
+
+    for (size_t i = 0; i < sizeof(loading) / sizeof(*loading); i++) {
+        if (loading[i] == NULL) {
+            loading[i] = p_track;
+            return p_track;
+        }
+    }
+    // Too many at once, this one is loaded right away
+    p_track->loaded = true;
+    return p_track;
+}
+
+sp_link *sp_link_create_from_string(const char *link)
+{
+    sp_link *p_link;
+
+    if (strncmp(link, "spotify:track:", 14) != 0 && strncmp(link, "spotify:album:", 14) != 0)
+        return NULL;
+
+    p_link = calloc(1, sizeof(*p_link));
+    if (p_link == NULL)
+        return NULL;
+
+    if (strncmp(link, "spotify:album:", 14) == 0) {
+        p_link->b_album = true;
+        return p_link;
+    }
+
+    p_link->p_track = create_track(link);
+    if (p_link->p_track == NULL) {
+        free(p_link);
+        return NULL;
+    }
+    return p_link;
+}
+
+sp_link *sp_link_create_from_track(sp_track *track, int offset)
+{
+    sp_link *p_link = calloc(1, sizeof(*p_link));
+
+    (void) offset;
+    if (p_link == NULL)
+        return NULL;
+
+    sp_track_add_ref(track);
+    p_link->p_track = track;
+    return p_link;
+}
+
+int sp_link_as_string(sp_link *link, char *buffer, int buffer_size)
+{
+    return snprintf(buffer, buffer_size, "%s", link->p_track ? link->p_track->uri : "");
+}
+
+sp_album *sp_link_as_album(sp_link *link)
+{
+    return link->b_album ? &fake_album : NULL;
+}
+
+sp_track *sp_link_as_track(sp_link *link)
+{
+    return link->p_track;
+}
+
+sp_error sp_link_release(sp_link *link)
+{
+    if (link->p_track)
+        sp_track_release(link->p_track);
+    free(link);
+    return SP_ERROR_OK;
+}
+
+sp_error sp_track_add_ref(sp_track *track)
+{
+    track->refs++;
+    return SP_ERROR_OK;
+}
+
+sp_error sp_track_release(sp_track *track)
+{
+    if (--track->refs == 0) {
+        for (size_t i = 0; i < sizeof(loading) / sizeof(*loading); i++)
+            if (loading[i] == track)
+                loading[i] = NULL;
+        free(track);
+    }
+    return SP_ERROR_OK;
+}
+
+sp_error sp_track_error(sp_track *track)
+{
+    return track->loaded ? SP_ERROR_OK : SP_ERROR_IS_LOADING;
+}
+
+bool sp_track_is_loaded(sp_track *track)
+{
+    return track->loaded;
+}
+
+sp_track_availability sp_track_get_availability(sp_session *session, sp_track *track)
+{
+    (void) session;
+    return strcmp(track->uri, FAKE_UNAVAILABLE_URI) == 0 ?
+        SP_TRACK_AVAILABILITY_UNAVAILABLE : SP_TRACK_AVAILABILITY_AVAILABLE;
+}
+
+bool sp_track_is_local(sp_session *session, sp_track *track)
+{
+    (void) session; (void) track;
+    return false;
+}
+
+// Never relinked
+sp_track *sp_track_get_playable(sp_session *session, sp_track *track)
+{
+    (void) session;
+    return track;
+}
+
+const char *sp_track_name(sp_track *track)
+{
+    (void) track;
+    return FAKE_TRACK_NAME;
+}
+
+int sp_track_duration(sp_track *track)
+{
+    (void) track;
+    return FAKE_TRACK_MS;
+}
+
+int sp_track_num_artists(sp_track *track)
+{
+    (void) track;
+    return 1;
+}
+
+sp_artist *sp_track_artist(sp_track *track, int index)
+{
+    (void) track; (void) index;
+    return &fake_artist;
+}
+
+sp_album *sp_track_album(sp_track *track)
+{
+    (void) track;
+    return &fake_album;
+}
+
+const char *sp_artist_name(sp_artist *artist)
+{
+    (void) artist;
+    return FAKE_ARTIST_NAME;
+}
+
+sp_error sp_album_add_ref(sp_album *album)
+{
+    (void) album;
+    return SP_ERROR_OK;
+}
+
+sp_error sp_album_release(sp_album *album)
+{
+    (void) album;
+    return SP_ERROR_OK;
+}
+
+const byte *sp_album_cover(sp_album *album, sp_image_size size)
+{
+    (void) album; (void) size;
+    return NULL;
+}
+
+// No covers, so the plugin never creates an image
+sp_image *sp_image_create(sp_session *session, const byte image_id[20])
+{
+    (void) session; (void) image_id;
+    return NULL;
+}
+
+bool sp_image_is_loaded(sp_image *image)
+{
+    (void) image;
+    return false;
+}
+
+sp_error sp_image_error(sp_image *image)
+{
+    (void) image;
+    return SP_ERROR_IS_LOADING;
+}
+
+const void *sp_image_data(sp_image *image, size_t *data_size)
+{
+    (void) image;
+    *data_size = 0;
+    return NULL;
+}
+
+sp_error sp_image_release(sp_image *image)
+{
+    (void) image;
+    return SP_ERROR_OK;
+}
+
+const char *sp_album_name(sp_album *album)
+{
+    (void) album;
+    return FAKE_ALBUM_NAME;
+}
+
+static void start_result(fake_result_t *p_result, int i_tracks, const char *psz_prefix,
+                         void (*pf_done)(void *, void *), void *userdata)
+{
+    char psz_uri[64];
+
+    for (int i = 0; i < i_tracks; i++) {
+        // 22 characters, like a real track id
+        snprintf(psz_uri, sizeof(psz_uri), "spotify:track:%s%012d", psz_prefix, i);
+        p_result->tracks[i] = calloc(1, sizeof(sp_track));
+        p_result->tracks[i]->refs = 1;
+        snprintf(p_result->tracks[i]->uri, sizeof(p_result->tracks[i]->uri), "%s", psz_uri);
+    }
+    p_result->i_tracks = i_tracks;
+    p_result->pf_done = pf_done;
+    p_result->userdata = userdata;
+
+    for (size_t i = 0; i < sizeof(loading_results) / sizeof(*loading_results); i++) {
+        if (loading_results[i] == NULL) {
+            loading_results[i] = p_result;
+            return;
+        }
+    }
+    abort();
+}
+
+static void release_result(fake_result_t *p_result)
+{
+    for (size_t i = 0; i < sizeof(loading_results) / sizeof(*loading_results); i++)
+        if (loading_results[i] == p_result)
+            loading_results[i] = NULL;
+    for (int i = 0; i < p_result->i_tracks; i++)
+        sp_track_release(p_result->tracks[i]);
+}
+
+sp_albumbrowse *sp_albumbrowse_create(sp_session *session, sp_album *album,
+                                      albumbrowse_complete_cb *callback, void *userdata)
+{
+    sp_albumbrowse *p_browse = calloc(1, sizeof(*p_browse));
+
+    (void) session; (void) album;
+    start_result(&p_browse->result, FAKE_ALBUM_TRACKS, "fakealbum0",
+                 (void (*)(void *, void *)) callback, userdata);
+    return p_browse;
+}
+
+sp_error sp_albumbrowse_error(sp_albumbrowse *albumbrowse)
+{
+    return albumbrowse->result.loaded ? SP_ERROR_OK : SP_ERROR_IS_LOADING;
+}
+
+bool sp_albumbrowse_is_loaded(sp_albumbrowse *albumbrowse)
+{
+    return albumbrowse->result.loaded;
+}
+
+int sp_albumbrowse_num_tracks(sp_albumbrowse *albumbrowse)
+{
+    return albumbrowse->result.loaded ? albumbrowse->result.i_tracks : 0;
+}
+
+sp_track *sp_albumbrowse_track(sp_albumbrowse *albumbrowse, int index)
+{
+    return albumbrowse->result.tracks[index];
+}
+
+sp_error sp_albumbrowse_release(sp_albumbrowse *albumbrowse)
+{
+    release_result(&albumbrowse->result);
+    free(albumbrowse);
+    return SP_ERROR_OK;
+}
+
+sp_search *sp_search_create(sp_session *session, const char *query, int track_offset,
+                            int track_count, int album_offset, int album_count,
+                            int artist_offset, int artist_count, int playlist_offset,
+                            int playlist_count, sp_search_type search_type,
+                            search_complete_cb *callback, void *userdata)
+{
+    sp_search *p_search = calloc(1, sizeof(*p_search));
+
+    (void) session; (void) query; (void) track_offset; (void) album_offset;
+    (void) album_count; (void) artist_offset; (void) artist_count;
+    (void) playlist_offset; (void) playlist_count; (void) search_type;
+    start_result(&p_search->result,
+                 track_count < FAKE_SEARCH_TRACKS ? track_count : FAKE_SEARCH_TRACKS,
+                 "fakesearch", (void (*)(void *, void *)) callback, userdata);
+    return p_search;
+}
+
+sp_error sp_search_error(sp_search *search)
+{
+    return search->result.loaded ? SP_ERROR_OK : SP_ERROR_IS_LOADING;
+}
+
+bool sp_search_is_loaded(sp_search *search)
+{
+    return search->result.loaded;
+}
+
+int sp_search_num_tracks(sp_search *search)
+{
+    return search->result.loaded ? search->result.i_tracks : 0;
+}
+
+int sp_search_total_tracks(sp_search *search)
+{
+    return sp_search_num_tracks(search);
+}
+
+sp_track *sp_search_track(sp_search *search, int index)
+{
+    return search->result.tracks[index];
+}
+
+sp_error sp_search_release(sp_search *search)
+{
+    release_result(&search->result);
+    free(search);
+    return SP_ERROR_OK;
+}
@@ -0,0 +1,37 @@
+/*****************************************************************************
+ * Copyright (C) 2015 Jonas Lundqvist
+ *
+ * Author: Jonas Lundqvist <jonas@gannon.se>
+ *
+ * This file is part of vlc-spotify.
+ *
+ * vlc-spotify is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+// What the libspotify stand-in in fake_libspotify.c plays
+
+#define FAKE_TRACK_NAME "Fake track"
+#define FAKE_ARTIST_NAME "Fake artist"
+#define FAKE_ALBUM_NAME "Fake album"
+#define FAKE_TRACK_MS 500
+#define FAKE_ALBUM_TRACKS 3
+#define FAKE_SEARCH_TRACKS 2
+
+// Loads like any other track, but is not available in the user's country
+#define FAKE_UNAVAILABLE_URI "spotify:track:0000000000000000000000"
+
+// Replay a callback trace instead of playing, see fake_libspotify.c
+#define FAKE_REPLAY_ENV "VLC_SPOTIFY_REPLAY"
+#define FAKE_REPLAY_FAST_ENV "VLC_SPOTIFY_REPLAY_FAST"
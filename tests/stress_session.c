@@ -0,0 +1,442 @@
+/*****************************************************************************
+ * Copyright (C) 2015 Jonas Lundqvist
+ *
+ * Author: Jonas Lundqvist <jonas@gannon.se>
+ *
+ * This file is part of vlc-spotify.
+ *
+ * vlc-spotify is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+// Soak test of the in-process session of session.c, built with the VLC
+// stand-ins in vlc/ and the libspotify one. Many threads attach clients,
+// play, search and detach again at the same time, like items being opened
+// and closed while playlists are expanded, and the session is logged out
+// and started over whenever they all let go of it. It fails if a client
+// gets a callback after it has been detached, an expander gets a player
+// callback, or a client never gets logged in. Run it with "make stress-session"
+// or, to let the sanitizers look at it, "make stress-session-tsan".
+
+#include <getopt.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <vlc_common.h>
+#include <vlc_dialog.h>
+
+#include <libspotify/api.h>
+
+#include "session.h"
+#include "artcache.h"
+#include "library.h"
+#include "metacache.h"
+#include "metaqueue.h"
+#include "fake_libspotify.h"
+
+#define TRACK_URI "spotify:track:6wNTqBF2Y69KG9EPyj9YJD"
+#define MAX_WORKERS 12      // The stand-in has room for 16 searches in flight
+#define LOGIN_TIMEOUT_US (5 * CLOCK_FREQ)
+
+typedef enum {
+    ROLE_PLAYER,        // Loads a track and plays it
+    ROLE_EXPANDER,      // Searches, like a playlist being expanded
+    ROLE_HOLDER,        // Only keeps the session, like the meta reader
+    ROLE_COUNT
+} role_e;
+
+static const char * const role_names[ROLE_COUNT] = { "player", "expander", "holder" };
+
+typedef struct {
+    spotify_client_t client;
+    role_e           role;
+    atomic_bool      b_detached;
+    atomic_bool      b_logged_in;
+    atomic_bool      b_searched;
+
+    // With the client lock, or by the worker once detached
+    sp_session      *p_session;
+    sp_track        *p_track;
+    sp_search       *p_search;
+} stress_client_t;
+
+static struct {
+    vlc_object_t obj;
+    vlc_object_t libvlc;
+    int          i_logout_delay;
+    atomic_bool  b_done;
+    atomic_bool  b_quiet;       // Nobody starts a cycle meanwhile
+
+    atomic_ulong cycles[ROLE_COUNT];
+    atomic_ulong i_deliveries;
+    atomic_ulong i_stale;       // Search results of an earlier cycle of the same client
+    atomic_ulong i_failures;
+} g;
+
+static void fail(const char *psz_what, const stress_client_t *p_sc)
+{
+    fprintf(stderr, "stress: %s (%s)\n", psz_what, role_names[p_sc->role]);
+    atomic_fetch_add(&g.i_failures, 1);
+}
+
+// Every callback, from the session thread or libspotify
+static void check_attached(const stress_client_t *p_sc)
+{
+    if (atomic_load(&p_sc->b_detached))
+        fail("callback after the detach", p_sc);
+}
+
+static void check_player(const stress_client_t *p_sc)
+{
+    check_attached(p_sc);
+    if (p_sc->role != ROLE_PLAYER)
+        fail("player callback to a client that never loaded", p_sc);
+}
+
+// The options session.c reads, as they are set up by the VLC plugin
+char *var_InheritString(vlc_object_t *p_obj, const char *psz_name)
+{
+    VLC_UNUSED(p_obj);
+    if (strcmp(psz_name, "spotify-username") == 0)
+        return strdup("user");
+    return NULL;
+}
+
+int64_t var_InheritInteger(vlc_object_t *p_obj, const char *psz_name)
+{
+    VLC_UNUSED(p_obj);
+    if (strcmp(psz_name, "spotify-logout-delay") == 0)
+        return g.i_logout_delay;
+    if (strcmp(psz_name, "preferred_bitrate") == 0)
+        return SP_BITRATE_160k;
+    return 0;
+}
+
+bool var_InheritBool(vlc_object_t *p_obj, const char *psz_name)
+{
+    VLC_UNUSED(p_obj); VLC_UNUSED(psz_name);
+    return false;
+}
+
+void dialog_Fatal(vlc_object_t *p_obj, const char *psz_title, const char *psz_format, ...)
+{
+    VLC_UNUSED(p_obj); VLC_UNUSED(psz_format);
+    fprintf(stderr, "stress: fatal dialog \"%s\"\n", psz_title);
+    atomic_fetch_add(&g.i_failures, 1);
+}
+
+void dialog_Login(vlc_object_t *p_obj, char **ppsz_username, char **ppsz_password,
+                  const char *psz_title, const char *psz_format, ...)
+{
+    VLC_UNUSED(p_obj); VLC_UNUSED(psz_title); VLC_UNUSED(psz_format);
+    free(*ppsz_username);
+    *ppsz_username = strdup("user");
+    *ppsz_password = strdup("password");
+}
+
+// The queues served by the session thread, with nothing to look up here
+void meta_queue_process(vlc_object_t *p_obj) { VLC_UNUSED(p_obj); }
+void meta_queue_flush(void) {}
+void art_queue_open(void) {}
+void art_queue_process(vlc_object_t *p_obj, sp_session *p_session)
+{
+    VLC_UNUSED(p_obj); VLC_UNUSED(p_session);
+}
+void art_queue_flush(void) {}
+void library_process(vlc_object_t *p_obj, sp_session *p_session)
+{
+    VLC_UNUSED(p_obj); VLC_UNUSED(p_session);
+}
+void library_shrink(sp_session *p_session) { VLC_UNUSED(p_session); }
+void library_flush(void) {}
+
+static SP_CALLCONV void search_done(sp_search *p_search, void *userdata);
+
+// Session thread
+static void client_logged_in(void *p_opaque, sp_error error)
+{
+    stress_client_t *p_sc = p_opaque;
+    sp_link         *p_link;
+
+    check_attached(p_sc);
+    if (error != SP_ERROR_OK) {
+        fail("login failed", p_sc);
+        return;
+    }
+
+    // Takes the player over from whoever had it
+    if (p_sc->role == ROLE_PLAYER && p_sc->p_track == NULL) {
+        p_link = sp_link_create_from_string(TRACK_URI);
+        p_sc->p_track = sp_link_as_track(p_link);
+        sp_track_add_ref(p_sc->p_track);
+        sp_link_release(p_link);
+        if (spotify_session_player_load_now(p_sc->p_track) != SP_ERROR_OK)
+            fail("player load failed", p_sc);
+    }
+    atomic_store(&p_sc->b_logged_in, true);
+}
+
+// Session thread. Also from spotify_session_metadata_recheck(), once the
+// worker has handed over the session the search is made on.
+static void client_metadata_updated(void *p_opaque)
+{
+    stress_client_t *p_sc = p_opaque;
+
+    check_attached(p_sc);
+    if (p_sc->role == ROLE_EXPANDER && p_sc->p_session != NULL &&
+        p_sc->p_search == NULL && atomic_load(&p_sc->b_logged_in))
+        p_sc->p_search = sp_search_create(p_sc->p_session, "stress", 0, FAKE_SEARCH_TRACKS,
+                                          0, 0, 0, 0, 0, 0, SP_SEARCH_STANDARD,
+                                          search_done, p_sc);
+}
+
+// Session thread, carrying the client that may have been detached since
+static SP_CALLCONV void search_done(sp_search *p_search, void *userdata)
+{
+    stress_client_t *p_sc = userdata;
+
+    if (!spotify_session_lock_client(&p_sc->client))
+        return;
+    check_attached(p_sc);
+    // The same client attached again, the search was handed over before
+    if (p_sc->p_search != p_search)
+        atomic_fetch_add(&g.i_stale, 1);
+    else
+        atomic_store(&p_sc->b_searched, true);
+    spotify_session_unlock_client();
+}
+
+// libspotify context
+static int client_music_delivery(void *p_opaque, const sp_audioformat *format,
+                                 const void *frames, int num_frames)
+{
+    VLC_UNUSED(format); VLC_UNUSED(frames);
+    check_player(p_opaque);
+    atomic_fetch_add(&g.i_deliveries, 1);
+    return num_frames;
+}
+
+static void client_end_of_track(void *p_opaque)
+{
+    check_player(p_opaque);
+}
+
+static void client_play_token_lost(void *p_opaque)
+{
+    check_player(p_opaque);
+}
+
+static void client_connection_changed(void *p_opaque, sp_connectionstate state, sp_error error)
+{
+    VLC_UNUSED(state); VLC_UNUSED(error);
+    check_player(p_opaque);
+}
+
+static void client_player_loaded(void *p_opaque, sp_error error)
+{
+    VLC_UNUSED(error);
+    check_player(p_opaque);
+}
+
+static void pause_ms(unsigned *p_seed, int i_max)
+{
+    usleep((rand_r(p_seed) % (i_max + 1)) * 1000);
+}
+
+static bool wait_flag(atomic_bool *p_flag, mtime_t timeout)
+{
+    mtime_t deadline = mdate() + timeout;
+
+    while (!atomic_load(p_flag)) {
+        if (mdate() >= deadline)
+            return false;
+        usleep(1000);
+    }
+    return true;
+}
+
+// One client attached, used and detached again, or only the session held
+static void cycle(stress_client_t *p_sc, unsigned *p_seed)
+{
+    role_e      role = rand_r(p_seed) % ROLE_COUNT;
+    // Sometimes gone before it was even logged in
+    bool        b_quick = rand_r(p_seed) % 4 == 0;
+    sp_session *p_session;
+
+    if (role == ROLE_HOLDER) {
+        if (spotify_session_acquire(&g.obj, NULL) == NULL) {
+            fprintf(stderr, "stress: acquire failed (holder)\n");
+            atomic_fetch_add(&g.i_failures, 1);
+            return;
+        }
+        pause_ms(p_seed, 20);
+        spotify_session_notify();
+        spotify_session_release();
+        atomic_fetch_add(&g.cycles[role], 1);
+        return;
+    }
+
+    memset(p_sc, 0, sizeof(*p_sc));
+    p_sc->role = role;
+    p_sc->client.p_opaque = p_sc;
+    p_sc->client.pf_logged_in = client_logged_in;
+    p_sc->client.pf_metadata_updated = client_metadata_updated;
+    p_sc->client.pf_music_delivery = client_music_delivery;
+    p_sc->client.pf_end_of_track = client_end_of_track;
+    p_sc->client.pf_play_token_lost = client_play_token_lost;
+    p_sc->client.pf_connection_changed = client_connection_changed;
+    p_sc->client.pf_player_loaded = client_player_loaded;
+
+    p_session = spotify_session_acquire(&g.obj, &p_sc->client);
+    if (p_session == NULL) {
+        fail("acquire failed", p_sc);
+        return;
+    }
+
+    if (spotify_session_lock_client(&p_sc->client)) {
+        p_sc->p_session = p_session;
+        spotify_session_unlock_client();
+    } else {
+        fail("not attached after the acquire", p_sc);
+    }
+    spotify_session_metadata_recheck(&p_sc->client);
+
+    if (!b_quick) {
+        if (!wait_flag(&p_sc->b_logged_in, LOGIN_TIMEOUT_US))
+            fail("never logged in", p_sc);
+        if (role == ROLE_PLAYER) {
+            spotify_session_player_play(true);
+            pause_ms(p_seed, 20);
+            spotify_session_player_seek(rand_r(p_seed) % FAKE_TRACK_MS);
+            pause_ms(p_seed, 20);
+            if (rand_r(p_seed) % 2)
+                spotify_session_player_play(false);
+        } else {
+            spotify_session_metadata_recheck(&p_sc->client);
+            // Not always in time, it is then handed over still loading
+            wait_flag(&p_sc->b_searched, 20 * 1000);
+        }
+    }
+
+    spotify_session_detach(&p_sc->client);
+    atomic_store(&p_sc->b_detached, true);
+    if (spotify_session_lock_client(&p_sc->client)) {
+        fail("locked after the detach", p_sc);
+        spotify_session_unlock_client();
+    }
+
+    // The callbacks are over, what they made is ours to hand over
+    spotify_session_defer_release(SPOTIFY_RELEASE_PLAYER_TRACK, p_sc->p_track);
+    spotify_session_defer_release(SPOTIFY_RELEASE_SEARCH, p_sc->p_search);
+    spotify_session_release();
+    atomic_fetch_add(&g.cycles[role], 1);
+}
+
+static void *worker(void *data)
+{
+    stress_client_t client;
+    unsigned        i_seed = (unsigned) (uintptr_t) data;
+
+    while (!atomic_load(&g.b_done)) {
+        if (atomic_load(&g.b_quiet)) {
+            usleep(1000);
+            continue;
+        }
+        cycle(&client, &i_seed);
+    }
+    return NULL;
+}
+
+static void usage(const char *psz_name)
+{
+    fprintf(stderr,
+            "Usage: %s [-n threads] [-t seconds] [-l logout delay]\n"
+            "  -n  concurrent threads, 1 to %d (8)\n"
+            "  -t  how long to run (10)\n"
+            "  -l  spotify-logout-delay in seconds (0)\n",
+            psz_name, MAX_WORKERS);
+}
+
+int main(int argc, char **argv)
+{
+    pthread_t     threads[MAX_WORKERS];
+    int           i_workers = 8, i_seconds = 10;
+    unsigned long i_total = 0;
+    unsigned      i_seed = 0;
+    mtime_t       deadline;
+    int           opt;
+
+    while ((opt = getopt(argc, argv, "n:t:l:h")) != -1) {
+        switch (opt) {
+        case 'n': i_workers = atoi(optarg); break;
+        case 't': i_seconds = atoi(optarg); break;
+        case 'l': g.i_logout_delay = atoi(optarg); break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+    if (i_workers < 1 || i_workers > MAX_WORKERS || i_seconds < 1 || g.i_logout_delay < 0) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    g.obj.psz_object_type = "demux";
+    g.obj.p_libvlc = (libvlc_int_t *) &g.libvlc;
+    g.libvlc.psz_object_type = "libvlc";
+
+    printf("stress: %d threads for %d s, logout delay %d s\n",
+           i_workers, i_seconds, g.i_logout_delay);
+    for (int i = 0; i < i_workers; i++)
+        if (pthread_create(&threads[i], NULL, worker, (void *) (uintptr_t) (i + 1))) {
+            fprintf(stderr, "stress: can't start the threads\n");
+            return EXIT_FAILURE;
+        }
+
+    // Now and then nobody holds the session for a while, so that the
+    // deferred logout gets to run, or is cancelled just in time, and the
+    // acquires that follow race with it
+    deadline = mdate() + i_seconds * CLOCK_FREQ;
+    while (mdate() < deadline) {
+        pause_ms(&i_seed, 500);
+        atomic_store(&g.b_quiet, true);
+        pause_ms(&i_seed, 1000 * g.i_logout_delay + 100);
+        atomic_store(&g.b_quiet, false);
+    }
+    atomic_store(&g.b_done, true);
+    for (int i = 0; i < i_workers; i++)
+        pthread_join(threads[i], NULL);
+    // As when the plugin is unloaded
+    spotify_session_shutdown();
+
+    for (int i = 0; i < ROLE_COUNT; i++) {
+        printf("stress: %-8s %lu cycles\n", role_names[i], atomic_load(&g.cycles[i]));
+        i_total += atomic_load(&g.cycles[i]);
+    }
+    printf("stress: %lu cycles, %lu deliveries, %lu stale search results, %lu failures\n",
+           i_total, atomic_load(&g.i_deliveries), atomic_load(&g.i_stale),
+           atomic_load(&g.i_failures));
+
+    if (atomic_load(&g.i_failures) > 0 || i_total == 0) {
+        printf("stress: FAILED\n");
+        return EXIT_FAILURE;
+    }
+    printf("stress: PASS\n");
+    return EXIT_SUCCESS;
+}
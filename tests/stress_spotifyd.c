@@ -0,0 +1,382 @@
+/*****************************************************************************
+ * Copyright (C) 2015 Jonas Lundqvist
+ *
+ * Author: Jonas Lundqvist <jonas@gannon.se>
+ *
+ * This file is part of vlc-spotify.
+ *
+ * vlc-spotify is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+// Soak test: many clients opening, pausing, seeking and closing tracks on
+// one vlc-spotifyd at the same time, built with the libspotify stand-in.
+// Every client takes the player over from the others, so most of the
+// requests race with a take over. It reports the opens per second, the
+// latency percentiles of the requests and how the daemon's RSS grows, and
+// fails if the daemon dies, a request gets no reply or the daemon does not
+// exit cleanly (which is what the sanitizers make it do when they find
+// something, see "make stress-tsan").
+
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <math.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "remote.h"
+#include "shmring.h"
+
+#define TRACK_URI "spotify:track:6wNTqBF2Y69KG9EPyj9YJD"
+#define MAX_CLIENTS 30      // Leaves the daemon a couple of connections
+// Latencies in buckets of 1/8 of an octave, from 1 us up to over 1000 s
+#define HIST_SUB 8
+#define HIST_BUCKETS (30 * HIST_SUB)
+
+typedef enum {
+    OP_PLAY,
+    OP_PAUSE,
+    OP_SEEK,
+    OP_META,
+    OP_STOP,
+    OP_COUNT
+} op_e;
+
+static const char * const op_names[OP_COUNT] = { "play", "pause", "seek", "meta", "stop" };
+
+static struct {
+    char         psz_socket[128];
+    pid_t        daemon;
+    atomic_bool  b_done;
+
+    atomic_ulong i_opens;
+    atomic_ulong i_cycles;
+    atomic_ulong i_taken_over;  // Requests answered "Not playing"
+    atomic_ulong i_failures;    // No reply, lost connection, refused open
+    atomic_ulong hist[OP_COUNT][HIST_BUCKETS];
+} g;
+
+static int64_t now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * INT64_C(1000000) + ts.tv_nsec / 1000;
+}
+
+static int bucket_of(int64_t i_us)
+{
+    int i;
+
+    if (i_us < 1)
+        return 0;
+    i = (int) (HIST_SUB * log2((double) i_us)) + 1;
+    return i < HIST_BUCKETS ? i : HIST_BUCKETS - 1;
+}
+
+// The upper bound of the bucket
+static double bucket_us(int i)
+{
+    return i == 0 ? 1 : exp2((double) i / HIST_SUB);
+}
+
+// Nearest rank over all the operations given, in us. -1 if there were none.
+static double percentile(const unsigned long hist[][HIST_BUCKETS], int i_first, int i_last,
+                         unsigned i_percent)
+{
+    unsigned long i_total = 0, i_rank, i_seen = 0;
+
+    for (int op = i_first; op <= i_last; op++)
+        for (int i = 0; i < HIST_BUCKETS; i++)
+            i_total += hist[op][i];
+    if (i_total == 0)
+        return -1;
+
+    i_rank = (i_percent * i_total + 99) / 100;
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        for (int op = i_first; op <= i_last; op++)
+            i_seen += hist[op][i];
+        if (i_seen >= i_rank)
+            return bucket_us(i);
+    }
+    return bucket_us(HIST_BUCKETS - 1);
+}
+
+static void snapshot_hist(unsigned long hist[][HIST_BUCKETS])
+{
+    for (int op = 0; op < OP_COUNT; op++)
+        for (int i = 0; i < HIST_BUCKETS; i++)
+            hist[op][i] = atomic_load_explicit(&g.hist[op][i], memory_order_relaxed);
+}
+
+static long daemon_rss_kb(void)
+{
+    char  psz_path[64];
+    char  psz_line[256];
+    long  i_kb = -1;
+    FILE *p_file;
+
+    snprintf(psz_path, sizeof(psz_path), "/proc/%d/status", (int) g.daemon);
+    p_file = fopen(psz_path, "r");
+    if (p_file == NULL)
+        return -1;
+    while (fgets(psz_line, sizeof(psz_line), p_file) != NULL)
+        if (sscanf(psz_line, "VmRSS: %ld kB", &i_kb) == 1)
+            break;
+    fclose(p_file);
+    return i_kb;
+}
+
+// Times one request. Being taken over is expected, anything else is not.
+static bool timed(remote_t *p_remote, op_e op, int i_ret, int64_t i_start)
+{
+    atomic_fetch_add_explicit(&g.hist[op][bucket_of(now_us() - i_start)], 1,
+                              memory_order_relaxed);
+    if (i_ret == 0)
+        return true;
+    if (strcmp(remote_error(p_remote), "Not playing") == 0) {
+        atomic_fetch_add(&g.i_taken_over, 1);
+    } else {
+        fprintf(stderr, "stress: %s failed: %s\n", op_names[op], remote_error(p_remote));
+        atomic_fetch_add(&g.i_failures, 1);
+    }
+    return false;
+}
+
+// Reads what there is, for at most i_ms, until the track is taken over
+static void drain(shmring_t *p_ring, int i_ms)
+{
+    int64_t     i_end = now_us() + i_ms * 1000;
+    const void *p_data;
+
+    while (now_us() < i_end && !(shmring_flags(p_ring) & (SHMRING_STOPPED | SHMRING_EOS))) {
+        size_t i_size = shmring_peek(p_ring, &p_data);
+        if (i_size == 0)
+            usleep(2000);
+        else
+            shmring_consume(p_ring, i_size);
+    }
+}
+
+// One open: connect, play, a few random requests while reading the ring,
+// stop and close
+static void cycle(int i_client, unsigned *pi_seed, unsigned i_cycle)
+{
+    char        psz_ring[64];
+    remote_t   *p_remote;
+    shmring_t  *p_ring;
+    uint64_t    i_head;
+    int         i_duration_ms;
+    int64_t     i_start;
+    int         i_ret;
+
+    p_remote = remote_connect(g.psz_socket);
+    if (p_remote == NULL) {
+        fprintf(stderr, "stress: client %d could not connect\n", i_client);
+        atomic_fetch_add(&g.i_failures, 1);
+        usleep(100000);
+        return;
+    }
+
+    snprintf(psz_ring, sizeof(psz_ring), "/vlc-spotify-stress-%d-%d-%u",
+             (int) getpid(), i_client, i_cycle);
+    p_ring = shmring_create(psz_ring, 64 * 1024);
+    if (p_ring == NULL) {
+        remote_close(p_remote);
+        atomic_fetch_add(&g.i_failures, 1);
+        return;
+    }
+
+    i_start = now_us();
+    i_ret = remote_play(p_remote, TRACK_URI, psz_ring, &i_duration_ms);
+    shmring_unlink(psz_ring);
+    if (timed(p_remote, OP_PLAY, i_ret, i_start)) {
+        atomic_fetch_add(&g.i_opens, 1);
+
+        for (int i = rand_r(pi_seed) % 4; i >= 0; i--) {
+            drain(p_ring, rand_r(pi_seed) % 20);
+            i_start = now_us();
+            switch (rand_r(pi_seed) % 4) {
+            case 0:
+                i_ret = remote_pause(p_remote, true);
+                timed(p_remote, OP_PAUSE, i_ret, i_start);
+                i_start = now_us();
+                i_ret = remote_pause(p_remote, false);
+                timed(p_remote, OP_PAUSE, i_ret, i_start);
+                break;
+            case 1:
+                i_ret = remote_seek(p_remote, rand_r(pi_seed) % i_duration_ms, &i_head);
+                if (timed(p_remote, OP_SEEK, i_ret, i_start))
+                    shmring_discard(p_ring, i_head);
+                break;
+            default: {
+                remote_meta_t meta;
+                i_ret = remote_meta(p_remote, TRACK_URI, &meta);
+                if (timed(p_remote, OP_META, i_ret, i_start))
+                    remote_meta_clean(&meta);
+                break;
+            }
+            }
+        }
+
+        i_start = now_us();
+        i_ret = remote_stop(p_remote);
+        timed(p_remote, OP_STOP, i_ret, i_start);
+    }
+
+    shmring_close(p_ring);
+    remote_close(p_remote);
+    atomic_fetch_add(&g.i_cycles, 1);
+}
+
+static void *client_thread(void *data)
+{
+    int      i_client = (int) (intptr_t) data;
+    unsigned i_seed = (unsigned) i_client * 7919 + 1;
+
+    for (unsigned i = 0; !atomic_load(&g.b_done); i++)
+        cycle(i_client, &i_seed, i);
+    return NULL;
+}
+
+static void usage(const char *psz_name)
+{
+    fprintf(stderr,
+            "Usage: %s [-n clients] [-t seconds] [-i report interval] [-D daemon]\n"
+            "  -n  concurrent clients, 1 to %d (8)\n"
+            "  -t  how long to run (10)\n"
+            "  -i  seconds between the progress lines (1)\n"
+            "  -D  the vlc-spotifyd built with the stand-in (./vlc-spotifyd-fake)\n",
+            psz_name, MAX_CLIENTS);
+}
+
+int main(int argc, char **argv)
+{
+    static unsigned long hist[OP_COUNT][HIST_BUCKETS];
+    const char *psz_daemon = "./vlc-spotifyd-fake";
+    pthread_t   threads[MAX_CLIENTS];
+    int         i_clients = 8, i_seconds = 10, i_interval = 1;
+    long        i_rss_first = -1, i_rss_max = -1, i_rss = -1;
+    int64_t     i_start, i_elapsed;
+    int         status = -1;
+    bool        b_alive = true;
+    int         opt;
+
+    while ((opt = getopt(argc, argv, "n:t:i:D:h")) != -1) {
+        switch (opt) {
+        case 'n': i_clients = atoi(optarg); break;
+        case 't': i_seconds = atoi(optarg); break;
+        case 'i': i_interval = atoi(optarg); break;
+        case 'D': psz_daemon = optarg; break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+    if (i_clients < 1 || i_clients > MAX_CLIENTS || i_seconds < 1 || i_interval < 1) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    snprintf(g.psz_socket, sizeof(g.psz_socket), "/tmp/stress_spotifyd-%d.sock", (int) getpid());
+
+    g.daemon = fork();
+    if (g.daemon == 0) {
+        setenv("SPOTIFY_PASSWORD", "password", 1);
+        execl(psz_daemon, psz_daemon, "-s", g.psz_socket,
+              "-u", "user", "-c", "/tmp", "-S", "/tmp", (char *) NULL);
+        _exit(127);
+    }
+
+    // Wait for it to listen
+    for (int i = 0; i < 500; i++) {
+        remote_t *p_remote = remote_connect(g.psz_socket);
+        if (p_remote != NULL) {
+            remote_close(p_remote);
+            break;
+        }
+        usleep(10000);
+    }
+
+    printf("stress: %d clients for %d s against %s\n", i_clients, i_seconds, psz_daemon);
+
+    i_start = now_us();
+    for (int i = 0; i < i_clients; i++)
+        pthread_create(&threads[i], NULL, client_thread, (void *) (intptr_t) i);
+
+    for (int i_tick = 1; (int64_t) i_tick * i_interval <= i_seconds; i_tick++) {
+        sleep(i_interval);
+
+        if (waitpid(g.daemon, &status, WNOHANG) != 0) {
+            fprintf(stderr, "stress: the daemon died\n");
+            b_alive = false;
+            break;
+        }
+
+        i_rss = daemon_rss_kb();
+        // The first sample is after the warm up
+        if (i_rss_first < 0)
+            i_rss_first = i_rss;
+        if (i_rss > i_rss_max)
+            i_rss_max = i_rss;
+
+        snapshot_hist(hist);
+        i_elapsed = now_us() - i_start;
+        printf("stress: t=%"PRId64" s opens=%lu (%.1f/s) p99=%.0f us rss=%ld kB\n",
+               i_elapsed / 1000000, atomic_load(&g.i_opens),
+               atomic_load(&g.i_opens) * 1e6 / i_elapsed,
+               percentile(hist, OP_PAUSE, OP_STOP, 99), i_rss);
+        fflush(stdout);
+    }
+
+    atomic_store(&g.b_done, true);
+    for (int i = 0; i < i_clients; i++)
+        pthread_join(threads[i], NULL);
+    i_elapsed = now_us() - i_start;
+
+    snapshot_hist(hist);
+    printf("stress: %lu opens in %.1f s, %.1f opens/s, %lu requests taken over, %lu failures\n",
+           atomic_load(&g.i_opens), i_elapsed / 1e6, atomic_load(&g.i_opens) * 1e6 / i_elapsed,
+           atomic_load(&g.i_taken_over), atomic_load(&g.i_failures));
+    for (int op = 0; op < OP_COUNT; op++)
+        printf("stress: %-5s p50=%.0f us p99=%.0f us max=%.0f us\n", op_names[op],
+               percentile(hist, op, op, 50), percentile(hist, op, op, 99),
+               percentile(hist, op, op, 100));
+    printf("stress: control p99=%.0f us\n", percentile(hist, OP_PAUSE, OP_STOP, 99));
+    printf("stress: rss first=%ld kB max=%ld kB last=%ld kB growth=%ld kB\n",
+           i_rss_first, i_rss_max, i_rss, i_rss - i_rss_first);
+
+    if (b_alive) {
+        kill(g.daemon, SIGTERM);
+        waitpid(g.daemon, &status, 0);
+    }
+    unlink(g.psz_socket);
+
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0 || atomic_load(&g.i_failures) > 0 ||
+        atomic_load(&g.i_opens) == 0) {
+        printf("stress: FAILED (daemon exit status %d)\n",
+               WIFEXITED(status) ? WEXITSTATUS(status) : -1);
+        return EXIT_FAILURE;
+    }
+    printf("stress: PASS\n");
+    return EXIT_SUCCESS;
+}
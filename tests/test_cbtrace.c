@@ -0,0 +1,282 @@
+/*****************************************************************************
+ * Copyright (C) 2015 Jonas Lundqvist
+ *
+ * Author: Jonas Lundqvist <jonas@gannon.se>
+ *
+ * This file is part of vlc-spotify.
+ *
+ * vlc-spotify is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <libspotify/api.h>
+
+#include "cbtrace.h"
+#include "fake_libspotify.h"
+#include "testrunner.h"
+
+#define GAP_US 50000
+
+static char trace_path[64];
+
+static int16_t frames[256 * 2];
+
+// What the replay made of the trace
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t  wait;
+    int             i_deliveries;
+    int             i_sizes[8];
+    int             i_frames;
+    int             i_first;        // Left channel of the first frame
+    bool            b_pattern;      // Every frame as the stand-in counts
+    bool            b_end;
+} replay = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .wait = PTHREAD_COND_INITIALIZER,
+};
+
+static int64_t now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void record_delivery(cbtrace_t *p_trace, unsigned i_frames, unsigned i_consumed)
+{
+    cbtrace_event_t event = {
+        .type = CBTRACE_MUSIC_DELIVERY,
+        .i_rate = 44100,
+        .i_channels = 2,
+        .i_frames = i_frames,
+        .i_consumed = i_consumed,
+        .p_frames = frames,
+    };
+
+    cbtrace_record(p_trace, &event);
+}
+
+// A delivery of 256 frames, 50 ms later one of 100 frames that only
+// partly was taken, and the end of the track another 50 ms later
+static int write_trace(bool b_audio)
+{
+    cbtrace_t      *p_trace = cbtrace_create(trace_path, b_audio);
+    cbtrace_event_t event = { .type = CBTRACE_CONNECTION, .i_state = 2, .i_value = 0x11 };
+
+    if (p_trace == NULL)
+        return 0;
+
+    for (int i = 0; i < 256 * 2; i++)
+        frames[i] = 1000 + i;
+
+    record_delivery(p_trace, 256, 256);
+    cbtrace_record(p_trace, &event);
+    usleep(GAP_US);
+    record_delivery(p_trace, 100, 60);
+    usleep(GAP_US);
+    event.type = CBTRACE_END_OF_TRACK;
+    cbtrace_record(p_trace, &event);
+    cbtrace_close(p_trace);
+    return 1;
+}
+
+static int read_trace(bool b_audio)
+{
+    cbtrace_reader_t *p_reader = cbtrace_open(trace_path);
+    cbtrace_event_t   event;
+    int               ok;
+
+    if (p_reader == NULL)
+        return 0;
+
+    ok = cbtrace_has_audio(p_reader) == b_audio;
+
+    ok = ok && cbtrace_read(p_reader, &event) == 1 &&
+         event.type == CBTRACE_MUSIC_DELIVERY && event.i_rate == 44100 &&
+         event.i_channels == 2 && event.i_frames == 256 && event.i_consumed == 256 &&
+         (b_audio ? event.p_frames && !memcmp(event.p_frames, frames, 256 * 4) :
+                    event.p_frames == NULL);
+    ok = ok && cbtrace_read(p_reader, &event) == 1 &&
+         event.type == CBTRACE_CONNECTION && event.i_state == 2 && event.i_value == 0x11;
+    ok = ok && cbtrace_read(p_reader, &event) == 1 &&
+         event.type == CBTRACE_MUSIC_DELIVERY && event.i_frames == 100 &&
+         event.i_consumed == 60 && event.i_time >= GAP_US;
+    ok = ok && cbtrace_read(p_reader, &event) == 1 &&
+         event.type == CBTRACE_END_OF_TRACK && event.i_time >= 2 * GAP_US;
+    ok = ok && cbtrace_read(p_reader, &event) == 0;
+
+    cbtrace_reader_close(p_reader);
+    return ok;
+}
+
+static int test_events(void)
+{
+    return write_trace(false) && read_trace(false);
+}
+
+static int test_audio(void)
+{
+    return write_trace(true) && read_trace(true);
+}
+
+// Cut in the middle of the audio of the last delivery
+static int test_damaged(void)
+{
+    cbtrace_reader_t *p_reader;
+    cbtrace_event_t   event;
+    FILE             *p_file;
+    int               ok;
+
+    if (!write_trace(true) || truncate(trace_path, 8 + 1 + 1 + 8 + 256 * 4 + 4 + 8 + 40))
+        return 0;
+
+    p_reader = cbtrace_open(trace_path);
+    ok = p_reader != NULL &&
+         cbtrace_read(p_reader, &event) == 1 &&
+         cbtrace_read(p_reader, &event) == 1 &&
+         cbtrace_read(p_reader, &event) == -1;
+    cbtrace_reader_close(p_reader);
+
+    p_file = fopen(trace_path, "wb");
+    if (p_file == NULL)
+        return 0;
+    fputs("not a trace", p_file);
+    fclose(p_file);
+    return ok && cbtrace_open(trace_path) == NULL;
+}
+
+static int music_delivery(sp_session *session, const sp_audioformat *format,
+                          const void *p_frames, int num_frames)
+{
+    const int16_t *p_samples = p_frames;
+    (void) session;
+
+    pthread_mutex_lock(&replay.lock);
+    if (replay.i_deliveries == 0)
+        replay.i_first = p_samples[0];
+    for (int i = 0; i < num_frames * format->channels; i++)
+        if (p_samples[i] != replay.i_frames + i / format->channels)
+            replay.b_pattern = false;
+    replay.i_frames += num_frames;
+    if (replay.i_deliveries < 8)
+        replay.i_sizes[replay.i_deliveries] = num_frames;
+    replay.i_deliveries++;
+    pthread_mutex_unlock(&replay.lock);
+
+    return num_frames;
+}
+
+static void end_of_track(sp_session *session)
+{
+    (void) session;
+
+    pthread_mutex_lock(&replay.lock);
+    replay.b_end = true;
+    pthread_cond_signal(&replay.wait);
+    pthread_mutex_unlock(&replay.lock);
+}
+
+static const sp_session_callbacks callbacks = {
+    .music_delivery = music_delivery,
+    .end_of_track = end_of_track,
+};
+
+// Replays the trace to the callbacks, returns how long it took
+static int64_t run_replay(bool b_fast)
+{
+    sp_session_config config = { .callbacks = &callbacks };
+    sp_session       *p_session;
+    int64_t           i_start = now_us();
+
+    replay.i_deliveries = 0;
+    replay.i_frames = 0;
+    replay.b_pattern = true;
+    replay.b_end = false;
+
+    setenv(FAKE_REPLAY_ENV, trace_path, 1);
+    if (b_fast)
+        setenv(FAKE_REPLAY_FAST_ENV, "1", 1);
+    else
+        unsetenv(FAKE_REPLAY_FAST_ENV);
+
+    if (sp_session_create(&config, &p_session) != SP_ERROR_OK)
+        return -1;
+
+    pthread_mutex_lock(&replay.lock);
+    while (!replay.b_end)
+        pthread_cond_wait(&replay.wait, &replay.lock);
+    pthread_mutex_unlock(&replay.lock);
+
+    sp_session_release(p_session);
+    unsetenv(FAKE_REPLAY_ENV);
+    return now_us() - i_start;
+}
+
+// The deliveries come as large and as far apart as when recorded, with the
+// audio of the trace
+static int test_replay(void)
+{
+    int64_t i_elapsed;
+
+    if (!write_trace(true))
+        return 0;
+
+    i_elapsed = run_replay(false);
+    return i_elapsed >= 2 * GAP_US && replay.i_deliveries == 2 &&
+           replay.i_sizes[0] == 256 && replay.i_sizes[1] == 100 &&
+           replay.b_pattern == false && replay.i_first == 1000;
+}
+
+// As fast as possible, and without audio in the trace, the counting pattern
+static int test_replay_fast(void)
+{
+    int64_t i_elapsed;
+
+    if (!write_trace(false))
+        return 0;
+
+    i_elapsed = run_replay(true);
+    return i_elapsed >= 0 && i_elapsed < GAP_US && replay.i_deliveries == 2 &&
+           replay.i_sizes[0] == 256 && replay.i_sizes[1] == 100 &&
+           replay.b_pattern == true && replay.i_first == 0;
+}
+
+static const test_case_t tests[] = {
+    { "events", test_events },
+    { "audio", test_audio },
+    { "damaged", test_damaged },
+    { "replay", test_replay },
+    { "replay fast", test_replay_fast },
+};
+
+int main(int argc, char *argv[]) {
+    int total_pass;
+
+    snprintf(trace_path, sizeof(trace_path), "/tmp/test_cbtrace-%d", (int) getpid());
+
+    total_pass = test_cases(tests, TEST_COUNT(tests));
+
+    unlink(trace_path);
+
+    return test_summary(total_pass, TEST_COUNT(tests));
+}
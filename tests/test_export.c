@@ -0,0 +1,185 @@
+/*****************************************************************************
+ * Copyright (C) 2015 Jonas Lundqvist
+ *
+ * Author: Jonas Lundqvist <jonas@gannon.se>
+ *
+ * This file is part of vlc-spotify.
+ *
+ * vlc-spotify is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+// vlc-spotify-export, built with the libspotify stand-in, and its output
+// functions.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "exportfmt.h"
+#include "fake_libspotify.h"
+#include "testrunner.h"
+
+#define TRACK "spotify:track:6wNTqBF2Y69KG9EPyj9YJD"
+#define ALBUM "https://open.spotify.com/album/2mCuMNdJkoyiXFhsQCLLqw"
+
+static const char expected_m3u[] =
+    "#EXTM3U\n"
+    "#EXTINF:1,Fake artist - Fake track\n"
+    "spotify://" TRACK "\n"
+    "#EXTINF:1,Fake artist - Fake track\n"
+    "spotify://spotify:track:fakealbum0000000000000\n"
+    "#EXTINF:1,Fake artist - Fake track\n"
+    "spotify://spotify:track:fakealbum0000000000001\n"
+    "#EXTINF:1,Fake artist - Fake track\n"
+    "spotify://spotify:track:fakealbum0000000000002\n"
+    "# bogus: Not a Spotify link\n"
+    "#EXTINF:1,Fake artist - Fake track\n"
+    "spotify://spotify:track:fakesearch000000000000\n"
+    "#EXTINF:1,Fake artist - Fake track\n"
+    "spotify://spotify:track:fakesearch000000000001\n";
+
+static char output[64];
+static char progress[80];
+
+static char *read_file(const char *psz_path)
+{
+    FILE *p_file = fopen(psz_path, "r");
+    char *psz = calloc(1, 65536);
+
+    if (p_file == NULL || psz == NULL) {
+        if (p_file)
+            fclose(p_file);
+        free(psz);
+        return NULL;
+    }
+    if (fread(psz, 1, 65535, p_file)) {}
+    fclose(p_file);
+    return psz;
+}
+
+static int run_export(const char *psz_args)
+{
+    char psz_cmd[512];
+
+    snprintf(psz_cmd, sizeof(psz_cmd),
+             "SPOTIFY_PASSWORD=password ./vlc-spotify-export-fake -u user -c /tmp -S /tmp "
+             "-j 2 -o %s %s 2>/dev/null", output, psz_args);
+    return system(psz_cmd);
+}
+
+static int test_json_escape(void)
+{
+    export_entry_t entry = {
+        .psz_input = "in\"put",
+        .psz_uri = TRACK,
+        .psz_title = "a\\b\nc\x01",
+        .psz_artist = NULL,
+        .psz_album = "Album",
+        .i_duration_ms = 1234,
+    };
+    FILE *p_file = fopen(output, "w");
+    char *psz;
+    int   ok;
+
+    if (p_file == NULL)
+        return 0;
+    export_entry(p_file, EXPORT_JSON, &entry);
+    fclose(p_file);
+
+    psz = read_file(output);
+    ok = psz && !strcmp(psz, "{\"input\":\"in\\\"put\",\"uri\":\"" TRACK "\","
+                              "\"title\":\"a\\\\b\\nc\\u0001\",\"artist\":null,"
+                              "\"album\":\"Album\",\"duration_ms\":1234}\n");
+    free(psz);
+    return ok;
+}
+
+static int test_progress(void)
+{
+    export_progress_t in = { 12, 3456 }, out = { 0, 0 };
+
+    unlink(progress);
+    return export_progress_read(progress, &out) == -1 &&
+           export_progress_write(progress, &in) == 0 &&
+           export_progress_read(progress, &out) == 0 &&
+           out.i_done == 12 && out.i_offset == 3456;
+}
+
+// Tracks, albums and searches, in the order of the input
+static int test_m3u(void)
+{
+    char *psz;
+    int   ok;
+
+    unlink(progress);
+    if (run_export("spotify://" TRACK " " ALBUM " bogus spotify:search:daft+punk"))
+        return 0;
+
+    psz = read_file(output);
+    ok = psz && !strcmp(psz, expected_m3u);
+    free(psz);
+    return ok;
+}
+
+// An interrupted run is picked up where the progress says, and what was
+// written after that is replaced
+static int test_resume(void)
+{
+    export_progress_t done = { 1, 0 };
+    const char *psz_after_track = strstr(expected_m3u, "#EXTINF:1,Fake artist - Fake track\n"
+                                                       "spotify://spotify:track:fakealbum");
+    FILE *p_file = fopen(output, "w");
+    char *psz;
+    int   ok;
+
+    if (p_file == NULL)
+        return 0;
+    done.i_offset = psz_after_track - expected_m3u;
+    fwrite(expected_m3u, 1, done.i_offset, p_file);
+    fputs("#EXTINF:1,Half written", p_file);
+    fclose(p_file);
+    if (export_progress_write(progress, &done))
+        return 0;
+
+    if (run_export("-r " TRACK " " ALBUM " bogus spotify:search:daft+punk"))
+        return 0;
+
+    psz = read_file(output);
+    ok = psz && !strcmp(psz, expected_m3u);
+    free(psz);
+    return ok;
+}
+
+static const test_case_t tests[] = {
+    { "json escape", test_json_escape },
+    { "progress", test_progress },
+    { "m3u", test_m3u },
+    { "resume", test_resume },
+};
+
+int main(int argc, char *argv[]) {
+    int total_pass;
+
+    snprintf(output, sizeof(output), "/tmp/test_export-%d.m3u", (int) getpid());
+    snprintf(progress, sizeof(progress), "%s.progress", output);
+
+    total_pass = test_cases(tests, TEST_COUNT(tests));
+
+    unlink(output);
+    unlink(progress);
+
+    return test_summary(total_pass, TEST_COUNT(tests));
+}
@@ -0,0 +1,155 @@
+/*****************************************************************************
+ * Copyright (C) 2015 Jonas Lundqvist
+ *
+ * Author: Jonas Lundqvist <jonas@gannon.se>
+ *
+ * This file is part of vlc-spotify.
+ *
+ * vlc-spotify is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "membudget.h"
+#include "testrunner.h"
+
+#define THREADS 4
+#define ROUNDS 200000
+
+static int test_accounting(void)
+{
+    int ok;
+
+    membudget_charge(MEMBUDGET_AUDIO, 1000);
+    membudget_charge(MEMBUDGET_METADATA, 200);
+    membudget_charge(MEMBUDGET_AUDIO, 24);
+    ok = membudget_used(MEMBUDGET_AUDIO) == 1024 &&
+         membudget_used(MEMBUDGET_METADATA) == 200 &&
+         membudget_used(MEMBUDGET_PLAYLISTS) == 0 &&
+         membudget_total() == 1224;
+
+    membudget_release(MEMBUDGET_AUDIO, 1024);
+    membudget_release(MEMBUDGET_METADATA, 200);
+    return ok && membudget_total() == 0 && membudget_used(MEMBUDGET_AUDIO) == 0;
+}
+
+static int test_limit(void)
+{
+    int ok;
+
+    // No limit, anything fits
+    ok = membudget_fits((size_t) 1 << 40) && !membudget_over();
+
+    membudget_set_limit(4096);
+    membudget_charge(MEMBUDGET_PLAYLISTS, 3000);
+    ok = ok && membudget_fits(1096) && !membudget_fits(1097) && !membudget_over();
+    membudget_charge(MEMBUDGET_METADATA, 2000);
+    ok = ok && membudget_over() && !membudget_fits(0);
+    membudget_release(MEMBUDGET_METADATA, 2000);
+    ok = ok && !membudget_over();
+
+    membudget_release(MEMBUDGET_PLAYLISTS, 3000);
+    membudget_set_limit(0);
+    return ok && membudget_limit() == 0;
+}
+
+// Only the component without which the rest fits is over
+static int test_over_by(void)
+{
+    int ok;
+
+    membudget_set_limit(4096);
+    membudget_charge(MEMBUDGET_PLAYLISTS, 3000);
+    membudget_charge(MEMBUDGET_METADATA, 2000);
+    ok = membudget_over_by(MEMBUDGET_PLAYLISTS) && membudget_over_by(MEMBUDGET_METADATA) &&
+         !membudget_over_by(MEMBUDGET_AUDIO);
+
+    // Over with or without any one of them, none of them is the reason
+    membudget_charge(MEMBUDGET_AUDIO, 5000);
+    ok = ok && membudget_over() && !membudget_over_by(MEMBUDGET_PLAYLISTS) &&
+         !membudget_over_by(MEMBUDGET_METADATA) && !membudget_over_by(MEMBUDGET_AUDIO);
+    membudget_release(MEMBUDGET_AUDIO, 5000);
+
+    membudget_release(MEMBUDGET_METADATA, 2000);
+    ok = ok && !membudget_over_by(MEMBUDGET_PLAYLISTS);
+
+    membudget_release(MEMBUDGET_PLAYLISTS, 3000);
+    membudget_set_limit(0);
+    return ok;
+}
+
+static int test_format(void)
+{
+    char psz_buf[128];
+    char psz_short[16];
+    int  ok;
+
+    membudget_charge(MEMBUDGET_METADATA, 120 * 1024);
+    membudget_format(psz_buf, sizeof(psz_buf));
+    ok = !strcmp(psz_buf, "audio 0 kB, metadata 120 kB, playlists 0 kB, no limit");
+
+    membudget_set_limit(64 * 1024 * 1024);
+    membudget_format(psz_buf, sizeof(psz_buf));
+    ok = ok && !strcmp(psz_buf, "audio 0 kB, metadata 120 kB, playlists 0 kB, of 65536 kB");
+
+    // Cut short, but terminated
+    membudget_format(psz_short, sizeof(psz_short));
+    ok = ok && strlen(psz_short) == sizeof(psz_short) - 1;
+
+    membudget_set_limit(0);
+    membudget_release(MEMBUDGET_METADATA, 120 * 1024);
+    return ok;
+}
+
+static void *churn(void *data)
+{
+    membudget_component_e component = (membudget_component_e) (size_t) data;
+
+    for (int i = 0; i < ROUNDS; i++) {
+        size_t i_bytes = 1 + i % 4096;
+        membudget_charge(component, i_bytes);
+        membudget_release(component, i_bytes);
+    }
+    return NULL;
+}
+
+// Charged and released from several threads at once, nothing is lost
+static int test_threads(void)
+{
+    pthread_t threads[THREADS];
+
+    for (size_t i = 0; i < THREADS; i++)
+        pthread_create(&threads[i], NULL, churn, (void *) (i % MEMBUDGET_COMPONENTS));
+    for (int i = 0; i < THREADS; i++)
+        pthread_join(threads[i], NULL);
+
+    return membudget_total() == 0 && membudget_used(MEMBUDGET_AUDIO) == 0 &&
+           membudget_used(MEMBUDGET_METADATA) == 0 && membudget_used(MEMBUDGET_PLAYLISTS) == 0;
+}
+
+static const test_case_t tests[] = {
+    { "accounting", test_accounting },
+    { "limit", test_limit },
+    { "over by", test_over_by },
+    { "format", test_format },
+    { "threads", test_threads },
+};
+
+int main(int argc, char *argv[]) {
+    return run_tests(tests, TEST_COUNT(tests));
+}
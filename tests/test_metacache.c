@@ -0,0 +1,205 @@
+/*****************************************************************************
+ * Copyright (C) 2015 Jonas Lundqvist
+ *
+ * Author: Jonas Lundqvist <jonas@gannon.se>
+ *
+ * This file is part of vlc-spotify.
+ *
+ * vlc-spotify is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "membudget.h"
+#include "metacache.h"
+#include "testrunner.h"
+
+#define URI "spotify:track:6wNTqBF2Y69KG9EPyj9YJD"
+
+static void make_meta(track_meta_t *p_meta, const char *psz_title)
+{
+    memset(p_meta, 0, sizeof(*p_meta));
+    p_meta->b_available = true;
+    p_meta->psz_title = (char *) psz_title;
+    p_meta->psz_artist = "Artist 1, Artist 2";
+    p_meta->psz_album = NULL;
+    p_meta->psz_art_id = "0123456789abcdef0123456789abcdef01234567";
+    p_meta->i_duration = 123000000;
+}
+
+static int test_put_get(void)
+{
+    track_meta_t meta, got;
+    int          ok;
+
+    meta_cache_clear();
+    make_meta(&meta, "Title");
+    meta_cache_put(URI, &meta);
+
+    ok = !meta_cache_get("spotify:track:other", &got);
+    ok = ok && meta_cache_get(URI, &got) && got.b_available &&
+         !strcmp(got.psz_title, "Title") && !strcmp(got.psz_artist, "Artist 1, Artist 2") &&
+         got.psz_album == NULL && !strcmp(got.psz_art_id, meta.psz_art_id) &&
+         got.i_duration == 123000000 && got.psz_title != meta.psz_title;
+    track_meta_clean(&got);
+    return ok;
+}
+
+// A newer lookup replaces the older one, also with a failure
+static int test_replace(void)
+{
+    track_meta_t meta, got;
+    int          ok;
+
+    meta_cache_clear();
+    make_meta(&meta, "Old");
+    meta_cache_put(URI, &meta);
+    make_meta(&meta, "New");
+    meta_cache_put(URI, &meta);
+    ok = meta_cache_get(URI, &got) && !strcmp(got.psz_title, "New");
+    track_meta_clean(&got);
+
+    memset(&meta, 0, sizeof(meta));
+    meta_cache_put(URI, &meta);
+    ok = ok && meta_cache_get(URI, &got) && !got.b_available && got.psz_title == NULL;
+    track_meta_clean(&got);
+    return ok;
+}
+
+// The least recently used goes first
+static int test_eviction(void)
+{
+    track_meta_t meta, got;
+    char         uri[64];
+    int          ok;
+
+    meta_cache_clear();
+    make_meta(&meta, "Title");
+    for (int i = 0; i < META_CACHE_SIZE; i++) {
+        snprintf(uri, sizeof(uri), "spotify:track:%d", i);
+        meta_cache_put(uri, &meta);
+    }
+
+    // Used, so the 2nd oldest is evicted instead
+    ok = meta_cache_get("spotify:track:0", &got);
+    track_meta_clean(&got);
+
+    meta_cache_put(URI, &meta);
+    ok = ok && meta_cache_get("spotify:track:0", &got);
+    track_meta_clean(&got);
+    ok = ok && !meta_cache_get("spotify:track:1", &got);
+    ok = ok && meta_cache_get("spotify:track:2", &got);
+    track_meta_clean(&got);
+    ok = ok && meta_cache_get(URI, &got);
+    track_meta_clean(&got);
+
+    meta_cache_clear();
+    return ok && !meta_cache_get(URI, &got);
+}
+
+// Charged while cached, and the oldest tracks make room within the budget
+static int test_budget(void)
+{
+    track_meta_t meta, got;
+    char         uri[64];
+    size_t       i_one;
+    int          ok;
+
+    meta_cache_clear();
+    ok = membudget_used(MEMBUDGET_METADATA) == 0;
+    make_meta(&meta, "Title");
+    meta_cache_put("spotify:track:00", &meta);
+    i_one = membudget_used(MEMBUDGET_METADATA);
+    ok = ok && i_one > 0;
+
+    // Room for 10 of them, 100 of the same size are put
+    membudget_set_limit(10 * i_one + i_one / 2);
+    for (int i = 1; i < 100; i++) {
+        snprintf(uri, sizeof(uri), "spotify:track:%02d", i);
+        meta_cache_put(uri, &meta);
+        ok = ok && !membudget_over();
+    }
+    ok = ok && membudget_used(MEMBUDGET_METADATA) == 10 * i_one;
+    ok = ok && !meta_cache_get("spotify:track:89", &got);
+    ok = ok && meta_cache_get("spotify:track:90", &got);
+    track_meta_clean(&got);
+
+    // Someone else takes most of it, the cache gives way
+    membudget_charge(MEMBUDGET_AUDIO, 8 * i_one);
+    ok = ok && membudget_over();
+    meta_cache_shrink();
+    ok = ok && !membudget_over() && membudget_used(MEMBUDGET_METADATA) == 2 * i_one;
+    ok = ok && meta_cache_get("spotify:track:99", &got);
+    track_meta_clean(&got);
+    membudget_release(MEMBUDGET_AUDIO, 8 * i_one);
+
+    // Over on its own, nothing the cache gives up would do: the cache stays
+    membudget_charge(MEMBUDGET_AUDIO, 11 * i_one);
+    meta_cache_shrink();
+    ok = ok && membudget_used(MEMBUDGET_METADATA) == 2 * i_one;
+    meta_cache_put("spotify:track:00", &meta);
+    ok = ok && membudget_used(MEMBUDGET_METADATA) == 3 * i_one;
+    ok = ok && meta_cache_get("spotify:track:00", &got);
+    track_meta_clean(&got);
+    membudget_release(MEMBUDGET_AUDIO, 11 * i_one);
+
+    membudget_set_limit(0);
+    meta_cache_clear();
+    return ok && membudget_total() == 0;
+}
+
+static void *put_later(void *data)
+{
+    track_meta_t meta;
+    (void) data;
+
+    usleep(50000);
+    make_meta(&meta, "Later");
+    meta_cache_put(URI, &meta);
+    return NULL;
+}
+
+// Waiting ends with the put, or with the timeout
+static int test_wait(void)
+{
+    track_meta_t meta;
+    pthread_t    thread;
+    int          ok;
+
+    meta_cache_clear();
+    ok = !meta_cache_wait(URI, &meta, 20);
+
+    pthread_create(&thread, NULL, put_later, NULL);
+    ok = ok && meta_cache_wait(URI, &meta, 5000) && !strcmp(meta.psz_title, "Later");
+    pthread_join(thread, NULL);
+    track_meta_clean(&meta);
+    return ok;
+}
+
+static const test_case_t tests[] = {
+    { "put and get", test_put_get },
+    { "replace", test_replace },
+    { "eviction", test_eviction },
+    { "wait", test_wait },
+    { "budget", test_budget },
+};
+
+int main(int argc, char *argv[]) {
+    return run_tests(tests, TEST_COUNT(tests));
+}
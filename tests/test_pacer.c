@@ -0,0 +1,155 @@
+/*****************************************************************************
+ * Copyright (C) 2015 Jonas Lundqvist
+ *
+ * Author: Jonas Lundqvist <jonas@gannon.se>
+ *
+ * This file is part of vlc-spotify.
+ *
+ * vlc-spotify is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "pacer.h"
+#include "testrunner.h"
+
+// As in spotify_music_delivery(): libspotify offers the audio in chunks
+// and retries a little later when one is not taken, a chunk is taken as
+// long as the audio ahead of the playing is within PACE_AHEAD_US.
+#define PACE_AHEAD_US 250000
+#define CHUNK_US (2048 * INT64_C(1000000) / 44100)
+#define RETRY_US 20000
+#define START_US INT64_C(1000000000)
+
+typedef struct {
+    pacer_t pace;
+    int64_t i_now;
+    int64_t i_pts;      // Of the next sample to be delivered
+    int64_t i_min_ahead_us;
+    int64_t i_max_ahead_wall;
+} sim_t;
+
+static void sim_start(sim_t *p_sim)
+{
+    pacer_init(&p_sim->pace, START_US);
+    p_sim->i_now = START_US;
+    p_sim->i_pts = 0;
+    p_sim->i_min_ahead_us = INT64_MAX;
+    p_sim->i_max_ahead_wall = 0;
+}
+
+// i_wall of playing, libspotify delivering what is taken
+static void sim_run(sim_t *p_sim, int64_t i_wall)
+{
+    for (int64_t i_end = p_sim->i_now + i_wall; p_sim->i_now < i_end; p_sim->i_now += RETRY_US) {
+        int64_t i_ahead;
+
+        while (p_sim->i_pts - pacer_time(&p_sim->pace, p_sim->i_now) <=
+               pacer_media(&p_sim->pace, PACE_AHEAD_US))
+            p_sim->i_pts += CHUNK_US;
+
+        i_ahead = p_sim->i_pts - pacer_time(&p_sim->pace, p_sim->i_now + RETRY_US);
+        // Just before the next retry is when the least is left
+        if (i_ahead < p_sim->i_min_ahead_us)
+            p_sim->i_min_ahead_us = i_ahead;
+        i_ahead = pacer_wall(&p_sim->pace, p_sim->i_pts - pacer_time(&p_sim->pace, p_sim->i_now));
+        if (i_ahead > p_sim->i_max_ahead_wall)
+            p_sim->i_max_ahead_wall = i_ahead;
+    }
+}
+
+static int test_rate_change(void)
+{
+    pacer_t pace;
+    int64_t i_time;
+
+    pacer_init(&pace, START_US);
+    i_time = pacer_time(&pace, START_US + 1000000);
+    pacer_set_rate(&pace, PACER_RATE_DEFAULT / 2, START_US + 1000000);
+
+    // Goes on from where it was, twice as fast
+    return i_time == 1000000 &&
+           pacer_time(&pace, START_US + 1000000) == 1000000 &&
+           pacer_time(&pace, START_US + 2000000) == 3000000 &&
+           pacer_media(&pace, 100) == 200 && pacer_wall(&pace, 200) == 100;
+}
+
+static int test_set_time(void)
+{
+    pacer_t pace;
+
+    pacer_init(&pace, START_US);
+    pacer_set_rate(&pace, PACER_RATE_DEFAULT * 2, START_US);
+    pacer_set_time(&pace, 5000000, START_US + 10000000);
+    pacer_delay(&pace, 1000000);
+
+    return pacer_time(&pace, START_US + 10000000) == 4500000 &&
+           pacer_time(&pace, START_US + 12000000) == 5500000;
+}
+
+// 0.5x to 4x: never runs dry, never more than the pace ahead in wall time
+static int test_rates(void)
+{
+    static const int rates[] = { 2000, 1000, 667, 500, 333, 250 };
+    int ok = 1;
+
+    for (size_t i = 0; i < sizeof(rates) / sizeof(rates[0]); i++) {
+        sim_t sim;
+
+        sim_start(&sim);
+        pacer_set_rate(&sim.pace, rates[i], sim.i_now);
+        sim_run(&sim, 60000000);
+
+        printf("  %.2fx: %"PRId64" ms min ahead, %"PRId64" ms max ahead (wall)\n",
+               (double) PACER_RATE_DEFAULT / rates[i],
+               sim.i_min_ahead_us / 1000, sim.i_max_ahead_wall / 1000);
+        ok &= sim.i_min_ahead_us > 0 &&
+              sim.i_max_ahead_wall <= PACE_AHEAD_US + pacer_wall(&sim.pace, CHUNK_US);
+    }
+    return ok;
+}
+
+// Speeding up and slowing down while playing, without a seek. Slowing down
+// leaves more ahead in wall time for a while, which is only played out.
+static int test_rate_steps(void)
+{
+    static const int rates[] = { 1000, 250, 2000, 333, 1000, 500, 250 };
+    sim_t sim;
+    int   ok = 1;
+
+    sim_start(&sim);
+    for (size_t i = 0; i < sizeof(rates) / sizeof(rates[0]); i++) {
+        int64_t i_before = pacer_time(&sim.pace, sim.i_now);
+        pacer_set_rate(&sim.pace, rates[i], sim.i_now);
+        // Rounded to the microsecond at the old and the new rate, well
+        // within a sample
+        ok &= llabs(pacer_time(&sim.pace, sim.i_now) - i_before) <= 10;
+        sim_run(&sim, 5000000);
+    }
+    return ok && sim.i_min_ahead_us > 0;
+}
+
+static const test_case_t tests[] = {
+    { "rate change", test_rate_change },
+    { "set time", test_set_time },
+    { "rates", test_rates },
+    { "rate steps", test_rate_steps },
+};
+
+int main(int argc, char *argv[]) {
+    return run_tests(tests, TEST_COUNT(tests));
+}
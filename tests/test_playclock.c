@@ -0,0 +1,153 @@
+/*****************************************************************************
+ * Copyright (C) 2015 Jonas Lundqvist
+ *
+ * Author: Jonas Lundqvist <jonas@gannon.se>
+ *
+ * This file is part of vlc-spotify.
+ *
+ * vlc-spotify is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "playclock.h"
+#include "testrunner.h"
+
+#define PUBLISHES 2000000
+#define READERS 2
+
+static playclock_t *p_clock;
+static atomic_bool  done;
+
+// Every field follows from i, so a torn read is one where they disagree
+static void snapshot_of(int64_t i, playclock_snapshot_t *p_snapshot)
+{
+    p_snapshot->i_pts = i;
+    p_snapshot->i_start = -i;
+    p_snapshot->i_rate = (int) (i % 4000);
+    p_snapshot->i_offset = 2 * i;
+    p_snapshot->i_duration = 3 * i;
+    p_snapshot->i_track_start = 4 * i;
+    p_snapshot->b_paused = i & 1;
+}
+
+static int consistent(const playclock_snapshot_t *p_snapshot)
+{
+    playclock_snapshot_t expected;
+
+    snapshot_of(p_snapshot->i_pts, &expected);
+    return p_snapshot->i_start == expected.i_start &&
+           p_snapshot->i_rate == expected.i_rate &&
+           p_snapshot->i_offset == expected.i_offset &&
+           p_snapshot->i_duration == expected.i_duration &&
+           p_snapshot->i_track_start == expected.i_track_start &&
+           p_snapshot->b_paused == expected.b_paused;
+}
+
+static int test_initial(void)
+{
+    playclock_snapshot_t snapshot;
+    int                  ok;
+
+    p_clock = playclock_new();
+    if (p_clock == NULL)
+        return 0;
+
+    playclock_read(p_clock, &snapshot);
+    ok = snapshot.i_pts == 0 && consistent(&snapshot);
+    playclock_delete(p_clock);
+    return ok;
+}
+
+static int test_publish(void)
+{
+    playclock_snapshot_t snapshot;
+    int                  ok;
+
+    p_clock = playclock_new();
+    if (p_clock == NULL)
+        return 0;
+
+    snapshot_of(12345, &snapshot);
+    playclock_publish(p_clock, &snapshot);
+    snapshot_of(0, &snapshot);
+    playclock_read(p_clock, &snapshot);
+    ok = snapshot.i_pts == 12345 && consistent(&snapshot);
+    playclock_delete(p_clock);
+    return ok;
+}
+
+static void *reader_thread(void *data)
+{
+    playclock_snapshot_t snapshot;
+    int64_t              i_last = 0;
+    long                 i_bad = 0;
+    (void) data;
+
+    while (!atomic_load(&done)) {
+        playclock_read(p_clock, &snapshot);
+        // Consistent, and never older than what was already seen
+        if (!consistent(&snapshot) || snapshot.i_pts < i_last)
+            i_bad++;
+        i_last = snapshot.i_pts;
+    }
+    return (void *) i_bad;
+}
+
+// Readers polling all the time while the writer publishes
+static int test_concurrent(void)
+{
+    pthread_t            readers[READERS];
+    playclock_snapshot_t snapshot;
+    int                  ok = 1;
+
+    p_clock = playclock_new();
+    if (p_clock == NULL)
+        return 0;
+
+    atomic_store(&done, false);
+    for (int i = 0; i < READERS; i++)
+        pthread_create(&readers[i], NULL, reader_thread, NULL);
+
+    for (int64_t i = 1; i <= PUBLISHES; i++) {
+        snapshot_of(i, &snapshot);
+        playclock_publish(p_clock, &snapshot);
+    }
+
+    atomic_store(&done, true);
+    for (int i = 0; i < READERS; i++) {
+        void *bad;
+        pthread_join(readers[i], &bad);
+        ok = ok && bad == NULL;
+    }
+
+    playclock_read(p_clock, &snapshot);
+    ok = ok && snapshot.i_pts == PUBLISHES;
+    playclock_delete(p_clock);
+    return ok;
+}
+
+static const test_case_t tests[] = {
+    { "initial", test_initial },
+    { "publish", test_publish },
+    { "concurrent", test_concurrent },
+};
+
+int main(int argc, char *argv[]) {
+    return run_tests(tests, TEST_COUNT(tests));
+}
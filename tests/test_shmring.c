@@ -0,0 +1,222 @@
+/*****************************************************************************
+ * Copyright (C) 2015 Jonas Lundqvist
+ *
+ * Author: Jonas Lundqvist <jonas@gannon.se>
+ *
+ * This file is part of vlc-spotify.
+ *
+ * vlc-spotify is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "shmring.h"
+#include "testrunner.h"
+
+#define STRESS_BYTES (64 * 1024 * 1024)
+
+static char ring_name[64];
+
+static int test_format(void)
+{
+    shmring_t *p_reader = shmring_create(ring_name, 4096);
+    shmring_t *p_writer = shmring_open(ring_name);
+    unsigned   i_rate = 0, i_channels = 0;
+    int        ok;
+
+    shmring_unlink(ring_name);
+    if (p_reader == NULL || p_writer == NULL)
+        return 0;
+
+    ok = !shmring_get_format(p_reader, &i_rate, &i_channels);
+    shmring_set_format(p_writer, 44100, 2);
+    ok = ok && shmring_get_format(p_reader, &i_rate, &i_channels) &&
+         i_rate == 44100 && i_channels == 2;
+
+    shmring_close(p_writer);
+    shmring_close(p_reader);
+    return ok;
+}
+
+static int test_open_missing(void)
+{
+    return shmring_open("/vlc-spotify-test-does-not-exist") == NULL;
+}
+
+// Fill, check that a full ring refuses, then read it back across the wrap
+static int test_wrap(void)
+{
+    shmring_t  *p_reader = shmring_create(ring_name, 4096);
+    shmring_t  *p_writer = shmring_open(ring_name);
+    uint8_t     chunk[1000];
+    const void *p_data;
+    size_t      i_size;
+    size_t      i_capacity;
+    unsigned    i_next = 0;
+    int         ok = 1;
+
+    shmring_unlink(ring_name);
+    if (p_reader == NULL || p_writer == NULL)
+        return 0;
+
+    // Some bytes first, so that the writes wrap around the end
+    for (int i = 0; i < 3; i++) {
+        memset(chunk, i, sizeof(chunk));
+        ok &= shmring_write(p_writer, chunk, sizeof(chunk));
+    }
+    shmring_peek(p_reader, &p_data);
+    shmring_consume(p_reader, 3 * sizeof(chunk));
+    i_next = 3;
+
+    for (i_capacity = 0; ; i_capacity += sizeof(chunk)) {
+        memset(chunk, i_next & 0xff, sizeof(chunk));
+        if (!shmring_write(p_writer, chunk, sizeof(chunk)))
+            break;
+        i_next++;
+    }
+    ok &= i_capacity > 0;
+
+    // Whatever is readable is contiguous, so it may take two peeks
+    for (size_t i_read = 0; i_read < i_capacity; ) {
+        i_size = shmring_peek(p_reader, &p_data);
+        if (i_size == 0)
+            return 0;
+        for (size_t i = 0; i < i_size; i++)
+            ok &= ((const uint8_t *) p_data)[i] == (((i_read + i) / sizeof(chunk) + 3) & 0xff);
+        shmring_consume(p_reader, i_size);
+        i_read += i_size;
+    }
+    ok &= shmring_peek(p_reader, &p_data) == 0;
+
+    shmring_close(p_writer);
+    shmring_close(p_reader);
+    return ok;
+}
+
+static int test_discard_and_flags(void)
+{
+    shmring_t  *p_reader = shmring_create(ring_name, 4096);
+    shmring_t  *p_writer = shmring_open(ring_name);
+    uint8_t     chunk[100] = { 0 };
+    const void *p_data;
+    uint64_t    i_head;
+    int         ok = 1;
+
+    shmring_unlink(ring_name);
+    if (p_reader == NULL || p_writer == NULL)
+        return 0;
+
+    ok &= shmring_write(p_writer, chunk, sizeof(chunk));
+    i_head = shmring_head(p_writer);
+    memset(chunk, 1, sizeof(chunk));
+    ok &= shmring_write(p_writer, chunk, sizeof(chunk));
+
+    shmring_discard(p_reader, i_head);
+    ok &= shmring_peek(p_reader, &p_data) == sizeof(chunk);
+    ok &= ((const uint8_t *) p_data)[0] == 1;
+
+    // Never past what is written
+    shmring_discard(p_reader, i_head + 10 * sizeof(chunk));
+    ok &= shmring_peek(p_reader, &p_data) == 0;
+
+    ok &= shmring_flags(p_reader) == 0;
+    shmring_set_flags(p_writer, SHMRING_EOS);
+    shmring_set_flags(p_writer, SHMRING_STOPPED);
+    ok &= shmring_flags(p_reader) == (SHMRING_EOS | SHMRING_STOPPED);
+
+    shmring_close(p_writer);
+    shmring_close(p_reader);
+    return ok;
+}
+
+static void *stress_writer(void *data)
+{
+    shmring_t *p_writer = data;
+    uint32_t   words[333];
+    uint32_t   i_next = 0;
+
+    for (size_t i_written = 0; i_written < STRESS_BYTES; i_written += sizeof(words)) {
+        for (size_t i = 0; i < sizeof(words) / sizeof(*words); i++)
+            words[i] = i_next++;
+        while (!shmring_write(p_writer, words, sizeof(words)))
+            sched_yield();
+    }
+    shmring_set_flags(p_writer, SHMRING_EOS);
+    return NULL;
+}
+
+// One thread writes a counter, the other checks that it reads every value
+static int test_stress(void)
+{
+    shmring_t  *p_reader = shmring_create(ring_name, 64 * 1024);
+    shmring_t  *p_writer = shmring_open(ring_name);
+    pthread_t   thread;
+    uint32_t    i_expected = 0;
+    size_t      i_read = 0;
+    int         ok = 1;
+
+    shmring_unlink(ring_name);
+    if (p_reader == NULL || p_writer == NULL)
+        return 0;
+
+    if (pthread_create(&thread, NULL, stress_writer, p_writer))
+        return 0;
+
+    for (;;) {
+        unsigned    i_flags = shmring_flags(p_reader);
+        const void *p_data;
+        size_t      i_size = shmring_peek(p_reader, &p_data);
+
+        // Whole words, the writer writes whole blocks of them
+        i_size -= i_size % sizeof(uint32_t);
+        if (i_size == 0) {
+            if (i_flags & SHMRING_EOS)
+                break;
+            sched_yield();
+            continue;
+        }
+
+        for (size_t i = 0; i < i_size / sizeof(uint32_t); i++)
+            ok &= ((const uint32_t *) p_data)[i] == i_expected++;
+        shmring_consume(p_reader, i_size);
+        i_read += i_size;
+    }
+    pthread_join(thread, NULL);
+
+    ok &= i_read == (STRESS_BYTES + 1331) / 1332 * 1332;
+
+    shmring_close(p_writer);
+    shmring_close(p_reader);
+    return ok;
+}
+
+static const test_case_t tests[] = {
+    { "format", test_format },
+    { "open missing", test_open_missing },
+    { "wrap around", test_wrap },
+    { "discard and flags", test_discard_and_flags },
+    { "two threads", test_stress },
+};
+
+int main(int argc, char *argv[]) {
+    snprintf(ring_name, sizeof(ring_name), "/vlc-spotify-test-%d", (int) getpid());
+
+    return run_tests(tests, TEST_COUNT(tests));
+}
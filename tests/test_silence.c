@@ -0,0 +1,149 @@
+/*****************************************************************************
+ * Copyright (C) 2015 Jonas Lundqvist
+ *
+ * Author: Jonas Lundqvist <jonas@gannon.se>
+ *
+ * This file is part of vlc-spotify.
+ *
+ * vlc-spotify is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "silence.h"
+#include "testrunner.h"
+
+#define MAX_SAMPLES 300
+
+// One sample at a time, what the kernel has to agree with
+static void reference(const int16_t *p_src, size_t i_samples, int i_level,
+                      silence_span_t *p_span)
+{
+    p_span->b_sound = false;
+    p_span->i_first = p_span->i_end = 0;
+    for (size_t i = 0; i < i_samples; i++) {
+        if (abs(p_src[i]) > i_level) {
+            if (!p_span->b_sound)
+                p_span->i_first = i;
+            p_span->b_sound = true;
+            p_span->i_end = i + 1;
+        }
+    }
+}
+
+static int same_span(const silence_span_t *p_a, const silence_span_t *p_b)
+{
+    return p_a->b_sound == p_b->b_sound && p_a->i_first == p_b->i_first &&
+           p_a->i_end == p_b->i_end;
+}
+
+// Both calls, against the reference
+static int check(const int16_t *p_src, size_t i_samples, int i_level)
+{
+    int16_t dst[MAX_SAMPLES + 1];
+    silence_span_t expected, scanned, copied;
+
+    reference(p_src, i_samples, i_level, &expected);
+    silence_scan(p_src, i_samples, i_level, &scanned);
+    // With a guard after the end
+    dst[i_samples] = 0x5a5a;
+    silence_copy(dst, p_src, i_samples, i_level, &copied);
+
+    return same_span(&expected, &scanned) && same_span(&expected, &copied) &&
+           memcmp(dst, p_src, i_samples * sizeof(*p_src)) == 0 &&
+           dst[i_samples] == 0x5a5a;
+}
+
+static int test_silent(void)
+{
+    int16_t buf[MAX_SAMPLES];
+    silence_span_t span;
+
+    for (int i = 0; i < MAX_SAMPLES; i++)
+        buf[i] = (i % 2) ? 32 : -32;
+    silence_scan(buf, MAX_SAMPLES, 32, &span);
+    return !span.b_sound && check(buf, MAX_SAMPLES, 32) && check(buf, 0, 32);
+}
+
+// One loud sample at every position of every length, so that each lane
+// and the tail are covered
+static int test_single(void)
+{
+    int16_t buf[MAX_SAMPLES];
+
+    for (size_t n = 1; n <= 40; n++) {
+        for (size_t i = 0; i < n; i++) {
+            memset(buf, 0, sizeof(buf));
+            buf[i] = (i % 2) ? 100 : -100;
+            if (!check(buf, n, 99) || !check(buf, n, 100))
+                return 0;
+        }
+    }
+    return 1;
+}
+
+// Right at the level, and the one sample with no positive counterpart
+static int test_limits(void)
+{
+    int16_t buf[16] = { 0 };
+    silence_span_t span;
+
+    buf[3] = 1000;
+    buf[12] = -1000;
+    silence_scan(buf, 16, 1000, &span);
+    if (span.b_sound)
+        return 0;
+    buf[5] = -32768;
+    silence_scan(buf, 16, 32767, &span);
+    if (!span.b_sound || span.i_first != 5 || span.i_end != 6)
+        return 0;
+    buf[9] = 1;
+    silence_scan(buf, 16, 0, &span);
+    return span.b_sound && span.i_first == 3 && span.i_end == 13 &&
+           check(buf, 16, 0) && check(buf, 16, 32767);
+}
+
+static int test_random(void)
+{
+    int16_t buf[MAX_SAMPLES + 1];
+
+    srand(44100);
+    for (int round = 0; round < 20000; round++) {
+        size_t i_samples = rand() % MAX_SAMPLES;
+        int    i_level = rand() % 2 ? rand() % 64 : rand() % 32768;
+        // Mostly quiet, so that the spans are not always the whole buffer
+        int    i_range = rand() % 4 ? 2 * i_level + 1 : 65536;
+        size_t i_offset = rand() % 2;
+
+        for (size_t i = 0; i < i_samples + i_offset; i++)
+            buf[i] = (int16_t) (rand() % i_range - i_range / 2);
+        if (!check(buf + i_offset, i_samples, i_level))
+            return 0;
+    }
+    return 1;
+}
+
+static const test_case_t tests[] = {
+    { "silent", test_silent },
+    { "single", test_single },
+    { "limits", test_limits },
+    { "random", test_random },
+};
+
+int main(int argc, char *argv[]) {
+    return run_tests(tests, TEST_COUNT(tests));
+}
@@ -0,0 +1,272 @@
+/*****************************************************************************
+ * Copyright (C) 2015 Jonas Lundqvist
+ *
+ * Author: Jonas Lundqvist <jonas@gannon.se>
+ *
+ * This file is part of vlc-spotify.
+ *
+ * vlc-spotify is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+// Runs vlc-spotifyd, built with the libspotify stand-in, and talks to it
+// the way the plugin does.
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "fake_libspotify.h"
+#include "remote.h"
+#include "shmring.h"
+#include "testrunner.h"
+
+#define TRACK_URI "spotify:track:6wNTqBF2Y69KG9EPyj9YJD"
+#define TRACK_FRAMES (FAKE_TRACK_MS * 44100 / 1000)
+
+static char socket_path[128];
+static char ring_name[64];
+
+static remote_t *connect_daemon(void)
+{
+    // Give it some time to start
+    for (int i = 0; i < 200; i++) {
+        remote_t *p_remote = remote_connect(socket_path);
+        if (p_remote != NULL)
+            return p_remote;
+        usleep(10000);
+    }
+    return NULL;
+}
+
+static shmring_t *play(remote_t *p_remote, int *pi_duration_ms)
+{
+    static int i_rings;
+    shmring_t *p_ring;
+
+    snprintf(ring_name, sizeof(ring_name), "/vlc-spotify-test-%d-%d", (int) getpid(), i_rings++);
+    p_ring = shmring_create(ring_name, 64 * 1024);
+    if (p_ring == NULL)
+        return NULL;
+
+    if (remote_play(p_remote, TRACK_URI, ring_name, pi_duration_ms)) {
+        shmring_unlink(ring_name);
+        shmring_close(p_ring);
+        return NULL;
+    }
+    shmring_unlink(ring_name);
+    return p_ring;
+}
+
+static int test_meta(void)
+{
+    remote_t      *p_remote = connect_daemon();
+    remote_meta_t  meta;
+    int            ok;
+
+    if (p_remote == NULL || remote_meta(p_remote, TRACK_URI, &meta))
+        return 0;
+
+    ok = meta.i_duration_ms == FAKE_TRACK_MS &&
+         meta.psz_title && !strcmp(meta.psz_title, FAKE_TRACK_NAME) &&
+         meta.psz_artist && !strcmp(meta.psz_artist, FAKE_ARTIST_NAME) &&
+         meta.psz_album && !strcmp(meta.psz_album, FAKE_ALBUM_NAME);
+
+    remote_meta_clean(&meta);
+    remote_close(p_remote);
+    return ok;
+}
+
+static int test_not_a_track(void)
+{
+    remote_t      *p_remote = connect_daemon();
+    remote_meta_t  meta;
+    int            ok;
+
+    if (p_remote == NULL)
+        return 0;
+
+    ok = remote_meta(p_remote, "spotify:album:2mCuMNdJkoyiXFhsQCLLqw", &meta) != 0 &&
+         strlen(remote_error(p_remote)) > 0;
+
+    remote_close(p_remote);
+    return ok;
+}
+
+// Refused at once with the reason, the player is not touched
+static int test_unavailable(void)
+{
+    remote_t  *p_remote = connect_daemon();
+    shmring_t *p_ring;
+    int        i_duration_ms;
+    int        ok;
+
+    if (p_remote == NULL)
+        return 0;
+
+    snprintf(ring_name, sizeof(ring_name), "/vlc-spotify-test-%d-u", (int) getpid());
+    p_ring = shmring_create(ring_name, 64 * 1024);
+    if (p_ring == NULL) {
+        remote_close(p_remote);
+        return 0;
+    }
+
+    ok = remote_play(p_remote, FAKE_UNAVAILABLE_URI, ring_name, &i_duration_ms) != 0 &&
+         strstr(remote_error(p_remote), "country") != NULL;
+
+    shmring_unlink(ring_name);
+    shmring_close(p_ring);
+    remote_close(p_remote);
+    return ok;
+}
+
+// All of the track, in order, then the end of it
+static int test_play(void)
+{
+    remote_t   *p_remote = connect_daemon();
+    shmring_t  *p_ring;
+    unsigned    i_rate, i_channels;
+    int         i_duration_ms = 0;
+    int         i_frames = 0;
+    int         ok = 1;
+
+    if (p_remote == NULL || (p_ring = play(p_remote, &i_duration_ms)) == NULL)
+        return 0;
+    ok &= i_duration_ms == FAKE_TRACK_MS;
+
+    for (int i_idle = 0; i_idle < 500; ) {
+        unsigned       i_flags = shmring_flags(p_ring);
+        const void    *p_data;
+        size_t         i_size = shmring_peek(p_ring, &p_data);
+        const int16_t *p_samples = p_data;
+
+        if (i_size == 0) {
+            if (i_flags & SHMRING_EOS)
+                break;
+            usleep(10000);
+            i_idle++;
+            continue;
+        }
+
+        for (size_t i = 0; i < i_size / 4; i++, i_frames++)
+            ok &= p_samples[2 * i] == (i_frames & 0x7fff) &&
+                  p_samples[2 * i + 1] == (i_frames & 0x7fff);
+        shmring_consume(p_ring, i_size);
+    }
+
+    ok &= shmring_get_format(p_ring, &i_rate, &i_channels) &&
+          i_rate == 44100 && i_channels == 2;
+    ok &= i_frames == TRACK_FRAMES;
+    ok &= remote_stop(p_remote) == 0;
+
+    shmring_close(p_ring);
+    remote_close(p_remote);
+    return ok;
+}
+
+// Seeking discards what is in the ring and goes on from the new position
+static int test_seek(void)
+{
+    remote_t   *p_remote = connect_daemon();
+    shmring_t  *p_ring;
+    uint64_t    i_head;
+    int         i_duration_ms;
+    const void *p_data;
+    int         ok = 1;
+
+    if (p_remote == NULL || (p_ring = play(p_remote, &i_duration_ms)) == NULL)
+        return 0;
+
+    ok &= remote_pause(p_remote, true) == 0;
+    // A delivery that was under way when pausing may still land in the
+    // ring, let it
+    usleep(50000);
+    ok &= remote_seek(p_remote, 400, &i_head) == 0;
+    shmring_discard(p_ring, i_head);
+    ok &= remote_pause(p_remote, false) == 0;
+
+    for (int i = 0; i < 500 && shmring_peek(p_ring, &p_data) == 0; i++)
+        usleep(10000);
+    ok &= shmring_peek(p_ring, &p_data) > 0 &&
+          ((const int16_t *) p_data)[0] == ((400 * 44100 / 1000) & 0x7fff);
+
+    shmring_close(p_ring);
+    remote_close(p_remote);
+    return ok;
+}
+
+// The last client to ask gets the player, the other one is told to stop
+static int test_take_over(void)
+{
+    remote_t   *p_first = connect_daemon();
+    remote_t   *p_second = connect_daemon();
+    shmring_t  *p_first_ring, *p_second_ring;
+    int         i_duration_ms;
+    int         ok = 1;
+
+    if (p_first == NULL || p_second == NULL ||
+        (p_first_ring = play(p_first, &i_duration_ms)) == NULL ||
+        (p_second_ring = play(p_second, &i_duration_ms)) == NULL)
+        return 0;
+
+    ok &= (shmring_flags(p_first_ring) & SHMRING_STOPPED) != 0;
+    ok &= (shmring_flags(p_second_ring) & SHMRING_STOPPED) == 0;
+    ok &= remote_pause(p_first, true) != 0;
+    ok &= remote_pause(p_second, true) == 0;
+
+    shmring_close(p_first_ring);
+    shmring_close(p_second_ring);
+    remote_close(p_first);
+    remote_close(p_second);
+    return ok;
+}
+
+static const test_case_t tests[] = {
+    { "meta", test_meta },
+    { "not a track", test_not_a_track },
+    { "unavailable", test_unavailable },
+    { "play", test_play },
+    { "seek", test_seek },
+    { "take over", test_take_over },
+};
+
+int main(int argc, char *argv[]) {
+    int   num_tests = TEST_COUNT(tests);
+    int   total_pass;
+    int   status = -1;
+    pid_t pid;
+
+    snprintf(socket_path, sizeof(socket_path), "/tmp/test_spotifyd-%d.sock", (int) getpid());
+
+    pid = fork();
+    if (pid == 0) {
+        setenv("SPOTIFY_PASSWORD", "password", 1);
+        execl("./vlc-spotifyd-fake", "vlc-spotifyd-fake", "-s", socket_path,
+              "-u", "user", "-c", "/tmp", "-S", "/tmp", (char *) NULL);
+        _exit(127);
+    }
+
+    total_pass = test_cases(tests, num_tests);
+
+    // It should shut down cleanly as well
+    kill(pid, SIGTERM);
+    waitpid(pid, &status, 0);
+    total_pass += test_verdict(num_tests, "exit", WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    num_tests++;
+
+    return test_summary(total_pass, num_tests);
+}
@@ -0,0 +1,137 @@
+/*****************************************************************************
+ * Copyright (C) 2015 Jonas Lundqvist
+ *
+ * Author: Jonas Lundqvist <jonas@gannon.se>
+ *
+ * This file is part of vlc-spotify.
+ *
+ * vlc-spotify is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "startlog.h"
+#include "testrunner.h"
+
+#define OPEN_AT 1000000
+
+static int test_first_mark(void)
+{
+    startlog_t log;
+
+    startlog_begin(&log, OPEN_AT);
+    return startlog_mark(&log, STARTLOG_LOGGED_IN, OPEN_AT + 5000) &&
+           !startlog_mark(&log, STARTLOG_LOGGED_IN, OPEN_AT + 9000) &&
+           log.pi_time[STARTLOG_LOGGED_IN] == OPEN_AT + 5000 &&
+           !startlog_reached(&log, STARTLOG_PLAYER_LOAD);
+}
+
+// The session phases of a session that was running before the open
+static int test_reused_session(void)
+{
+    startlog_t log;
+    char       psz[512];
+
+    startlog_begin(&log, OPEN_AT);
+    startlog_mark_at(&log, STARTLOG_SESSION_CREATE, OPEN_AT - 1);
+    startlog_mark_at(&log, STARTLOG_LOGGED_IN, OPEN_AT - 1);
+    startlog_mark(&log, STARTLOG_METADATA_UPDATED, OPEN_AT + 2000);
+    startlog_format(&log, "ok", NULL, psz, sizeof(psz));
+
+    return !startlog_reached(&log, STARTLOG_SESSION_CREATE) &&
+           !strcmp(psz, "startup result=ok session=reused total_ms=2.0 metadata_updated_ms=2.0");
+}
+
+static int test_format(void)
+{
+    static const char expected[] =
+        "startup result=ok session=new total_ms=812.3 session_create_ms=1.2 "
+        "thread_spawn_ms=1.3 login_ms=1.4 logged_in_ms=540.0 metadata_updated_ms=610.0 "
+        "player_load_ms=611.5 music_delivery_ms=790.0 es_out_send_ms=812.3 "
+        "uri=spotify:track:abc";
+    static const int64_t offsets[STARTLOG_PHASES] = {
+        0, 1200, 1300, 1400, 540000, 610000, 611500, 790000, 812345,
+    };
+    startlog_t log;
+    char       psz[512];
+    char       psz_short[16];
+    int        i_len;
+
+    startlog_begin(&log, OPEN_AT);
+    for (int i = STARTLOG_OPEN + 1; i < STARTLOG_PHASES; i++)
+        startlog_mark(&log, i, OPEN_AT + offsets[i]);
+
+    i_len = startlog_format(&log, "ok", "spotify:track:abc", psz, sizeof(psz));
+    // Truncated like snprintf()
+    return i_len == (int) strlen(expected) && !strcmp(psz, expected) &&
+           startlog_format(&log, "ok", "spotify:track:abc", psz_short, sizeof(psz_short)) == i_len &&
+           !strncmp(psz_short, expected, sizeof(psz_short) - 1);
+}
+
+static int test_percentiles(void)
+{
+    startlog_stats_t *p_stats = startlog_stats_new();
+    startlog_t        log;
+    char              psz[512];
+    int               ok;
+
+    if (p_stats == NULL)
+        return 0;
+
+    // 1..100 ms to logged_in, only the even ones get to the player load
+    for (int i = 1; i <= 100; i++) {
+        startlog_begin(&log, OPEN_AT);
+        startlog_mark(&log, STARTLOG_LOGGED_IN, OPEN_AT + i * 1000);
+        if (i % 2 == 0)
+            startlog_mark(&log, STARTLOG_PLAYER_LOAD, OPEN_AT + i * 1000);
+        startlog_stats_add(p_stats, &log);
+    }
+    startlog_stats_format(p_stats, psz, sizeof(psz));
+
+    ok = startlog_stats_count(p_stats) == 100 &&
+         startlog_stats_percentile(p_stats, STARTLOG_LOGGED_IN, 50) == 50000 &&
+         startlog_stats_percentile(p_stats, STARTLOG_LOGGED_IN, 99) == 99000 &&
+         startlog_stats_percentile(p_stats, STARTLOG_LOGGED_IN, 100) == 100000 &&
+         startlog_stats_percentile(p_stats, STARTLOG_PLAYER_LOAD, 50) == 50000 &&
+         startlog_stats_percentile(p_stats, STARTLOG_ES_OUT_SEND, 50) == -1 &&
+         !strcmp(psz, "startup percentiles n=100 logged_in_ms=p50:50.0,p90:90.0,p99:99.0 "
+                      "player_load_ms=p50:50.0,p90:90.0,p99:100.0");
+
+    // Only the last STARTLOG_STATS_SIZE are kept
+    for (int i = 0; i < STARTLOG_STATS_SIZE; i++) {
+        startlog_begin(&log, OPEN_AT);
+        startlog_mark(&log, STARTLOG_LOGGED_IN, OPEN_AT + 7000);
+        startlog_stats_add(p_stats, &log);
+    }
+    ok = ok && startlog_stats_count(p_stats) == STARTLOG_STATS_SIZE &&
+         startlog_stats_percentile(p_stats, STARTLOG_LOGGED_IN, 100) == 7000 &&
+         startlog_stats_percentile(p_stats, STARTLOG_PLAYER_LOAD, 50) == -1;
+
+    startlog_stats_delete(p_stats);
+    return ok;
+}
+
+static const test_case_t tests[] = {
+    { "first mark", test_first_mark },
+    { "reused session", test_reused_session },
+    { "format", test_format },
+    { "percentiles", test_percentiles },
+};
+
+int main(int argc, char *argv[]) {
+    return run_tests(tests, TEST_COUNT(tests));
+}
@@ -38,7 +38,19 @@ const char *test_vector_in[] = {
     "open.spotify.com/track/6WoNBlwgSRD3CEeOlrQSXq",
     "open.spotify.com/track/BlwgSRD3CEeOlrQSXq", // Short id
     "open.spotify.com/trac/6WoNBlwgSRD3CEeOlrQSXq", // incorrect 'trac'
-    "open.spotify.com/trac/6WoNBlwgSRD3CEeOlrQSXq1" // incorrect 'trac' but too long id. Total length OK.
+    "open.spotify.com/trac/6WoNBlwgSRD3CEeOlrQSXq1", // incorrect 'trac' but too long id. Total length OK.
+    "spotify:search:daft+punk",
+    "open.spotify.com/search/abba",
+    "spotify:search:",                       // Empty query
+    "spotify:search:artist%3Aabba+year%3A1976-1980", // Longer than any id
+    "spotify:user:jonas:playlist:2mCuMNdJkoyiXFhsQCLLqw",
+    "open.spotify.com/user/jonas/playlist/2mCuMNdJkoyiXFhsQCLLqw",
+    "spotify:user:jonas:starred",
+    "spotify:user::playlist:2mCuMNdJkoyiXFhsQCLLqw", // No user
+    "spotify:user:jonas:playlist:2mCuMNdJkoyiXFhsQCLL", // Short id
+    "spotify:user:jonas",                    // Nothing of the user
+    "spotify:folder:00000000deadbeef",
+    "spotify:folder:deadbeef",               // Short id
 };
 
 const char *test_vector_out[] = {
@@ -53,7 +65,19 @@ const char *test_vector_out[] = {
     "spotify:track:6WoNBlwgSRD3CEeOlrQSXq",
     "",
     "",
-    ""
+    "",
+    "spotify:search:daft+punk",
+    "spotify:search:abba",
+    "",
+    "spotify:search:artist%3Aabba+year%3A1976-1980",
+    "spotify:user:jonas:playlist:2mCuMNdJkoyiXFhsQCLLqw",
+    "spotify:user:jonas:playlist:2mCuMNdJkoyiXFhsQCLLqw",
+    "spotify:user:jonas:starred",
+    "",
+    "",
+    "",
+    "spotify:folder:00000000deadbeef",
+    "",
 };
 
 const spotify_type_e test_result[] = {
@@ -69,10 +93,37 @@ const spotify_type_e test_result[] = {
     SPOTIFY_UNKNOWN,
     SPOTIFY_UNKNOWN,
     SPOTIFY_UNKNOWN,
+    SPOTIFY_SEARCH,
+    SPOTIFY_SEARCH,
+    SPOTIFY_UNKNOWN,
+    SPOTIFY_SEARCH,
+    SPOTIFY_PLAYLIST,
+    SPOTIFY_PLAYLIST,
+    SPOTIFY_PLAYLIST,
+    SPOTIFY_UNKNOWN,
+    SPOTIFY_UNKNOWN,
+    SPOTIFY_UNKNOWN,
+    SPOTIFY_FOLDER,
+    SPOTIFY_UNKNOWN,
+};
+
+const char *query_vector_in[] = {
+    "spotify:search:daft+punk",
+    "spotify:search:artist%3Aabba+year%3A1976-1980",
+    "spotify:search:100%",                   // Stray '%' is kept
+    "spotify:track:6wNTqBF2Y69KG9EPyj9YJD",  // Not a search
+};
+
+const char *query_vector_out[] = {
+    "daft punk",
+    "artist:abba year:1976-1980",
+    "100%",
+    NULL,
 };
 
 int main(int argc, char *argv[]) {
     int num_tests = sizeof(test_result) / sizeof(spotify_type_e);
+    int num_queries = sizeof(query_vector_in) / sizeof(char *);
     int i;
     spotify_type_e result;
     int total_pass = 0;
@@ -90,11 +141,26 @@ int main(int argc, char *argv[]) {
         free(out);
     }
 
-    if (total_pass == num_tests) {
-        printf("All PASS %d/%d\n", total_pass, num_tests);
+    for(i = 0; i < num_queries; i++) {
+        int verdict = 0;
+        char *query = ParseSearchQuery(query_vector_in[i]);
+
+        if ((query == NULL && query_vector_out[i] == NULL) ||
+            (query != NULL && query_vector_out[i] != NULL &&
+             strcmp(query_vector_out[i], query) == 0)) {
+            verdict = 1;
+            total_pass++;
+        }
+        printf("[#%d] query \"%s\" -> \"%s\": %s\n", num_tests + i, query_vector_in[i],
+               query ? query : "(null)", verdict ? "PASS":"FAIL");
+        free(query);
+    }
+
+    if (total_pass == num_tests + num_queries) {
+        printf("All PASS %d/%d\n", total_pass, num_tests + num_queries);
         return EXIT_SUCCESS;
     } else {
-        printf("%d of %d pass\n", total_pass, num_tests);
+        printf("%d of %d pass\n", total_pass, num_tests + num_queries);
         printf("Test FAILED\n");
         return EXIT_FAILURE;
     }
@@ -0,0 +1,76 @@
+/*****************************************************************************
+ * Copyright (C) 2015 Jonas Lundqvist
+ *
+ * Author: Jonas Lundqvist <jonas@gannon.se>
+ *
+ * This file is part of vlc-spotify.
+ *
+ * vlc-spotify is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+// The cases of a test program, run in order. A case returns 1 when it
+// passes.
+//
+// static const test_case_t tests[] = {
+//     { "format", test_format },
+// };
+//
+// int main(int argc, char *argv[]) {
+//     return run_tests(tests, TEST_COUNT(tests));
+// }
+
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef struct {
+    const char *psz_name;
+    int (*pf_test)(void);
+} test_case_t;
+
+#define TEST_COUNT(tests) ((int) (sizeof(tests) / sizeof(*(tests))))
+
+static inline int test_verdict(int i, const char *psz_name, int verdict)
+{
+    printf("[#%d] %s: %s\n", i, psz_name, verdict ? "PASS":"FAIL");
+    return verdict;
+}
+
+// How many of the cases pass
+static inline int test_cases(const test_case_t *p_tests, int num_tests)
+{
+    int total_pass = 0;
+
+    for (int i = 0; i < num_tests; i++)
+        total_pass += test_verdict(i, p_tests[i].psz_name, p_tests[i].pf_test());
+    return total_pass;
+}
+
+// The exit status of the program
+static inline int test_summary(int total_pass, int num_tests)
+{
+    if (total_pass == num_tests) {
+        printf("All PASS %d/%d\n", total_pass, num_tests);
+        return EXIT_SUCCESS;
+    } else {
+        printf("%d of %d pass\n", total_pass, num_tests);
+        printf("Test FAILED\n");
+        return EXIT_FAILURE;
+    }
+}
+
+static inline int run_tests(const test_case_t *p_tests, int num_tests)
+{
+    return test_summary(test_cases(p_tests, num_tests), num_tests);
+}
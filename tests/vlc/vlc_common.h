@@ -0,0 +1,72 @@
+/*****************************************************************************
+ * Copyright (C) 2015 Jonas Lundqvist
+ *
+ * Author: Jonas Lundqvist <jonas@gannon.se>
+ *
+ * This file is part of vlc-spotify.
+ *
+ * vlc-spotify is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+// Stand-in for the VLC headers that session.c and the headers it includes
+// need, so that it can be built into tests/stress_session.c without
+// libvlccore. Only that much, over pthread, see tests/vlc_stubs.c.
+
+#ifndef VLC_COMMON_H
+#define VLC_COMMON_H 1
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef int64_t mtime_t;
+#define CLOCK_FREQ INT64_C(1000000)
+
+typedef struct libvlc_int_t libvlc_int_t;
+typedef struct vlc_object_t vlc_object_t;
+struct vlc_object_t {
+    const char   *psz_object_type;
+    libvlc_int_t *p_libvlc;
+};
+#define VLC_OBJECT(x) ((vlc_object_t *)(x))
+
+typedef struct input_item_t input_item_t;
+
+#define VLC_SUCCESS 0
+#define VLC_EGENERIC (-1)
+#define VLC_ENOMEM (-2)
+
+#define VLC_UNUSED(x) (void)(x)
+#define likely(p)   __builtin_expect(!!(p), 1)
+#define unlikely(p) __builtin_expect(!!(p), 0)
+#define __MIN(a, b) (((a) < (b)) ? (a) : (b))
+#define __MAX(a, b) (((a) > (b)) ? (a) : (b))
+
+// Monotonic, in us
+mtime_t mdate(void);
+
+// Left to the program, which decides what the options are set to
+char *var_InheritString(vlc_object_t *p_obj, const char *psz_name);
+int64_t var_InheritInteger(vlc_object_t *p_obj, const char *psz_name);
+bool var_InheritBool(vlc_object_t *p_obj, const char *psz_name);
+
+#include "vlc_threads.h"
+#include "vlc_messages.h"
+
+#endif
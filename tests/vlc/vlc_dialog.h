@@ -0,0 +1,36 @@
+/*****************************************************************************
+ * Copyright (C) 2015 Jonas Lundqvist
+ *
+ * Author: Jonas Lundqvist <jonas@gannon.se>
+ *
+ * This file is part of vlc-spotify.
+ *
+ * vlc-spotify is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+// Stand-in for VLC's dialogs, left to the program like the options
+
+#ifndef VLC_DIALOG_H
+#define VLC_DIALOG_H 1
+
+#include "vlc_common.h"
+
+void dialog_Fatal(vlc_object_t *p_obj, const char *psz_title, const char *psz_format, ...)
+    __attribute__((format(printf, 3, 4)));
+void dialog_Login(vlc_object_t *p_obj, char **ppsz_username, char **ppsz_password,
+                  const char *psz_title, const char *psz_format, ...)
+    __attribute__((format(printf, 5, 6)));
+
+#endif
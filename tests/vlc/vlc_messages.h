@@ -0,0 +1,52 @@
+/*****************************************************************************
+ * Copyright (C) 2015 Jonas Lundqvist
+ *
+ * Author: Jonas Lundqvist <jonas@gannon.se>
+ *
+ * This file is part of vlc-spotify.
+ *
+ * vlc-spotify is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+// Stand-in for VLC's logging, see vlc_common.h. Printed to stderr up to
+// the level in the VLC_VERBOSE environment variable, as -v does in VLC:
+// 0 errors only (the default), 1 also warnings and info, 2 everything.
+
+#ifndef VLC_MESSAGES_H
+#define VLC_MESSAGES_H 1
+
+#include "vlc_common.h"
+
+enum vlc_log_type {
+    VLC_MSG_INFO = 0,
+    VLC_MSG_ERR,
+    VLC_MSG_WARN,
+    VLC_MSG_DBG,
+};
+
+void vlc_Log(vlc_object_t *p_obj, int i_type, const char *psz_module,
+             const char *psz_format, ...) __attribute__((format(printf, 4, 5)));
+
+#ifndef MODULE_STRING
+#define MODULE_STRING "stub"
+#endif
+
+#define msg_Generic(o, t, ...) vlc_Log(VLC_OBJECT(o), t, MODULE_STRING, __VA_ARGS__)
+#define msg_Info(o, ...) msg_Generic(o, VLC_MSG_INFO, __VA_ARGS__)
+#define msg_Err(o, ...)  msg_Generic(o, VLC_MSG_ERR, __VA_ARGS__)
+#define msg_Warn(o, ...) msg_Generic(o, VLC_MSG_WARN, __VA_ARGS__)
+#define msg_Dbg(o, ...)  msg_Generic(o, VLC_MSG_DBG, __VA_ARGS__)
+
+#endif
@@ -0,0 +1,58 @@
+/*****************************************************************************
+ * Copyright (C) 2015 Jonas Lundqvist
+ *
+ * Author: Jonas Lundqvist <jonas@gannon.se>
+ *
+ * This file is part of vlc-spotify.
+ *
+ * vlc-spotify is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+// Stand-in for VLC's thread API, see vlc_common.h
+
+#ifndef VLC_THREADS_H
+#define VLC_THREADS_H 1
+
+#include <pthread.h>
+
+#include "vlc_common.h"
+
+typedef pthread_mutex_t vlc_mutex_t;
+typedef pthread_cond_t  vlc_cond_t;
+typedef pthread_t       vlc_thread_t;
+
+#define VLC_STATIC_MUTEX PTHREAD_MUTEX_INITIALIZER
+#define VLC_STATIC_COND  PTHREAD_COND_INITIALIZER
+
+#define VLC_THREAD_PRIORITY_LOW 0
+#define VLC_THREAD_PRIORITY_INPUT 0
+
+void vlc_mutex_init(vlc_mutex_t *p_mutex);
+void vlc_mutex_destroy(vlc_mutex_t *p_mutex);
+void vlc_mutex_lock(vlc_mutex_t *p_mutex);
+void vlc_mutex_unlock(vlc_mutex_t *p_mutex);
+
+void vlc_cond_init(vlc_cond_t *p_cond);
+void vlc_cond_destroy(vlc_cond_t *p_cond);
+void vlc_cond_signal(vlc_cond_t *p_cond);
+void vlc_cond_broadcast(vlc_cond_t *p_cond);
+void vlc_cond_wait(vlc_cond_t *p_cond, vlc_mutex_t *p_mutex);
+// Until the mdate() deadline, non-zero once it has passed
+int vlc_cond_timedwait(vlc_cond_t *p_cond, vlc_mutex_t *p_mutex, mtime_t deadline);
+
+int vlc_clone(vlc_thread_t *p_thread, void *(*pf_entry)(void *), void *p_data, int i_priority);
+void vlc_join(vlc_thread_t thread, void **pp_result);
+
+#endif
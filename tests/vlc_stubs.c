@@ -0,0 +1,142 @@
+/*****************************************************************************
+ * Copyright (C) 2015 Jonas Lundqvist
+ *
+ * Author: Jonas Lundqvist <jonas@gannon.se>
+ *
+ * This file is part of vlc-spotify.
+ *
+ * vlc-spotify is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+// The VLC thread and message functions of the stand-in headers in vlc/,
+// for building session.c into a test
+
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+
+#include <vlc_common.h>
+#include <vlc_threads.h>
+#include <vlc_messages.h>
+
+mtime_t mdate(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (mtime_t) ts.tv_sec * CLOCK_FREQ + ts.tv_nsec / 1000;
+}
+
+void vlc_mutex_init(vlc_mutex_t *p_mutex)
+{
+    pthread_mutex_init(p_mutex, NULL);
+}
+
+void vlc_mutex_destroy(vlc_mutex_t *p_mutex)
+{
+    pthread_mutex_destroy(p_mutex);
+}
+
+void vlc_mutex_lock(vlc_mutex_t *p_mutex)
+{
+    pthread_mutex_lock(p_mutex);
+}
+
+void vlc_mutex_unlock(vlc_mutex_t *p_mutex)
+{
+    pthread_mutex_unlock(p_mutex);
+}
+
+void vlc_cond_init(vlc_cond_t *p_cond)
+{
+    pthread_cond_init(p_cond, NULL);
+}
+
+void vlc_cond_destroy(vlc_cond_t *p_cond)
+{
+    pthread_cond_destroy(p_cond);
+}
+
+void vlc_cond_signal(vlc_cond_t *p_cond)
+{
+    pthread_cond_signal(p_cond);
+}
+
+void vlc_cond_broadcast(vlc_cond_t *p_cond)
+{
+    pthread_cond_broadcast(p_cond);
+}
+
+void vlc_cond_wait(vlc_cond_t *p_cond, vlc_mutex_t *p_mutex)
+{
+    pthread_cond_wait(p_cond, p_mutex);
+}
+
+// VLC_STATIC_COND waits on the realtime clock, the deadline is on mdate()'s
+int vlc_cond_timedwait(vlc_cond_t *p_cond, vlc_mutex_t *p_mutex, mtime_t deadline)
+{
+    mtime_t         delay = deadline - mdate();
+    struct timespec ts;
+
+    if (delay < 0)
+        delay = 0;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += delay / CLOCK_FREQ;
+    ts.tv_nsec += (delay % CLOCK_FREQ) * 1000;
+    if (ts.tv_nsec >= 1000000000) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000;
+    }
+    return pthread_cond_timedwait(p_cond, p_mutex, &ts);
+}
+
+int vlc_clone(vlc_thread_t *p_thread, void *(*pf_entry)(void *), void *p_data, int i_priority)
+{
+    VLC_UNUSED(i_priority);
+    return pthread_create(p_thread, NULL, pf_entry, p_data);
+}
+
+void vlc_join(vlc_thread_t thread, void **pp_result)
+{
+    int i_ret = pthread_join(thread, pp_result);
+
+    // VLC aborts on this as well
+    if (i_ret != 0) {
+        fprintf(stderr, "vlc_join: %s\n", strerror(i_ret));
+        abort();
+    }
+}
+
+void vlc_Log(vlc_object_t *p_obj, int i_type, const char *psz_module,
+             const char *psz_format, ...)
+{
+    static const char * const types[] = { "", " error", " warning", " debug" };
+    static const int levels[] = { 1, 0, 1, 2 };
+    const char *psz_verbose = getenv("VLC_VERBOSE");
+    va_list     args;
+
+    VLC_UNUSED(p_obj);
+    if (levels[i_type] > (psz_verbose != NULL ? atoi(psz_verbose) : 0))
+        return;
+
+    // One line at a time from every thread
+    flockfile(stderr);
+    fprintf(stderr, "%s%s: ", psz_module, types[i_type]);
+    va_start(args, psz_format);
+    vfprintf(stderr, psz_format, args);
+    va_end(args);
+    fputc('\n', stderr);
+    funlockfile(stderr);
+}